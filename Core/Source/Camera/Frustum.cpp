@@ -0,0 +1,53 @@
+#include "Frustum.h"
+#include <glm/gtc/matrix_access.hpp>
+
+namespace SockEngine {
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+    // Gribb-Hartmann plane extraction
+    glm::vec4 row0 = glm::row(viewProjection, 0);
+    glm::vec4 row1 = glm::row(viewProjection, 1);
+    glm::vec4 row2 = glm::row(viewProjection, 2);
+    glm::vec4 row3 = glm::row(viewProjection, 3);
+
+    m_Planes[0] = row3 + row0; // Left
+    m_Planes[1] = row3 - row0; // Right
+    m_Planes[2] = row3 + row1; // Bottom
+    m_Planes[3] = row3 - row1; // Top
+    m_Planes[4] = row3 + row2; // Near
+    m_Planes[5] = row3 - row2; // Far
+
+    for (auto& plane : m_Planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) {
+            plane /= length;
+        }
+    }
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+{
+    for (const auto& plane : m_Planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::IntersectsAABB(const glm::vec3& min, const glm::vec3& max) const
+{
+    for (const auto& plane : m_Planes) {
+        // Test the corner furthest along the plane normal
+        glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x,
+                           plane.y >= 0.0f ? max.y : min.y,
+                           plane.z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,30 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+namespace SockEngine {
+
+// View frustum extracted from a view-projection matrix, used for visibility tests
+class Frustum
+{
+public:
+    Frustum() = default;
+
+    // Extracts the six clip planes from a view-projection matrix
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    // Returns true if the sphere is at least partially inside the frustum
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+
+    // Returns true if the axis-aligned box is at least partially inside the frustum
+    bool IntersectsAABB(const glm::vec3& min, const glm::vec3& max) const;
+
+private:
+    // Planes stored as (normal, distance), normals pointing inwards
+    glm::vec4 m_Planes[6] = {};
+};
+
+}
+
+#endif
@@ -0,0 +1,169 @@
+#include "BonePaletteBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace SockEngine {
+
+namespace {
+
+// Matrices per region before the first frame has been seen, about 16 characters
+constexpr size_t INITIAL_CAPACITY = 1024;
+
+}
+
+BonePaletteBuffer::BonePaletteBuffer()
+    : m_Persistent(GLAD_GL_VERSION_4_4 != 0)
+{
+}
+
+BonePaletteBuffer::~BonePaletteBuffer()
+{
+    Release();
+}
+
+void BonePaletteBuffer::Upload(const std::vector<Entity>& entities)
+{
+    m_Ranges.clear();
+    m_MatrixCount = 0;
+
+    // Lay out every palette first so the region only has to be sized once
+    m_Palettes.clear();
+    for (const auto& entity : entities) {
+        if (!entity.HasComponent<AnimatorComponent>()) {
+            continue;
+        }
+
+        const auto& palette = entity.GetComponent<AnimatorComponent>().GetBoneMatrices();
+        if (palette.empty()) {
+            continue;
+        }
+
+        Range& range = m_Ranges[entity];
+        range.offset = static_cast<int>(m_MatrixCount);
+        range.count = static_cast<int>(palette.size());
+        m_MatrixCount += palette.size();
+        m_Palettes.push_back(&palette);
+    }
+
+    if (m_MatrixCount == 0) {
+        return;
+    }
+
+    Reserve(m_MatrixCount);
+
+    size_t regionOffset = 0;
+    if (m_Persistent) {
+        // Write straight into the mapped region once the GPU is done with it
+        m_Region = (m_Region + 1) % REGION_COUNT;
+        WaitForRegion(m_Region);
+
+        regionOffset = m_Region * m_RegionStride;
+        glm::mat4* destination = m_MappedData + regionOffset / sizeof(glm::mat4);
+        for (const auto* palette : m_Palettes) {
+            std::memcpy(destination, palette->data(), palette->size() * sizeof(glm::mat4));
+            destination += palette->size();
+        }
+    } else {
+        // Single upload per frame, orphaning last frame's storage
+        m_Staging.clear();
+        for (const auto* palette : m_Palettes) {
+            m_Staging.insert(m_Staging.end(), palette->begin(), palette->end());
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_RegionCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_Staging.size() * sizeof(glm::mat4), m_Staging.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, m_Buffer, regionOffset, m_MatrixCount * sizeof(glm::mat4));
+}
+
+void BonePaletteBuffer::EndFrame()
+{
+    if (!m_Persistent || m_MatrixCount == 0) {
+        return;
+    }
+
+    if (m_Fences[m_Region]) {
+        glDeleteSync(m_Fences[m_Region]);
+    }
+    m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+BonePaletteBuffer::Range BonePaletteBuffer::GetRange(const Entity& entity) const
+{
+    auto it = m_Ranges.find(entity);
+    return it != m_Ranges.end() ? it->second : Range();
+}
+
+void BonePaletteBuffer::Reserve(size_t matrixCount)
+{
+    if (m_Buffer != 0 && matrixCount <= m_RegionCapacity) {
+        return;
+    }
+
+    // Grow geometrically so a growing crowd does not reallocate every frame. Commands already
+    // issued keep the old storage alive until they complete.
+    size_t capacity = std::max({ matrixCount, m_RegionCapacity * 2, INITIAL_CAPACITY });
+    Release();
+
+    m_RegionCapacity = capacity;
+    glGenBuffers(1, &m_Buffer);
+
+    if (!m_Persistent) {
+        return;
+    }
+
+    // Regions start on a binding offset boundary, and on a whole matrix for the mapped pointer
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    size_t regionAlignment = std::max<size_t>(alignment, sizeof(glm::mat4));
+    m_RegionStride = (capacity * sizeof(glm::mat4) + regionAlignment - 1) / regionAlignment * regionAlignment;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, m_RegionStride * REGION_COUNT, nullptr, flags);
+    m_MappedData = static_cast<glm::mat4*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_RegionStride * REGION_COUNT, flags));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void BonePaletteBuffer::Release()
+{
+    for (auto& fence : m_Fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if (m_Buffer != 0) {
+        if (m_MappedData) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffer);
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            m_MappedData = nullptr;
+        }
+        glDeleteBuffers(1, &m_Buffer);
+        m_Buffer = 0;
+    }
+    m_RegionCapacity = 0;
+}
+
+void BonePaletteBuffer::WaitForRegion(int region)
+{
+    GLsync fence = m_Fences[region];
+    if (!fence) {
+        return;
+    }
+
+    // Usually already signaled, the region was last written two frames ago
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+
+    glDeleteSync(fence);
+    m_Fences[region] = nullptr;
+}
+
+}
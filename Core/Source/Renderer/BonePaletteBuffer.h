@@ -0,0 +1,74 @@
+#ifndef BONE_PALETTE_BUFFER_H
+#define BONE_PALETTE_BUFFER_H
+
+#include "Scene/Entity.h"
+#include <vector>
+#include <unordered_map>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+namespace SockEngine {
+
+// Bone palettes of every animated entity, written once per frame into a ring of regions in one
+// persistently mapped shader storage buffer. Draws and the skinning pass index the bound region
+// by offset, so a palette is uploaded once no matter how many passes draw it.
+class BonePaletteBuffer {
+public:
+    // Binding point of the BoneMatrices block in the animated and skinning shaders
+    static constexpr unsigned int BINDING = 2;
+
+    // Regions in flight, the CPU writes one while the GPU may still read the others
+    static constexpr int REGION_COUNT = 3;
+
+    // Location of an entity's palette in the bound region
+    struct Range {
+        int offset = 0;
+        int count = 0;
+    };
+
+    BonePaletteBuffer();
+    ~BonePaletteBuffer();
+
+    BonePaletteBuffer(const BonePaletteBuffer&) = delete;
+    BonePaletteBuffer& operator=(const BonePaletteBuffer&) = delete;
+
+    // Writes the palettes of the animated entities into the next region and binds it
+    void Upload(const std::vector<Entity>& entities);
+
+    // Marks the region as in use by the commands issued this frame
+    void EndFrame();
+
+    // Range of the entity's palette, count is zero if it has none this frame
+    Range GetRange(const Entity& entity) const;
+
+    // Statistics for the last frame
+    size_t GetMatrixCount() const { return m_MatrixCount; }
+    size_t GetCapacity() const { return m_RegionCapacity; }
+    bool IsPersistent() const { return m_Persistent; }
+
+private:
+    // Reallocates the buffer so every region holds at least the given number of matrices
+    void Reserve(size_t matrixCount);
+    void Release();
+
+    // Blocks until the GPU has finished reading the region
+    void WaitForRegion(int region);
+
+    unsigned int m_Buffer = 0;
+    glm::mat4* m_MappedData = nullptr;  // Whole buffer, persistent path only
+    bool m_Persistent = false;          // Falls back to orphaning uploads without GL 4.4
+
+    size_t m_RegionCapacity = 0;        // Matrices per region
+    size_t m_RegionStride = 0;          // Bytes per region, aligned for glBindBufferRange
+    GLsync m_Fences[REGION_COUNT] = {};
+    int m_Region = 0;
+
+    std::unordered_map<entt::entity, Range> m_Ranges;
+    std::vector<const std::vector<glm::mat4>*> m_Palettes;  // This frame's palettes in upload order
+    std::vector<glm::mat4> m_Staging;   // Orphaning path only
+    size_t m_MatrixCount = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,169 @@
+#include "CrowdPass.h"
+#include "Resources/ModelManager.h"
+#include <glad/gl.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace SockEngine {
+
+CrowdPass::~CrowdPass()
+{
+    for (auto& [entity, buffers] : m_Buffers) {
+        DestroyBuffers(buffers);
+    }
+}
+
+void CrowdPass::Prepare(Scene& scene)
+{
+    m_Frame++;
+    m_DrawItems.clear();
+    m_InstanceCount = 0;
+
+    auto& registry = scene.GetNativeRegistry();
+    auto view = registry.view<TransformComponent, CrowdComponent, ActiveComponent>();
+
+    for (auto entityHandle : view) {
+        auto& crowd = view.get<CrowdComponent>(entityHandle);
+        Model* model = ModelManager::Get().Resolve(crowd.model);
+        if (!view.get<ActiveComponent>(entityHandle).active || !model || !crowd.bakedAnimation || crowd.instances.empty()) {
+            continue;
+        }
+
+        // Rebuild the vertex arrays if the model changed, re-upload the instances if they were edited
+        CrowdBuffers& buffers = m_Buffers[entityHandle];
+        if (buffers.model != model) {
+            DestroyBuffers(buffers);
+            CreateBuffers(buffers, *model);
+        }
+        if (buffers.instanceVersion != crowd.instanceVersion) {
+            UploadInstances(buffers, crowd);
+        }
+        buffers.lastFrame = m_Frame;
+
+        DrawItem item;
+        item.crowd = &crowd;
+        item.model = model;
+        item.buffers = &buffers;
+        item.worldMatrix = view.get<TransformComponent>(entityHandle).GetWorldModelMatrix(registry);
+        m_DrawItems.push_back(item);
+        m_InstanceCount += buffers.instanceCount;
+    }
+
+    // Release crowds that are gone or inactive
+    for (auto it = m_Buffers.begin(); it != m_Buffers.end();) {
+        if (it->second.lastFrame != m_Frame) {
+            DestroyBuffers(it->second);
+            it = m_Buffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CrowdPass::Draw(Shader& shader, bool shadowPass)
+{
+    for (const auto& item : m_DrawItems) {
+        const CrowdComponent& crowd = *item.crowd;
+        if (shadowPass && !crowd.castShadows) {
+            continue;
+        }
+
+        shader.SetMat4("model", item.worldMatrix);
+        shader.SetFloat("crowdTime", crowd.time);
+        shader.SetFloat("material.shininess", crowd.shininess);
+
+        glActiveTexture(GL_TEXTURE0 + BAKED_ANIMATION_UNIT);
+        glBindTexture(GL_TEXTURE_2D, crowd.bakedAnimation->GetTexture());
+        shader.SetInt("bakedAnimation", BAKED_ANIMATION_UNIT);
+
+        item.model->Draw(shader, item.buffers->vertexArrays, item.buffers->instanceCount);
+    }
+}
+
+void CrowdPass::RequestTextureDetail(const glm::vec3& cameraPosition, float projectionScale) const
+{
+    for (const auto& item : m_DrawItems) {
+        // The nearest instance needs the finest mips, the others share its textures
+        const CrowdInstance* nearest = nullptr;
+        float nearestDistance = 0.0f;
+        for (const auto& instance : item.crowd->instances) {
+            glm::vec3 position = glm::vec3(item.worldMatrix * glm::vec4(instance.position, 1.0f));
+            float distance = glm::dot(position - cameraPosition, position - cameraPosition);
+            if (!nearest || distance < nearestDistance) {
+                nearest = &instance;
+                nearestDistance = distance;
+            }
+        }
+
+        glm::mat4 instanceMatrix = glm::translate(item.worldMatrix, nearest->position);
+        instanceMatrix = glm::scale(instanceMatrix, glm::vec3(nearest->scale));
+        item.model->RequestTextureDetail(instanceMatrix, cameraPosition, projectionScale);
+    }
+}
+
+void CrowdPass::CreateBuffers(CrowdBuffers& buffers, Model& model)
+{
+    buffers.model = &model;
+    glGenBuffers(1, &buffers.instanceBuffer);
+
+    // Mesh attributes 0 to 6 come from the mesh, 7 to 11 advance once per instance
+    for (auto& mesh : model.meshes) {
+        unsigned int vertexArray = mesh.CreateVertexArray();
+        glBindBuffer(GL_ARRAY_BUFFER, buffers.instanceBuffer);
+
+        for (int column = 0; column < 4; column++) {
+            glEnableVertexAttribArray(7 + column);
+            glVertexAttribPointer(7 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, transform) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(7 + column, 1);
+        }
+        glEnableVertexAttribArray(11);
+        glVertexAttribPointer(11, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, animation));
+        glVertexAttribDivisor(11, 1);
+
+        glBindVertexArray(0);
+        buffers.vertexArrays.push_back(vertexArray);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CrowdPass::UploadInstances(CrowdBuffers& buffers, const CrowdComponent& crowd)
+{
+    const auto& clips = crowd.bakedAnimation->GetClips();
+
+    m_InstanceData.clear();
+    m_InstanceData.reserve(crowd.instances.size());
+    for (const auto& instance : crowd.instances) {
+        if (clips.empty()) {
+            break;
+        }
+        const BakedAnimation::Clip& clip = clips[glm::clamp(instance.clip, 0, static_cast<int>(clips.size()) - 1)];
+
+        InstanceData data;
+        data.transform = glm::translate(glm::mat4(1.0f), instance.position);
+        data.transform = glm::rotate(data.transform, instance.yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+        data.transform = glm::scale(data.transform, glm::vec3(instance.scale));
+        data.animation = glm::vec4(static_cast<float>(clip.firstFrame), static_cast<float>(clip.frameCount),
+                                   clip.framesPerSecond * instance.speed, instance.timeOffset);
+        m_InstanceData.push_back(data);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_InstanceData.size() * sizeof(InstanceData), m_InstanceData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    buffers.instanceCount = static_cast<int>(m_InstanceData.size());
+    buffers.instanceVersion = crowd.instanceVersion;
+}
+
+void CrowdPass::DestroyBuffers(CrowdBuffers& buffers)
+{
+    if (!buffers.vertexArrays.empty()) {
+        glDeleteVertexArrays(static_cast<GLsizei>(buffers.vertexArrays.size()), buffers.vertexArrays.data());
+    }
+    if (buffers.instanceBuffer != 0) {
+        glDeleteBuffers(1, &buffers.instanceBuffer);
+    }
+    buffers = CrowdBuffers();
+}
+
+}
@@ -0,0 +1,74 @@
+#ifndef CROWD_PASS_H
+#define CROWD_PASS_H
+
+#include "Resources/Shader.h"
+#include "Resources/Model.h"
+#include "Scene/Scene.h"
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace SockEngine {
+
+// Draws every crowd in one instanced draw per mesh. Instance data only goes to the GPU when
+// the crowd changes, each frame costs one clock uniform per crowd.
+class CrowdPass {
+public:
+    // Texture unit of the baked animation, after the material textures and the shadow map
+    static constexpr int BAKED_ANIMATION_UNIT = 6;
+
+    CrowdPass() = default;
+    ~CrowdPass();
+
+    // Collects the active crowds and uploads the instances of crowds that changed
+    void Prepare(Scene& scene);
+
+    // Draws the collected crowds with one of the crowd shaders
+    void Draw(Shader& shader, bool shadowPass);
+
+    // Requests the texture mips of each crowd's model as seen on its instance nearest to the camera
+    void RequestTextureDetail(const glm::vec3& cameraPosition, float projectionScale) const;
+
+    // Statistics for the last frame
+    size_t GetCrowdCount() const { return m_DrawItems.size(); }
+    size_t GetInstanceCount() const { return m_InstanceCount; }
+
+    // Per-instance vertex data, attributes 7 to 11 of the crowd shaders
+    struct InstanceData {
+        glm::mat4 transform;    // Relative to the crowd entity
+        glm::vec4 animation;    // First frame, frame count, frames per second, time offset in seconds
+    };
+
+private:
+    // Instance buffer and one vertex array per mesh of a crowd
+    struct CrowdBuffers {
+        const Model* model = nullptr;
+        uint32_t instanceVersion = 0;
+        unsigned int instanceBuffer = 0;
+        std::vector<unsigned int> vertexArrays;
+        int instanceCount = 0;
+        uint64_t lastFrame = 0;
+    };
+
+    struct DrawItem {
+        const CrowdComponent* crowd;
+        Model* model;
+        const CrowdBuffers* buffers;
+        glm::mat4 worldMatrix;
+    };
+
+    void CreateBuffers(CrowdBuffers& buffers, Model& model);
+    void UploadInstances(CrowdBuffers& buffers, const CrowdComponent& crowd);
+    void DestroyBuffers(CrowdBuffers& buffers);
+
+    std::unordered_map<entt::entity, CrowdBuffers> m_Buffers;
+    std::vector<DrawItem> m_DrawItems;
+    std::vector<InstanceData> m_InstanceData;
+    uint64_t m_Frame = 0;
+    size_t m_InstanceCount = 0;
+};
+
+}
+
+#endif
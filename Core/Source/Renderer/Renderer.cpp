@@ -1,9 +1,12 @@
 #include "Renderer.h"
+#include "Camera/Frustum.h"
+#include "Resources/TextureManager.h"
+#include "Resources/GeometryArena.h"
+#include "Resources/ModelManager.h"
 #include <iostream>
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
-#include <SOIL2/SOIL2.h>
 
 namespace SockEngine {
 
@@ -18,6 +21,17 @@ Renderer::Renderer()
     // Main rendering shaders for animated objects
     m_ShadowMapAnimatedShader = std::make_unique<Shader>("../Shaders/ShadowMapAnimated.vert", "../Shaders/ShadowMap.frag");
     m_LightingAnimatedShader = std::make_unique<Shader>("../Shaders/LightingAnimated.vert", "../Shaders/Lighting.frag");
+
+    // Instanced crowds animated from baked textures
+    m_CrowdShadowMapShader = std::make_unique<Shader>("../Shaders/CrowdShadowMap.vert", "../Shaders/ShadowMap.frag");
+    m_CrowdLightingShader = std::make_unique<Shader>("../Shaders/CrowdLighting.vert", "../Shaders/Lighting.frag");
+    m_CrowdPass = std::make_unique<CrowdPass>();
+
+    // Bone palettes of every animated entity, shared by all passes
+    m_BonePalettes = std::make_unique<BonePaletteBuffer>();
+
+    // Compute skinning, falls back to the animated shaders if unsupported
+    m_SkinningPass = std::make_unique<SkinningPass>();
 }
 
 Renderer::~Renderer() {
@@ -47,6 +61,12 @@ void Renderer::Initialize() {
 void Renderer::Shutdown() {
     glDeleteVertexArrays(1, &m_SkyboxVAO);
     glDeleteBuffers(1, &m_SkyboxVBO);
+    m_SkyboxTexture.reset();
+
+    // Models release their textures and arena ranges, so they go first
+    ModelManager::Get().Shutdown();
+    TextureManager::Get().Shutdown();
+    GeometryArena::Get().Shutdown();
     
     // Delete framebuffers
     glDeleteFramebuffers(1, &m_ViewportFBO);
@@ -56,17 +76,40 @@ void Renderer::Shutdown() {
     // Delete shadow mapping resources
     glDeleteFramebuffers(1, &m_DepthMapFBO);
     glDeleteTextures(1, &m_DepthMap);
+
+    // Delete skinning buffers while the context is alive
+    m_SkinningPass.reset();
+    m_BonePalettes.reset();
+    m_CrowdPass.reset();
 }
 
 void Renderer::RenderScene(Scene& scene, Camera& camera) {
     // Collect all renderable entities from the scene
     std::vector<Entity> renderableEntities = CollectRenderableEntities(scene);
+
+    // Upload every bone palette once, draws index them by offset
+    m_BonePalettes->Upload(renderableEntities);
+
+    // Skin animated meshes once for both passes
+    if (m_EnableGPUSkinning && IsGPUSkinningSupported()) {
+        m_SkinningPass->Execute(renderableEntities, *m_BonePalettes);
+    }
+
+    // Upload the instances of crowds that changed
+    m_CrowdPass->Prepare(scene);
+
+    // Detail levels seen from the camera, the shadow pass draws the same ones
+    SelectMeshLODs(renderableEntities, scene, camera);
     
     // First pass: Shadow mapping
     RenderShadowPass(renderableEntities, scene);
     
-    // Second pass: Main rendering
+    // Second pass: Main rendering. Both passes cull animated entities by their posed bounds
+    // and feed the result back to the animation LOD.
     RenderMainPass(renderableEntities, scene, camera);
+
+    // The palette region stays untouched until the GPU has drawn this frame
+    m_BonePalettes->EndFrame();
 }
 
 std::vector<Entity> Renderer::CollectRenderableEntities(Scene& scene) {
@@ -79,7 +122,7 @@ std::vector<Entity> Renderer::CollectRenderableEntities(Scene& scene) {
         auto& active = view.get<ActiveComponent>(entityHandle);
         auto& model = view.get<ModelComponent>(entityHandle);
         
-        if (active.active && model.model) {
+        if (active.active && ModelManager::Get().Resolve(model.model)) {
             Entity entity(entityHandle, &scene.GetSceneRegistry());
             entities.push_back(entity);
         }
@@ -88,22 +131,60 @@ std::vector<Entity> Renderer::CollectRenderableEntities(Scene& scene) {
     return entities;
 }
 
+void Renderer::SelectMeshLODs(const std::vector<Entity>& entities, Scene& scene, Camera& camera) {
+    auto& registry = scene.GetNativeRegistry();
+    m_LODTriangleCount = 0;
+    m_FullTriangleCount = 0;
+
+    // The projection of this frame, BeginScene has not stored it yet
+    glm::mat4 projection = camera.GetProjectionMatrix(static_cast<float>(m_RenderWidth) / static_cast<float>(m_RenderHeight));
+    const float projectionScale = projection[1][1] * 0.5f * static_cast<float>(m_RenderHeight);
+
+    for (const auto& entity : entities) {
+        auto& modelComponent = entity.GetComponent<ModelComponent>();
+        auto& transform = entity.GetComponent<TransformComponent>();
+        const Model* model = ModelManager::Get().Resolve(modelComponent.model);
+        model->SelectLODs(transform.GetWorldModelMatrix(registry), camera.Position, projectionScale,
+                          m_MeshLODErrorThreshold, modelComponent.meshLODs);
+
+        for (size_t i = 0; i < model->meshes.size(); i++) {
+            m_LODTriangleCount += model->meshes[i].GetLOD(modelComponent.meshLODs[i]).indexCount / 3;
+            m_FullTriangleCount += model->meshes[i].GetLOD(0).indexCount / 3;
+        }
+    }
+}
+
 void Renderer::RenderShadowPass(const std::vector<Entity>& entities, Scene& scene) {
     BeginShadowPass(m_DirectionalLightDir, 50000.0f);
     
     auto& registry = scene.GetNativeRegistry();
+    Frustum shadowFrustum(m_LightSpaceMatrix);
+    m_CulledAnimatedShadowCount = 0;
     
     // Render all entities that cast shadows
     for (const auto& entity : entities) {
         if (entity.HasComponent<ModelComponent>()) {
             auto& modelComponent = entity.GetComponent<ModelComponent>();
+
+            // Skip animated entities whose shadow can't reach the shadow map
+            if (entity.HasComponent<AnimatorComponent>()) {
+                auto& animatorComponent = entity.GetComponent<AnimatorComponent>();
+                animatorComponent.castsVisibleShadow = modelComponent.castShadows &&
+                                                       IsAnimatedEntityInFrustum(entity, registry, shadowFrustum);
+                if (modelComponent.castShadows && !animatorComponent.castsVisibleShadow) {
+                    m_CulledAnimatedShadowCount++;
+                    continue;
+                }
+            }
             
             if (modelComponent.castShadows) {
                 auto& transform = entity.GetComponent<TransformComponent>();
                 glm::mat4 worldMatrix = transform.GetWorldModelMatrix(registry);
                 
-                // Choose appropriate shader based on whether entity has animation
-                bool isAnimated = entity.HasComponent<AnimatorComponent>();
+                // Choose appropriate shader based on whether entity has animation.
+                // Meshes skinned by the compute pass are drawn like static ones.
+                const std::vector<unsigned int>* skinnedVertexArrays = GetSkinnedVertexArrays(entity);
+                bool isAnimated = entity.HasComponent<AnimatorComponent>() && !skinnedVertexArrays;
                 Shader* shadowShader = isAnimated ? m_ShadowMapAnimatedShader.get() : m_ShadowMapShader.get();
                 
                 shadowShader->Use();
@@ -111,14 +192,28 @@ void Renderer::RenderShadowPass(const std::vector<Entity>& entities, Scene& scen
                 shadowShader->SetMat4("model", worldMatrix);
 
                 // Handle skeletal animation only for animated models
+                int skeletonLOD = 0;
                 if (isAnimated) {
                     SetBoneMatrices(entity, *shadowShader);
+                    skeletonLOD = entity.GetComponent<AnimatorComponent>().skeletonLOD;
                 }
                 
-                modelComponent.model->Draw(*shadowShader);
+                Model* model = ModelManager::Get().Resolve(modelComponent.model);
+                if (skinnedVertexArrays) {
+                    model->Draw(*shadowShader, *skinnedVertexArrays, 1, &modelComponent.meshLODs);
+                } else {
+                    model->Draw(*shadowShader, skeletonLOD, &modelComponent.meshLODs);
+                }
             }
         }
     }
+
+    // Crowds cast shadows with one instanced draw per mesh
+    if (m_CrowdPass->GetCrowdCount() > 0) {
+        m_CrowdShadowMapShader->Use();
+        m_CrowdShadowMapShader->SetMat4("lightSpaceMatrix", m_LightSpaceMatrix);
+        m_CrowdPass->Draw(*m_CrowdShadowMapShader, true);
+    }
     
     EndShadowPass();
 }
@@ -127,15 +222,32 @@ void Renderer::RenderMainPass(const std::vector<Entity>& entities, Scene& scene,
     BeginScene(camera);
     
     auto& registry = scene.GetNativeRegistry();
+    Frustum viewFrustum(m_ProjectionMatrix * m_ViewMatrix);
+    m_CulledAnimatedCount = 0;
+
+    // Pixels covered by one unit at a distance of one, for texture streaming
+    const float projectionScale = m_ProjectionMatrix[1][1] * 0.5f * static_cast<float>(m_RenderHeight);
     
     // Render all entities
     for (const auto& entity : entities) {
         if (entity.HasComponent<ModelComponent>() && entity.HasComponent<TransformComponent>()) {
             auto& modelComponent = entity.GetComponent<ModelComponent>();
             auto& transform = entity.GetComponent<TransformComponent>();
+
+            // Skip animated entities outside the camera
+            if (entity.HasComponent<AnimatorComponent>()) {
+                auto& animatorComponent = entity.GetComponent<AnimatorComponent>();
+                animatorComponent.isVisible = IsAnimatedEntityInFrustum(entity, registry, viewFrustum);
+                if (!animatorComponent.isVisible) {
+                    m_CulledAnimatedCount++;
+                    continue;
+                }
+            }
             
-            // Choose appropriate shader based on whether entity has animation
-            bool isAnimated = entity.HasComponent<AnimatorComponent>();
+            // Choose appropriate shader based on whether entity has animation.
+            // Meshes skinned by the compute pass are drawn like static ones.
+            const std::vector<unsigned int>* skinnedVertexArrays = GetSkinnedVertexArrays(entity);
+            bool isAnimated = entity.HasComponent<AnimatorComponent>() && !skinnedVertexArrays;
             Shader* lightingShader = isAnimated ? m_LightingAnimatedShader.get() : m_LightingShader.get();
             
             lightingShader->Use();
@@ -172,15 +284,29 @@ void Renderer::RenderMainPass(const std::vector<Entity>& entities, Scene& scene,
             lightingShader->SetMat4("model", worldMatrix);
 
             // Handle skeletal animation only for animated models
+            int skeletonLOD = 0;
             if (isAnimated) {
                 SetBoneMatrices(entity, *lightingShader);
+                skeletonLOD = entity.GetComponent<AnimatorComponent>().skeletonLOD;
             }
             
-            // Draw the model
-            modelComponent.model->Draw(*lightingShader);
+            // Draw the model, reduced skeletons use their own bone ID stream
+            Model* model = ModelManager::Get().Resolve(modelComponent.model);
+            model->RequestTextureDetail(worldMatrix, camera.Position, projectionScale);
+            if (skinnedVertexArrays) {
+                model->Draw(*lightingShader, *skinnedVertexArrays, 1, &modelComponent.meshLODs);
+            } else {
+                model->Draw(*lightingShader, skeletonLOD, &modelComponent.meshLODs);
+            }
         }
     }
     
+    // Render crowds
+    if (m_CrowdPass->GetCrowdCount() > 0) {
+        m_CrowdPass->RequestTextureDetail(camera.Position, projectionScale);
+        RenderCrowds(camera);
+    }
+    
     // Render skybox if enabled
     if (!m_DebugNormals && !m_DebugSpecular && m_EnableSkybox) {
         RenderSkybox();
@@ -189,27 +315,82 @@ void Renderer::RenderMainPass(const std::vector<Entity>& entities, Scene& scene,
     EndScene();
 }
 
-void Renderer::SetBoneMatrices(const Entity& entity, Shader& shader) {
-    // Check if entity has an animator component
-    if (entity.HasComponent<AnimatorComponent>()) {
-        auto& animatorComponent = entity.GetComponent<AnimatorComponent>();
-        
-        // Get bone matrices from the animator
-        std::vector<glm::mat4> boneMatrices = animatorComponent.GetBoneMatrices();
-        
-        // Upload bone matrices to shader
-        for (int i = 0; i < boneMatrices.size() && i < 100; ++i) {
-            std::string uniformName = "finalBonesMatrices[" + std::to_string(i) + "]";
-            shader.SetMat4(uniformName, boneMatrices[i]);
-        }
-    } else {
-        // For non-animated models, set identity matrices
-        glm::mat4 identity = glm::mat4(1.0f);
-        for (int i = 0; i < 100; ++i) {
-            std::string uniformName = "finalBonesMatrices[" + std::to_string(i) + "]";
-            shader.SetMat4(uniformName, identity);
-        }
+void Renderer::RenderCrowds(Camera& camera) {
+    Shader& shader = *m_CrowdLightingShader;
+    shader.Use();
+    shader.SetVec3("viewPos", camera.Position);
+    
+    // Set common uniforms
+    shader.SetBool("debugNormals", m_DebugNormals);
+    shader.SetBool("debugSpec", m_DebugSpecular);
+    
+    // Set lighting parameters
+    shader.SetVec3("dirLight.direction", m_DirectionalLightDir);
+    shader.SetVec3("dirLight.ambient", 0.1f, 0.1f, 0.1f);
+    shader.SetVec3("dirLight.diffuse", 1.0f, 1.0f, 1.0f);
+    shader.SetVec3("dirLight.specular", 0.3f, 0.3f, 0.3f);
+    
+    // Set shadow mapping uniforms
+    shader.SetMat4("lightSpaceMatrix", m_LightSpaceMatrix);
+    shader.SetFloat("shadowBias", m_ShadowBias);
+    
+    // Bind shadow map
+    glActiveTexture(GL_TEXTURE0 + 5);
+    glBindTexture(GL_TEXTURE_2D, m_DepthMap);
+    shader.SetInt("shadowMap", 5);
+    
+    // Set view/projection matrices
+    shader.SetMat4("projection", m_ProjectionMatrix);
+    shader.SetMat4("view", m_ViewMatrix);
+
+    // Model transform, shininess and the baked animation are set per crowd
+    m_CrowdPass->Draw(shader, false);
+}
+
+bool Renderer::IsAnimatedEntityInFrustum(const Entity& entity, entt::registry& registry, const Frustum& frustum) const {
+    auto& animatorComponent = entity.GetComponent<AnimatorComponent>();
+    auto& transform = entity.GetComponent<TransformComponent>();
+
+    // Bounding sphere around the entity's origin until the pose has bounds
+    if (!animatorComponent.hasBounds) {
+        glm::vec3 center = transform.GetWorldPosition(registry);
+        glm::vec3 scale = glm::abs(transform.GetWorldScale(registry));
+        float radius = animatorComponent.boundingRadius * glm::max(scale.x, glm::max(scale.y, scale.z));
+        return frustum.IntersectsSphere(center, radius);
     }
+
+    // A paused pose no longer follows the clip's root motion, allow for anywhere the root can reach
+    glm::vec3 boundsMin = animatorComponent.boundsMin;
+    glm::vec3 boundsMax = animatorComponent.boundsMax;
+    if (animatorComponent.currentLOD == AnimationLOD::Paused && animatorComponent.isPlaying) {
+        boundsMin -= animatorComponent.pausedMotionExtent;
+        boundsMax += animatorComponent.pausedMotionExtent;
+    }
+
+    // Move the posed box to world space, keeping it axis-aligned
+    glm::mat4 worldMatrix = transform.GetWorldModelMatrix(registry);
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+    glm::vec3 worldCenter = glm::vec3(worldMatrix * glm::vec4(center, 1.0f));
+    glm::vec3 worldExtent = glm::abs(glm::vec3(worldMatrix[0])) * extent.x +
+                            glm::abs(glm::vec3(worldMatrix[1])) * extent.y +
+                            glm::abs(glm::vec3(worldMatrix[2])) * extent.z;
+    return frustum.IntersectsAABB(worldCenter - worldExtent, worldCenter + worldExtent);
+}
+
+const std::vector<unsigned int>* Renderer::GetSkinnedVertexArrays(const Entity& entity) const {
+    if (!m_EnableGPUSkinning || !IsGPUSkinningSupported()) {
+        return nullptr;
+    }
+    return m_SkinningPass->GetVertexArrays(entity);
+}
+
+void Renderer::SetBoneMatrices(const Entity& entity, Shader& shader) {
+    // The palette was uploaded at the start of the frame, the shader only needs its location.
+    // Reduced skeletons have a smaller palette, matching the bone IDs of their LOD stream.
+    BonePaletteBuffer::Range palette = m_BonePalettes->GetRange(entity);
+    shader.SetInt("boneOffset", palette.offset);
+    shader.SetInt("boneCount", palette.count);
 }
 
 void Renderer::RenderSkybox() {
@@ -226,7 +407,7 @@ void Renderer::RenderSkybox() {
     // Skybox cube
     glBindVertexArray(m_SkyboxVAO);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_SkyboxTexture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_SkyboxTexture ? m_SkyboxTexture->GetID() : 0);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
     glDepthFunc(GL_LESS); // Set depth function back to default
@@ -403,9 +584,7 @@ void Renderer::BeginScene(Camera& camera) {
     
     // Store view and projection matrices
     m_ViewMatrix = camera.GetViewMatrix();
-    m_ProjectionMatrix = glm::perspective(glm::radians(camera.Zoom), 
-                                          (float)m_RenderWidth / (float)m_RenderHeight, 
-                                          0.1f, 50000.0f);
+    m_ProjectionMatrix = camera.GetProjectionMatrix((float)m_RenderWidth / (float)m_RenderHeight);
 }
 
 void Renderer::EndScene() {
@@ -441,22 +620,17 @@ void Renderer::RenderModel(Model& model, const glm::mat4& transform, Shader& sha
     // Set model transform
     shader.SetMat4("model", transform);
 
-    // Set identity matrices for bone transforms
-    glm::mat4 identity = glm::mat4(1.0f);
-    for (int i = 0; i < 100; ++i) {
-        std::string uniformName = "finalBonesMatrices[" + std::to_string(i) + "]";
-        shader.SetMat4(uniformName, identity);
-    }
+    // No palette, animated shaders leave the vertices in bind pose
+    shader.SetInt("boneOffset", 0);
+    shader.SetInt("boneCount", 0);
     
     // Draw the model
     model.Draw(shader);
 }
 
 void Renderer::LoadSkybox(const std::vector<std::string>& skyboxFaces) {
-    if (m_SkyboxTexture != 0) {
-        glDeleteTextures(1, &m_SkyboxTexture);
-    }
-    m_SkyboxTexture = LoadCubemap(skyboxFaces);
+    // The previous cube map is deleted unless something else still uses it
+    m_SkyboxTexture = TextureManager::Get().LoadCubemap(skyboxFaces);
 }
 
 void Renderer::SetRenderResolution(uint32_t width, uint32_t height) {
@@ -468,47 +642,4 @@ void Renderer::SetRenderResolution(uint32_t width, uint32_t height) {
     }
 }
 
-unsigned int Renderer::LoadCubemap(std::vector<std::string> faces) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrComponents;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char* data = SOIL_load_image(faces[i].c_str(), &width, &height, &nrComponents, 0);
-        GLenum format = GL_RGB;
-        if (data)
-        {
-            if (nrComponents == 1) {
-                format = GL_RED;
-            }
-            else if (nrComponents == 2) {
-                format = GL_RG;
-            }
-            else if (nrComponents == 3) {
-                format = GL_RGB;
-            }
-            else if (nrComponents == 4) {
-                format = GL_RGBA;
-            }
-            
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            SOIL_free_image_data(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-    return textureID;
-}
-
 }
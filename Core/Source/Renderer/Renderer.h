@@ -5,6 +5,9 @@
 #include "Resources/Model.h"
 #include "Camera/Camera.h"
 #include "Scene/Scene.h"
+#include "SkinningPass.h"
+#include "BonePaletteBuffer.h"
+#include "CrowdPass.h"
 #include <vector>
 #include <string>
 #include <memory>
@@ -12,6 +15,8 @@
 
 namespace SockEngine {
 
+class Frustum;
+
 class Renderer {
 public:
     Renderer();
@@ -39,7 +44,6 @@ public:
     void LoadSkybox(const std::vector<std::string>& skyboxFaces);
     void EnableSkybox(bool enable) { m_EnableSkybox = enable; }
     bool IsSkyboxEnabled() const { return m_EnableSkybox; }
-    static unsigned int LoadCubemap(std::vector<std::string> faces);
     
     // Shadow mapping
     void SetupShadowMap(unsigned int width, unsigned int height);
@@ -57,6 +61,29 @@ public:
     void SetDirectionalLight(const glm::vec3& direction) { m_DirectionalLightDir = direction; }
     glm::vec3 GetDirectionalLight() const { return m_DirectionalLightDir; }
 
+    // GPU skinning, animated meshes are skinned once per frame in a compute pass
+    void EnableGPUSkinning(bool enable) { m_EnableGPUSkinning = enable; }
+    bool IsGPUSkinningEnabled() const { return m_EnableGPUSkinning; }
+    bool IsGPUSkinningSupported() const { return m_SkinningPass && m_SkinningPass->IsSupported(); }
+    const SkinningPass* GetSkinningPass() const { return m_SkinningPass.get(); }
+    const BonePaletteBuffer* GetBonePalettes() const { return m_BonePalettes.get(); }
+
+    // Instanced crowds animated from baked textures
+    const CrowdPass* GetCrowdPass() const { return m_CrowdPass.get(); }
+
+    // Animated entities skipped last frame because their posed bounds were outside the frustum
+    size_t GetCulledAnimatedCount() const { return m_CulledAnimatedCount; }
+    size_t GetCulledAnimatedShadowCount() const { return m_CulledAnimatedShadowCount; }
+
+    // Mesh detail levels are picked so their error stays under this many pixels on screen, 0 keeps
+    // every mesh at full detail
+    void SetMeshLODErrorThreshold(float pixels) { m_MeshLODErrorThreshold = pixels; }
+    float GetMeshLODErrorThreshold() const { return m_MeshLODErrorThreshold; }
+
+    // Triangles of last frame's models at their selected detail levels, and at full detail
+    size_t GetLODTriangleCount() const { return m_LODTriangleCount; }
+    size_t GetFullTriangleCount() const { return m_FullTriangleCount; }
+
 private:
     // Viewport
     uint32_t m_RenderWidth = 1920;
@@ -86,7 +113,7 @@ private:
     
     // Skybox
     unsigned int m_SkyboxVAO, m_SkyboxVBO;
-    unsigned int m_SkyboxTexture;
+    TextureRef m_SkyboxTexture;
     std::unique_ptr<Shader> m_SkyboxShader;
     bool m_EnableSkybox = true;
     
@@ -100,6 +127,25 @@ private:
     std::unique_ptr<Shader> m_LightingShader;
     std::unique_ptr<Shader> m_ShadowMapAnimatedShader;
     std::unique_ptr<Shader> m_LightingAnimatedShader;
+    std::unique_ptr<Shader> m_CrowdShadowMapShader;
+    std::unique_ptr<Shader> m_CrowdLightingShader;
+
+    // GPU skinning
+    std::unique_ptr<BonePaletteBuffer> m_BonePalettes;
+    std::unique_ptr<SkinningPass> m_SkinningPass;
+    bool m_EnableGPUSkinning = true;
+
+    // Crowds
+    std::unique_ptr<CrowdPass> m_CrowdPass;
+
+    // Animated culling statistics
+    size_t m_CulledAnimatedCount = 0;
+    size_t m_CulledAnimatedShadowCount = 0;
+
+    // Mesh detail levels
+    float m_MeshLODErrorThreshold = 1.0f;
+    size_t m_LODTriangleCount = 0;
+    size_t m_FullTriangleCount = 0;
 
     // Internal rendering methods
     void BeginScene(Camera& camera);
@@ -110,11 +156,15 @@ private:
 
     // Skeletal animation
     void SetBoneMatrices(const Entity& entity, Shader& shader);
+    const std::vector<unsigned int>* GetSkinnedVertexArrays(const Entity& entity) const;
     
     // Scene data collection
     std::vector<Entity> CollectRenderableEntities(Scene& scene);
+    void SelectMeshLODs(const std::vector<Entity>& entities, Scene& scene, Camera& camera);
     void RenderShadowPass(const std::vector<Entity>& entities, Scene& scene);
     void RenderMainPass(const std::vector<Entity>& entities, Scene& scene, Camera& camera);
+    void RenderCrowds(Camera& camera);
+    bool IsAnimatedEntityInFrustum(const Entity& entity, entt::registry& registry, const Frustum& frustum) const;
     void RenderSkybox();
 };
 
@@ -0,0 +1,339 @@
+#include "SkinningPass.h"
+#include "Resources/ModelManager.h"
+#include "Resources/VertexPacking.h"
+#include <iostream>
+#include <glad/gl.h>
+#include <algorithm>
+
+namespace SockEngine {
+
+namespace {
+
+constexpr int WORKGROUP_SIZE = 64;
+
+// Bone ID strides in uints, see Skinning.comp
+constexpr int SKIN_VERTEX_STRIDE = sizeof(VertexPacking::SkinVertex) / sizeof(uint32_t);
+constexpr int SKELETON_LOD_STRIDE = 1;
+
+static_assert(sizeof(SkinningPass::SkinnedVertex) == 7 * sizeof(uint32_t), "Must match SKINNED_STRIDE in Skinning.comp");
+
+}
+
+SkinningPass::SkinningPass()
+{
+    if (!GLAD_GL_VERSION_4_3) {
+        std::cout << "WARNING: Compute shaders are not supported, skinning stays in the vertex shaders" << std::endl;
+        return;
+    }
+
+    m_Shader = std::make_unique<ComputeShader>("../Shaders/Skinning.comp");
+    m_MorphShader = std::make_unique<ComputeShader>("../Shaders/Morph.comp");
+}
+
+SkinningPass::~SkinningPass()
+{
+    for (auto& [entity, instance] : m_Instances) {
+        DestroyInstance(instance);
+    }
+}
+
+void SkinningPass::Execute(const std::vector<Entity>& entities, const BonePaletteBuffer& bonePalettes)
+{
+    if (!m_Shader) {
+        return;
+    }
+
+    m_Frame++;
+    m_Dispatches.clear();
+    m_MorphJobs.clear();
+    m_SkinnedVertexCount = 0;
+    m_MorphDeltaCount = 0;
+    m_SkippedInstanceCount = 0;
+
+    for (const auto& entity : entities) {
+        if (!entity.HasComponent<AnimatorComponent>() || !entity.HasComponent<ModelComponent>()) {
+            continue;
+        }
+
+        auto& animatorComponent = entity.GetComponent<AnimatorComponent>();
+        auto& modelComponent = entity.GetComponent<ModelComponent>();
+        BonePaletteBuffer::Range palette = bonePalettes.GetRange(entity);
+        const Model* model = ModelManager::Get().Resolve(modelComponent.model);
+        if (palette.count == 0 || !model) {
+            continue;
+        }
+
+        // Rebuild the output buffer if the entity is new or its model changed
+        SkinnedInstance& instance = m_Instances[entity];
+        if (instance.model != model) {
+            DestroyInstance(instance);
+            CreateInstance(instance, *model);
+        }
+        instance.lastFrame = m_Frame;
+
+        // Entities culled from both passes last frame most likely are again. The buffer is kept,
+        // and the passes skin those that turn out visible in their vertex shaders.
+        if (!animatorComponent.isVisible && !animatorComponent.castsVisibleShadow) {
+            instance.current = false;
+            m_SkippedInstanceCount++;
+            continue;
+        }
+
+        // A frozen pose (e.g. a paused animator) with unchanged morph weights is already skinned
+        uint64_t paletteVersion = animatorComponent.animator ? animatorComponent.animator->GetPaletteVersion() : 0;
+        const std::vector<float>* morphWeights = nullptr;
+        if (instance.morphBuffer != 0 && entity.HasComponent<MorphTargetComponent>()) {
+            morphWeights = &entity.GetComponent<MorphTargetComponent>().weights;
+        }
+        bool morphsChanged = morphWeights ? *morphWeights != instance.morphWeights : !instance.morphWeights.empty();
+        if (instance.current && paletteVersion == instance.paletteVersion &&
+            animatorComponent.skeletonLOD == instance.skeletonLOD && !morphsChanged) {
+            m_SkippedInstanceCount++;
+            continue;
+        }
+        instance.current = true;
+        instance.paletteVersion = paletteVersion;
+        instance.skeletonLOD = animatorComponent.skeletonLOD;
+        if (morphWeights) {
+            instance.morphWeights = *morphWeights;
+        } else {
+            instance.morphWeights.clear();
+        }
+
+        Dispatch dispatch;
+        dispatch.instance = &instance;
+        dispatch.model = model;
+        dispatch.skeletonLOD = animatorComponent.skeletonLOD;
+        dispatch.boneOffset = palette.offset;
+        dispatch.boneCount = palette.count;
+
+        std::fill(instance.activeMorphOffsets.begin(), instance.activeMorphOffsets.end(), -1);
+        if (morphWeights) {
+            PrepareMorphs(dispatch, entity.GetComponent<MorphTargetComponent>());
+        }
+        m_Dispatches.push_back(dispatch);
+    }
+
+    // Release entities that are gone or no longer animated
+    for (auto it = m_Instances.begin(); it != m_Instances.end();) {
+        if (it->second.lastFrame != m_Frame) {
+            DestroyInstance(it->second);
+            it = m_Instances.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (m_Dispatches.empty()) {
+        return;
+    }
+
+    ExecuteMorphs();
+
+    // The palettes are read from the region bound by the palette buffer
+    m_Shader->Use();
+    for (const auto& dispatch : m_Dispatches) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, dispatch.instance->outputBuffer);
+        m_Shader->SetInt("boneOffset", dispatch.boneOffset);
+        m_Shader->SetInt("boneCount", dispatch.boneCount);
+
+        const auto& meshes = dispatch.model->meshes;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const Mesh& mesh = meshes[i];
+            int vertexCount = static_cast<int>(mesh.GetVertexCount());
+            if (vertexCount == 0) {
+                continue;
+            }
+
+            // The mesh's range of the arena buffers starts at its base vertex
+            int baseVertex = static_cast<int>(mesh.GetBaseVertex());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mesh.GetVertexBuffer());
+            m_Shader->SetInt("baseVertex", baseVertex);
+            m_Shader->SetVec3("positionOffset", mesh.GetPositionOffset());
+            m_Shader->SetVec3("positionScale", mesh.GetPositionScale());
+
+            // Reduced skeletons read their remapped bone IDs from a separate stream, the weights
+            // always come from the skin stream. Meshes without one have no influences.
+            unsigned int lodBoneBuffer = mesh.GetSkeletonLODBoneBuffer(dispatch.skeletonLOD);
+            if (!mesh.IsSkinned()) {
+                m_Shader->SetInt("boneIDStride", 0);
+            } else if (lodBoneBuffer != 0) {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, lodBoneBuffer);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mesh.GetSkinBuffer());
+                m_Shader->SetInt("boneIDStride", SKELETON_LOD_STRIDE);
+                m_Shader->SetInt("boneIDBaseVertex", 0);
+            } else {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mesh.GetSkinBuffer());
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mesh.GetSkinBuffer());
+                m_Shader->SetInt("boneIDStride", SKIN_VERTEX_STRIDE);
+                m_Shader->SetInt("boneIDBaseVertex", baseVertex);
+            }
+
+            // Offsets accumulated by the morph pass
+            int morphSlotOffset = dispatch.instance->activeMorphOffsets.empty() ? -1 : dispatch.instance->activeMorphOffsets[i];
+            if (morphSlotOffset >= 0) {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mesh.GetMorphSlotBuffer());
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, dispatch.instance->morphBuffer);
+            }
+            m_Shader->SetInt("morphSlotOffset", morphSlotOffset);
+
+            m_Shader->SetInt("vertexCount", vertexCount);
+            m_Shader->SetInt("outputOffset", dispatch.instance->baseVertices[i]);
+            glDispatchCompute((vertexCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+            m_SkinnedVertexCount += vertexCount;
+        }
+    }
+
+    // The skinned vertices are read as vertex attributes by the following passes
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void SkinningPass::PrepareMorphs(Dispatch& dispatch, const MorphTargetComponent& morphs)
+{
+    SkinnedInstance& instance = *dispatch.instance;
+    const auto& meshes = dispatch.model->meshes;
+    bool active = false;
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        int round = 0;
+        for (const auto& target : meshes[i].morphTargets) {
+            float weight = target.index >= 0 && target.index < static_cast<int>(morphs.weights.size()) ? morphs.weights[target.index] : 0.0f;
+            if (weight == 0.0f) {
+                continue;
+            }
+
+            MorphJob job;
+            job.instance = &instance;
+            job.mesh = &meshes[i];
+            job.target = &target;
+            job.slotOffset = instance.morphSlotOffsets[i];
+            job.weight = weight;
+            job.round = round++;
+            m_MorphJobs.push_back(job);
+            m_MorphDeltaCount += target.deltaCount;
+        }
+
+        if (round > 0) {
+            instance.activeMorphOffsets[i] = instance.morphSlotOffsets[i];
+            active = true;
+        }
+    }
+
+    // Offsets are accumulated, start from zero
+    if (active) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance.morphBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_RGBA32F, GL_RGBA, GL_FLOAT, nullptr);
+    }
+}
+
+void SkinningPass::ExecuteMorphs()
+{
+    if (m_MorphJobs.empty()) {
+        return;
+    }
+
+    std::stable_sort(m_MorphJobs.begin(), m_MorphJobs.end(),
+        [](const MorphJob& a, const MorphJob& b) { return a.round < b.round; });
+
+    // One thread per delta, only the vertices the active targets move are touched
+    m_MorphShader->Use();
+    int round = 0;
+    for (const auto& job : m_MorphJobs) {
+        if (job.round != round) {
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            round = job.round;
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, job.mesh->GetMorphDeltaBuffer());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, job.instance->morphBuffer);
+        m_MorphShader->SetInt("firstDelta", static_cast<int>(job.target->firstDelta));
+        m_MorphShader->SetInt("deltaCount", static_cast<int>(job.target->deltaCount));
+        m_MorphShader->SetInt("slotOffset", job.slotOffset);
+        m_MorphShader->SetFloat("weight", job.weight);
+        glDispatchCompute((job.target->deltaCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+    }
+
+    // The skinning shader reads the accumulated offsets
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+const std::vector<unsigned int>* SkinningPass::GetVertexArrays(const Entity& entity) const
+{
+    auto it = m_Instances.find(entity);
+    if (it == m_Instances.end() || it->second.lastFrame != m_Frame || !it->second.current) {
+        return nullptr;
+    }
+    return &it->second.vertexArrays;
+}
+
+void SkinningPass::CreateInstance(SkinnedInstance& instance, const Model& model)
+{
+    instance.model = &model;
+
+    int totalVertices = 0;
+    for (const auto& mesh : model.meshes) {
+        instance.baseVertices.push_back(totalVertices);
+        totalVertices += static_cast<int>(mesh.GetVertexCount());
+    }
+
+    // Every morphed vertex of the model gets two vec4 of accumulated offsets
+    for (const auto& mesh : model.meshes) {
+        instance.morphSlotOffsets.push_back(instance.morphSlotCount);
+        if (mesh.HasMorphTargets()) {
+            instance.morphSlotCount += mesh.GetMorphedVertexCount();
+        }
+    }
+    if (instance.morphSlotCount > 0) {
+        instance.activeMorphOffsets.assign(model.meshes.size(), -1);
+        glGenBuffers(1, &instance.morphBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance.morphBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<size_t>(instance.morphSlotCount) * 2 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    glGenBuffers(1, &instance.outputBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instance.outputBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<size_t>(totalVertices) * sizeof(SkinnedVertex), nullptr, GL_DYNAMIC_COPY);
+
+    // One vertex array per mesh, reading its range of the output buffer with the mesh's indices
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        size_t base = static_cast<size_t>(instance.baseVertices[i]) * sizeof(SkinnedVertex);
+
+        unsigned int vertexArray;
+        glGenVertexArrays(1, &vertexArray);
+        glBindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, instance.outputBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.meshes[i].GetIndexBuffer());
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)(base + offsetof(SkinnedVertex, Position)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(SkinnedVertex), (void*)(base + offsetof(SkinnedVertex, Normal)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)(base + offsetof(SkinnedVertex, TexCoords)));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(SkinnedVertex), (void*)(base + offsetof(SkinnedVertex, Tangent)));
+
+        glBindVertexArray(0);
+        instance.vertexArrays.push_back(vertexArray);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SkinningPass::DestroyInstance(SkinnedInstance& instance)
+{
+    if (!instance.vertexArrays.empty()) {
+        glDeleteVertexArrays(static_cast<GLsizei>(instance.vertexArrays.size()), instance.vertexArrays.data());
+    }
+    if (instance.outputBuffer != 0) {
+        glDeleteBuffers(1, &instance.outputBuffer);
+    }
+    if (instance.morphBuffer != 0) {
+        glDeleteBuffers(1, &instance.morphBuffer);
+    }
+    instance = SkinnedInstance();
+}
+
+}
@@ -0,0 +1,113 @@
+#ifndef SKINNING_PASS_H
+#define SKINNING_PASS_H
+
+#include "Resources/ComputeShader.h"
+#include "Resources/Model.h"
+#include "BonePaletteBuffer.h"
+#include "Scene/Entity.h"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace SockEngine {
+
+// Skins animated meshes once per frame with a compute shader. The shadow and main passes then
+// draw the skinned vertices as static geometry instead of skinning them in each vertex shader.
+class SkinningPass {
+public:
+    SkinningPass();
+    ~SkinningPass();
+
+    // Compute shaders need OpenGL 4.3
+    bool IsSupported() const { return m_Shader != nullptr; }
+
+    // Skins every animated entity in the list with the palettes already uploaded this frame.
+    // Morph targets with a nonzero weight are applied to the bind pose first. Entities whose
+    // palette and morph weights haven't changed since they were last skinned are not dispatched
+    // again, nor are those culled from both passes last frame.
+    void Execute(const std::vector<Entity>& entities, const BonePaletteBuffer& bonePalettes);
+
+    // Vertex arrays of the entity's skinned meshes, one per mesh, or nullptr if its skinned vertices
+    // are not current this frame
+    const std::vector<unsigned int>* GetVertexArrays(const Entity& entity) const;
+
+    // Statistics for the last frame
+    size_t GetSkinnedVertexCount() const { return m_SkinnedVertexCount; }
+    size_t GetInstanceCount() const { return m_Instances.size(); }
+    size_t GetSkippedInstanceCount() const { return m_SkippedInstanceCount; }
+    size_t GetActiveMorphTargetCount() const { return m_MorphJobs.size(); }
+    size_t GetMorphDeltaCount() const { return m_MorphDeltaCount; }
+
+    // Skinned vertex layout, attributes 0 to 3 like VertexPacking::PackedVertex. Skinned positions
+    // can leave the bind pose bounds, so they stay float, in the mesh's quantization space.
+    struct SkinnedVertex {
+        glm::vec4 Position;     // w is the bitangent sign
+        int16_t Normal[2];      // snorm16 octahedral
+        uint16_t TexCoords[2];  // half
+        int16_t Tangent[2];     // snorm16 octahedral
+    };
+
+private:
+    // Output buffer holding every mesh of one entity
+    struct SkinnedInstance {
+        const Model* model = nullptr;
+        unsigned int outputBuffer = 0;
+        std::vector<unsigned int> vertexArrays;
+        std::vector<int> baseVertices;
+        uint64_t lastFrame = 0;
+
+        // Inputs the output was skinned with, it is reused while they don't change
+        bool current = false;
+        uint64_t paletteVersion = 0;
+        int skeletonLOD = 0;
+        std::vector<float> morphWeights;
+
+        // Accumulated morph offsets (position, normal) of every morphed vertex of the model
+        unsigned int morphBuffer = 0;
+        std::vector<int> morphSlotOffsets;      // First slot of each mesh
+        std::vector<int> activeMorphOffsets;    // Slot offset of each mesh with an active target this frame, else -1
+        int morphSlotCount = 0;
+    };
+
+    struct Dispatch {
+        SkinnedInstance* instance;
+        const Model* model;
+        int skeletonLOD;
+        int boneOffset;
+        int boneCount;
+    };
+
+    // One morph target of one mesh with a nonzero weight. Targets of the same mesh move the
+    // same slots, so each goes into its own round and rounds are separated by barriers.
+    struct MorphJob {
+        const SkinnedInstance* instance;
+        const Mesh* mesh;
+        const MorphTarget* target;
+        int slotOffset;
+        float weight;
+        int round;
+    };
+
+    void PrepareMorphs(Dispatch& dispatch, const MorphTargetComponent& morphs);
+    void ExecuteMorphs();
+
+    void CreateInstance(SkinnedInstance& instance, const Model& model);
+    void DestroyInstance(SkinnedInstance& instance);
+
+    std::unique_ptr<ComputeShader> m_Shader;
+    std::unique_ptr<ComputeShader> m_MorphShader;
+
+    std::unordered_map<entt::entity, SkinnedInstance> m_Instances;
+    std::vector<Dispatch> m_Dispatches;
+    std::vector<MorphJob> m_MorphJobs;
+    uint64_t m_Frame = 0;
+    size_t m_SkinnedVertexCount = 0;
+    size_t m_MorphDeltaCount = 0;
+    size_t m_SkippedInstanceCount = 0;
+};
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace SockEngine {
 
@@ -16,6 +17,31 @@ struct BoneInfo {
 // Type alias for bone info map
 using BoneInfoMap = std::map<std::string, BoneInfo>;
 
+// Bones dropped by the reduced skeletons of a model. Bone names are matched by whole words: the
+// rig namespace (up to the last ':' or '|') is stripped, the rest is split on separators, digits
+// and camel case, and each word is compared without case. "LeftHandIndex1" and "index_01_l" both
+// contain "index", "Controller" does not contain "roll".
+struct SkeletonLODBones {
+    std::vector<std::string> reduced = {
+        "finger", "thumb", "index", "middle", "ring", "pinky", "twist", "roll",
+        "face", "jaw", "eye", "eyelid", "brow", "eyebrow", "lid", "lip", "lips", "cheek", "tongue", "teeth", "nose", "end"
+    };
+    std::vector<std::string> minimal = { "hand", "toe", "toes", "ball" }; // Also dropped from the minimal skeleton
+};
+
+// Reduced skeleton generated at import. Dropped bones (and everything below them) are not
+// evaluated and their vertex weights are moved to the nearest kept ancestor.
+struct SkeletonLOD {
+    std::vector<int> boneRemap;     // Bone ID -> palette index at this LOD, -1 if the bone is not in the hierarchy
+    std::vector<bool> boneKept;     // False for bones that are dropped at this LOD
+    int paletteSize = 0;            // Number of bone matrices uploaded at this LOD
+
+    bool IsKept(int boneID) const { return boneID >= 0 && boneID < static_cast<int>(boneKept.size()) && boneKept[boneID]; }
+};
+
+// Reduced skeletons of a model, from the least to the most reduced
+using SkeletonLODSet = std::vector<SkeletonLOD>;
+
 }
 
 #endif
\ No newline at end of file
@@ -1,12 +1,16 @@
 #include "Animation.h"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
 namespace SockEngine {
 
-Bone::Bone(const std::string& name, int ID, const aiNodeAnim* channel)
-    : m_Name(name), m_ID(ID), m_LocalTransform(1.0f)
+Bone::Bone(const std::string& name, int ID, const aiNodeAnim* channel,
+           const AnimationCompressionSettings& compression)
+    : m_Name(name), m_ID(ID)
 {
     m_NumPositions = channel->mNumPositionKeys;
     for (int positionIndex = 0; positionIndex < m_NumPositions; ++positionIndex) {
@@ -37,33 +41,147 @@ Bone::Bone(const std::string& name, int ID, const aiNodeAnim* channel)
         data.timeStamp = timeStamp;
         m_Scales.push_back(data);
     }
+
+    if (compression.enabled) {
+        Compress(compression);
+    }
+}
+
+Bone::Bone(const std::string& name, int ID)
+    : m_NumPositions(0), m_NumRotations(0), m_NumScalings(0), m_Name(name), m_ID(ID)
+{
+}
+
+Bone Bone::Truncate(float endTime) const {
+    Bone head(m_Name, m_ID);
+    head.m_IsCompressed = m_IsCompressed;
+
+    // Number of keys up to and including the first key at or after endTime,
+    // never fewer than the two needed to interpolate
+    auto keepCount = [endTime](int numKeys, auto keyTime) {
+        int count = 0;
+        while (count < numKeys && keyTime(count) < endTime) {
+            count++;
+        }
+        return std::min(numKeys, std::max(count + 1, 2));
+    };
+
+    auto truncateVector = [&](const CompressedVectorTrack& track) {
+        CompressedVectorTrack result = track;
+        if (!track.IsConstant()) {
+            int count = keepCount(track.keyTimes.NumKeys(), [&](int key) { return track.keyTimes.GetTime(key); });
+            result.keyTimes.times.resize(count);
+            result.values.resize(count * 3);
+        }
+        return result;
+    };
+
+    if (m_IsCompressed) {
+        head.m_CompressedPositions = truncateVector(m_CompressedPositions);
+        head.m_CompressedScales = truncateVector(m_CompressedScales);
+
+        head.m_CompressedRotations = m_CompressedRotations;
+        if (!m_CompressedRotations.IsConstant()) {
+            const CompressedKeyTimes& keyTimes = m_CompressedRotations.keyTimes;
+            int count = keepCount(keyTimes.NumKeys(), [&](int key) { return keyTimes.GetTime(key); });
+            head.m_CompressedRotations.keyTimes.times.resize(count);
+            head.m_CompressedRotations.values.resize(count * 3);
+        }
+
+        head.m_NumPositions = head.m_CompressedPositions.keyTimes.NumKeys();
+        head.m_NumRotations = head.m_CompressedRotations.keyTimes.NumKeys();
+        head.m_NumScalings = head.m_CompressedScales.keyTimes.NumKeys();
+        return head;
+    }
+
+    head.m_NumPositions = keepCount(m_NumPositions, [&](int key) { return m_Positions[key].timeStamp; });
+    head.m_NumRotations = keepCount(m_NumRotations, [&](int key) { return m_Rotations[key].timeStamp; });
+    head.m_NumScalings = keepCount(m_NumScalings, [&](int key) { return m_Scales[key].timeStamp; });
+    head.m_Positions.assign(m_Positions.begin(), m_Positions.begin() + head.m_NumPositions);
+    head.m_Rotations.assign(m_Rotations.begin(), m_Rotations.begin() + head.m_NumRotations);
+    head.m_Scales.assign(m_Scales.begin(), m_Scales.begin() + head.m_NumScalings);
+    return head;
+}
+
+void Bone::Compress(const AnimationCompressionSettings& compression) {
+    std::vector<float> times;
+    std::vector<glm::vec3> vectors;
+    std::vector<glm::quat> rotations;
+
+    for (const auto& key : m_Positions) {
+        times.push_back(key.timeStamp);
+        vectors.push_back(key.position);
+    }
+    m_CompressedPositions = AnimationCompression::CompressVectorTrack(times, vectors, compression.positionTolerance);
+
+    times.clear();
+    for (const auto& key : m_Rotations) {
+        times.push_back(key.timeStamp);
+        rotations.push_back(key.orientation);
+    }
+    m_CompressedRotations = AnimationCompression::CompressRotationTrack(times, rotations, compression.rotationTolerance);
+
+    times.clear();
+    vectors.clear();
+    for (const auto& key : m_Scales) {
+        times.push_back(key.timeStamp);
+        vectors.push_back(key.scale);
+    }
+    m_CompressedScales = AnimationCompression::CompressVectorTrack(times, vectors, compression.scaleTolerance);
+
+    // Release the raw keyframes
+    std::vector<PositionKeyframe>().swap(m_Positions);
+    std::vector<RotationKeyframe>().swap(m_Rotations);
+    std::vector<ScaleKeyframe>().swap(m_Scales);
+    m_NumPositions = m_CompressedPositions.keyTimes.NumKeys();
+    m_NumRotations = m_CompressedRotations.keyTimes.NumKeys();
+    m_NumScalings = m_CompressedScales.keyTimes.NumKeys();
+    m_IsCompressed = true;
+}
+
+bool Bone::IsConstant() const {
+    if (m_IsCompressed) {
+        return m_CompressedPositions.IsConstant() && m_CompressedRotations.IsConstant() && m_CompressedScales.IsConstant();
+    }
+    return m_NumPositions <= 1 && m_NumRotations <= 1 && m_NumScalings <= 1;
 }
 
-void Bone::Update(float animationTime) {
+size_t Bone::GetMemoryUsage() const {
+    if (m_IsCompressed) {
+        return m_CompressedPositions.GetMemoryUsage() + m_CompressedRotations.GetMemoryUsage() +
+               m_CompressedScales.GetMemoryUsage() + sizeof(glm::vec3) * 2 + sizeof(glm::quat);
+    }
+    return m_Positions.size() * sizeof(PositionKeyframe) + m_Rotations.size() * sizeof(RotationKeyframe) +
+           m_Scales.size() * sizeof(ScaleKeyframe);
+}
+
+glm::mat4 Bone::GetLocalTransform(float animationTime) const {
     glm::mat4 translation = InterpolatePosition(animationTime);
     glm::mat4 rotation = InterpolateRotation(animationTime);
     glm::mat4 scale = InterpolateScaling(animationTime);
-    m_LocalTransform = translation * rotation * scale;
+    return translation * rotation * scale;
 }
 
-glm::mat4 Bone::InterpolatePosition(float animationTime) {
+glm::vec3 Bone::SamplePosition(float animationTime) const {
+    if (m_IsCompressed)
+        return m_CompressedPositions.Sample(animationTime);
+
     if (1 == m_NumPositions)
-        return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
+        return m_Positions[0].position;
 
     int p0Index = GetPositionIndex(animationTime);
     int p1Index = p0Index + 1;
     float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp,
         m_Positions[p1Index].timeStamp, animationTime);
-    glm::vec3 finalPosition = glm::mix(m_Positions[p0Index].position,
-        m_Positions[p1Index].position, scaleFactor);
-    return glm::translate(glm::mat4(1.0f), finalPosition);
+    return glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position, scaleFactor);
 }
 
-glm::mat4 Bone::InterpolateRotation(float animationTime) {
-    if (1 == m_NumRotations) {
-        auto rotation = glm::normalize(m_Rotations[0].orientation);
-        return glm::mat4_cast(rotation);
-    }
+glm::quat Bone::SampleRotation(float animationTime) const {
+    if (m_IsCompressed)
+        return m_CompressedRotations.Sample(animationTime);
+
+    if (1 == m_NumRotations)
+        return glm::normalize(m_Rotations[0].orientation);
 
     int p0Index = GetRotationIndex(animationTime);
     int p1Index = p0Index + 1;
@@ -71,24 +189,36 @@ glm::mat4 Bone::InterpolateRotation(float animationTime) {
         m_Rotations[p1Index].timeStamp, animationTime);
     glm::quat finalRotation = glm::slerp(m_Rotations[p0Index].orientation,
         m_Rotations[p1Index].orientation, scaleFactor);
-    finalRotation = glm::normalize(finalRotation);
-    return glm::mat4_cast(finalRotation);
+    return glm::normalize(finalRotation);
 }
 
-glm::mat4 Bone::InterpolateScaling(float animationTime) {
+glm::vec3 Bone::SampleScale(float animationTime) const {
+    if (m_IsCompressed)
+        return m_CompressedScales.Sample(animationTime);
+
     if (1 == m_NumScalings)
-        return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
+        return m_Scales[0].scale;
 
     int p0Index = GetScaleIndex(animationTime);
     int p1Index = p0Index + 1;
     float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp,
         m_Scales[p1Index].timeStamp, animationTime);
-    glm::vec3 finalScale = glm::mix(m_Scales[p0Index].scale,
-        m_Scales[p1Index].scale, scaleFactor);
-    return glm::scale(glm::mat4(1.0f), finalScale);
+    return glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale, scaleFactor);
+}
+
+glm::mat4 Bone::InterpolatePosition(float animationTime) const {
+    return glm::translate(glm::mat4(1.0f), SamplePosition(animationTime));
+}
+
+glm::mat4 Bone::InterpolateRotation(float animationTime) const {
+    return glm::mat4_cast(SampleRotation(animationTime));
+}
+
+glm::mat4 Bone::InterpolateScaling(float animationTime) const {
+    return glm::scale(glm::mat4(1.0f), SampleScale(animationTime));
 }
 
-int Bone::GetPositionIndex(float animationTime) {
+int Bone::GetPositionIndex(float animationTime) const {
     for (int index = 0; index < m_NumPositions - 1; ++index) {
         if (animationTime < m_Positions[index + 1].timeStamp)
             return index;
@@ -96,7 +226,7 @@ int Bone::GetPositionIndex(float animationTime) {
     return 0;
 }
 
-int Bone::GetRotationIndex(float animationTime) {
+int Bone::GetRotationIndex(float animationTime) const {
     for (int index = 0; index < m_NumRotations - 1; ++index) {
         if (animationTime < m_Rotations[index + 1].timeStamp)
             return index;
@@ -104,7 +234,7 @@ int Bone::GetRotationIndex(float animationTime) {
     return 0;
 }
 
-int Bone::GetScaleIndex(float animationTime) {
+int Bone::GetScaleIndex(float animationTime) const {
     for (int index = 0; index < m_NumScalings - 1; ++index) {
         if (animationTime < m_Scales[index + 1].timeStamp)
             return index;
@@ -112,7 +242,7 @@ int Bone::GetScaleIndex(float animationTime) {
     return 0;
 }
 
-float Bone::GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) {
+float Bone::GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) const {
     float midWayLength = animationTime - lastTimeStamp;
     float framesDiff = nextTimeStamp - lastTimeStamp;
     float scaleFactor = midWayLength / framesDiff;
@@ -120,7 +250,8 @@ float Bone::GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float anima
 }
 
 Animation::Animation(const std::string& animationPath, 
-                    const BoneInfoMap& boneInfoMap) {
+                    const BoneInfoMap& boneInfoMap,
+                    const AnimationCompressionSettings& compression) {
     Assimp::Importer importer;
     const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
     
@@ -139,10 +270,81 @@ Animation::Animation(const std::string& animationPath,
     m_TicksPerSecond = animation->mTicksPerSecond;
     
     ReadHierarchyData(m_RootNode, scene->mRootNode);
-    ReadBonesFromAnimation(animation, boneInfoMap);
+    ReadBonesFromAnimation(animation, boneInfoMap, compression);
+
+    if (compression.enabled) {
+        RemoveBindPoseChannels(compression);
+    }
+
+    FlattenHierarchy(m_RootNode, -1);
+}
+
+size_t Animation::GetKeyframeMemory() const {
+    size_t total = 0;
+    for (const auto& bone : m_Bones) {
+        total += bone.GetMemoryUsage();
+    }
+    return total;
 }
 
-Bone* Animation::FindBone(const std::string& name) {
+std::shared_ptr<Animation> Animation::CreateHead(float endTime) const {
+    auto head = std::make_shared<Animation>();
+    head->m_Duration = std::min(endTime, m_Duration);
+    head->m_TicksPerSecond = m_TicksPerSecond;
+    head->m_Nodes = m_Nodes;
+    head->m_HierarchySignature = m_HierarchySignature;
+    head->m_BoneCount = m_BoneCount;
+
+    head->m_Bones.reserve(m_Bones.size());
+    for (const auto& bone : m_Bones) {
+        head->m_Bones.push_back(bone.Truncate(head->m_Duration));
+    }
+    return head;
+}
+
+glm::vec3 Animation::ComputeRootMotionExtent() const {
+    // Only nodes above the first deforming bone of each branch are needed
+    std::vector<bool> belowBone(m_Nodes.size(), false);
+    for (size_t i = 0; i < m_Nodes.size(); i++) {
+        int parent = m_Nodes[i].parent;
+        belowBone[i] = parent >= 0 && (belowBone[parent] || m_Nodes[parent].boneID >= 0);
+    }
+
+    std::vector<glm::mat4> globalTransforms(m_Nodes.size(), glm::mat4(1.0f));
+    std::vector<glm::vec3> rootMin(m_Nodes.size(), glm::vec3(FLT_MAX));
+    std::vector<glm::vec3> rootMax(m_Nodes.size(), glm::vec3(-FLT_MAX));
+
+    for (int sample = 0; sample <= ROOT_MOTION_SAMPLES; sample++) {
+        float time = m_Duration * static_cast<float>(sample) / ROOT_MOTION_SAMPLES;
+        for (size_t i = 0; i < m_Nodes.size(); i++) {
+            if (belowBone[i]) {
+                continue;
+            }
+
+            const SkeletonNode& node = m_Nodes[i];
+            glm::mat4 localTransform = node.channel >= 0 ? m_Bones[node.channel].GetLocalTransform(time) :
+                glm::translate(glm::mat4(1.0f), node.bindPosition) * glm::mat4_cast(node.bindRotation) *
+                glm::scale(glm::mat4(1.0f), node.bindScale);
+            globalTransforms[i] = node.parent >= 0 ? globalTransforms[node.parent] * localTransform : localTransform;
+
+            if (node.boneID >= 0) {
+                glm::vec3 position = glm::vec3(globalTransforms[i][3]);
+                rootMin[i] = glm::min(rootMin[i], position);
+                rootMax[i] = glm::max(rootMax[i], position);
+            }
+        }
+    }
+
+    glm::vec3 extent(0.0f);
+    for (size_t i = 0; i < m_Nodes.size(); i++) {
+        if (!belowBone[i] && m_Nodes[i].boneID >= 0) {
+            extent = glm::max(extent, rootMax[i] - rootMin[i]);
+        }
+    }
+    return extent;
+}
+
+const Bone* Animation::FindBone(const std::string& name) const {
     auto iter = std::find_if(m_Bones.begin(), m_Bones.end(),
         [&](const Bone& bone) {
             return bone.m_Name == name;
@@ -152,11 +354,15 @@ Bone* Animation::FindBone(const std::string& name) {
 }
 
 void Animation::ReadBonesFromAnimation(const aiAnimation* animation, 
-                                      const BoneInfoMap& boneInfoMap) {
+                                      const BoneInfoMap& boneInfoMap,
+                                      const AnimationCompressionSettings& compression) {
     int size = animation->mNumChannels;
     
     // Copy the provided bone info map
     m_BoneInfoMap = boneInfoMap;
+    for (const auto& [name, info] : m_BoneInfoMap) {
+        m_BoneCount = std::max(m_BoneCount, info.id + 1);
+    }
 
     for (int i = 0; i < size; i++) {
         auto channel = animation->mChannels[i];
@@ -165,7 +371,7 @@ void Animation::ReadBonesFromAnimation(const aiAnimation* animation,
         // Check if this bone exists in the provided bone info map
         auto it = m_BoneInfoMap.find(boneName);
         if (it != m_BoneInfoMap.end()) {
-            m_Bones.push_back(Bone(channel->mNodeName.data, it->second.id, channel));
+            m_Bones.push_back(Bone(channel->mNodeName.data, it->second.id, channel, compression));
         } else {
             // Clean the bone name
             std::string cleanedName = boneName;
@@ -182,7 +388,7 @@ void Animation::ReadBonesFromAnimation(const aiAnimation* animation,
             // Try to find with cleaned name
             auto cleanIt = m_BoneInfoMap.find(cleanedName);
             if (cleanIt != m_BoneInfoMap.end()) {
-                m_Bones.push_back(Bone(cleanedName, cleanIt->second.id, channel));
+                m_Bones.push_back(Bone(cleanedName, cleanIt->second.id, channel, compression));
             } else {
                 std::cout << "WARNING: Animation bone '" << boneName << "' (cleaned: '" << cleanedName << "') not found in model bone info" << std::endl;
             }
@@ -207,78 +413,440 @@ void Animation::ReadHierarchyData(AssimpNodeData& dest, const aiNode* src) {
     }
 }
 
-Animator::Animator(Animation* animation) {
+void Animation::RemoveBindPoseChannels(const AnimationCompressionSettings& compression) {
+    auto matchesBindPose = [&](const Bone& bone) {
+        if (!bone.IsConstant()) {
+            return false;
+        }
+
+        const AssimpNodeData* node = FindNode(m_RootNode, bone.m_Name);
+        if (!node) {
+            return false;
+        }
+
+        // A constant channel equal to the bind transform changes nothing, the node's
+        // own transformation is used when no channel is found
+        glm::mat4 local = bone.GetLocalTransform(0.0f);
+        for (int column = 0; column < 4; column++) {
+            float tolerance = column == 3 ? compression.positionTolerance : compression.rotationTolerance;
+            for (int row = 0; row < 3; row++) {
+                if (std::abs(local[column][row] - node->transformation[column][row]) > tolerance) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    m_Bones.erase(std::remove_if(m_Bones.begin(), m_Bones.end(), matchesBindPose), m_Bones.end());
+}
+
+void Animation::FlattenHierarchy(const AssimpNodeData& node, int parent) {
+    if (parent < 0) {
+        m_Nodes.clear();
+        m_HierarchySignature = 14695981039346656037ull;
+    }
+
+    SkeletonNode flatNode;
+    flatNode.name = node.name;
+    flatNode.parent = parent;
+
+    for (size_t i = 0; i < m_Bones.size(); i++) {
+        if (m_Bones[i].m_Name == node.name) {
+            flatNode.channel = static_cast<int>(i);
+            break;
+        }
+    }
+
+    auto boneInfo = m_BoneInfoMap.find(node.name);
+    if (boneInfo != m_BoneInfoMap.end()) {
+        flatNode.boneID = boneInfo->second.id;
+        flatNode.offset = boneInfo->second.offset;
+    }
+
+    // Split the bind transform into translation, rotation and scale for blending
+    const glm::mat4& transform = node.transformation;
+    flatNode.bindPosition = glm::vec3(transform[3]);
+    flatNode.bindScale = glm::vec3(glm::length(glm::vec3(transform[0])),
+                                   glm::length(glm::vec3(transform[1])),
+                                   glm::length(glm::vec3(transform[2])));
+    glm::mat3 rotation(glm::vec3(transform[0]) / flatNode.bindScale.x,
+                       glm::vec3(transform[1]) / flatNode.bindScale.y,
+                       glm::vec3(transform[2]) / flatNode.bindScale.z);
+    flatNode.bindRotation = glm::normalize(glm::quat_cast(rotation));
+
+    // FNV-1a over the node names and parent indices
+    for (char c : node.name) {
+        m_HierarchySignature = (m_HierarchySignature ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    m_HierarchySignature = (m_HierarchySignature ^ static_cast<uint64_t>(parent + 1)) * 1099511628211ull;
+
+    int index = static_cast<int>(m_Nodes.size());
+    m_Nodes.push_back(flatNode);
+
+    for (const auto& child : node.children) {
+        FlattenHierarchy(child, index);
+    }
+}
+
+BoneMask Animation::CreateBoneMask(const std::vector<std::string>& rootNodes) const {
+    BoneMask mask;
+    mask.weights.assign((m_Nodes.size() + 3) / 4 * 4, 0.0f);
+
+    // Parents come first, so a single pass propagates the weight down each subtree
+    for (size_t i = 0; i < m_Nodes.size(); i++) {
+        const SkeletonNode& node = m_Nodes[i];
+        bool isRoot = std::find(rootNodes.begin(), rootNodes.end(), node.name) != rootNodes.end();
+        bool parentMasked = node.parent >= 0 && mask.weights[node.parent] > 0.0f;
+        mask.weights[i] = isRoot || parentMasked ? 1.0f : 0.0f;
+    }
+
+    return mask;
+}
+
+const AssimpNodeData* Animation::FindNode(const AssimpNodeData& node, const std::string& name) {
+    if (node.name == name) {
+        return &node;
+    }
+
+    for (const auto& child : node.children) {
+        if (const AssimpNodeData* found = FindNode(child, name)) {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+Animator::Animator(const Animation* animation) {
     m_CurrentTime = 0.0;
     m_CurrentAnimation = animation;
-    m_FinalBoneMatrices.reserve(100);
     m_HasEnded = false;
 
-    for (int i = 0; i < 100; i++)
-        m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+    ResizePalette();
+    MarkPaletteChanged();
+}
+
+void Animator::MarkPaletteChanged() {
+    // Shared by every animator, a replaced animator never repeats a version of the old one
+    static std::atomic<uint64_t> nextVersion { 1 };
+    m_PaletteVersion = nextVersion++;
 }
 
 void Animator::UpdateAnimation(float dt, bool looping) {
+    if (AdvanceTime(dt, looping)) {
+        EvaluatePose();
+    }
+}
+
+bool Animator::AdvanceTime(float dt, bool looping) {
     m_DeltaTime = dt;
-    if (m_CurrentAnimation) {
-        if (!m_HasEnded) {
-            m_CurrentTime += m_CurrentAnimation->m_TicksPerSecond * dt;
+    if (!m_CurrentAnimation) {
+        return false;
+    }
+
+    // Secondary clips always loop
+    auto advance = [dt](const Animation* animation, float& time) {
+        if (animation && animation->m_Duration > 0.0f) {
+            time = fmod(time + animation->m_TicksPerSecond * dt, animation->m_Duration);
         }
-        
-        // Only wrap time if looping is enabled
-        if (looping) {
-            m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->m_Duration);
-            m_HasEnded = false;  // Reset end state for looping animations
-            CalculateBoneTransform(&m_CurrentAnimation->m_RootNode, glm::mat4(1.0f));
+    };
+
+    if (m_FadeAnimation) {
+        m_FadeElapsed += dt;
+        if (m_FadeElapsed >= m_FadeDuration) {
+            m_FadeAnimation = nullptr;
         } else {
-            // Check if animation has ended
-            if (m_CurrentTime >= m_CurrentAnimation->m_Duration && !m_HasEnded) {
-                m_HasEnded = true;
-                ResetToFirstFrame();
-            } else if (!m_HasEnded) {
-                CalculateBoneTransform(&m_CurrentAnimation->m_RootNode, glm::mat4(1.0f));
+            advance(m_FadeAnimation, m_FadeTime);
+        }
+    }
+    for (size_t i = 1; i < m_BlendInputs.size(); i++) {
+        advance(m_BlendInputs[i].animation, m_BlendInputs[i].time);
+    }
+    for (auto& layer : m_Layers) {
+        advance(layer.animation, layer.time);
+    }
+
+    if (!m_HasEnded) {
+        m_CurrentTime += m_CurrentAnimation->m_TicksPerSecond * dt;
+    }
+    
+    // Only wrap time if looping is enabled
+    if (looping) {
+        m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->m_Duration);
+        m_HasEnded = false;  // Reset end state for looping animations
+        return true;
+    }
+
+    // Check if animation has ended
+    if (m_CurrentTime >= m_CurrentAnimation->m_Duration && !m_HasEnded) {
+        m_HasEnded = true;
+        ResetToFirstFrame();
+        return false;
+    }
+    return !m_HasEnded;
+}
+
+void Animator::EvaluatePose() {
+    if (!m_CurrentAnimation || m_CurrentAnimation->m_Nodes.empty()) {
+        return;
+    }
+
+    PooledPose pose(static_cast<int>(m_CurrentAnimation->m_Nodes.size()));
+    BuildPose(*pose);
+    PoseBlend::ComputeBoneMatrices(*m_CurrentAnimation, *pose, GetActiveNodes(), m_SkeletonLOD, m_FinalBoneMatrices);
+    MarkPaletteChanged();
+}
+
+void Animator::BuildPose(Pose& pose) {
+    const std::vector<char>* activeNodes = GetActiveNodes();
+    int nodeCount = static_cast<int>(m_CurrentAnimation->m_Nodes.size());
+
+    // Base pose, either the current clip or the N-way blend
+    if (m_BlendInputs.size() > 1) {
+        PosePool& pool = PosePool::Get();
+        Pose* inputPoses[MAX_BLEND_INPUTS];
+        float weights[MAX_BLEND_INPUTS];
+        int count = 0;
+
+        for (size_t i = 0; i < m_BlendInputs.size(); i++) {
+            const BlendInput& input = m_BlendInputs[i];
+            if (!m_CurrentAnimation->SharesHierarchy(*input.animation)) {
+                continue;
             }
+
+            // The first input is the current clip and follows the playback time
+            inputPoses[count] = pool.Acquire(nodeCount);
+            PoseBlend::Sample(*input.animation, i == 0 ? m_CurrentTime : input.time, activeNodes, *inputPoses[count]);
+            weights[count] = input.weight;
+            count++;
+        }
+
+        PoseBlend::BlendWeighted(inputPoses, weights, count, pose);
+        for (int i = 0; i < count; i++) {
+            pool.Release(inputPoses[i]);
         }
+    } else {
+        PoseBlend::Sample(*m_CurrentAnimation, m_CurrentTime, activeNodes, pose);
+    }
+
+    // Crossfade from the previous clip
+    if (m_FadeAnimation && m_FadeDuration > 0.0f && m_CurrentAnimation->SharesHierarchy(*m_FadeAnimation)) {
+        PooledPose fadePose(nodeCount);
+        PoseBlend::Sample(*m_FadeAnimation, m_FadeTime, activeNodes, *fadePose);
+        float factor = glm::clamp(m_FadeElapsed / m_FadeDuration, 0.0f, 1.0f);
+        PoseBlend::Blend(*fadePose, pose, factor, nullptr, pose);
+    }
+
+    // Layers
+    for (const auto& layer : m_Layers) {
+        if (layer.weight <= 0.0f || !m_CurrentAnimation->SharesHierarchy(*layer.animation)) {
+            continue;
+        }
+
+        PooledPose layerPose(nodeCount);
+        PoseBlend::Sample(*layer.animation, layer.time, activeNodes, *layerPose);
+        if (layer.additive) {
+            PoseBlend::MakeAdditive(*layerPose, layer.reference, *layerPose);
+            PoseBlend::ApplyAdditive(pose, *layerPose, layer.weight, layer.mask.get());
+        } else {
+            PoseBlend::Blend(pose, *layerPose, layer.weight, layer.mask.get(), pose);
+        }
+    }
+}
+
+const std::vector<char>* Animator::GetActiveNodes() {
+    if (!m_SkeletonLOD) {
+        return nullptr;
+    }
+
+    if (m_ActiveNodesAnimation != m_CurrentAnimation || m_ActiveNodesSkeleton != m_SkeletonLOD) {
+        // A node is evaluated if its parent is and it is not a dropped bone
+        const auto& nodes = m_CurrentAnimation->m_Nodes;
+        m_ActiveNodes.assign(nodes.size(), 1);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            bool parentActive = nodes[i].parent < 0 || m_ActiveNodes[nodes[i].parent];
+            bool dropped = nodes[i].boneID >= 0 && !m_SkeletonLOD->IsKept(nodes[i].boneID);
+            m_ActiveNodes[i] = parentActive && !dropped;
+        }
+        m_ActiveNodesAnimation = m_CurrentAnimation;
+        m_ActiveNodesSkeleton = m_SkeletonLOD;
+    }
+    return &m_ActiveNodes;
+}
+
+bool Animator::IsCompatible(const Animation* animation) const {
+    if (!animation || !animation->IsValid()) {
+        return false;
+    }
+    if (m_CurrentAnimation && !m_CurrentAnimation->SharesHierarchy(*animation)) {
+        std::cout << "WARNING: Cannot blend animations with different node hierarchies" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Animator::EvaluatePoseAt(float animationTime) {
+    float savedTime = m_CurrentTime;
+    m_CurrentTime = animationTime;
+    EvaluatePose();
+    m_CurrentTime = savedTime;
+}
+
+void Animator::EvaluateKeyPose() {
+    EvaluatePose();
+
+    std::swap(m_PreviousKeyPose, m_NextKeyPose);
+    m_NextKeyPose = m_FinalBoneMatrices;
+    if (m_PreviousKeyPose.size() != m_NextKeyPose.size()) {
+        m_PreviousKeyPose = m_NextKeyPose;
     }
 }
 
-void Animator::PlayAnimation(Animation* pAnimation) {
+void Animator::InterpolateKeyPoses(float factor) {
+    if (!HasKeyPoses()) {
+        return;
+    }
+
+    for (size_t i = 0; i < m_FinalBoneMatrices.size(); i++) {
+        m_FinalBoneMatrices[i] = m_PreviousKeyPose[i] + (m_NextKeyPose[i] - m_PreviousKeyPose[i]) * factor;
+    }
+    MarkPaletteChanged();
+}
+
+void Animator::ResetKeyPoses() {
+    m_PreviousKeyPose.clear();
+    m_NextKeyPose.clear();
+}
+
+void Animator::PlayAnimation(const Animation* pAnimation) {
     m_CurrentAnimation = pAnimation;
     m_CurrentTime = 0.0f;
     m_HasEnded = false;
+    m_FadeAnimation = nullptr;
+    m_BlendInputs.clear();
+    ResizePalette();
+    ResetKeyPoses();
 }
 
-void Animator::CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform) {
-    std::string nodeName = node->name;
-    glm::mat4 nodeTransform = node->transformation;
+void Animator::ReplaceAnimation(const Animation* pAnimation) {
+    if (!m_CurrentAnimation || !IsCompatible(pAnimation)) {
+        PlayAnimation(pAnimation);
+        return;
+    }
 
-    Bone* bone = m_CurrentAnimation->FindBone(nodeName);
+    if (!m_BlendInputs.empty() && m_BlendInputs[0].animation == m_CurrentAnimation) {
+        m_BlendInputs[0].animation = pAnimation;
+    }
+    m_CurrentAnimation = pAnimation;
+    m_CurrentTime = glm::clamp(m_CurrentTime, 0.0f, pAnimation->m_Duration);
+}
 
-    if (bone) {
-        bone->Update(m_CurrentTime);
-        nodeTransform = bone->m_LocalTransform;
+void Animator::CrossfadeTo(const Animation* pAnimation, float duration) {
+    if (!m_CurrentAnimation || duration <= 0.0f || !IsCompatible(pAnimation)) {
+        PlayAnimation(pAnimation);
+        return;
     }
 
-    glm::mat4 globalTransformation = parentTransform * nodeTransform;
+    // Fading out of an N-way blend fades out of its first input
+    m_FadeAnimation = m_CurrentAnimation;
+    m_FadeTime = m_CurrentTime;
+    m_FadeDuration = duration;
+    m_FadeElapsed = 0.0f;
+    m_BlendInputs.clear();
+
+    m_CurrentAnimation = pAnimation;
+    m_CurrentTime = 0.0f;
+    m_HasEnded = false;
+}
+
+void Animator::SetBlendInputs(const std::vector<BlendInput>& inputs) {
+    m_BlendInputs.clear();
+    if (inputs.empty() || !inputs[0].animation || !inputs[0].animation->IsValid()) {
+        return;
+    }
 
-    auto boneInfoMap = m_CurrentAnimation->m_BoneInfoMap;
-    if (boneInfoMap.find(nodeName) != boneInfoMap.end()) {
-        int index = boneInfoMap[nodeName].id;
-        glm::mat4 offset = boneInfoMap[nodeName].offset;
-        m_FinalBoneMatrices[index] = globalTransformation * offset;
+    // The first input drives the playback time and the node layout
+    if (m_CurrentAnimation != inputs[0].animation) {
+        m_CurrentAnimation = inputs[0].animation;
+        m_CurrentTime = inputs[0].time;
+        m_HasEnded = false;
+        ResizePalette();
+        ResetKeyPoses();
     }
+    m_BlendInputs.push_back(inputs[0]);
 
-    for (int i = 0; i < node->childrenCount; i++)
-        CalculateBoneTransform(&node->children[i], globalTransformation);
+    for (size_t i = 1; i < inputs.size() && m_BlendInputs.size() < MAX_BLEND_INPUTS; i++) {
+        if (IsCompatible(inputs[i].animation)) {
+            m_BlendInputs.push_back(inputs[i]);
+        }
+    }
 }
 
-void Animator::ResetToFirstFrame() {
-    if (m_CurrentAnimation) {
-        // Calculate transforms for first frame
-        float savedTime = m_CurrentTime;
-        m_CurrentTime = 0.0f;
-        CalculateBoneTransform(&m_CurrentAnimation->m_RootNode, glm::mat4(1.0f));
-        m_CurrentTime = savedTime;  // Restore time for UI purposes
+void Animator::SetBlendWeight(size_t input, float weight) {
+    if (input < m_BlendInputs.size()) {
+        m_BlendInputs[input].weight = weight;
     }
 }
 
+int Animator::AddLayer(const Animation* pAnimation, float weight, bool additive, std::shared_ptr<const BoneMask> mask) {
+    if (!IsCompatible(pAnimation)) {
+        return -1;
+    }
+
+    AnimationLayer layer;
+    layer.animation = pAnimation;
+    layer.weight = weight;
+    layer.additive = additive;
+    layer.mask = std::move(mask);
+    if (additive) {
+        PoseBlend::Sample(*pAnimation, 0.0f, nullptr, layer.reference);
+    }
+
+    m_Layers.push_back(std::move(layer));
+    return static_cast<int>(m_Layers.size()) - 1;
+}
+
+void Animator::SetLayerWeight(int layer, float weight) {
+    if (layer >= 0 && layer < static_cast<int>(m_Layers.size())) {
+        m_Layers[layer].weight = weight;
+    }
+}
+
+void Animator::ClearLayers() {
+    m_Layers.clear();
+}
+
+void Animator::SetSkeletonLOD(const SkeletonLOD* skeletonLOD) {
+    if (skeletonLOD == m_SkeletonLOD) {
+        return;
+    }
+
+    // Palette layouts differ between skeletons, so start over from an identity palette
+    m_SkeletonLOD = skeletonLOD;
+    m_FinalBoneMatrices.clear();
+    ResizePalette();
+    ResetKeyPoses();
+    MarkPaletteChanged();
+}
+
+void Animator::ResizePalette() {
+    // The palette holds exactly the bones of the skeleton, there is no fixed upper limit
+    size_t paletteSize = 0;
+    if (m_SkeletonLOD) {
+        paletteSize = m_SkeletonLOD->paletteSize;
+    } else if (m_CurrentAnimation) {
+        paletteSize = m_CurrentAnimation->GetBoneCount();
+    }
+
+    if (m_FinalBoneMatrices.size() != paletteSize) {
+        m_FinalBoneMatrices.assign(paletteSize, glm::mat4(1.0f));
+        MarkPaletteChanged();
+    }
+}
+
+void Animator::ResetToFirstFrame() {
+    // Calculate transforms for first frame, the time is kept for UI purposes
+    EvaluatePoseAt(0.0f);
+}
+
 }
\ No newline at end of file
@@ -3,12 +3,16 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <string>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <assimp/scene.h>
 #include "AnimData.h"
+#include "AnimationCompression.h"
+#include "AnimationPose.h"
 
 namespace SockEngine {
 
@@ -40,36 +44,63 @@ public:
     int m_NumRotations;
     int m_NumScalings;
 
-    glm::mat4 m_LocalTransform;
+    // Compressed tracks, sampled instead of the raw keyframes when m_IsCompressed is set
+    bool m_IsCompressed = false;
+    CompressedVectorTrack m_CompressedPositions;
+    CompressedRotationTrack m_CompressedRotations;
+    CompressedVectorTrack m_CompressedScales;
+
     std::string m_Name;
     int m_ID;
 
-    Bone(const std::string& name, int ID, const aiNodeAnim* channel);
+    Bone(const std::string& name, int ID, const aiNodeAnim* channel,
+         const AnimationCompressionSettings& compression = AnimationCompressionSettings());
+
+    // Bone without keys, filled in by the clip file reader
+    Bone(const std::string& name, int ID);
+
+    // Copy holding only the keys needed to sample the bone up to endTime
+    Bone Truncate(float endTime) const;
+
+    // True if every channel of the bone holds a single key
+    bool IsConstant() const;
+
+    // Bytes used by the keyframe data
+    size_t GetMemoryUsage() const;
+
+    // Interpolates between keyframes and returns the local transform at the given time.
+    // Sampling is const so a single Bone can be shared by every Animator playing its clip.
+    glm::mat4 GetLocalTransform(float animationTime) const;
 
-    // Interpolates between keyframes and updates m_LocalTransform
-    void Update(float animationTime);
+    // Sample the individual channels at the given time
+    glm::vec3 SamplePosition(float animationTime) const;
+    glm::quat SampleRotation(float animationTime) const;
+    glm::vec3 SampleScale(float animationTime) const;
 
     // Get the current position interpolated between keyframes
-    glm::mat4 InterpolatePosition(float animationTime);
+    glm::mat4 InterpolatePosition(float animationTime) const;
     
     // Get the current rotation interpolated between keyframes
-    glm::mat4 InterpolateRotation(float animationTime);
+    glm::mat4 InterpolateRotation(float animationTime) const;
     
     // Get the current scale interpolated between keyframes
-    glm::mat4 InterpolateScaling(float animationTime);
+    glm::mat4 InterpolateScaling(float animationTime) const;
 
 private:
+    // Replaces the raw keyframes with compressed tracks
+    void Compress(const AnimationCompressionSettings& compression);
+
     // Get the index of the position keyframe before the current time
-    int GetPositionIndex(float animationTime);
+    int GetPositionIndex(float animationTime) const;
     
     // Get the index of the rotation keyframe before the current time
-    int GetRotationIndex(float animationTime);
+    int GetRotationIndex(float animationTime) const;
     
     // Get the index of the scale keyframe before the current time
-    int GetScaleIndex(float animationTime);
+    int GetScaleIndex(float animationTime) const;
 
     // Calculate interpolation factor between keyframes
-    float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime);
+    float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) const;
 };
 
 // Helper structure to store node hierarchy
@@ -80,58 +111,212 @@ struct AssimpNodeData {
     std::vector<AssimpNodeData> children;
 };
 
+// Node of the flattened hierarchy. Nodes are stored depth-first, so a parent always comes
+// before its children and the pose can be evaluated in a single forward pass.
+struct SkeletonNode {
+    std::string name;
+    int parent = -1;                    // Index of the parent node, -1 for the root
+    int channel = -1;                   // Index into m_Bones, -1 if the clip does not animate the node
+    int boneID = -1;                    // Index in finalBoneMatrices, -1 if the node does not deform the mesh
+    glm::mat4 offset = glm::mat4(1.0f); // Offset matrix of the bone
+    glm::vec3 bindPosition = glm::vec3(0.0f);           // Bind transform, used when the node is not animated
+    glm::quat bindRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 bindScale = glm::vec3(1.0f);
+};
+
 // Represents an animation sequence
 class Animation {
 public:
-    float m_Duration;
-    int m_TicksPerSecond;
+    float m_Duration = 0.0f;
+    int m_TicksPerSecond = 0;
     std::vector<Bone> m_Bones;
     AssimpNodeData m_RootNode;
     BoneInfoMap m_BoneInfoMap;
+    std::vector<SkeletonNode> m_Nodes;  // Flattened m_RootNode
+    uint64_t m_HierarchySignature = 0;  // Hash of the node names and parents
+    int m_BoneCount = 0;                // Size of the full skeleton's palette
+
+    static constexpr int ROOT_MOTION_SAMPLES = 32;
 
     Animation() = default;
     
-    // Constructor that loads from file with provided bone info
+    // Constructor that loads from file with provided bone info.
+    // Keyframes are compressed at import unless compression is disabled.
     Animation(const std::string& animationPath, 
-              const BoneInfoMap& boneInfoMap);
+              const BoneInfoMap& boneInfoMap,
+              const AnimationCompressionSettings& compression = AnimationCompressionSettings());
 
     // Find a bone in the animation by name
-    Bone* FindBone(const std::string& name);
+    const Bone* FindBone(const std::string& name) const;
+
+    // True if the clip was imported successfully
+    bool IsValid() const { return m_Duration > 0.0f; }
+
+    // Bytes used by the keyframe data of every bone
+    size_t GetKeyframeMemory() const;
+
+    // Number of matrices in the full skeleton's palette
+    int GetBoneCount() const { return m_BoneCount; }
+
+    // Copy of the first endTime ticks of the clip. It shares the hierarchy of this clip,
+    // so it blends and crossfades with the same clips.
+    std::shared_ptr<Animation> CreateHead(float endTime) const;
+
+    // Size of the model-space box swept by the skeleton's root bones over the clip, sampled at
+    // ROOT_MOTION_SAMPLES evenly spaced times. Bounds of a frozen pose grown by this much on every
+    // side contain the clip's root motion from any playback time.
+    glm::vec3 ComputeRootMotionExtent() const;
+
+    // True if poses of both clips use the same node layout and can be blended
+    bool SharesHierarchy(const Animation& other) const {
+        return m_HierarchySignature == other.m_HierarchySignature && m_Nodes.size() == other.m_Nodes.size();
+    }
+
+    // Mask that is one for the given nodes and everything below them, zero elsewhere
+    BoneMask CreateBoneMask(const std::vector<std::string>& rootNodes) const;
 
 private:
     // Read keyframes from assimp animation
     void ReadBonesFromAnimation(const aiAnimation* animation, 
-                               const BoneInfoMap& boneInfoMap);
+                               const BoneInfoMap& boneInfoMap,
+                               const AnimationCompressionSettings& compression);
     
     // Read hierarchy data from assimp node
     void ReadHierarchyData(AssimpNodeData& dest, const aiNode* src);
+
+    // Drop constant channels that only reproduce the node's bind transform
+    void RemoveBindPoseChannels(const AnimationCompressionSettings& compression);
+
+    // Build m_Nodes from m_RootNode once the channels are final
+    void FlattenHierarchy(const AssimpNodeData& node, int parent);
+
+    // Find a node in the hierarchy by name
+    static const AssimpNodeData* FindNode(const AssimpNodeData& node, const std::string& name);
+};
+
+// Additional clip blended on top of the base pose
+struct AnimationLayer {
+    const Animation* animation = nullptr;
+    float time = 0.0f;
+    float weight = 1.0f;
+    bool additive = false;                  // Add the clip's motion relative to its first frame instead of overriding
+    std::shared_ptr<const BoneMask> mask;   // Optional per-node weights
+    Pose reference;                         // First frame of an additive clip
+};
+
+// Clip taking part in a weighted N-way blend
+struct BlendInput {
+    const Animation* animation = nullptr;
+    float time = 0.0f;
+    float weight = 1.0f;
 };
 
 // Handles animation playback and bone matrix calculation
 class Animator {
 public:
+    static constexpr size_t MAX_BLEND_INPUTS = 8;
+
     std::vector<glm::mat4> m_FinalBoneMatrices;
-    Animation* m_CurrentAnimation;
+    const Animation* m_CurrentAnimation;
     float m_CurrentTime;
     float m_DeltaTime;
     bool m_HasEnded = false;
 
-    Animator(Animation* animation);
+    Animator(const Animation* animation);
 
     // Update animation and calculate bone matrices
     void UpdateAnimation(float dt, bool looping = true);
 
-    // Play a specific animation
-    void PlayAnimation(Animation* pAnimation);
+    // Advance the playback time without evaluating the pose.
+    // Returns true if the pose needs to be evaluated for the new time.
+    bool AdvanceTime(float dt, bool looping = true);
+
+    // Evaluate the pose at the current time into m_FinalBoneMatrices
+    void EvaluatePose();
+
+    // Evaluate the pose at the given time without changing the playback time
+    void EvaluatePoseAt(float animationTime);
+
+    // Reduced-rate evaluation: samples a key pose at the current time. Between key poses
+    // InterpolateKeyPoses blends the previous and latest key pose into m_FinalBoneMatrices.
+    void EvaluateKeyPose();
+    void InterpolateKeyPoses(float factor);
+    void ResetKeyPoses();
+    bool HasKeyPoses() const { return !m_NextKeyPose.empty(); }
+
+    // Play a specific animation. Snaps to the new clip and clears any blend.
+    void PlayAnimation(const Animation* pAnimation);
+
+    // Swap the current clip for another sampling of the same motion (e.g. a streamed clip's full
+    // keyframes replacing its head). Keeps the playback time, fade, blend and layers.
+    void ReplaceAnimation(const Animation* pAnimation);
+
+    // Fade from the current pose to a new clip over the given time in seconds
+    void CrossfadeTo(const Animation* pAnimation, float duration);
+
+    // Replace the current clip with a weighted blend of up to MAX_BLEND_INPUTS clips. The first input
+    // becomes the current animation. An empty list goes back to playing the current clip alone.
+    void SetBlendInputs(const std::vector<BlendInput>& inputs);
+    void SetBlendWeight(size_t input, float weight);
+
+    // Layers are applied in order on top of the base pose. Returns the layer index.
+    int AddLayer(const Animation* pAnimation, float weight, bool additive, std::shared_ptr<const BoneMask> mask = nullptr);
+    void SetLayerWeight(int layer, float weight);
+    void ClearLayers();
 
-    // Calculate bone transforms recursively
-    void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform);
+    // True if the pose depends on more than the current clip and time
+    bool IsBlending() const { return m_FadeAnimation || !m_BlendInputs.empty() || !m_Layers.empty(); }
+    const std::vector<AnimationLayer>& GetLayers() const { return m_Layers; }
+    const std::vector<BlendInput>& GetBlendInputs() const { return m_BlendInputs; }
+
+    // Evaluate a reduced skeleton (nullptr for the full skeleton). The palette is compacted
+    // to the skeleton's palette size and must be drawn with the matching bone ID stream.
+    void SetSkeletonLOD(const SkeletonLOD* skeletonLOD);
+    const SkeletonLOD* GetSkeletonLOD() const { return m_SkeletonLOD; }
 
     // Reset method for when animation ends
     void ResetToFirstFrame();
 
     // Get the final bone matrices for shader upload
-    std::vector<glm::mat4> GetFinalBoneMatrices() { return m_FinalBoneMatrices; }
+    const std::vector<glm::mat4>& GetFinalBoneMatrices() const { return m_FinalBoneMatrices; }
+
+    // Changes whenever m_FinalBoneMatrices does and is unique across animators, so consumers of
+    // the palette can tell a frozen pose from a new one. Callers writing the palette directly
+    // must call MarkPaletteChanged.
+    uint64_t GetPaletteVersion() const { return m_PaletteVersion; }
+    void MarkPaletteChanged();
+
+private:
+    // Samples the base clip or blend inputs, the crossfade and the layers into the pose
+    void BuildPose(Pose& pose);
+
+    // True if the clip's poses can be blended with the current clip
+    bool IsCompatible(const Animation* animation) const;
+
+    // Nodes evaluated for the current clip and skeleton LOD, empty if every node is
+    const std::vector<char>* GetActiveNodes();
+
+    // Sizes m_FinalBoneMatrices to the current skeleton's palette
+    void ResizePalette();
+
+    std::vector<glm::mat4> m_PreviousKeyPose;
+    std::vector<glm::mat4> m_NextKeyPose;
+    const SkeletonLOD* m_SkeletonLOD = nullptr;
+    uint64_t m_PaletteVersion = 0;
+
+    // Crossfade source, it keeps playing while it fades out
+    const Animation* m_FadeAnimation = nullptr;
+    float m_FadeTime = 0.0f;
+    float m_FadeDuration = 0.0f;
+    float m_FadeElapsed = 0.0f;
+
+    std::vector<BlendInput> m_BlendInputs;
+    std::vector<AnimationLayer> m_Layers;
+
+    // Cached active node mask
+    std::vector<char> m_ActiveNodes;
+    const Animation* m_ActiveNodesAnimation = nullptr;
+    const SkeletonLOD* m_ActiveNodesSkeleton = nullptr;
 };
 
 }
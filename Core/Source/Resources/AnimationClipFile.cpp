@@ -0,0 +1,300 @@
+#include "AnimationClipFile.h"
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+namespace SockEngine {
+
+namespace {
+
+constexpr uint32_t CLIP_MAGIC = 0x50494c43;  // "CLIP"
+constexpr uint32_t CLIP_VERSION = 2;
+
+// Guards against allocating garbage sizes from a corrupt file
+constexpr uint32_t MAX_ELEMENT_COUNT = 1u << 26;
+
+class ClipWriter {
+public:
+    explicit ClipWriter(std::ofstream& stream) : m_Stream(stream) {}
+
+    template<typename T>
+    void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_Stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void WriteVector(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Write(static_cast<uint32_t>(values.size()));
+        m_Stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void WriteString(const std::string& value) {
+        Write(static_cast<uint32_t>(value.size()));
+        m_Stream.write(value.data(), value.size());
+    }
+
+    void WriteKeyTimes(const CompressedKeyTimes& keyTimes) {
+        Write(keyTimes.startTime);
+        Write(keyTimes.timeStep);
+        WriteVector(keyTimes.times);
+    }
+
+    void WriteVectorTrack(const CompressedVectorTrack& track) {
+        WriteKeyTimes(track.keyTimes);
+        Write(track.rangeMin);
+        Write(track.rangeExtent);
+        WriteVector(track.values);
+    }
+
+    void WriteRotationTrack(const CompressedRotationTrack& track) {
+        WriteKeyTimes(track.keyTimes);
+        Write(track.constant);
+        WriteVector(track.values);
+    }
+
+private:
+    std::ofstream& m_Stream;
+};
+
+class ClipReader {
+public:
+    explicit ClipReader(std::ifstream& stream) : m_Stream(stream) {}
+
+    bool IsGood() const { return static_cast<bool>(m_Stream); }
+
+    template<typename T>
+    void Read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_Stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void ReadVector(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint32_t count = ReadCount();
+        values.resize(count);
+        m_Stream.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+    }
+
+    void ReadString(std::string& value) {
+        uint32_t count = ReadCount();
+        value.resize(count);
+        m_Stream.read(value.data(), count);
+    }
+
+    void ReadKeyTimes(CompressedKeyTimes& keyTimes) {
+        Read(keyTimes.startTime);
+        Read(keyTimes.timeStep);
+        ReadVector(keyTimes.times);
+    }
+
+    void ReadVectorTrack(CompressedVectorTrack& track) {
+        ReadKeyTimes(track.keyTimes);
+        Read(track.rangeMin);
+        Read(track.rangeExtent);
+        ReadVector(track.values);
+    }
+
+    void ReadRotationTrack(CompressedRotationTrack& track) {
+        ReadKeyTimes(track.keyTimes);
+        Read(track.constant);
+        ReadVector(track.values);
+    }
+
+    uint32_t ReadCount() {
+        uint32_t count = 0;
+        Read(count);
+        if (!m_Stream || count > MAX_ELEMENT_COUNT) {
+            m_Stream.setstate(std::ios::failbit);
+            return 0;
+        }
+        return count;
+    }
+
+private:
+    std::ifstream& m_Stream;
+};
+
+// Animation data shared by both sections
+void WriteAnimation(ClipWriter& writer, const Animation& animation) {
+    writer.Write(animation.m_Duration);
+    writer.Write(animation.m_TicksPerSecond);
+    writer.Write(animation.m_HierarchySignature);
+    writer.Write(animation.m_BoneCount);
+
+    writer.Write(static_cast<uint32_t>(animation.m_Nodes.size()));
+    for (const auto& node : animation.m_Nodes) {
+        writer.WriteString(node.name);
+        writer.Write(node.parent);
+        writer.Write(node.channel);
+        writer.Write(node.boneID);
+        writer.Write(node.offset);
+        writer.Write(node.bindPosition);
+        writer.Write(node.bindRotation);
+        writer.Write(node.bindScale);
+    }
+
+    // Bones are written in order, node channels index into them
+    writer.Write(static_cast<uint32_t>(animation.m_Bones.size()));
+    for (const auto& bone : animation.m_Bones) {
+        writer.WriteString(bone.m_Name);
+        writer.Write(bone.m_ID);
+        writer.Write(static_cast<uint8_t>(bone.m_IsCompressed));
+        if (bone.m_IsCompressed) {
+            writer.WriteVectorTrack(bone.m_CompressedPositions);
+            writer.WriteRotationTrack(bone.m_CompressedRotations);
+            writer.WriteVectorTrack(bone.m_CompressedScales);
+        } else {
+            writer.WriteVector(bone.m_Positions);
+            writer.WriteVector(bone.m_Rotations);
+            writer.WriteVector(bone.m_Scales);
+        }
+    }
+}
+
+std::shared_ptr<Animation> ReadAnimation(ClipReader& reader, const std::string& path) {
+    auto animation = std::make_shared<Animation>();
+    reader.Read(animation->m_Duration);
+    reader.Read(animation->m_TicksPerSecond);
+    reader.Read(animation->m_HierarchySignature);
+    reader.Read(animation->m_BoneCount);
+
+    animation->m_Nodes.resize(reader.ReadCount());
+    for (auto& node : animation->m_Nodes) {
+        reader.ReadString(node.name);
+        reader.Read(node.parent);
+        reader.Read(node.channel);
+        reader.Read(node.boneID);
+        reader.Read(node.offset);
+        reader.Read(node.bindPosition);
+        reader.Read(node.bindRotation);
+        reader.Read(node.bindScale);
+    }
+
+    uint32_t boneCount = reader.ReadCount();
+    animation->m_Bones.reserve(boneCount);
+    for (uint32_t i = 0; i < boneCount && reader.IsGood(); i++) {
+        std::string name;
+        int id = -1;
+        uint8_t compressed = 0;
+        reader.ReadString(name);
+        reader.Read(id);
+        reader.Read(compressed);
+
+        Bone bone(name, id);
+        bone.m_IsCompressed = compressed != 0;
+        if (bone.m_IsCompressed) {
+            reader.ReadVectorTrack(bone.m_CompressedPositions);
+            reader.ReadRotationTrack(bone.m_CompressedRotations);
+            reader.ReadVectorTrack(bone.m_CompressedScales);
+            bone.m_NumPositions = bone.m_CompressedPositions.keyTimes.NumKeys();
+            bone.m_NumRotations = bone.m_CompressedRotations.keyTimes.NumKeys();
+            bone.m_NumScalings = bone.m_CompressedScales.keyTimes.NumKeys();
+        } else {
+            reader.ReadVector(bone.m_Positions);
+            reader.ReadVector(bone.m_Rotations);
+            reader.ReadVector(bone.m_Scales);
+            bone.m_NumPositions = static_cast<int>(bone.m_Positions.size());
+            bone.m_NumRotations = static_cast<int>(bone.m_Rotations.size());
+            bone.m_NumScalings = static_cast<int>(bone.m_Scales.size());
+        }
+        animation->m_Bones.push_back(std::move(bone));
+    }
+
+    if (!reader.IsGood() || !animation->IsValid()) {
+        std::cout << "WARNING: Animation clip file '" << path << "' is corrupt" << std::endl;
+        return nullptr;
+    }
+
+    // Reject channels that point past the bones that were read
+    for (const auto& node : animation->m_Nodes) {
+        if (node.channel >= static_cast<int>(animation->m_Bones.size()) || node.parent >= static_cast<int>(animation->m_Nodes.size())) {
+            std::cout << "WARNING: Animation clip file '" << path << "' is corrupt" << std::endl;
+            return nullptr;
+        }
+    }
+
+    return animation;
+}
+
+// Checks the magic and version and reads the rest of the file header
+bool ReadHeader(ClipReader& reader, float& headSeconds, uint64_t& bodyOffset) {
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    reader.Read(magic);
+    reader.Read(version);
+    if (!reader.IsGood() || magic != CLIP_MAGIC || version != CLIP_VERSION) {
+        return false;
+    }
+
+    reader.Read(headSeconds);
+    reader.Read(bodyOffset);
+    return reader.IsGood();
+}
+
+}
+
+namespace AnimationClipFile {
+
+bool Write(const Animation& animation, const Animation& head, float headSeconds, const std::string& path) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+        return false;
+    }
+
+    ClipWriter writer(stream);
+    writer.Write(CLIP_MAGIC);
+    writer.Write(CLIP_VERSION);
+    writer.Write(headSeconds);
+
+    // The body offset is patched in once the head has been written
+    std::streampos offsetPosition = stream.tellp();
+    writer.Write(uint64_t(0));
+    WriteAnimation(writer, head);
+
+    uint64_t bodyOffset = static_cast<uint64_t>(stream.tellp());
+    WriteAnimation(writer, animation);
+
+    stream.seekp(offsetPosition);
+    writer.Write(bodyOffset);
+    return static_cast<bool>(stream);
+}
+
+std::shared_ptr<Animation> ReadHead(const std::string& path, float headSeconds) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return nullptr;
+    }
+
+    ClipReader reader(stream);
+    float fileHeadSeconds = 0.0f;
+    uint64_t bodyOffset = 0;
+    if (!ReadHeader(reader, fileHeadSeconds, bodyOffset) || fileHeadSeconds != headSeconds) {
+        return nullptr;
+    }
+    return ReadAnimation(reader, path);
+}
+
+std::shared_ptr<Animation> Read(const std::string& path) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return nullptr;
+    }
+
+    ClipReader reader(stream);
+    float headSeconds = 0.0f;
+    uint64_t bodyOffset = 0;
+    if (!ReadHeader(reader, headSeconds, bodyOffset)) {
+        return nullptr;
+    }
+
+    // Skip the head
+    stream.seekg(static_cast<std::streamoff>(bodyOffset));
+    return ReadAnimation(reader, path);
+}
+
+}
+
+}
@@ -0,0 +1,31 @@
+#ifndef ANIMATION_CLIP_FILE_H
+#define ANIMATION_CLIP_FILE_H
+
+#include "Animation.h"
+#include <string>
+#include <memory>
+
+namespace SockEngine {
+
+// Compact binary form of an imported clip: the flattened hierarchy and the keyframes exactly
+// as they are held in memory, so reading a clip is a handful of bulk reads with no Assimp import.
+// The clip's head is stored in its own section ahead of the body so it can be read on its own.
+namespace AnimationClipFile {
+
+    // Writes the clip's runtime data and its head, created for headSeconds.
+    // Returns false if the file could not be written.
+    bool Write(const Animation& animation, const Animation& head, float headSeconds, const std::string& path);
+
+    // Reads only the head section. Returns nullptr if the file is missing, truncated, was written
+    // by another version of the format or holds a head of a different length.
+    std::shared_ptr<Animation> ReadHead(const std::string& path, float headSeconds);
+
+    // Reads the full clip, skipping the head. Returns nullptr if the file is missing, truncated or
+    // was written by another version of the format.
+    std::shared_ptr<Animation> Read(const std::string& path);
+
+}
+
+}
+
+#endif
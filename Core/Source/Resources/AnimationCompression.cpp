@@ -0,0 +1,272 @@
+#include "AnimationCompression.h"
+#include <algorithm>
+#include <cmath>
+
+namespace SockEngine {
+
+namespace {
+
+constexpr float QUANTIZE_MAX = 65535.0f;
+constexpr float SMALLEST_THREE_MAX = 32767.0f;
+constexpr float SMALLEST_THREE_RANGE = 0.70710678f; // 1 / sqrt(2)
+
+// Returns the indices of the keys that must be kept so that linear interpolation between
+// kept keys reproduces every dropped key within tolerance
+template<typename T, typename Lerp, typename Error>
+std::vector<int> ReduceKeys(const std::vector<float>& times, const std::vector<T>& values,
+                            float tolerance, Lerp lerp, Error error) {
+    std::vector<int> kept;
+    int count = static_cast<int>(values.size());
+    if (count == 0) {
+        return kept;
+    }
+
+    // Constant tracks collapse to a single key
+    bool constant = true;
+    for (int i = 1; i < count && constant; i++) {
+        constant = error(values[0], values[i]) <= tolerance;
+    }
+    kept.push_back(0);
+    if (constant) {
+        return kept;
+    }
+
+    int anchor = 0;
+    for (int i = 1; i < count - 1; i++) {
+        // Key i can be dropped if interpolating from the anchor to key i + 1 covers every key in between
+        float span = times[i + 1] - times[anchor];
+        bool canDrop = span > 0.0f;
+        for (int j = anchor + 1; j <= i && canDrop; j++) {
+            float factor = (times[j] - times[anchor]) / span;
+            canDrop = error(lerp(values[anchor], values[i + 1], factor), values[j]) <= tolerance;
+        }
+
+        if (!canDrop) {
+            kept.push_back(i);
+            anchor = i;
+        }
+    }
+    kept.push_back(count - 1);
+
+    return kept;
+}
+
+// Rotation angle between two unit quaternions. Uses the chord length rather than acos of
+// the dot product, which loses all precision for the tiny angles the tolerance is about.
+float AngleBetween(const glm::quat& a, const glm::quat& b) {
+    glm::vec4 va(a.x, a.y, a.z, a.w);
+    glm::vec4 vb(b.x, b.y, b.z, b.w);
+    if (glm::dot(va, vb) < 0.0f) {
+        vb = -vb;
+    }
+    return 4.0f * std::asin(std::min(1.0f, glm::length(va - vb) * 0.5f));
+}
+
+uint16_t QuantizeUnit(float value) {
+    return static_cast<uint16_t>(std::lround(glm::clamp(value, 0.0f, 1.0f) * QUANTIZE_MAX));
+}
+
+}
+
+int CompressedKeyTimes::FindKey(float animationTime, float& factor) const {
+    float quantizedTime = timeStep > 0.0f ? (animationTime - startTime) / timeStep : 0.0f;
+
+    // Binary search for the first key after the sample time
+    auto next = std::upper_bound(times.begin(), times.end(), quantizedTime,
+        [](float t, uint16_t key) { return t < static_cast<float>(key); });
+    int key = static_cast<int>(next - times.begin()) - 1;
+    key = glm::clamp(key, 0, NumKeys() - 2);
+
+    float t0 = static_cast<float>(times[key]);
+    float t1 = static_cast<float>(times[key + 1]);
+    factor = t1 > t0 ? glm::clamp((quantizedTime - t0) / (t1 - t0), 0.0f, 1.0f) : 0.0f;
+    return key;
+}
+
+float CompressedKeyTimes::GetTime(int key) const {
+    return startTime + static_cast<float>(times[key]) * timeStep;
+}
+
+void CompressedKeyTimes::Quantize(const std::vector<float>& keyTimes) {
+    times.clear();
+    if (keyTimes.empty()) {
+        return;
+    }
+
+    startTime = keyTimes.front();
+    float timeExtent = keyTimes.back() - keyTimes.front();
+
+    bool wholeTicks = timeExtent <= QUANTIZE_MAX;
+    for (size_t i = 0; i < keyTimes.size() && wholeTicks; i++) {
+        float offset = keyTimes[i] - startTime;
+        wholeTicks = offset == std::floor(offset);
+    }
+    timeStep = wholeTicks ? 1.0f : timeExtent / QUANTIZE_MAX;
+
+    times.reserve(keyTimes.size());
+    for (float t : keyTimes) {
+        float offset = timeStep > 0.0f ? (t - startTime) / timeStep : 0.0f;
+        times.push_back(static_cast<uint16_t>(std::lround(glm::clamp(offset, 0.0f, QUANTIZE_MAX))));
+    }
+}
+
+glm::vec3 CompressedVectorTrack::GetKey(int key) const {
+    const uint16_t* v = &values[key * 3];
+    return rangeMin + rangeExtent * glm::vec3(v[0], v[1], v[2]) / QUANTIZE_MAX;
+}
+
+glm::vec3 CompressedVectorTrack::Sample(float animationTime) const {
+    if (IsConstant()) {
+        return rangeMin;
+    }
+
+    float factor;
+    int key = keyTimes.FindKey(animationTime, factor);
+    return glm::mix(GetKey(key), GetKey(key + 1), factor);
+}
+
+glm::quat CompressedRotationTrack::GetKey(int key) const {
+    return AnimationCompression::DecodeQuaternion(&values[key * 3]);
+}
+
+glm::quat CompressedRotationTrack::Sample(float animationTime) const {
+    if (IsConstant()) {
+        return constant;
+    }
+
+    float factor;
+    int key = keyTimes.FindKey(animationTime, factor);
+    return glm::normalize(glm::slerp(GetKey(key), GetKey(key + 1), factor));
+}
+
+namespace AnimationCompression {
+
+void EncodeQuaternion(const glm::quat& q, uint16_t out[3]) {
+    glm::vec4 v = glm::normalize(glm::vec4(q.x, q.y, q.z, q.w));
+
+    // Drop the largest component, it is reconstructed from the unit length constraint
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (std::abs(v[i]) > std::abs(v[largest])) {
+            largest = i;
+        }
+    }
+    // q and -q are the same rotation, so make the dropped component positive
+    if (v[largest] < 0.0f) {
+        v = -v;
+    }
+
+    uint64_t packed = static_cast<uint64_t>(largest);
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) {
+            continue;
+        }
+        float normalized = (v[i] / SMALLEST_THREE_RANGE) * 0.5f + 0.5f;
+        uint64_t quantized = static_cast<uint64_t>(std::lround(glm::clamp(normalized, 0.0f, 1.0f) * SMALLEST_THREE_MAX));
+        packed = (packed << 15) | quantized;
+    }
+
+    out[0] = static_cast<uint16_t>(packed >> 32);
+    out[1] = static_cast<uint16_t>(packed >> 16);
+    out[2] = static_cast<uint16_t>(packed);
+}
+
+glm::quat DecodeQuaternion(const uint16_t in[3]) {
+    uint64_t packed = (static_cast<uint64_t>(in[0]) << 32) | (static_cast<uint64_t>(in[1]) << 16) | in[2];
+    int largest = static_cast<int>((packed >> 45) & 0x3);
+
+    glm::vec4 v(0.0f);
+    float sumSquares = 0.0f;
+    int shift = 30;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) {
+            continue;
+        }
+        float quantized = static_cast<float>((packed >> shift) & 0x7FFF);
+        v[i] = (quantized / SMALLEST_THREE_MAX * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+        sumSquares += v[i] * v[i];
+        shift -= 15;
+    }
+    v[largest] = std::sqrt(std::max(0.0f, 1.0f - sumSquares));
+
+    return glm::quat(v.w, v.x, v.y, v.z);
+}
+
+CompressedVectorTrack CompressVectorTrack(const std::vector<float>& times, const std::vector<glm::vec3>& values, float tolerance) {
+    CompressedVectorTrack track;
+    if (values.empty()) {
+        return track;
+    }
+
+    // Leave room in the error budget for quantization
+    glm::vec3 minValue = values[0], maxValue = values[0];
+    for (const auto& value : values) {
+        minValue = glm::min(minValue, value);
+        maxValue = glm::max(maxValue, value);
+    }
+    float quantizationError = glm::length(maxValue - minValue) / QUANTIZE_MAX;
+    float reduceTolerance = std::max(0.0f, tolerance - quantizationError);
+
+    std::vector<int> kept = ReduceKeys(times, values, reduceTolerance,
+        [](const glm::vec3& a, const glm::vec3& b, float f) { return glm::mix(a, b, f); },
+        [](const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b); });
+
+    if (kept.size() == 1) {
+        track.rangeMin = values[kept[0]];
+        return track;
+    }
+
+    std::vector<float> keptTimes;
+    track.rangeMin = values[kept[0]];
+    maxValue = values[kept[0]];
+    for (int index : kept) {
+        keptTimes.push_back(times[index]);
+        track.rangeMin = glm::min(track.rangeMin, values[index]);
+        maxValue = glm::max(maxValue, values[index]);
+    }
+    track.rangeExtent = maxValue - track.rangeMin;
+    track.keyTimes.Quantize(keptTimes);
+
+    track.values.reserve(kept.size() * 3);
+    for (int index : kept) {
+        for (int c = 0; c < 3; c++) {
+            float normalized = track.rangeExtent[c] > 0.0f ? (values[index][c] - track.rangeMin[c]) / track.rangeExtent[c] : 0.0f;
+            track.values.push_back(QuantizeUnit(normalized));
+        }
+    }
+
+    return track;
+}
+
+CompressedRotationTrack CompressRotationTrack(const std::vector<float>& times, const std::vector<glm::quat>& values, float tolerance) {
+    CompressedRotationTrack track;
+    if (values.empty()) {
+        return track;
+    }
+
+    // Smallest-three with 15 bits per component is accurate to roughly 1e-4 radians
+    float reduceTolerance = std::max(0.0f, tolerance - 1e-4f);
+
+    std::vector<int> kept = ReduceKeys(times, values, reduceTolerance,
+        [](const glm::quat& a, const glm::quat& b, float f) { return glm::normalize(glm::slerp(a, b, f)); },
+        [](const glm::quat& a, const glm::quat& b) { return AngleBetween(a, b); });
+
+    if (kept.size() == 1) {
+        track.constant = glm::normalize(values[kept[0]]);
+        return track;
+    }
+
+    std::vector<float> keptTimes;
+    track.values.resize(kept.size() * 3);
+    for (size_t i = 0; i < kept.size(); i++) {
+        keptTimes.push_back(times[kept[i]]);
+        EncodeQuaternion(values[kept[i]], &track.values[i * 3]);
+    }
+    track.keyTimes.Quantize(keptTimes);
+
+    return track;
+}
+
+}
+
+}
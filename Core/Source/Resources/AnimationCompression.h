@@ -0,0 +1,79 @@
+#ifndef ANIMATION_COMPRESSION_H
+#define ANIMATION_COMPRESSION_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace SockEngine {
+
+// Import-time compression settings for animation clips
+struct AnimationCompressionSettings {
+    bool enabled = true;
+    float positionTolerance = 0.01f;   // Max position error in model units
+    float rotationTolerance = 0.001f;  // Max rotation error in radians
+    float scaleTolerance = 0.001f;     // Max scale error
+};
+
+// Key times quantized to 16 bits relative to the track's start. Tracks keyed on whole
+// ticks are stored exactly, anything else is spread over the track's time range.
+struct CompressedKeyTimes {
+    float startTime = 0.0f;
+    float timeStep = 0.0f;
+    std::vector<uint16_t> times;
+
+    int NumKeys() const { return static_cast<int>(times.size()); }
+
+    // Finds the key before animationTime and the interpolation factor towards the next key
+    int FindKey(float animationTime, float& factor) const;
+
+    float GetTime(int key) const;
+    void Quantize(const std::vector<float>& keyTimes);
+    size_t GetMemoryUsage() const { return times.size() * sizeof(uint16_t); }
+};
+
+// Position or scale track with each component quantized to 16 bits within the track's range.
+// Constant tracks store a single exact value in rangeMin and no keys.
+struct CompressedVectorTrack {
+    CompressedKeyTimes keyTimes;
+    glm::vec3 rangeMin = glm::vec3(0.0f);
+    glm::vec3 rangeExtent = glm::vec3(0.0f);
+    std::vector<uint16_t> values; // 3 per key
+
+    bool IsConstant() const { return keyTimes.NumKeys() <= 1; }
+    glm::vec3 GetKey(int key) const;
+    glm::vec3 Sample(float animationTime) const;
+    size_t GetMemoryUsage() const { return keyTimes.GetMemoryUsage() + values.size() * sizeof(uint16_t); }
+};
+
+// Rotation track using smallest-three quantization (48 bits per key).
+// Constant tracks store a single exact value and no keys.
+struct CompressedRotationTrack {
+    CompressedKeyTimes keyTimes;
+    glm::quat constant = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    std::vector<uint16_t> values; // 3 per key
+
+    bool IsConstant() const { return keyTimes.NumKeys() <= 1; }
+    glm::quat GetKey(int key) const;
+    glm::quat Sample(float animationTime) const;
+    size_t GetMemoryUsage() const { return keyTimes.GetMemoryUsage() + values.size() * sizeof(uint16_t); }
+};
+
+namespace AnimationCompression {
+
+    // Smallest-three quaternion packing: 2 bits for the index of the dropped component
+    // and 15 bits for each of the remaining three
+    void EncodeQuaternion(const glm::quat& q, uint16_t out[3]);
+    glm::quat DecodeQuaternion(const uint16_t in[3]);
+
+    // Removes keys that linear interpolation between their neighbours reproduces within
+    // tolerance, collapses constant tracks to a single key and quantizes what remains
+    CompressedVectorTrack CompressVectorTrack(const std::vector<float>& times, const std::vector<glm::vec3>& values, float tolerance);
+    CompressedRotationTrack CompressRotationTrack(const std::vector<float>& times, const std::vector<glm::quat>& values, float tolerance);
+
+}
+
+}
+
+#endif
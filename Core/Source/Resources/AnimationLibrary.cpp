@@ -0,0 +1,178 @@
+#include "AnimationLibrary.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+
+namespace SockEngine {
+
+AnimationLibrary& AnimationLibrary::Get() {
+    static AnimationLibrary instance;
+    return instance;
+}
+
+AnimationLibrary::~AnimationLibrary() {
+    // Wait for in-flight imports before the cache goes away
+    for (auto& worker : m_Workers) {
+        if (worker.valid()) {
+            worker.wait();
+        }
+    }
+}
+
+AnimationRef AnimationLibrary::Load(const std::string& animationPath, const BoneInfoMap& boneInfoMap) {
+    std::shared_future<AnimationRef> future;
+    std::shared_ptr<std::promise<AnimationRef>> promise;
+    AnimationCompressionSettings compression;
+    std::string key;
+
+    if (Acquire(animationPath, boneInfoMap, future, promise, compression, key)) {
+        promise->set_value(Import(animationPath, boneInfoMap, compression, key));
+    }
+
+    return future.get();
+}
+
+std::shared_future<AnimationRef> AnimationLibrary::LoadAsync(const std::string& animationPath, const BoneInfoMap& boneInfoMap) {
+    std::shared_future<AnimationRef> future;
+    std::shared_ptr<std::promise<AnimationRef>> promise;
+    AnimationCompressionSettings compression;
+    std::string key;
+
+    if (Acquire(animationPath, boneInfoMap, future, promise, compression, key)) {
+        auto worker = std::async(std::launch::async, [this, animationPath, boneInfoMap, promise, compression, key]() {
+            promise->set_value(Import(animationPath, boneInfoMap, compression, key));
+        });
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        // Forget workers that have already finished
+        m_Workers.erase(std::remove_if(m_Workers.begin(), m_Workers.end(),
+            [](const std::future<void>& w) {
+                return w.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            }), m_Workers.end());
+        m_Workers.push_back(std::move(worker));
+    }
+
+    return future;
+}
+
+void AnimationLibrary::ReleaseUnused() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (auto it = m_Clips.begin(); it != m_Clips.end();) {
+        const auto& future = it->second;
+        if (future.wait_for(std::chrono::seconds(0)) == std::future_status::ready && future.get().use_count() <= 1) {
+            it = m_Clips.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void AnimationLibrary::Clear() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Clips.clear();
+}
+
+size_t AnimationLibrary::GetClipCount() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Clips.size();
+}
+
+void AnimationLibrary::SetCompressionSettings(const AnimationCompressionSettings& settings) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_CompressionSettings = settings;
+}
+
+AnimationCompressionSettings AnimationLibrary::GetCompressionSettings() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_CompressionSettings;
+}
+
+uint64_t AnimationLibrary::ComputeSkeletonSignature(const BoneInfoMap& boneInfoMap) {
+    // FNV-1a over every bone name, id and offset matrix
+    uint64_t hash = 14695981039346656037ull;
+    auto hashBytes = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    for (const auto& [name, info] : boneInfoMap) {
+        hashBytes(name.data(), name.size());
+        hashBytes(&info.id, sizeof(info.id));
+        hashBytes(&info.offset[0][0], sizeof(info.offset));
+    }
+
+    return hash;
+}
+
+bool AnimationLibrary::Acquire(const std::string& animationPath, const BoneInfoMap& boneInfoMap,
+                               std::shared_future<AnimationRef>& future, std::shared_ptr<std::promise<AnimationRef>>& promise,
+                               AnimationCompressionSettings& compression, std::string& key) {
+    uint64_t signature = ComputeSkeletonSignature(boneInfoMap);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    key = MakeKey(animationPath, signature);
+    compression = m_CompressionSettings;
+
+    auto it = m_Clips.find(key);
+    if (it != m_Clips.end()) {
+        future = it->second;
+        return false;
+    }
+
+    // First request for this clip, the caller is responsible for importing it
+    promise = std::make_shared<std::promise<AnimationRef>>();
+    future = promise->get_future().share();
+    m_Clips[key] = future;
+    return true;
+}
+
+AnimationRef AnimationLibrary::Import(const std::string& animationPath, const BoneInfoMap& boneInfoMap,
+                                     const AnimationCompressionSettings& compression, const std::string& key) {
+    m_ImportCount++;
+
+    std::shared_ptr<const Animation> animation;
+    try {
+        animation = std::make_shared<const Animation>(animationPath, boneInfoMap, compression);
+    }
+    catch (const std::exception& e) {
+        std::cout << "ERROR: Failed to import animation '" << animationPath << "': " << e.what() << std::endl;
+    }
+
+    if (!animation || !animation->IsValid()) {
+        // Don't cache failures so the clip can be retried once the file is fixed
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Clips.erase(key);
+        return nullptr;
+    }
+
+    return animation;
+}
+
+std::string AnimationLibrary::MakeKey(const std::string& animationPath, uint64_t signature) const {
+    // Normalize the path so "../a/b.fbx" and "../a/./b.fbx" share an entry
+    std::string normalizedPath = animationPath;
+    try {
+        normalizedPath = std::filesystem::absolute(animationPath).lexically_normal().generic_string();
+    }
+    catch (const std::exception&) {
+        // Fall back to the path as given
+    }
+
+    // Clips imported with different compression settings are different clips
+    std::string key = normalizedPath + "#" + std::to_string(signature);
+    if (m_CompressionSettings.enabled) {
+        key += "#" + std::to_string(m_CompressionSettings.positionTolerance) +
+               "/" + std::to_string(m_CompressionSettings.rotationTolerance) +
+               "/" + std::to_string(m_CompressionSettings.scaleTolerance);
+    }
+    return key;
+}
+
+}
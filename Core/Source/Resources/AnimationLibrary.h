@@ -0,0 +1,81 @@
+#ifndef ANIMATION_LIBRARY_H
+#define ANIMATION_LIBRARY_H
+
+#include "Animation.h"
+#include "AnimData.h"
+#include <string>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+namespace SockEngine {
+
+// Shared, immutable animation clip
+using AnimationRef = std::shared_ptr<const Animation>;
+
+// Engine-wide animation clip cache. Each (file, skeleton) pair is imported through Assimp
+// exactly once and every AnimatorComponent that asks for it gets the same immutable clip.
+class AnimationLibrary {
+public:
+    // Global instance
+    static AnimationLibrary& Get();
+
+    // Returns the cached clip, importing it on the calling thread if it isn't loaded yet.
+    // Blocks if another thread is already importing the same clip.
+    AnimationRef Load(const std::string& animationPath, const BoneInfoMap& boneInfoMap);
+
+    // Starts importing the clip on a worker thread and returns immediately.
+    // Concurrent requests for the same clip share a single import.
+    std::shared_future<AnimationRef> LoadAsync(const std::string& animationPath, const BoneInfoMap& boneInfoMap);
+
+    // Drops clips that are no longer referenced outside the library
+    void ReleaseUnused();
+
+    // Drops every cached clip. Clips still held by components stay alive until released.
+    void Clear();
+
+    // Number of clips currently cached (including in-flight imports)
+    size_t GetClipCount() const;
+
+    // Number of Assimp imports performed since startup
+    size_t GetImportCount() const { return m_ImportCount; }
+
+    // Compression applied to clips imported from now on
+    void SetCompressionSettings(const AnimationCompressionSettings& settings);
+    AnimationCompressionSettings GetCompressionSettings() const;
+
+    // Hash of the bone names, ids and offsets a clip is bound against
+    static uint64_t ComputeSkeletonSignature(const BoneInfoMap& boneInfoMap);
+
+private:
+    AnimationLibrary() = default;
+    ~AnimationLibrary();
+    AnimationLibrary(const AnimationLibrary&) = delete;
+    AnimationLibrary& operator=(const AnimationLibrary&) = delete;
+
+    // Finds or creates the cache entry for a clip. Returns true if the caller has to import it,
+    // in which case the compression settings and cache key to import with are filled in.
+    bool Acquire(const std::string& animationPath, const BoneInfoMap& boneInfoMap,
+                 std::shared_future<AnimationRef>& future, std::shared_ptr<std::promise<AnimationRef>>& promise,
+                 AnimationCompressionSettings& compression, std::string& key);
+
+    // Imports a clip from disk
+    AnimationRef Import(const std::string& animationPath, const BoneInfoMap& boneInfoMap,
+                        const AnimationCompressionSettings& compression, const std::string& key);
+
+    std::string MakeKey(const std::string& animationPath, uint64_t signature) const;
+
+    mutable std::mutex m_Mutex;
+    std::unordered_map<std::string, std::shared_future<AnimationRef>> m_Clips;
+    std::vector<std::future<void>> m_Workers;
+    AnimationCompressionSettings m_CompressionSettings;
+    std::atomic<size_t> m_ImportCount = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,470 @@
+#include "AnimationPose.h"
+#include "Animation.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POSE_BLEND_SSE
+#include <emmintrin.h>
+#endif
+
+namespace SockEngine {
+
+namespace {
+
+constexpr int LANES = 4;
+
+// Weight of a node, the mask is optional
+inline float NodeWeight(float weight, const BoneMask* mask, int node) {
+    return mask ? weight * mask->weights[node] : weight;
+}
+
+#ifdef POSE_BLEND_SSE
+
+// Weights of four nodes
+inline __m128 LoadWeights(float weight, const BoneMask* mask, int node) {
+    __m128 w = _mm_set1_ps(weight);
+    return mask ? _mm_mul_ps(w, _mm_loadu_ps(&mask->weights[node])) : w;
+}
+
+inline __m128 Lerp(__m128 a, __m128 b, __m128 t) {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+// Flips the sign of b where dot(a, b) is negative so blends take the shortest arc
+inline __m128 ShortestArcSign(__m128 ax, __m128 ay, __m128 az, __m128 aw,
+                              __m128 bx, __m128 by, __m128 bz, __m128 bw) {
+    __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                            _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+    __m128 negative = _mm_cmplt_ps(dot, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(negative, _mm_set1_ps(-1.0f)), _mm_andnot_ps(negative, _mm_set1_ps(1.0f)));
+}
+
+inline void Normalize(__m128& x, __m128& y, __m128& z, __m128& w) {
+    __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                      _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+    __m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(lengthSquared, _mm_set1_ps(1e-12f))));
+    x = _mm_mul_ps(x, inverseLength);
+    y = _mm_mul_ps(y, inverseLength);
+    z = _mm_mul_ps(z, inverseLength);
+    w = _mm_mul_ps(w, inverseLength);
+}
+
+// r = a * b
+inline void Multiply(__m128 ax, __m128 ay, __m128 az, __m128 aw,
+                     __m128 bx, __m128 by, __m128 bz, __m128 bw,
+                     __m128& rx, __m128& ry, __m128& rz, __m128& rw) {
+    rx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bx), _mm_mul_ps(ax, bw)), _mm_mul_ps(ay, bz)), _mm_mul_ps(az, by));
+    ry = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, by), _mm_mul_ps(ax, bz)), _mm_mul_ps(ay, bw)), _mm_mul_ps(az, bx));
+    rz = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(aw, bz), _mm_mul_ps(ax, by)), _mm_mul_ps(ay, bx)), _mm_mul_ps(az, bw));
+    rw = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+#else
+
+inline void Normalize(float& x, float& y, float& z, float& w) {
+    float inverseLength = 1.0f / std::sqrt(std::max(x * x + y * y + z * z + w * w, 1e-12f));
+    x *= inverseLength;
+    y *= inverseLength;
+    z *= inverseLength;
+    w *= inverseLength;
+}
+
+#endif
+
+}
+
+void Pose::Resize(int nodeCount) {
+    if (nodeCount == m_NodeCount && !m_Data.empty()) {
+        return;
+    }
+
+    m_NodeCount = nodeCount;
+    m_Stride = (nodeCount + LANES - 1) / LANES * LANES;
+    m_Data.assign(static_cast<size_t>(m_Stride) * StreamCount, 0.0f);
+
+    // Identity everywhere, including the padding lanes the kernels also process
+    std::fill_n(Get(RotationW), m_Stride, 1.0f);
+    std::fill_n(Get(ScaleX), m_Stride * 3, 1.0f);
+}
+
+void Pose::SetTransform(int node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    Get(TranslationX)[node] = position.x;
+    Get(TranslationY)[node] = position.y;
+    Get(TranslationZ)[node] = position.z;
+    Get(RotationX)[node] = rotation.x;
+    Get(RotationY)[node] = rotation.y;
+    Get(RotationZ)[node] = rotation.z;
+    Get(RotationW)[node] = rotation.w;
+    Get(ScaleX)[node] = scale.x;
+    Get(ScaleY)[node] = scale.y;
+    Get(ScaleZ)[node] = scale.z;
+}
+
+glm::mat4 Pose::GetTransform(int node) const {
+    glm::quat rotation(Get(RotationW)[node], Get(RotationX)[node], Get(RotationY)[node], Get(RotationZ)[node]);
+    glm::vec3 scale(Get(ScaleX)[node], Get(ScaleY)[node], Get(ScaleZ)[node]);
+
+    // translation * rotation * scale without the full matrix products
+    glm::mat4 transform = glm::mat4_cast(rotation);
+    transform[0] *= scale.x;
+    transform[1] *= scale.y;
+    transform[2] *= scale.z;
+    transform[3] = glm::vec4(Get(TranslationX)[node], Get(TranslationY)[node], Get(TranslationZ)[node], 1.0f);
+    return transform;
+}
+
+PosePool& PosePool::Get() {
+    thread_local PosePool pool;
+    return pool;
+}
+
+Pose* PosePool::Acquire(int nodeCount) {
+    if (m_FreePoses.empty()) {
+        m_Poses.push_back(std::make_unique<Pose>());
+        m_FreePoses.push_back(m_Poses.back().get());
+    }
+
+    Pose* pose = m_FreePoses.back();
+    m_FreePoses.pop_back();
+    pose->Resize(nodeCount);
+    return pose;
+}
+
+void PosePool::Release(Pose* pose) {
+    m_FreePoses.push_back(pose);
+}
+
+namespace PoseBlend {
+
+void Blend(const Pose& from, const Pose& to, float weight, const BoneMask* mask, Pose& out) {
+    int stride = from.GetStride();
+    const float* f[Pose::StreamCount];
+    const float* t[Pose::StreamCount];
+    float* o[Pose::StreamCount];
+    for (int s = 0; s < Pose::StreamCount; s++) {
+        f[s] = from.Get(static_cast<Pose::Stream>(s));
+        t[s] = to.Get(static_cast<Pose::Stream>(s));
+        o[s] = out.Get(static_cast<Pose::Stream>(s));
+    }
+
+#ifdef POSE_BLEND_SSE
+    for (int i = 0; i < stride; i += LANES) {
+        __m128 w = LoadWeights(weight, mask, i);
+
+        // Translation and scale
+        for (int s : { Pose::TranslationX, Pose::TranslationY, Pose::TranslationZ, Pose::ScaleX, Pose::ScaleY, Pose::ScaleZ }) {
+            _mm_storeu_ps(o[s] + i, Lerp(_mm_loadu_ps(f[s] + i), _mm_loadu_ps(t[s] + i), w));
+        }
+
+        // Rotation
+        __m128 fx = _mm_loadu_ps(f[Pose::RotationX] + i), fy = _mm_loadu_ps(f[Pose::RotationY] + i);
+        __m128 fz = _mm_loadu_ps(f[Pose::RotationZ] + i), fw = _mm_loadu_ps(f[Pose::RotationW] + i);
+        __m128 tx = _mm_loadu_ps(t[Pose::RotationX] + i), ty = _mm_loadu_ps(t[Pose::RotationY] + i);
+        __m128 tz = _mm_loadu_ps(t[Pose::RotationZ] + i), tw = _mm_loadu_ps(t[Pose::RotationW] + i);
+        __m128 sign = ShortestArcSign(fx, fy, fz, fw, tx, ty, tz, tw);
+
+        __m128 rx = Lerp(fx, _mm_mul_ps(tx, sign), w);
+        __m128 ry = Lerp(fy, _mm_mul_ps(ty, sign), w);
+        __m128 rz = Lerp(fz, _mm_mul_ps(tz, sign), w);
+        __m128 rw = Lerp(fw, _mm_mul_ps(tw, sign), w);
+        Normalize(rx, ry, rz, rw);
+
+        _mm_storeu_ps(o[Pose::RotationX] + i, rx);
+        _mm_storeu_ps(o[Pose::RotationY] + i, ry);
+        _mm_storeu_ps(o[Pose::RotationZ] + i, rz);
+        _mm_storeu_ps(o[Pose::RotationW] + i, rw);
+    }
+#else
+    for (int i = 0; i < stride; i++) {
+        float w = NodeWeight(weight, mask, i);
+
+        for (int s : { Pose::TranslationX, Pose::TranslationY, Pose::TranslationZ, Pose::ScaleX, Pose::ScaleY, Pose::ScaleZ }) {
+            o[s][i] = f[s][i] + (t[s][i] - f[s][i]) * w;
+        }
+
+        float dot = f[Pose::RotationX][i] * t[Pose::RotationX][i] + f[Pose::RotationY][i] * t[Pose::RotationY][i] +
+                    f[Pose::RotationZ][i] * t[Pose::RotationZ][i] + f[Pose::RotationW][i] * t[Pose::RotationW][i];
+        float sign = dot < 0.0f ? -1.0f : 1.0f;
+
+        float r[4];
+        for (int c = 0; c < 4; c++) {
+            int s = Pose::RotationX + c;
+            r[c] = f[s][i] + (t[s][i] * sign - f[s][i]) * w;
+        }
+        Normalize(r[0], r[1], r[2], r[3]);
+        for (int c = 0; c < 4; c++) {
+            o[Pose::RotationX + c][i] = r[c];
+        }
+    }
+#endif
+}
+
+void BlendWeighted(const Pose* const* poses, const float* weights, int count, Pose& out) {
+    if (count <= 0) {
+        return;
+    }
+
+    float totalWeight = 0.0f;
+    for (int p = 0; p < count; p++) {
+        totalWeight += std::max(weights[p], 0.0f);
+    }
+    float scale = totalWeight > 0.0f ? 1.0f / totalWeight : 0.0f;
+
+    const Pose& first = *poses[0];
+    int stride = first.GetStride();
+    float* o[Pose::StreamCount];
+    for (int s = 0; s < Pose::StreamCount; s++) {
+        o[s] = out.Get(static_cast<Pose::Stream>(s));
+    }
+
+#ifdef POSE_BLEND_SSE
+    for (int i = 0; i < stride; i += LANES) {
+        __m128 sum[Pose::StreamCount];
+        for (int s = 0; s < Pose::StreamCount; s++) {
+            sum[s] = _mm_setzero_ps();
+        }
+
+        // Rotations are aligned to the hemisphere of the first pose before summing
+        __m128 rx0 = _mm_loadu_ps(first.Get(Pose::RotationX) + i), ry0 = _mm_loadu_ps(first.Get(Pose::RotationY) + i);
+        __m128 rz0 = _mm_loadu_ps(first.Get(Pose::RotationZ) + i), rw0 = _mm_loadu_ps(first.Get(Pose::RotationW) + i);
+
+        for (int p = 0; p < count; p++) {
+            const Pose& pose = *poses[p];
+            __m128 w = _mm_set1_ps(std::max(weights[p], 0.0f) * scale);
+
+            for (int s : { Pose::TranslationX, Pose::TranslationY, Pose::TranslationZ, Pose::ScaleX, Pose::ScaleY, Pose::ScaleZ }) {
+                sum[s] = _mm_add_ps(sum[s], _mm_mul_ps(_mm_loadu_ps(pose.Get(static_cast<Pose::Stream>(s)) + i), w));
+            }
+
+            __m128 rx = _mm_loadu_ps(pose.Get(Pose::RotationX) + i), ry = _mm_loadu_ps(pose.Get(Pose::RotationY) + i);
+            __m128 rz = _mm_loadu_ps(pose.Get(Pose::RotationZ) + i), rw = _mm_loadu_ps(pose.Get(Pose::RotationW) + i);
+            __m128 signedWeight = _mm_mul_ps(w, ShortestArcSign(rx0, ry0, rz0, rw0, rx, ry, rz, rw));
+            sum[Pose::RotationX] = _mm_add_ps(sum[Pose::RotationX], _mm_mul_ps(rx, signedWeight));
+            sum[Pose::RotationY] = _mm_add_ps(sum[Pose::RotationY], _mm_mul_ps(ry, signedWeight));
+            sum[Pose::RotationZ] = _mm_add_ps(sum[Pose::RotationZ], _mm_mul_ps(rz, signedWeight));
+            sum[Pose::RotationW] = _mm_add_ps(sum[Pose::RotationW], _mm_mul_ps(rw, signedWeight));
+        }
+
+        Normalize(sum[Pose::RotationX], sum[Pose::RotationY], sum[Pose::RotationZ], sum[Pose::RotationW]);
+        for (int s = 0; s < Pose::StreamCount; s++) {
+            _mm_storeu_ps(o[s] + i, sum[s]);
+        }
+    }
+#else
+    for (int i = 0; i < stride; i++) {
+        float sum[Pose::StreamCount] = {};
+
+        for (int p = 0; p < count; p++) {
+            const Pose& pose = *poses[p];
+            float w = std::max(weights[p], 0.0f) * scale;
+
+            for (int s : { Pose::TranslationX, Pose::TranslationY, Pose::TranslationZ, Pose::ScaleX, Pose::ScaleY, Pose::ScaleZ }) {
+                sum[s] += pose.Get(static_cast<Pose::Stream>(s))[i] * w;
+            }
+
+            float dot = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                auto stream = static_cast<Pose::Stream>(Pose::RotationX + c);
+                dot += first.Get(stream)[i] * pose.Get(stream)[i];
+            }
+            float signedWeight = dot < 0.0f ? -w : w;
+            for (int c = 0; c < 4; c++) {
+                sum[Pose::RotationX + c] += pose.Get(static_cast<Pose::Stream>(Pose::RotationX + c))[i] * signedWeight;
+            }
+        }
+
+        Normalize(sum[Pose::RotationX], sum[Pose::RotationY], sum[Pose::RotationZ], sum[Pose::RotationW]);
+        for (int s = 0; s < Pose::StreamCount; s++) {
+            o[s][i] = sum[s];
+        }
+    }
+#endif
+}
+
+void MakeAdditive(const Pose& pose, const Pose& reference, Pose& delta) {
+    int stride = pose.GetStride();
+    const float* p[Pose::StreamCount];
+    const float* r[Pose::StreamCount];
+    float* d[Pose::StreamCount];
+    for (int s = 0; s < Pose::StreamCount; s++) {
+        p[s] = pose.Get(static_cast<Pose::Stream>(s));
+        r[s] = reference.Get(static_cast<Pose::Stream>(s));
+        d[s] = delta.Get(static_cast<Pose::Stream>(s));
+    }
+
+#ifdef POSE_BLEND_SSE
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 epsilon = _mm_set1_ps(1e-6f);
+    __m128 signBit = _mm_set1_ps(-0.0f);
+    for (int i = 0; i < stride; i += LANES) {
+        // Translation difference
+        for (int s : { Pose::TranslationX, Pose::TranslationY, Pose::TranslationZ }) {
+            _mm_storeu_ps(d[s] + i, _mm_sub_ps(_mm_loadu_ps(p[s] + i), _mm_loadu_ps(r[s] + i)));
+        }
+
+        // Scale ratio, 1 where the reference scale is zero
+        for (int s : { Pose::ScaleX, Pose::ScaleY, Pose::ScaleZ }) {
+            __m128 referenceScale = _mm_loadu_ps(r[s] + i);
+            __m128 valid = _mm_cmpgt_ps(_mm_andnot_ps(signBit, referenceScale), epsilon);
+            __m128 ratio = _mm_div_ps(_mm_loadu_ps(p[s] + i), _mm_or_ps(_mm_and_ps(valid, referenceScale), _mm_andnot_ps(valid, one)));
+            _mm_storeu_ps(d[s] + i, _mm_or_ps(_mm_and_ps(valid, ratio), _mm_andnot_ps(valid, one)));
+        }
+
+        // Rotation relative to the reference, inverse(reference) * pose
+        __m128 rx, ry, rz, rw;
+        Multiply(_mm_xor_ps(_mm_loadu_ps(r[Pose::RotationX] + i), signBit), _mm_xor_ps(_mm_loadu_ps(r[Pose::RotationY] + i), signBit),
+                 _mm_xor_ps(_mm_loadu_ps(r[Pose::RotationZ] + i), signBit), _mm_loadu_ps(r[Pose::RotationW] + i),
+                 _mm_loadu_ps(p[Pose::RotationX] + i), _mm_loadu_ps(p[Pose::RotationY] + i),
+                 _mm_loadu_ps(p[Pose::RotationZ] + i), _mm_loadu_ps(p[Pose::RotationW] + i),
+                 rx, ry, rz, rw);
+        Normalize(rx, ry, rz, rw);
+
+        _mm_storeu_ps(d[Pose::RotationX] + i, rx);
+        _mm_storeu_ps(d[Pose::RotationY] + i, ry);
+        _mm_storeu_ps(d[Pose::RotationZ] + i, rz);
+        _mm_storeu_ps(d[Pose::RotationW] + i, rw);
+    }
+#else
+    for (int i = 0; i < stride; i++) {
+        // Translation difference
+        for (int s : { Pose::TranslationX, Pose::TranslationY, Pose::TranslationZ }) {
+            d[s][i] = p[s][i] - r[s][i];
+        }
+
+        // Scale ratio
+        for (int s : { Pose::ScaleX, Pose::ScaleY, Pose::ScaleZ }) {
+            d[s][i] = std::abs(r[s][i]) > 1e-6f ? p[s][i] / r[s][i] : 1.0f;
+        }
+
+        // Rotation relative to the reference, inverse(reference) * pose
+        glm::quat q = glm::conjugate(glm::quat(r[Pose::RotationW][i], r[Pose::RotationX][i], r[Pose::RotationY][i], r[Pose::RotationZ][i])) *
+                      glm::quat(p[Pose::RotationW][i], p[Pose::RotationX][i], p[Pose::RotationY][i], p[Pose::RotationZ][i]);
+        q = glm::normalize(q);
+        d[Pose::RotationX][i] = q.x;
+        d[Pose::RotationY][i] = q.y;
+        d[Pose::RotationZ][i] = q.z;
+        d[Pose::RotationW][i] = q.w;
+    }
+#endif
+}
+
+void ApplyAdditive(Pose& pose, const Pose& delta, float weight, const BoneMask* mask) {
+    int stride = pose.GetStride();
+    float* o[Pose::StreamCount];
+    const float* d[Pose::StreamCount];
+    for (int s = 0; s < Pose::StreamCount; s++) {
+        o[s] = pose.Get(static_cast<Pose::Stream>(s));
+        d[s] = delta.Get(static_cast<Pose::Stream>(s));
+    }
+
+#ifdef POSE_BLEND_SSE
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 zero = _mm_setzero_ps();
+    for (int i = 0; i < stride; i += LANES) {
+        __m128 w = LoadWeights(weight, mask, i);
+
+        for (int s : { Pose::TranslationX, Pose::TranslationY, Pose::TranslationZ }) {
+            _mm_storeu_ps(o[s] + i, _mm_add_ps(_mm_loadu_ps(o[s] + i), _mm_mul_ps(_mm_loadu_ps(d[s] + i), w)));
+        }
+        for (int s : { Pose::ScaleX, Pose::ScaleY, Pose::ScaleZ }) {
+            _mm_storeu_ps(o[s] + i, _mm_mul_ps(_mm_loadu_ps(o[s] + i), Lerp(one, _mm_loadu_ps(d[s] + i), w)));
+        }
+
+        // Scale the delta rotation by nlerp from identity, then apply it on top of the pose
+        __m128 dx = _mm_loadu_ps(d[Pose::RotationX] + i), dy = _mm_loadu_ps(d[Pose::RotationY] + i);
+        __m128 dz = _mm_loadu_ps(d[Pose::RotationZ] + i), dw = _mm_loadu_ps(d[Pose::RotationW] + i);
+        __m128 sign = ShortestArcSign(zero, zero, zero, one, dx, dy, dz, dw);
+        dx = _mm_mul_ps(_mm_mul_ps(dx, sign), w);
+        dy = _mm_mul_ps(_mm_mul_ps(dy, sign), w);
+        dz = _mm_mul_ps(_mm_mul_ps(dz, sign), w);
+        dw = Lerp(one, _mm_mul_ps(dw, sign), w);
+        Normalize(dx, dy, dz, dw);
+
+        __m128 rx, ry, rz, rw;
+        Multiply(_mm_loadu_ps(o[Pose::RotationX] + i), _mm_loadu_ps(o[Pose::RotationY] + i),
+                 _mm_loadu_ps(o[Pose::RotationZ] + i), _mm_loadu_ps(o[Pose::RotationW] + i),
+                 dx, dy, dz, dw, rx, ry, rz, rw);
+        Normalize(rx, ry, rz, rw);
+
+        _mm_storeu_ps(o[Pose::RotationX] + i, rx);
+        _mm_storeu_ps(o[Pose::RotationY] + i, ry);
+        _mm_storeu_ps(o[Pose::RotationZ] + i, rz);
+        _mm_storeu_ps(o[Pose::RotationW] + i, rw);
+    }
+#else
+    for (int i = 0; i < stride; i++) {
+        float w = NodeWeight(weight, mask, i);
+
+        for (int s : { Pose::TranslationX, Pose::TranslationY, Pose::TranslationZ }) {
+            o[s][i] += d[s][i] * w;
+        }
+        for (int s : { Pose::ScaleX, Pose::ScaleY, Pose::ScaleZ }) {
+            o[s][i] *= 1.0f + (d[s][i] - 1.0f) * w;
+        }
+
+        float sign = d[Pose::RotationW][i] < 0.0f ? -1.0f : 1.0f;
+        float dx = d[Pose::RotationX][i] * sign * w;
+        float dy = d[Pose::RotationY][i] * sign * w;
+        float dz = d[Pose::RotationZ][i] * sign * w;
+        float dw = 1.0f + (d[Pose::RotationW][i] * sign - 1.0f) * w;
+        Normalize(dx, dy, dz, dw);
+
+        glm::quat r = glm::quat(o[Pose::RotationW][i], o[Pose::RotationX][i], o[Pose::RotationY][i], o[Pose::RotationZ][i]) *
+                      glm::quat(dw, dx, dy, dz);
+        r = glm::normalize(r);
+        o[Pose::RotationX][i] = r.x;
+        o[Pose::RotationY][i] = r.y;
+        o[Pose::RotationZ][i] = r.z;
+        o[Pose::RotationW][i] = r.w;
+    }
+#endif
+}
+
+void Sample(const Animation& clip, float animationTime, const std::vector<char>* activeNodes, Pose& out) {
+    const auto& nodes = clip.m_Nodes;
+    out.Resize(static_cast<int>(nodes.size()));
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const SkeletonNode& node = nodes[i];
+        bool active = !activeNodes || (*activeNodes)[i];
+
+        if (active && node.channel >= 0) {
+            const Bone& bone = clip.m_Bones[node.channel];
+            out.SetTransform(static_cast<int>(i), bone.SamplePosition(animationTime),
+                             bone.SampleRotation(animationTime), bone.SampleScale(animationTime));
+        } else {
+            out.SetTransform(static_cast<int>(i), node.bindPosition, node.bindRotation, node.bindScale);
+        }
+    }
+}
+
+void ComputeBoneMatrices(const Animation& clip, const Pose& pose, const std::vector<char>* activeNodes,
+                         const SkeletonLOD* skeletonLOD, std::vector<glm::mat4>& palette) {
+    const auto& nodes = clip.m_Nodes;
+
+    // Model space transforms, kept per thread so the palette pass does not allocate
+    thread_local std::vector<glm::mat4> globalTransforms;
+    globalTransforms.resize(nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (activeNodes && !(*activeNodes)[i]) {
+            continue;
+        }
+
+        const SkeletonNode& node = nodes[i];
+        glm::mat4 local = pose.GetTransform(static_cast<int>(i));
+        globalTransforms[i] = node.parent >= 0 ? globalTransforms[node.parent] * local : local;
+
+        if (node.boneID >= 0) {
+            int index = skeletonLOD ? skeletonLOD->boneRemap[node.boneID] : node.boneID;
+            if (index >= 0 && index < static_cast<int>(palette.size())) {
+                palette[index] = globalTransforms[i] * node.offset;
+            }
+        }
+    }
+}
+
+}
+
+}
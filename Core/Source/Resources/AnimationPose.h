@@ -0,0 +1,110 @@
+#ifndef ANIMATION_POSE_H
+#define ANIMATION_POSE_H
+
+#include "AnimData.h"
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace SockEngine {
+
+class Animation;
+
+// Local transforms of every node of a skeleton, stored as structure-of-arrays with one stream
+// per component. Streams are padded to a multiple of four so the blend kernels always process
+// four nodes at a time.
+class Pose {
+public:
+    enum Stream {
+        TranslationX, TranslationY, TranslationZ,
+        RotationX, RotationY, RotationZ, RotationW,
+        ScaleX, ScaleY, ScaleZ,
+        StreamCount
+    };
+
+    // Resizes the pose. Existing transforms are reset to identity if the node count changes.
+    void Resize(int nodeCount);
+
+    int GetNodeCount() const { return m_NodeCount; }
+    int GetStride() const { return m_Stride; }
+
+    float* Get(Stream stream) { return m_Data.data() + stream * m_Stride; }
+    const float* Get(Stream stream) const { return m_Data.data() + stream * m_Stride; }
+
+    void SetTransform(int node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+    glm::mat4 GetTransform(int node) const;
+
+private:
+    std::vector<float> m_Data;
+    int m_NodeCount = 0;
+    int m_Stride = 0;
+};
+
+// Per-node blend weights in [0, 1], padded to the pose stride
+struct BoneMask {
+    std::vector<float> weights;
+};
+
+// Per-thread free list of poses. Released poses keep their memory, so once a blend has run
+// a few times it no longer allocates.
+class PosePool {
+public:
+    // Pool of the calling thread
+    static PosePool& Get();
+
+    Pose* Acquire(int nodeCount);
+    void Release(Pose* pose);
+
+    size_t GetPoseCount() const { return m_Poses.size(); }
+
+private:
+    std::vector<std::unique_ptr<Pose>> m_Poses;
+    std::vector<Pose*> m_FreePoses;
+};
+
+// Pose borrowed from the calling thread's pool for the current scope
+class PooledPose {
+public:
+    explicit PooledPose(int nodeCount) : m_Pose(PosePool::Get().Acquire(nodeCount)) {}
+    ~PooledPose() { PosePool::Get().Release(m_Pose); }
+
+    PooledPose(const PooledPose&) = delete;
+    PooledPose& operator=(const PooledPose&) = delete;
+
+    Pose& operator*() { return *m_Pose; }
+    Pose* operator->() { return m_Pose; }
+
+private:
+    Pose* m_Pose;
+};
+
+// Blend kernels. Rotations are blended with a normalized lerp along the shortest arc, which
+// matches slerp closely for the small angles between neighbouring poses and vectorizes well.
+namespace PoseBlend {
+
+// out = lerp(from, to, weight * mask). out may alias either input.
+void Blend(const Pose& from, const Pose& to, float weight, const BoneMask* mask, Pose& out);
+
+// out = normalized weighted sum of the poses. out may alias the first pose.
+void BlendWeighted(const Pose* const* poses, const float* weights, int count, Pose& out);
+
+// delta = pose relative to reference, for use as an additive layer. delta may alias pose.
+void MakeAdditive(const Pose& pose, const Pose& reference, Pose& delta);
+
+// Applies an additive delta on top of the pose, scaled by weight * mask
+void ApplyAdditive(Pose& pose, const Pose& delta, float weight, const BoneMask* mask);
+
+// Samples the clip into a pose. Nodes whose mask entry is zero get their bind transform.
+void Sample(const Animation& clip, float animationTime, const std::vector<char>* activeNodes, Pose& out);
+
+// Converts local transforms to the skinning palette, skipping inactive nodes.
+// The skeleton LOD, if any, picks the palette layout.
+void ComputeBoneMatrices(const Animation& clip, const Pose& pose, const std::vector<char>* activeNodes,
+                         const SkeletonLOD* skeletonLOD, std::vector<glm::mat4>& palette);
+
+}
+
+}
+
+#endif
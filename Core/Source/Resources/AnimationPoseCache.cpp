@@ -0,0 +1,32 @@
+#include "AnimationPoseCache.h"
+
+namespace SockEngine {
+
+void AnimationPoseCache::BeginFrame() {
+    m_Index.clear();
+    m_UsedPalettes = 0;
+    m_Hits = 0;
+}
+
+const std::vector<glm::mat4>* AnimationPoseCache::Find(const Animation* clip, const SkeletonLOD* skeletonLOD, int64_t timeBucket) const {
+    auto it = m_Index.find(Key{ clip, skeletonLOD, timeBucket });
+    if (it == m_Index.end()) {
+        return nullptr;
+    }
+    return &m_Palettes[it->second];
+}
+
+const std::vector<glm::mat4>* AnimationPoseCache::Store(const Animation* clip, const SkeletonLOD* skeletonLOD, int64_t timeBucket,
+                                                        const std::vector<glm::mat4>& palette) {
+    // Reuse a palette from an earlier frame if one is free
+    if (m_UsedPalettes == m_Palettes.size()) {
+        m_Palettes.emplace_back();
+    }
+
+    size_t index = m_UsedPalettes++;
+    m_Palettes[index] = palette;
+    m_Index[Key{ clip, skeletonLOD, timeBucket }] = index;
+    return &m_Palettes[index];
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef ANIMATION_POSE_CACHE_H
+#define ANIMATION_POSE_CACHE_H
+
+#include "Animation.h"
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace SockEngine {
+
+// Per-frame cache of evaluated bone palettes. Animators that play the same clip at the same
+// quantized time share one palette, so a crowd costs one evaluation per distinct (clip, phase).
+class AnimationPoseCache {
+public:
+    // Starts a new frame. Palettes are recycled, not freed, so a returned palette is only
+    // valid until the next BeginFrame.
+    void BeginFrame();
+
+    // Returns the palette evaluated this frame for the clip, skeleton LOD and time bucket, or nullptr
+    const std::vector<glm::mat4>* Find(const Animation* clip, const SkeletonLOD* skeletonLOD, int64_t timeBucket) const;
+
+    // Stores a palette for the clip, skeleton LOD and time bucket and returns the shared copy
+    const std::vector<glm::mat4>* Store(const Animation* clip, const SkeletonLOD* skeletonLOD, int64_t timeBucket,
+                                        const std::vector<glm::mat4>& palette);
+
+    // Statistics for the current frame
+    size_t GetPaletteCount() const { return m_UsedPalettes; }
+    size_t GetHitCount() const { return m_Hits; }
+    void RecordHit() { m_Hits++; }
+
+private:
+    struct Key {
+        const Animation* clip;
+        const SkeletonLOD* skeletonLOD; // Palette layout, nullptr for the full skeleton
+        int64_t timeBucket;
+
+        bool operator==(const Key& other) const {
+            return clip == other.clip && skeletonLOD == other.skeletonLOD && timeBucket == other.timeBucket;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t hash = std::hash<const void*>()(key.clip);
+            hash = hash * 31 + std::hash<const void*>()(key.skeletonLOD);
+            return hash * 31 + std::hash<int64_t>()(key.timeBucket);
+        }
+    };
+
+    std::unordered_map<Key, size_t, KeyHash> m_Index;
+    std::deque<std::vector<glm::mat4>> m_Palettes; // Deque keeps element addresses stable as it grows
+    size_t m_UsedPalettes = 0;
+    size_t m_Hits = 0;
+};
+
+}
+
+#endif
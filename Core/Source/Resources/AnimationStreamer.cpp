@@ -0,0 +1,301 @@
+#include "AnimationStreamer.h"
+#include "AnimationClipFile.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace SockEngine {
+
+AnimationRef StreamedClip::GetHead() const {
+    std::lock_guard<std::mutex> lock(AnimationStreamer::Get().m_Mutex);
+    return m_Head;
+}
+
+AnimationRef StreamedClip::Acquire() {
+    return AnimationStreamer::Get().Acquire(*this);
+}
+
+bool StreamedClip::IsResident() const {
+    std::lock_guard<std::mutex> lock(AnimationStreamer::Get().m_Mutex);
+    return m_Body != nullptr;
+}
+
+AnimationStreamer& AnimationStreamer::Get() {
+    static AnimationStreamer instance;
+    return instance;
+}
+
+AnimationStreamer::~AnimationStreamer() {
+    // Wait for in-flight cooks and page-ins before the clips go away
+    for (auto& [key, clip] : m_Clips) {
+        if (clip->m_Cook.valid()) {
+            clip->m_Cook.wait();
+        }
+        if (clip->m_PageIn.valid()) {
+            clip->m_PageIn.wait();
+        }
+    }
+}
+
+std::shared_ptr<StreamedClip> AnimationStreamer::Register(const std::string& animationPath, const BoneInfoMap& boneInfoMap) {
+    AnimationCompressionSettings compression = AnimationLibrary::Get().GetCompressionSettings();
+
+    // Same identity as the library's cache: normalized path, skeleton and compression settings
+    std::string normalizedPath = animationPath;
+    try {
+        normalizedPath = std::filesystem::absolute(animationPath).lexically_normal().generic_string();
+    }
+    catch (const std::exception&) {
+        // Fall back to the path as given
+    }
+
+    std::string key = normalizedPath + "#" + std::to_string(AnimationLibrary::ComputeSkeletonSignature(boneInfoMap));
+    if (compression.enabled) {
+        key += "#" + std::to_string(compression.positionTolerance) +
+               "/" + std::to_string(compression.rotationTolerance) +
+               "/" + std::to_string(compression.scaleTolerance);
+    }
+
+    float headDuration = 0.0f;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = m_Clips.find(key);
+        if (it != m_Clips.end()) {
+            return it->second;
+        }
+        headDuration = m_HeadDuration;
+    }
+
+    // Clip files are named after the FNV-1a hash of the key
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.clip", static_cast<unsigned long long>(hash));
+
+    auto clip = std::make_shared<StreamedClip>();
+    clip->m_SourcePath = animationPath;
+    clip->m_ClipPath = std::string(CLIP_CACHE_DIRECTORY) + fileName;
+    clip->m_BoneInfoMap = boneInfoMap;
+    clip->m_Compression = compression;
+    clip->m_HeadSeconds = headDuration;
+
+    // Only the head section is read here, the body is paged in when the clip is played
+    if (IsClipFileCurrent(animationPath, clip->m_ClipPath)) {
+        clip->m_Head = AnimationClipFile::ReadHead(clip->m_ClipPath, headDuration);
+    }
+    if (!clip->m_Head) {
+        std::error_code error;
+        if (!std::filesystem::exists(animationPath, error)) {
+            std::cout << "ERROR: Animation file '" << animationPath << "' does not exist" << std::endl;
+            return nullptr;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // Another thread may have registered the clip in the meantime
+    auto [it, inserted] = m_Clips.emplace(key, clip);
+    if (!inserted) {
+        return it->second;
+    }
+
+    // Missing, stale or corrupt clip file, import the source off the calling thread
+    if (!clip->m_Head) {
+        clip->m_Cook = std::async(std::launch::async,
+            [sourcePath = clip->m_SourcePath, boneInfoMap, compression, clipPath = clip->m_ClipPath, headDuration]() {
+                return Cook(sourcePath, boneInfoMap, compression, clipPath, headDuration);
+            });
+    }
+    return clip;
+}
+
+AnimationRef AnimationStreamer::Acquire(StreamedClip& clip) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    clip.m_LastUsedFrame = m_Frame;
+
+    // A clip that is still cooking gets its body along with the head
+    if (clip.m_Body || clip.m_Failed || clip.m_Cook.valid() || clip.m_PageIn.valid()) {
+        return clip.m_Body;
+    }
+
+    clip.m_PageIn = std::async(std::launch::async,
+        [sourcePath = clip.m_SourcePath, boneInfoMap = clip.m_BoneInfoMap, compression = clip.m_Compression,
+         clipPath = clip.m_ClipPath, headSeconds = clip.m_HeadSeconds]() {
+            return LoadBody(sourcePath, boneInfoMap, compression, clipPath, headSeconds);
+        });
+    return nullptr;
+}
+
+void AnimationStreamer::Update() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (auto& [key, clip] : m_Clips) {
+        if (clip->m_Cook.valid() && clip->m_Cook.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            CookedClip cooked = clip->m_Cook.get();
+            if (!cooked.body) {
+                std::cout << "ERROR: Failed to import animation '" << clip->m_SourcePath << "'" << std::endl;
+                clip->m_Failed = true;
+                continue;
+            }
+            if (!cooked.clipFileWritten) {
+                std::cout << "WARNING: Could not write clip file for '" << clip->m_SourcePath << "', it stays resident" << std::endl;
+                clip->m_Pinned = true;
+            }
+
+            // The body was just imported, keep it until the budget needs the space
+            clip->m_Head = cooked.head;
+            clip->m_Body = cooked.body;
+            clip->m_BodyMemory = cooked.body->GetKeyframeMemory();
+            m_ResidentMemory += clip->m_BodyMemory;
+            continue;
+        }
+
+        if (!clip->m_PageIn.valid() || clip->m_PageIn.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            continue;
+        }
+
+        std::shared_ptr<Animation> body = clip->m_PageIn.get();
+        if (!body || !body->SharesHierarchy(*clip->m_Head)) {
+            std::cout << "ERROR: Failed to page in animation '" << clip->m_SourcePath << "'" << std::endl;
+            clip->m_Failed = true;
+            continue;
+        }
+
+        clip->m_Body = body;
+        clip->m_BodyMemory = body->GetKeyframeMemory();
+        m_ResidentMemory += clip->m_BodyMemory;
+        m_PageInCount++;
+    }
+
+    Evict();
+    m_Frame++;
+}
+
+void AnimationStreamer::Evict() {
+    if (m_ResidentMemory <= m_Budget) {
+        return;
+    }
+
+    // Bodies that nothing but the streamer references and that weren't used this frame
+    std::vector<StreamedClip*> candidates;
+    for (auto& [key, clip] : m_Clips) {
+        if (clip->m_Body && !clip->m_Pinned && clip->m_LastUsedFrame != m_Frame && clip->m_Body.use_count() == 1) {
+            candidates.push_back(clip.get());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+        [](const StreamedClip* a, const StreamedClip* b) { return a->m_LastUsedFrame < b->m_LastUsedFrame; });
+
+    for (StreamedClip* clip : candidates) {
+        if (m_ResidentMemory <= m_Budget) {
+            break;
+        }
+        m_ResidentMemory -= clip->m_BodyMemory;
+        clip->m_Body.reset();
+        clip->m_BodyMemory = 0;
+        m_EvictionCount++;
+    }
+}
+
+CookedClip AnimationStreamer::Cook(const std::string& animationPath, const BoneInfoMap& boneInfoMap,
+                                   const AnimationCompressionSettings& compression,
+                                   const std::string& clipPath, float headSeconds) {
+    CookedClip cooked;
+    try {
+        cooked.body = std::make_shared<Animation>(animationPath, boneInfoMap, compression);
+    }
+    catch (const std::exception& e) {
+        std::cout << "ERROR: Failed to import animation '" << animationPath << "': " << e.what() << std::endl;
+    }
+    if (!cooked.body || !cooked.body->IsValid()) {
+        cooked.body.reset();
+        return cooked;
+    }
+
+    // The import-only data is not part of the clip file, drop it so both paths produce the same clip
+    cooked.body->m_RootNode = AssimpNodeData();
+    cooked.body->m_BoneInfoMap.clear();
+
+    float ticksPerSecond = cooked.body->m_TicksPerSecond > 0 ? static_cast<float>(cooked.body->m_TicksPerSecond) : 25.0f;
+    cooked.head = cooked.body->CreateHead(headSeconds * ticksPerSecond);
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(clipPath).parent_path(), error);
+    cooked.clipFileWritten = AnimationClipFile::Write(*cooked.body, *cooked.head, headSeconds, clipPath);
+    return cooked;
+}
+
+std::shared_ptr<Animation> AnimationStreamer::LoadBody(const std::string& animationPath, const BoneInfoMap& boneInfoMap,
+                                                       const AnimationCompressionSettings& compression,
+                                                       const std::string& clipPath, float headSeconds) {
+    if (IsClipFileCurrent(animationPath, clipPath)) {
+        if (auto animation = AnimationClipFile::Read(clipPath)) {
+            return animation;
+        }
+    }
+
+    // The clip file went stale or was removed since registration
+    return Cook(animationPath, boneInfoMap, compression, clipPath, headSeconds).body;
+}
+
+bool AnimationStreamer::IsClipFileCurrent(const std::string& animationPath, const std::string& clipPath) {
+    std::error_code error;
+    auto sourceTime = std::filesystem::last_write_time(animationPath, error);
+    bool sourceExists = !error;
+    auto clipTime = std::filesystem::last_write_time(clipPath, error);
+    return !error && (!sourceExists || clipTime >= sourceTime);
+}
+
+void AnimationStreamer::SetBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Budget = bytes;
+}
+
+size_t AnimationStreamer::GetBudget() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Budget;
+}
+
+void AnimationStreamer::SetHeadDuration(float seconds) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_HeadDuration = std::max(seconds, 0.0f);
+}
+
+float AnimationStreamer::GetHeadDuration() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_HeadDuration;
+}
+
+size_t AnimationStreamer::GetClipCount() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Clips.size();
+}
+
+size_t AnimationStreamer::GetResidentClipCount() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return std::count_if(m_Clips.begin(), m_Clips.end(),
+        [](const auto& entry) { return entry.second->m_Body != nullptr; });
+}
+
+size_t AnimationStreamer::GetResidentMemory() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_ResidentMemory;
+}
+
+size_t AnimationStreamer::GetHeadMemory() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    size_t total = 0;
+    for (const auto& [key, clip] : m_Clips) {
+        if (clip->m_Head) {
+            total += clip->m_Head->GetKeyframeMemory();
+        }
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,128 @@
+#ifndef ANIMATION_STREAMER_H
+#define ANIMATION_STREAMER_H
+
+#include "AnimationLibrary.h"
+#include <string>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+namespace SockEngine {
+
+// Result of importing a clip and writing its clip file
+struct CookedClip {
+    std::shared_ptr<Animation> head;
+    std::shared_ptr<Animation> body;
+    bool clipFileWritten = false;
+};
+
+// Clip whose keyframes are paged in from its clip file on demand. The head, the first
+// moments of the clip, stays resident so playback can start before the body arrives.
+class StreamedClip {
+public:
+    const std::string& GetSourcePath() const { return m_SourcePath; }
+
+    // Samples the clip up to the head duration. Resident once read from the clip file, nullptr
+    // while the clip is still being cooked or if cooking failed.
+    AnimationRef GetHead() const;
+
+    // Returns the full clip if it is resident, otherwise starts paging it in and returns nullptr.
+    // Marks the clip as used this frame, clips in use are never evicted.
+    AnimationRef Acquire();
+
+    bool IsResident() const;
+
+private:
+    friend class AnimationStreamer;
+
+    std::string m_SourcePath;
+    std::string m_ClipPath;
+    BoneInfoMap m_BoneInfoMap;
+    AnimationCompressionSettings m_Compression;
+    float m_HeadSeconds = 0.0f;
+    AnimationRef m_Head;
+    AnimationRef m_Body;
+    std::future<CookedClip> m_Cook;
+    std::future<std::shared_ptr<Animation>> m_PageIn;
+    size_t m_BodyMemory = 0;
+    uint64_t m_LastUsedFrame = 0;
+    bool m_Pinned = false;   // The clip file could not be written, so the body can't be evicted
+    bool m_Failed = false;   // Cooking or paging in failed, the clip plays its head only
+};
+
+// Keeps the keyframes of streamed clips within a memory budget. Clips are imported once on a worker
+// thread and written to a compact binary clip file under CLIP_CACHE_DIRECTORY; registration reads
+// only the head section, bodies are read back on a worker thread when played and the least
+// recently used ones are evicted when over budget.
+class AnimationStreamer {
+public:
+    static constexpr const char* CLIP_CACHE_DIRECTORY = "../Cache/Animations/";
+
+    // Global instance
+    static AnimationStreamer& Get();
+
+    // Returns the streamed clip for the file and skeleton, reading the head from its clip file.
+    // Without a current clip file the clip is cooked on a worker thread and has no head until
+    // Update collects it. Returns nullptr if neither the clip file nor the source exist.
+    std::shared_ptr<StreamedClip> Register(const std::string& animationPath, const BoneInfoMap& boneInfoMap);
+
+    // Collects finished cooks and page-ins and evicts bodies over budget. Called once per frame.
+    void Update();
+
+    // Memory budget for resident bodies, heads are not counted
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const;
+
+    // Length of the head kept for clips registered from now on
+    void SetHeadDuration(float seconds);
+    float GetHeadDuration() const;
+
+    // Statistics
+    size_t GetClipCount() const;
+    size_t GetResidentClipCount() const;
+    size_t GetResidentMemory() const;
+    size_t GetHeadMemory() const;
+    size_t GetPageInCount() const { return m_PageInCount; }
+    size_t GetEvictionCount() const { return m_EvictionCount; }
+
+private:
+    friend class StreamedClip;
+
+    AnimationStreamer() = default;
+    ~AnimationStreamer();
+    AnimationStreamer(const AnimationStreamer&) = delete;
+    AnimationStreamer& operator=(const AnimationStreamer&) = delete;
+
+    AnimationRef Acquire(StreamedClip& clip);
+
+    // Imports the source and writes the clip file. Safe to call from worker threads.
+    static CookedClip Cook(const std::string& animationPath, const BoneInfoMap& boneInfoMap,
+                           const AnimationCompressionSettings& compression,
+                           const std::string& clipPath, float headSeconds);
+
+    // Reads the clip file if it is newer than the source, otherwise cooks it again.
+    // Safe to call from worker threads.
+    static std::shared_ptr<Animation> LoadBody(const std::string& animationPath, const BoneInfoMap& boneInfoMap,
+                                               const AnimationCompressionSettings& compression,
+                                               const std::string& clipPath, float headSeconds);
+
+    static bool IsClipFileCurrent(const std::string& animationPath, const std::string& clipPath);
+
+    // Evicts unreferenced bodies, least recently used first, until resident memory fits the budget
+    void Evict();
+
+    mutable std::mutex m_Mutex;
+    std::unordered_map<std::string, std::shared_ptr<StreamedClip>> m_Clips;
+    size_t m_Budget = 32 * 1024 * 1024;
+    float m_HeadDuration = 0.5f;
+    size_t m_ResidentMemory = 0;
+    uint64_t m_Frame = 1;
+    size_t m_PageInCount = 0;
+    size_t m_EvictionCount = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include "BakedAnimation.h"
+#include "AnimationPose.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <glad/gl.h>
+
+namespace SockEngine {
+
+// Texels per bone, the bottom row of a skinning matrix is always (0, 0, 0, 1)
+static constexpr int TEXELS_PER_BONE = 3;
+
+std::shared_ptr<BakedAnimation> BakedAnimation::Bake(const std::vector<std::pair<std::string, AnimationRef>>& clips,
+                                                     float framesPerSecond) {
+    if (clips.empty() || framesPerSecond <= 0.0f) {
+        return nullptr;
+    }
+
+    const Animation* first = clips[0].second.get();
+    if (!first || !first->IsValid() || first->GetBoneCount() == 0) {
+        std::cout << "ERROR: Cannot bake an animation without a skeleton" << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<BakedAnimation> baked(new BakedAnimation());
+    baked->m_BoneCount = first->GetBoneCount();
+
+    // Lay out the clips one after another, a looping clip's last frame blends back into its first
+    int frameCount = 0;
+    std::vector<const Animation*> sources;
+    for (const auto& [name, clip] : clips) {
+        if (!clip || !clip->IsValid() || !clip->SharesHierarchy(*first)) {
+            std::cout << "WARNING: Skipping animation '" << name << "', it does not match the baked skeleton" << std::endl;
+            continue;
+        }
+
+        float ticksPerSecond = clip->m_TicksPerSecond > 0 ? static_cast<float>(clip->m_TicksPerSecond) : 25.0f;
+        float duration = clip->m_Duration / ticksPerSecond;
+
+        Clip bakedClip;
+        bakedClip.name = name;
+        bakedClip.firstFrame = frameCount;
+        bakedClip.frameCount = std::max(1, static_cast<int>(std::round(duration * framesPerSecond)));
+        bakedClip.framesPerSecond = framesPerSecond;
+        baked->m_Clips.push_back(bakedClip);
+        sources.push_back(clip.get());
+        frameCount += bakedClip.frameCount;
+    }
+
+    if (frameCount == 0) {
+        return nullptr;
+    }
+
+    int width = baked->m_BoneCount * TEXELS_PER_BONE;
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (width > maxTextureSize || frameCount > maxTextureSize) {
+        std::cout << "ERROR: Baked animation of " << width << "x" << frameCount << " texels exceeds the texture size limit of "
+                  << maxTextureSize << std::endl;
+        return nullptr;
+    }
+
+    // Sample every frame with the same kernels the animators use
+    std::vector<glm::vec4> texels(static_cast<size_t>(width) * frameCount);
+    std::vector<glm::mat4> palette;
+    for (size_t i = 0; i < sources.size(); i++) {
+        const Animation* clip = sources[i];
+        const Clip& bakedClip = baked->m_Clips[i];
+
+        float ticksPerSecond = clip->m_TicksPerSecond > 0 ? static_cast<float>(clip->m_TicksPerSecond) : 25.0f;
+        PooledPose pose(static_cast<int>(clip->m_Nodes.size()));
+
+        for (int frame = 0; frame < bakedClip.frameCount; frame++) {
+            float animationTime = std::fmod(frame / framesPerSecond * ticksPerSecond, clip->m_Duration);
+            PoseBlend::Sample(*clip, animationTime, nullptr, *pose);
+
+            palette.assign(baked->m_BoneCount, glm::mat4(1.0f));
+            PoseBlend::ComputeBoneMatrices(*clip, *pose, nullptr, nullptr, palette);
+
+            glm::vec4* row = texels.data() + static_cast<size_t>(bakedClip.firstFrame + frame) * width;
+            for (int bone = 0; bone < baked->m_BoneCount; bone++) {
+                const glm::mat4& matrix = palette[bone];
+                for (int r = 0; r < TEXELS_PER_BONE; r++) {
+                    row[bone * TEXELS_PER_BONE + r] = glm::vec4(matrix[0][r], matrix[1][r], matrix[2][r], matrix[3][r]);
+                }
+            }
+        }
+    }
+
+    glGenTextures(1, &baked->m_Texture);
+    glBindTexture(GL_TEXTURE_2D, baked->m_Texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, frameCount, 0, GL_RGBA, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    baked->m_Memory = texels.size() * sizeof(glm::vec4);
+    return baked;
+}
+
+BakedAnimation::~BakedAnimation() {
+    if (m_Texture != 0) {
+        glDeleteTextures(1, &m_Texture);
+    }
+}
+
+int BakedAnimation::FindClip(const std::string& name) const {
+    for (size_t i = 0; i < m_Clips.size(); i++) {
+        if (m_Clips[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef BAKED_ANIMATION_H
+#define BAKED_ANIMATION_H
+
+#include "AnimationLibrary.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+
+namespace SockEngine {
+
+// Clips sampled into a texture of bone matrices for GPU-only crowds. Each texture row holds one
+// frame of one clip, and each bone takes three RGBA32F texels with the first three rows of its
+// skinning matrix. Instances pick their palette by (clip, frame) in the vertex shader.
+class BakedAnimation {
+public:
+    struct Clip {
+        std::string name;
+        int firstFrame = 0;         // Texture row of the clip's first frame
+        int frameCount = 0;
+        float framesPerSecond = 0.0f;
+    };
+
+    // Samples the clips, which must share one skeleton, and uploads the texture.
+    // Must be called on the thread that owns the GL context. Returns nullptr on failure.
+    static std::shared_ptr<BakedAnimation> Bake(const std::vector<std::pair<std::string, AnimationRef>>& clips,
+                                                float framesPerSecond = 30.0f);
+
+    ~BakedAnimation();
+
+    BakedAnimation(const BakedAnimation&) = delete;
+    BakedAnimation& operator=(const BakedAnimation&) = delete;
+
+    unsigned int GetTexture() const { return m_Texture; }
+    int GetBoneCount() const { return m_BoneCount; }
+    const std::vector<Clip>& GetClips() const { return m_Clips; }
+
+    // Index of the named clip, -1 if it was not baked
+    int FindClip(const std::string& name) const;
+
+    // Bytes used by the texture
+    size_t GetMemory() const { return m_Memory; }
+
+private:
+    BakedAnimation() = default;
+
+    unsigned int m_Texture = 0;
+    int m_BoneCount = 0;
+    std::vector<Clip> m_Clips;
+    size_t m_Memory = 0;
+};
+
+}
+
+#endif
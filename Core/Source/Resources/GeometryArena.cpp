@@ -0,0 +1,266 @@
+#include "GeometryArena.h"
+#include "VertexPacking.h"
+#include <glad/gl.h>
+#include <algorithm>
+#include <iostream>
+
+namespace SockEngine {
+
+namespace {
+
+// Default block size, 20 MB of static vertices (28 MB skinned) and 16 MB of indices. Meshes larger
+// than that get a block of their own.
+constexpr size_t BLOCK_VERTEX_COUNT = 1 << 20;
+constexpr size_t BLOCK_INDEX_SIZE = 16 * 1024 * 1024;
+
+// Index ranges start on 4 bytes so 16 and 32 bit indices can share a buffer
+constexpr size_t INDEX_ALIGNMENT = 4;
+
+void CreateBuffer(unsigned int& buffer, size_t size) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (GLAD_GL_VERSION_4_4) {
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    }
+}
+
+size_t GetVertexSize(VertexFormat format) {
+    size_t size = sizeof(VertexPacking::PackedVertex);
+    if (format == VertexFormat::Skinned) {
+        size += sizeof(VertexPacking::SkinVertex);
+    }
+    return size;
+}
+
+}
+
+GeometryArena::FreeList::FreeList(size_t size) {
+    if (size > 0) {
+        m_Ranges[0] = size;
+    }
+}
+
+bool GeometryArena::FreeList::Allocate(size_t size, size_t alignment, size_t& offset) {
+    for (auto it = m_Ranges.begin(); it != m_Ranges.end(); ++it) {
+        size_t start = (it->first + alignment - 1) / alignment * alignment;
+        size_t end = it->first + it->second;
+        if (start + size > end) {
+            continue;
+        }
+
+        // Keep what is left on both sides of the allocation
+        size_t rangeStart = it->first;
+        m_Ranges.erase(it);
+        if (start > rangeStart) {
+            m_Ranges[rangeStart] = start - rangeStart;
+        }
+        if (start + size < end) {
+            m_Ranges[start + size] = end - start - size;
+        }
+        offset = start;
+        return true;
+    }
+    return false;
+}
+
+void GeometryArena::FreeList::Free(size_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    auto it = m_Ranges.emplace(offset, size).first;
+
+    // Merge with the following range, then with the preceding one
+    auto next = std::next(it);
+    if (next != m_Ranges.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        m_Ranges.erase(next);
+    }
+    if (it != m_Ranges.begin()) {
+        auto previous = std::prev(it);
+        if (previous->first + previous->second == it->first) {
+            previous->second += it->second;
+            m_Ranges.erase(it);
+        }
+    }
+}
+
+GeometryArena& GeometryArena::Get() {
+    static GeometryArena instance;
+    return instance;
+}
+
+GeometryAllocation GeometryArena::Allocate(VertexFormat format, const VertexPacking::PackedVertex* vertices,
+                                           const VertexPacking::SkinVertex* skinVertices, size_t vertexCount,
+                                           const void* indices, size_t indexSize) {
+    GeometryAllocation allocation;
+    if (vertexCount == 0 || indexSize == 0) {
+        return allocation;
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // First block of the format with room for both streams
+    size_t vertexOffset = 0;
+    size_t indexOffset = 0;
+    int blockIndex = -1;
+    for (int i = 0; i < static_cast<int>(m_Blocks.size()) && blockIndex < 0; i++) {
+        Block& block = m_Blocks[i];
+        if (block.format != format || !block.vertices.Allocate(vertexCount, 1, vertexOffset)) {
+            continue;
+        }
+        if (!block.indices.Allocate(indexSize, INDEX_ALIGNMENT, indexOffset)) {
+            block.vertices.Free(vertexOffset, vertexCount);
+            continue;
+        }
+        blockIndex = i;
+    }
+
+    if (blockIndex < 0) {
+        blockIndex = CreateBlock(format, vertexCount, indexSize);
+        m_Blocks[blockIndex].vertices.Allocate(vertexCount, 1, vertexOffset);
+        m_Blocks[blockIndex].indices.Allocate(indexSize, INDEX_ALIGNMENT, indexOffset);
+    }
+
+    Block& block = m_Blocks[blockIndex];
+    block.usedSize += vertexCount * GetVertexSize(format) + indexSize;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block.vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * sizeof(VertexPacking::PackedVertex),
+                    vertexCount * sizeof(VertexPacking::PackedVertex), vertices);
+    if (format == VertexFormat::Skinned) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, block.skinBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * sizeof(VertexPacking::SkinVertex),
+                        vertexCount * sizeof(VertexPacking::SkinVertex), skinVertices);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block.indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexSize, indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    allocation.format = format;
+    allocation.block = blockIndex;
+    allocation.baseVertex = static_cast<uint32_t>(vertexOffset);
+    allocation.vertexCount = static_cast<uint32_t>(vertexCount);
+    allocation.indexOffset = indexOffset;
+    allocation.indexSize = indexSize;
+    return allocation;
+}
+
+void GeometryArena::Free(const GeometryAllocation& allocation) {
+    if (!allocation.IsValid()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (allocation.block >= static_cast<int>(m_Blocks.size())) {
+        return;
+    }
+
+    // Nothing to do on the GPU, the range is simply overwritten by the next mesh placed there
+    Block& block = m_Blocks[allocation.block];
+    block.vertices.Free(allocation.baseVertex, allocation.vertexCount);
+    block.indices.Free(allocation.indexOffset, allocation.indexSize);
+    block.usedSize -= allocation.vertexCount * GetVertexSize(block.format) + allocation.indexSize;
+}
+
+int GeometryArena::CreateBlock(VertexFormat format, size_t vertexCount, size_t indexSize) {
+    Block block;
+    block.format = format;
+    block.vertexCapacity = std::max(vertexCount, BLOCK_VERTEX_COUNT);
+    block.indexCapacity = std::max((indexSize + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT, BLOCK_INDEX_SIZE);
+    block.vertices = FreeList(block.vertexCapacity);
+    block.indices = FreeList(block.indexCapacity);
+
+    CreateBuffer(block.vertexBuffer, block.vertexCapacity * sizeof(VertexPacking::PackedVertex));
+    if (format == VertexFormat::Skinned) {
+        CreateBuffer(block.skinBuffer, block.vertexCapacity * sizeof(VertexPacking::SkinVertex));
+    }
+    CreateBuffer(block.indexBuffer, block.indexCapacity);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // The shared vertex array, the format is defined once for every mesh in the block
+    glGenVertexArrays(1, &block.vertexArray);
+    glBindVertexArray(block.vertexArray);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, block.indexBuffer);
+    SetupVertexAttributes(block.vertexBuffer, block.skinBuffer, 0, true);
+    glBindVertexArray(0);
+
+    if (block.vertexCapacity > BLOCK_VERTEX_COUNT || block.indexCapacity > BLOCK_INDEX_SIZE) {
+        std::cout << "WARNING: Mesh of " << vertexCount << " vertices is larger than a geometry block, it gets one of its own" << std::endl;
+    }
+
+    m_Blocks.push_back(std::move(block));
+    return static_cast<int>(m_Blocks.size()) - 1;
+}
+
+void GeometryArena::SetupVertexAttributes(unsigned int vertexBuffer, unsigned int skinBuffer, size_t firstVertex, bool includeBoneIDs) {
+    using VertexPacking::PackedVertex;
+    using VertexPacking::SkinVertex;
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    size_t base = firstVertex * sizeof(PackedVertex);
+
+    // Set the vertex attribute pointers
+    // Vertex positions, w is the bitangent sign
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)(base + offsetof(PackedVertex, position)));
+    // Vertex normals, octahedral
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)(base + offsetof(PackedVertex, normal)));
+    // Vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)(base + offsetof(PackedVertex, texCoords)));
+    // Vertex tangent, octahedral
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)(base + offsetof(PackedVertex, tangent)));
+
+    // Without a skin stream the animated shaders read the constant attributes, see Mesh::DrawElements
+    if (skinBuffer == 0) {
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, skinBuffer);
+    base = firstVertex * sizeof(SkinVertex);
+    // Bone IDs
+    if (includeBoneIDs) {
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, sizeof(SkinVertex), (void*)(base + offsetof(SkinVertex, boneIDs)));
+    }
+    // Bone weights
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinVertex), (void*)(base + offsetof(SkinVertex, weights)));
+}
+
+void GeometryArena::Shutdown() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto& block : m_Blocks) {
+        glDeleteVertexArrays(1, &block.vertexArray);
+        glDeleteBuffers(1, &block.vertexBuffer);
+        if (block.skinBuffer != 0) {
+            glDeleteBuffers(1, &block.skinBuffer);
+        }
+        glDeleteBuffers(1, &block.indexBuffer);
+    }
+    m_Blocks.clear();
+}
+
+size_t GeometryArena::GetCapacity() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    size_t capacity = 0;
+    for (const auto& block : m_Blocks) {
+        capacity += block.vertexCapacity * GetVertexSize(block.format) + block.indexCapacity;
+    }
+    return capacity;
+}
+
+size_t GeometryArena::GetUsedSize() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    size_t used = 0;
+    for (const auto& block : m_Blocks) {
+        used += block.usedSize;
+    }
+    return used;
+}
+
+}
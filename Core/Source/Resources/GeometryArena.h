@@ -0,0 +1,109 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+namespace SockEngine {
+
+namespace VertexPacking {
+    struct PackedVertex;
+    struct SkinVertex;
+}
+
+// Vertex streams of a mesh, each format has its own blocks and vertex array
+enum class VertexFormat {
+    Static,     // PackedVertex
+    Skinned     // PackedVertex and SkinVertex, at the same vertex index in parallel buffers
+};
+
+// Range of a mesh in the arena. Draws use the block's vertex array with the base vertex and the
+// byte offset of the first index.
+struct GeometryAllocation {
+    VertexFormat format = VertexFormat::Static;
+    int block = -1;
+    uint32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+    size_t indexOffset = 0;
+    size_t indexSize = 0;
+
+    bool IsValid() const { return block >= 0; }
+};
+
+// Engine-wide vertex and index storage. Meshes are sub-allocated from a few large immutable buffers
+// per vertex format instead of owning their own, so every mesh of a format draws from the same
+// vertex array and draws only differ by base vertex and first index. Blocks are added when the
+// existing ones are full, freed ranges are reused first fit. GL thread only, besides Free.
+class GeometryArena {
+public:
+    // Global instance
+    static GeometryArena& Get();
+
+    // Copies a mesh's streams into a block with room for them. skinVertices is only read for the
+    // Skinned format. indices holds indexSize bytes of 16 or 32 bit indices.
+    GeometryAllocation Allocate(VertexFormat format, const VertexPacking::PackedVertex* vertices,
+                                const VertexPacking::SkinVertex* skinVertices, size_t vertexCount,
+                                const void* indices, size_t indexSize);
+
+    // Returns the range for reuse. Any thread, ignored once the arena is shut down.
+    void Free(const GeometryAllocation& allocation);
+
+    // Buffers of the block holding an allocation
+    unsigned int GetVertexArray(const GeometryAllocation& allocation) const { return m_Blocks[allocation.block].vertexArray; }
+    unsigned int GetVertexBuffer(const GeometryAllocation& allocation) const { return m_Blocks[allocation.block].vertexBuffer; }
+    unsigned int GetSkinBuffer(const GeometryAllocation& allocation) const { return m_Blocks[allocation.block].skinBuffer; }
+    unsigned int GetIndexBuffer(const GeometryAllocation& allocation) const { return m_Blocks[allocation.block].indexBuffer; }
+
+    // Points the attributes of the bound vertex array at the streams, starting at firstVertex.
+    // Without a skin buffer the bone attributes are left disabled, Mesh sets their constant values when drawing.
+    static void SetupVertexAttributes(unsigned int vertexBuffer, unsigned int skinBuffer, size_t firstVertex, bool includeBoneIDs);
+
+    // Deletes the blocks while the GL context is still alive
+    void Shutdown();
+
+    // Statistics
+    size_t GetBlockCount() const { return m_Blocks.size(); }
+    size_t GetCapacity() const;
+    size_t GetUsedSize() const;
+
+private:
+    GeometryArena() = default;
+    ~GeometryArena() = default;
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // First fit allocator over the free ranges of a buffer, merged when they touch
+    class FreeList {
+    public:
+        explicit FreeList(size_t size = 0);
+        bool Allocate(size_t size, size_t alignment, size_t& offset);
+        void Free(size_t offset, size_t size);
+
+    private:
+        std::map<size_t, size_t> m_Ranges;  // Offset -> size
+    };
+
+    struct Block {
+        VertexFormat format;
+        unsigned int vertexArray = 0;
+        unsigned int vertexBuffer = 0;
+        unsigned int skinBuffer = 0;
+        unsigned int indexBuffer = 0;
+        size_t vertexCapacity = 0;
+        size_t indexCapacity = 0;
+        size_t usedSize = 0;
+        FreeList vertices;
+        FreeList indices;
+    };
+
+    int CreateBlock(VertexFormat format, size_t vertexCount, size_t indexSize);
+
+    mutable std::mutex m_Mutex;
+    std::vector<Block> m_Blocks;
+};
+
+}
+
+#endif
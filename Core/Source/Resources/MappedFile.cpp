@@ -0,0 +1,88 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SockEngine {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    m_File = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        return;
+    }
+    m_Mapping = mapping;
+
+    m_Data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    m_Size = m_Data ? static_cast<size_t>(size.QuadPart) : 0;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_Data) {
+        UnmapViewOfFile(m_Data);
+    }
+    if (m_Mapping) {
+        CloseHandle(m_Mapping);
+    }
+    if (m_File) {
+        CloseHandle(m_File);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+    m_File = open(path.c_str(), O_RDONLY);
+    if (m_File < 0) {
+        return;
+    }
+
+    struct stat status;
+    if (fstat(m_File, &status) != 0 || status.st_size == 0) {
+        return;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, m_File, 0);
+    if (data == MAP_FAILED) {
+        return;
+    }
+    m_Data = static_cast<const unsigned char*>(data);
+    m_Size = static_cast<size_t>(status.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_Data) {
+        munmap(const_cast<unsigned char*>(m_Data), m_Size);
+    }
+    if (m_File >= 0) {
+        close(m_File);
+    }
+}
+
+#endif
+
+}
@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+namespace SockEngine {
+
+// Read-only memory mapping of a whole file. The pages are loaded by the OS on first access,
+// so reading a large file costs no copy into an intermediate buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file is missing, empty or could not be mapped
+    bool IsOpen() const { return m_Data != nullptr; }
+
+    const unsigned char* GetData() const { return m_Data; }
+    size_t GetSize() const { return m_Size; }
+
+private:
+    const unsigned char* m_Data = nullptr;
+    size_t m_Size = 0;
+
+#ifdef _WIN32
+    void* m_File = nullptr;
+    void* m_Mapping = nullptr;
+#else
+    int m_File = -1;
+#endif
+};
+
+}
+
+#endif
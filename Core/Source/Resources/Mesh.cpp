@@ -1,20 +1,161 @@
 #include "Mesh.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <limits>
 
 namespace SockEngine {
 
+namespace {
+
+// Share of the error threshold a coarser level has to stay under before it replaces the current one
+constexpr float LOD_HYSTERESIS = 0.25f;
+
+}
+
 // Constructor
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, bool upload,
+           std::vector<MeshLOD> lods)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+    this->lods = std::move(lods);
+    if (this->lods.empty()) {
+        MeshLOD full;
+        full.indexCount = static_cast<uint32_t>(this->indices.size());
+        this->lods.push_back(full);
+    }
+    m_VertexCount = this->vertices.size();
+    m_IndexCount = this->indices.size();
+
+    if (!this->vertices.empty()) {
+        m_BoundsMin = m_BoundsMax = this->vertices[0].Position;
+        for (const auto& vertex : this->vertices) {
+            m_BoundsMin = glm::min(m_BoundsMin, vertex.Position);
+            m_BoundsMax = glm::max(m_BoundsMax, vertex.Position);
+            m_Skinned = m_Skinned || vertex.m_BoneIDs[0] >= 0;
+        }
+    }
+
+    // Indices are uploaded as 16 bit whenever they fit
+    unsigned int maxIndex = this->indices.empty() ? 0 : *std::max_element(this->indices.begin(), this->indices.end());
+    m_IndexType = maxIndex <= std::numeric_limits<uint16_t>::max() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    // Positions are uploaded as snorm16 spanning the bounds
+    VertexPacking::PositionQuantization quantization = VertexPacking::ComputeQuantization(m_BoundsMin, m_BoundsMax);
+    m_PositionOffset = quantization.offset;
+    m_PositionScale = quantization.scale;
 
     // Now that we have all the required data, set the vertex buffers and its attribute pointers.
+    if (upload) {
+        Upload();
+    }
+}
+
+void Mesh::Upload()
+{
+    if (m_Uploaded) {
+        return;
+    }
+
     SetupMesh();
+    m_Uploaded = true;
+
+    UploadSkeletonLODs();
+    UploadMorphTargets();
+}
+
+size_t Mesh::GetUploadSize() const
+{
+    size_t size = m_VertexCount * sizeof(VertexPacking::PackedVertex) + m_IndexCount * GetIndexSize();
+    if (m_Skinned) {
+        size += m_VertexCount * sizeof(VertexPacking::SkinVertex);
+    }
+    size += m_PendingSkeletonLODs.size() * m_VertexCount * sizeof(uint32_t);
+    if (!morphTargets.empty()) {
+        size += morphDeltas.size() * sizeof(MorphDelta) + m_VertexCount * sizeof(int);
+    }
+    return size;
 }
 
 // Render the mesh
-void Mesh::Draw(Shader& shader)
+void Mesh::Draw(Shader& shader, int skeletonLOD, int lod)
+{
+    if (skeletonLOD > 0 && skeletonLOD <= static_cast<int>(m_SkeletonLODVAOs.size())) {
+        DrawVertexArray(shader, m_SkeletonLODVAOs[skeletonLOD - 1], 1, lod);
+        return;
+    }
+    if (!m_Geometry.IsValid()) {
+        return;
+    }
+
+    BindTextures(shader);
+    shader.SetVec3("positionOffset", m_PositionOffset);
+    shader.SetVec3("positionScale", m_PositionScale);
+
+    // Draw mesh from the vertex array shared by the whole arena block
+    glBindVertexArray(GeometryArena::Get().GetVertexArray(m_Geometry));
+    DrawElements(static_cast<int>(m_Geometry.baseVertex), 1, lod);
+    glBindVertexArray(0);
+
+    // Always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawVertexArray(Shader& shader, unsigned int vertexArray, int instanceCount, int lod)
+{
+    if (!m_Geometry.IsValid()) {
+        return;
+    }
+
+    BindTextures(shader);
+    shader.SetVec3("positionOffset", m_PositionOffset);
+    shader.SetVec3("positionScale", m_PositionScale);
+
+    // Draw mesh
+    glBindVertexArray(vertexArray);
+    DrawElements(0, instanceCount, lod);
+    glBindVertexArray(0);
+
+    // Always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawElements(int baseVertex, int instanceCount, int lod)
+{
+    const MeshLOD& level = lods[std::clamp(lod, 0, GetLODCount() - 1)];
+    unsigned int count = level.indexCount;
+    void* firstIndex = (void*)(m_Geometry.indexOffset + level.firstIndex * GetIndexSize());
+
+    // Static meshes have no skin stream, the animated shaders read the constant attributes instead.
+    // Those are context state rather than vertex array state, so they are set for every draw.
+    if (!m_Skinned) {
+        glVertexAttribI4ui(5, VertexPacking::NO_BONE, VertexPacking::NO_BONE, VertexPacking::NO_BONE, VertexPacking::NO_BONE);
+        glVertexAttrib4f(6, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    if (instanceCount == 1) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, count, m_IndexType, firstIndex, baseVertex);
+    } else {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, m_IndexType, firstIndex, instanceCount, baseVertex);
+    }
+}
+
+int Mesh::SelectLOD(float pixelsPerUnit, float errorThreshold, int currentLOD) const
+{
+    int lod = std::clamp(currentLOD, 0, GetLODCount() - 1);
+
+    // Finer while the current level is visibly off, then coarser while the next one stays well under
+    while (lod > 0 && lods[lod].error * pixelsPerUnit > errorThreshold) {
+        lod--;
+    }
+    while (lod + 1 < GetLODCount() && lods[lod + 1].error * pixelsPerUnit < errorThreshold * (1.0f - LOD_HYSTERESIS)) {
+        lod++;
+    }
+    return lod;
+}
+
+void Mesh::BindTextures(Shader& shader)
 {
     // Bind appropriate textures
     unsigned int diffuseNr = 1;
@@ -50,57 +191,181 @@ void Mesh::Draw(Shader& shader)
         // And finally bind the texture
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
+}
 
-    // Draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+void Mesh::SetupMesh()
+{
+    // Pack the vertices for the GPU
+    VertexPacking::PositionQuantization quantization = { m_PositionOffset, m_PositionScale };
+    std::vector<VertexPacking::PackedVertex> packedVertices(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        packedVertices[i] = VertexPacking::PackVertex(vertices[i], quantization);
+    }
 
-    // Always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+    // Bone influences go to a second stream, static meshes don't carry them
+    std::vector<VertexPacking::SkinVertex> skinVertices;
+    if (m_Skinned) {
+        skinVertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            skinVertices[i] = VertexPacking::PackSkin(vertices[i]);
+        }
+    }
+
+    // Load data into a range of the geometry arena
+    VertexFormat format = m_Skinned ? VertexFormat::Skinned : VertexFormat::Static;
+    if (m_IndexType == GL_UNSIGNED_SHORT) {
+        std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+        m_Geometry = GeometryArena::Get().Allocate(format, packedVertices.data(), skinVertices.data(), vertices.size(),
+                                                   shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+    } else {
+        m_Geometry = GeometryArena::Get().Allocate(format, packedVertices.data(), skinVertices.data(), vertices.size(),
+                                                   indices.data(), indices.size() * sizeof(unsigned int));
+    }
 }
 
-void Mesh::SetupMesh()
+void Mesh::ReleaseGeometry()
 {
-    // Create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    // Load data into vertex buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for all its items.
-    // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-    // again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-    // Set the vertex attribute pointers
-    // Vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // Vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    // Vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-    // Vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-    // Vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-    // Bone IDs
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-    // Bone weights
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-    glBindVertexArray(0);
+    GeometryArena::Get().Free(m_Geometry);
+    m_Geometry = GeometryAllocation();
+
+    // Skeleton LOD streams live outside the arena
+    if (!m_SkeletonLODVAOs.empty()) {
+        glDeleteVertexArrays(static_cast<GLsizei>(m_SkeletonLODVAOs.size()), m_SkeletonLODVAOs.data());
+        glDeleteBuffers(static_cast<GLsizei>(m_SkeletonLODBoneBuffers.size()), m_SkeletonLODBoneBuffers.data());
+        m_SkeletonLODVAOs.clear();
+        m_SkeletonLODBoneBuffers.clear();
+    }
+
+    // So do the morph target deltas and slots
+    if (m_MorphDeltaBuffer != 0) {
+        glDeleteBuffers(1, &m_MorphDeltaBuffer);
+        glDeleteBuffers(1, &m_MorphSlotBuffer);
+        m_MorphDeltaBuffer = 0;
+        m_MorphSlotBuffer = 0;
+    }
+}
+
+void Mesh::ReleaseVertexData(MeshResidency residency)
+{
+    // Pending skeleton LODs and morph targets still need the vertices
+    if (!m_Uploaded) {
+        return;
+    }
+
+    if (residency == MeshResidency::Collision && positions.empty()) {
+        positions.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            positions[i] = vertices[i].Position;
+        }
+    }
+
+    // Swapped with empty vectors, clear alone keeps the memory
+    std::vector<Vertex>().swap(vertices);
+    std::vector<MorphDelta>().swap(morphDeltas);
+    std::vector<unsigned int>().swap(morphedVertices);
+    if (residency == MeshResidency::GpuOnly) {
+        std::vector<unsigned int>().swap(indices);
+        std::vector<glm::vec3>().swap(positions);
+    } else {
+        // Collision only needs the full level
+        indices.resize(lods[0].indexCount);
+        indices.shrink_to_fit();
+    }
+}
+
+void Mesh::SetupSkeletonLODs(const SkeletonLODSet& skeletonLODs)
+{
+    for (const auto& skeletonLOD : skeletonLODs) {
+        // Point every influence at the bone's palette index at this LOD. Weights are unchanged,
+        // influences that collapse onto the same ancestor simply add up in the shader.
+        std::vector<uint32_t> boneIDs(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            int remapped[MAX_BONE_INFLUENCE];
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+                int boneID = vertices[i].m_BoneIDs[j];
+                bool mapped = boneID >= 0 && boneID < static_cast<int>(skeletonLOD.boneRemap.size());
+                remapped[j] = mapped ? skeletonLOD.boneRemap[boneID] : -1;
+            }
+            boneIDs[i] = VertexPacking::PackBoneIDs(remapped);
+        }
+        m_PendingSkeletonLODs.push_back(std::move(boneIDs));
+    }
+
+    if (m_Uploaded) {
+        UploadSkeletonLODs();
+    }
 }
 
-}
\ No newline at end of file
+void Mesh::UploadSkeletonLODs()
+{
+    if (!m_Geometry.IsValid()) {
+        m_PendingSkeletonLODs.clear();
+        return;
+    }
+
+    for (const auto& boneIDs : m_PendingSkeletonLODs) {
+        unsigned int lodVAO, boneBuffer;
+        glGenVertexArrays(1, &lodVAO);
+        glGenBuffers(1, &boneBuffer);
+
+        glBindVertexArray(lodVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, boneBuffer);
+        glBufferData(GL_ARRAY_BUFFER, boneIDs.size() * sizeof(uint32_t), boneIDs.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, sizeof(uint32_t), (void*)0);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GetIndexBuffer());
+        GeometryArena::SetupVertexAttributes(GetVertexBuffer(), GetSkinBuffer(), m_Geometry.baseVertex, false);
+        glBindVertexArray(0);
+
+        m_SkeletonLODVAOs.push_back(lodVAO);
+        m_SkeletonLODBoneBuffers.push_back(boneBuffer);
+    }
+    m_PendingSkeletonLODs.clear();
+}
+
+void Mesh::SetupMorphTargets(std::vector<MorphTarget> targets, std::vector<MorphDelta> deltas, std::vector<unsigned int> morphed)
+{
+    morphTargets = std::move(targets);
+    morphDeltas = std::move(deltas);
+    morphedVertices = std::move(morphed);
+    m_MorphedVertexCount = morphedVertices.size();
+    if (m_Uploaded) {
+        UploadMorphTargets();
+    }
+}
+
+void Mesh::UploadMorphTargets()
+{
+    if (morphTargets.empty() || m_MorphDeltaBuffer != 0) {
+        return;
+    }
+
+    std::vector<int> slots(m_VertexCount, -1);
+    for (size_t slot = 0; slot < morphedVertices.size(); slot++) {
+        slots[morphedVertices[slot]] = static_cast<int>(slot);
+    }
+
+    glGenBuffers(1, &m_MorphDeltaBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_MorphDeltaBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, morphDeltas.size() * sizeof(MorphDelta), morphDeltas.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &m_MorphSlotBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_MorphSlotBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, slots.size() * sizeof(int), slots.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+unsigned int Mesh::CreateVertexArray()
+{
+    unsigned int vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    if (m_Geometry.IsValid()) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GetIndexBuffer());
+        GeometryArena::SetupVertexAttributes(GetVertexBuffer(), GetSkinBuffer(), m_Geometry.baseVertex, true);
+    }
+    return vertexArray;
+}
+
+}
@@ -2,8 +2,11 @@
 #define MESH_H
 
 #include "Shader.h"
+#include "AnimData.h"
+#include "GeometryArena.h"
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -11,6 +14,7 @@
 
 namespace SockEngine {
 
+// Vertex as imported, uploaded packed (see VertexPacking.h)
 struct Vertex {
     // Position
     glm::vec3 Position;
@@ -34,26 +38,173 @@ struct Texture {
     std::string path;
 };
 
+// Offset of one vertex in one morph target. Only vertices the target moves have a delta.
+// Matches the MorphDelta struct of Morph.comp (std430).
+struct MorphDelta {
+    glm::vec3 position;
+    uint32_t slot;          // Index into the mesh's morphed vertices
+    glm::vec3 normal;
+    float padding = 0.0f;
+};
+
+// Blend shape, a range of the mesh's sparse deltas
+struct MorphTarget {
+    std::string name;
+    int index = -1;             // Model-wide target index, targets with the same name share it
+    uint32_t firstDelta = 0;
+    uint32_t deltaCount = 0;
+};
+
+// Detail level of a mesh, a range of its indices drawn with the same vertices. Level 0 is the full
+// mesh, the others are simplified at import (see MeshSimplifier.h).
+struct MeshLOD {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    float error = 0.0f;     // Distance in model units the surface strays from the full mesh
+};
+
+// CPU data a mesh keeps once it is on the GPU, see Mesh::ReleaseVertexData
+enum class MeshResidency {
+    GpuOnly,    // Nothing, the geometry only lives in the arena
+    Collision   // Positions and indices, for ray casts and collision
+};
+
 class Mesh {
 public:
-    // Mesh data
+    // Mesh data. The vertices, indices and morph deltas are only needed to import and upload the
+    // mesh, ReleaseVertexData drops them afterwards.
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
-    unsigned int VAO;
 
-    // Constructor
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+    // Vertex positions kept by MeshResidency::Collision, indexed like the vertices
+    std::vector<glm::vec3> positions;
+
+    // Detail levels, ranges of the indices. The full mesh comes first, with the lowest indices.
+    std::vector<MeshLOD> lods;
+
+    // Morph targets. Every vertex moved by at least one target gets a slot, deltas refer to slots.
+    std::vector<MorphTarget> morphTargets;
+    std::vector<MorphDelta> morphDeltas;
+    std::vector<unsigned int> morphedVertices;  // Slot -> vertex index
+
+    // Constructor. Meshes imported on a worker thread defer their GL buffers to Upload. Without
+    // detail levels the mesh only has the full one, all of its indices.
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, bool upload = true,
+         std::vector<MeshLOD> lods = {});
+
+    // Creates the buffers of a deferred mesh, including its skeleton LOD and morph streams. GL thread only.
+    void Upload();
+    bool IsUploaded() const { return m_Uploaded; }
+
+    // Returns the mesh's range of the geometry arena and deletes the GL objects it owns outside of
+    // it, called by the model owning it. GL thread only.
+    void ReleaseGeometry();
+
+    // Frees the CPU copy of an uploaded mesh, keeping what the residency asks for. Counts and
+    // bounds stay valid.
+    void ReleaseVertexData(MeshResidency residency);
+
+    // Bytes Upload sends to the GPU
+    size_t GetUploadSize() const;
+
+    // Render the mesh at a detail level. Skinned meshes draw with the bone IDs of the given skeleton
+    // LOD (0 is the full skeleton).
+    void Draw(Shader& shader, int skeletonLOD = 0, int lod = 0);
 
-    // Render the mesh
-    void Draw(Shader& shader);
+    // Render the mesh with another vertex array that shares its index buffer (e.g. skinned vertices),
+    // optionally instanced. Its vertices start at 0 and its positions must be in the mesh's
+    // quantization space.
+    void DrawVertexArray(Shader& shader, unsigned int vertexArray, int instanceCount = 1, int lod = 0);
+
+    // Creates a vertex array over the mesh's range of the arena, its first vertex at 0. It is left
+    // bound so the caller can add its own attributes (e.g. per-instance data) after the mesh's, from 7 on.
+    unsigned int CreateVertexArray();
+
+    // Creates a remapped bone ID stream for each reduced skeleton (on Upload if deferred)
+    void SetupSkeletonLODs(const SkeletonLODSet& skeletonLODs);
+
+    // Uploads the sparse deltas and the vertex -> slot map read by the morph and skinning passes (on Upload if deferred)
+    void SetupMorphTargets(std::vector<MorphTarget> targets, std::vector<MorphDelta> deltas, std::vector<unsigned int> morphed);
+
+    // Arena buffers holding the mesh, for passes that read it directly. The mesh's vertices start
+    // at GetBaseVertex, PackedVertex in the vertex buffer and SkinVertex in the skin buffer (0 for
+    // meshes without bone influences). Its indices start GetIndexOffset bytes into the index buffer.
+    unsigned int GetVertexBuffer() const { return GeometryArena::Get().GetVertexBuffer(m_Geometry); }
+    unsigned int GetSkinBuffer() const { return GeometryArena::Get().GetSkinBuffer(m_Geometry); }
+    unsigned int GetIndexBuffer() const { return GeometryArena::Get().GetIndexBuffer(m_Geometry); }
+    uint32_t GetBaseVertex() const { return m_Geometry.baseVertex; }
+    size_t GetIndexOffset() const { return m_Geometry.indexOffset; }
+
+    // GL_UNSIGNED_SHORT when every index fits 16 bits, GL_UNSIGNED_INT otherwise
+    unsigned int GetIndexType() const { return m_IndexType; }
+    size_t GetIndexSize() const { return m_IndexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t); }
+    size_t GetVertexCount() const { return m_VertexCount; }
+    size_t GetIndexCount() const { return m_IndexCount; }
+    int GetLODCount() const { return static_cast<int>(lods.size()); }
+    const MeshLOD& GetLOD(int lod) const { return lods[lod]; }
+
+    // Coarsest level whose error, seen from the distance, stays under errorThreshold pixels.
+    // pixelsPerUnit is the size on screen of one model unit at the mesh. To keep levels from
+    // flickering at a boundary, a coarser level than currentLOD has to stay further under the
+    // threshold than the current one has to exceed it.
+    int SelectLOD(float pixelsPerUnit, float errorThreshold, int currentLOD) const;
+
+    bool IsSkinned() const { return m_Skinned; }
+
+    // Packed positions map to model space as offset + scale * position, the shaders' positionOffset
+    // and positionScale
+    const glm::vec3& GetPositionOffset() const { return m_PositionOffset; }
+    const glm::vec3& GetPositionScale() const { return m_PositionScale; }
+
+    // Bind pose bounds in model space
+    const glm::vec3& GetBoundsMin() const { return m_BoundsMin; }
+    const glm::vec3& GetBoundsMax() const { return m_BoundsMax; }
+    bool HasMorphTargets() const { return !morphTargets.empty(); }
+    int GetMorphedVertexCount() const { return static_cast<int>(m_MorphedVertexCount); }
+    unsigned int GetMorphDeltaBuffer() const { return m_MorphDeltaBuffer; }
+    unsigned int GetMorphSlotBuffer() const { return m_MorphSlotBuffer; }
+    unsigned int GetSkeletonLODBoneBuffer(int skeletonLOD) const {
+        return skeletonLOD > 0 && skeletonLOD <= static_cast<int>(m_SkeletonLODBoneBuffers.size()) ? m_SkeletonLODBoneBuffers[skeletonLOD - 1] : 0;
+    }
 
 private:
-    // Render data 
-    unsigned int VBO, EBO;
+    // Render data, a range of the geometry arena
+    GeometryAllocation m_Geometry;
+    unsigned int m_IndexType = GL_UNSIGNED_INT;
+    size_t m_VertexCount = 0;
+    size_t m_IndexCount = 0;
+    size_t m_MorphedVertexCount = 0;
+    bool m_Skinned = false;
+
+    glm::vec3 m_BoundsMin = glm::vec3(0.0f);
+    glm::vec3 m_BoundsMax = glm::vec3(0.0f);
+    glm::vec3 m_PositionOffset = glm::vec3(0.0f);
+    glm::vec3 m_PositionScale = glm::vec3(1.0f);
+
+    // One vertex array per reduced skeleton, over the mesh's range of the arena
+    std::vector<unsigned int> m_SkeletonLODVAOs;
+    std::vector<unsigned int> m_SkeletonLODBoneBuffers;
+
+    // Morph target deltas and the slot of every vertex (-1 if no target moves it)
+    unsigned int m_MorphDeltaBuffer = 0;
+    unsigned int m_MorphSlotBuffer = 0;
+
+    // Remapped bone IDs waiting for Upload, one stream per reduced skeleton, packed like SkinVertex::boneIDs
+    std::vector<std::vector<uint32_t>> m_PendingSkeletonLODs;
+    bool m_Uploaded = false;
 
     // Initializes all the buffer objects/arrays
     void SetupMesh();
+
+    void UploadSkeletonLODs();
+    void UploadMorphTargets();
+
+    // Draws the indices of a detail level from the bound vertex array
+    void DrawElements(int baseVertex, int instanceCount, int lod);
+
+    // Binds the material textures to the shader's samplers
+    void BindTextures(Shader& shader);
 };
 
 }
@@ -0,0 +1,343 @@
+#include "MeshOptimizer.h"
+#include <unordered_set>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cstring>
+#include <cmath>
+
+namespace SockEngine {
+
+namespace {
+
+// FIFO cache the statistics and the overdraw clustering are measured on
+constexpr size_t STATS_CACHE_SIZE = 16;
+
+// LRU cache modelled by the triangle ordering, larger than the real one so the order stays good
+// across GPUs with different cache sizes
+constexpr int FORSYTH_CACHE_SIZE = 32;
+
+// Vertex scores of Forsyth's "Linear-Speed Vertex Cache Optimisation": the vertices of the last
+// triangle score a little lower so the next one doesn't reuse all three, older entries decay, and
+// vertices with few triangles left are boosted so they get finished off before leaving the cache
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+// The overdraw order is dropped if it costs more vertex shader runs than this times the cache order
+constexpr float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+constexpr unsigned int NO_TRIANGLE = ~0u;
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+// FIFO vertex cache. A vertex is still cached if fewer than the cache size misses happened since
+// it was last loaded, so nothing has to be shifted.
+class FifoCache {
+public:
+    explicit FifoCache(size_t vertexCount) : m_Timestamps(vertexCount, 0) {}
+
+    // Returns 1 if the vertex had to be transformed
+    unsigned int Access(unsigned int vertex) {
+        if (m_Time - m_Timestamps[vertex] <= STATS_CACHE_SIZE) {
+            return 0;
+        }
+        m_Timestamps[vertex] = m_Time++;
+        return 1;
+    }
+
+private:
+    std::vector<size_t> m_Timestamps;
+    size_t m_Time = STATS_CACHE_SIZE + 1;
+};
+
+// Vertex bytes compared as a whole, the struct has no padding
+struct VertexHash {
+    const std::vector<Vertex>* vertices;
+
+    size_t operator()(unsigned int index) const {
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(&(*vertices)[index]);
+        uint64_t hash = FNV_OFFSET;
+        for (size_t i = 0; i < sizeof(Vertex); i++) {
+            hash ^= data[i];
+            hash *= FNV_PRIME;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+struct VertexEqual {
+    const std::vector<Vertex>* vertices;
+
+    bool operator()(unsigned int a, unsigned int b) const {
+        return std::memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(Vertex)) == 0;
+    }
+};
+
+// Returns the first vertex identical to each vertex
+std::vector<unsigned int> WeldVertices(const std::vector<Vertex>& vertices) {
+    std::vector<unsigned int> remap(vertices.size());
+    std::unordered_set<unsigned int, VertexHash, VertexEqual> unique(vertices.size(), VertexHash{ &vertices }, VertexEqual{ &vertices });
+    for (unsigned int i = 0; i < vertices.size(); i++) {
+        remap[i] = *unique.insert(i).first;
+    }
+    return remap;
+}
+
+float ComputeVertexScore(int cachePosition, unsigned int liveTriangles) {
+    if (liveTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0 && cachePosition < 3) {
+        score = LAST_TRIANGLE_SCORE;
+    }
+    else if (cachePosition >= 3) {
+        score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    }
+    return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(liveTriangles), -VALENCE_BOOST_POWER);
+}
+
+// Forsyth's greedy ordering: emits the best scoring triangle among the ones using cached vertices,
+// falls back to the next triangle left in the original order when none does
+std::vector<unsigned int> OptimizeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount) {
+    const size_t triangleCount = indices.size() / 3;
+
+    // Triangles of every vertex, the first liveTriangles of each list are still to be emitted
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index : indices) {
+        liveTriangles[index]++;
+    }
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        firstTriangle[v + 1] = firstTriangle[v] + liveTriangles[v];
+    }
+    std::vector<unsigned int> vertexTriangles(indices.size());
+    std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        vertexTriangles[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = ComputeVertexScore(-1, liveTriangles[v]);
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    size_t cursor = 0;
+    unsigned int best = NO_TRIANGLE;
+    while (result.size() < indices.size()) {
+        if (best == NO_TRIANGLE) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = static_cast<unsigned int>(cursor);
+        }
+
+        emitted[best] = true;
+        const unsigned int* triangle = &indices[best * 3];
+        nextCache.clear();
+        for (int k = 0; k < 3; k++) {
+            unsigned int vertex = triangle[k];
+            result.push_back(vertex);
+
+            // Swap the triangle out of the live part of the vertex's list
+            unsigned int* begin = vertexTriangles.data() + firstTriangle[vertex];
+            unsigned int* last = begin + liveTriangles[vertex] - 1;
+            std::iter_swap(std::find(begin, last + 1, best), last);
+            liveTriangles[vertex]--;
+
+            if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end()) {
+                nextCache.push_back(vertex);
+            }
+        }
+
+        // The triangle's vertices move to the front of the cache, the entries pushed past its end are evicted
+        for (unsigned int vertex : cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                nextCache.push_back(vertex);
+            }
+        }
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            unsigned int vertex = nextCache[i];
+            cachePositions[vertex] = i < static_cast<size_t>(FORSYTH_CACHE_SIZE) ? static_cast<int>(i) : -1;
+            vertexScores[vertex] = ComputeVertexScore(cachePositions[vertex], liveTriangles[vertex]);
+        }
+
+        // Only the triangles of vertices whose score changed can become the best one
+        best = NO_TRIANGLE;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (unsigned int vertex : nextCache) {
+            const unsigned int* begin = vertexTriangles.data() + firstTriangle[vertex];
+            for (const unsigned int* t = begin; t < begin + liveTriangles[vertex]; t++) {
+                float score = vertexScores[indices[*t * 3]] + vertexScores[indices[*t * 3 + 1]] + vertexScores[indices[*t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = *t;
+                }
+            }
+        }
+
+        nextCache.resize(std::min<size_t>(nextCache.size(), FORSYTH_CACHE_SIZE));
+        std::swap(cache, nextCache);
+    }
+    return result;
+}
+
+// Simplified "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander et al.):
+// the cache order is cut into clusters where the cache is cold, and the clusters facing away from
+// the mesh center are drawn first, so they hide the ones behind them from most viewpoints
+std::vector<unsigned int> OptimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices) {
+    const size_t triangleCount = indices.size() / 3;
+
+    // A triangle missing all of its vertices starts a cluster, reordering clusters costs little there
+    std::vector<size_t> clusterStarts;
+    FifoCache cache(vertices.size());
+    for (size_t t = 0; t < triangleCount; t++) {
+        unsigned int misses = cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+        if (misses == 3 || t == 0) {
+            clusterStarts.push_back(t);
+        }
+    }
+    if (clusterStarts.size() < 2) {
+        return indices;
+    }
+    clusterStarts.push_back(triangleCount);
+
+    // Area weighted centroid and normal of every cluster
+    struct Cluster {
+        size_t firstTriangle;
+        size_t lastTriangle;
+        glm::vec3 centroid;
+        glm::vec3 normal;
+        float area;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t i = 0; i + 1 < clusterStarts.size(); i++) {
+        Cluster cluster = { clusterStarts[i], clusterStarts[i + 1], glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f };
+        for (size_t t = cluster.firstTriangle; t < cluster.lastTriangle; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float area = glm::length(normal);
+            cluster.centroid += (a + b + c) * (area / 3.0f);
+            cluster.normal += normal;
+            cluster.area += area;
+        }
+        meshCentroid += cluster.centroid;
+        meshArea += cluster.area;
+        clusters.push_back(cluster);
+    }
+    if (meshArea <= 0.0f) {
+        return indices;
+    }
+    meshCentroid /= meshArea;
+
+    for (auto& cluster : clusters) {
+        float normalLength = glm::length(cluster.normal);
+        if (cluster.area <= 0.0f || normalLength <= 0.0f) {
+            continue;
+        }
+        cluster.sortKey = glm::dot(cluster.centroid / cluster.area - meshCentroid, cluster.normal / normalLength);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const auto& cluster : clusters) {
+        result.insert(result.end(), indices.begin() + cluster.firstTriangle * 3, indices.begin() + cluster.lastTriangle * 3);
+    }
+
+    // Cutting between clusters loses some cache hits, keep the cache order if it loses too many
+    size_t cacheOrderMisses = MeshOptimizer::AnalyzeVertexCache(indices, vertices.size()).missCount;
+    size_t overdrawOrderMisses = MeshOptimizer::AnalyzeVertexCache(result, vertices.size()).missCount;
+    if (overdrawOrderMisses > cacheOrderMisses * OVERDRAW_ACMR_THRESHOLD) {
+        return indices;
+    }
+    return result;
+}
+
+}
+
+namespace MeshOptimizer {
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount) {
+    VertexCacheStats stats;
+    stats.triangleCount = indices.size() / 3;
+    stats.vertexCount = vertexCount;
+
+    FifoCache cache(vertexCount);
+    for (unsigned int index : indices) {
+        if (index < vertexCount) {
+            stats.missCount += cache.Access(index);
+        }
+    }
+    return stats;
+}
+
+std::vector<unsigned int> Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, bool weld,
+                                   VertexCacheStats& before, VertexCacheStats& after) {
+    std::vector<unsigned int> remap(vertices.size());
+    std::iota(remap.begin(), remap.end(), 0u);
+
+    before = AnalyzeVertexCache(indices, vertices.size());
+    after = before;
+    bool validIndices = std::all_of(indices.begin(), indices.end(), [&vertices](unsigned int index) { return index < vertices.size(); });
+    if (indices.empty() || indices.size() % 3 != 0 || !validIndices) {
+        return remap;
+    }
+
+    if (weld) {
+        remap = WeldVertices(vertices);
+        for (auto& index : indices) {
+            index = remap[index];
+        }
+    }
+
+    indices = OptimizeVertexCache(indices, vertices.size());
+    indices = OptimizeOverdraw(indices, vertices);
+
+    // Vertices are stored in the order the triangles first use them, dropping welded and unused ones
+    std::vector<unsigned int> fetchRemap(vertices.size(), REMOVED_VERTEX);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (auto& index : indices) {
+        if (fetchRemap[index] == REMOVED_VERTEX) {
+            fetchRemap[index] = static_cast<unsigned int>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = fetchRemap[index];
+    }
+    for (auto& target : remap) {
+        target = fetchRemap[target];
+    }
+    vertices = std::move(reordered);
+
+    after = AnalyzeVertexCache(indices, vertices.size());
+    return remap;
+}
+
+std::vector<unsigned int> OptimizeTriangleOrder(const std::vector<unsigned int>& indices, size_t vertexCount) {
+    if (indices.empty() || indices.size() % 3 != 0) {
+        return indices;
+    }
+    return OptimizeVertexCache(indices, vertexCount);
+}
+
+}
+
+}
@@ -0,0 +1,510 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+
+namespace SockEngine {
+
+namespace {
+
+// Meshes with fewer triangles aren't worth extra levels
+constexpr size_t MIN_LOD_TRIANGLES = 64;
+
+// Triangles of a level relative to the level before
+constexpr float LOD_TRIANGLE_RATIO = 0.5f;
+
+// A level that doesn't get below this share of the level before is dropped, and no coarser one is made
+constexpr float MIN_LOD_REDUCTION = 0.8f;
+
+// Largest error a collapse may reach, relative to the radius of the mesh's bounds
+constexpr float MAX_RELATIVE_ERROR = 0.1f;
+
+// Weight of the planes holding open borders in place, relative to the faces
+constexpr double BORDER_WEIGHT = 10.0;
+
+// Collapses turning a triangle further than this (cosine between its old and new normal) are refused
+constexpr double MIN_NORMAL_COSINE = 0.25;
+
+constexpr unsigned int NO_VERTEX = ~0u;
+
+enum class VertexKind : uint8_t {
+    Manifold,   // Inside the surface, collapses onto any neighbour
+    Border,     // On an open border between two border edges, collapses along them
+    Locked      // Attribute seams, non-manifold edges and border corners stay where they are
+};
+
+// Sum of squared distances to a set of planes, weighted by the area they come from
+struct Quadric {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    // Plane dot(normal, p) + distance = 0
+    void AddPlane(const glm::dvec3& normal, double distance, double planeWeight) {
+        a00 += planeWeight * normal.x * normal.x;
+        a01 += planeWeight * normal.x * normal.y;
+        a02 += planeWeight * normal.x * normal.z;
+        a11 += planeWeight * normal.y * normal.y;
+        a12 += planeWeight * normal.y * normal.z;
+        a22 += planeWeight * normal.z * normal.z;
+        b0 += planeWeight * normal.x * distance;
+        b1 += planeWeight * normal.y * distance;
+        b2 += planeWeight * normal.z * distance;
+        c += planeWeight * distance * distance;
+        weight += planeWeight;
+    }
+
+    void Add(const Quadric& other) {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // Weighted mean of the squared distances from the point to the planes
+    double Evaluate(const glm::dvec3& p) const {
+        double q = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                 + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                 + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return weight > 0.0 ? std::max(q, 0.0) / weight : 0.0;
+    }
+};
+
+// Edge collapse state of one mesh. Vertices at the same position form a group, named after its first
+// vertex; a group of several vertices is an attribute seam. Collapses move a vertex onto a
+// neighbour, so the simplified triangles only use the original vertices.
+class Simplifier {
+public:
+    Simplifier(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+        : m_Vertices(vertices), m_Indices(indices) {
+        BuildGroups();
+
+        // Triangles on every edge between two positions
+        std::unordered_map<uint64_t, unsigned int> edgeTriangles;
+        edgeTriangles.reserve(m_Indices.size());
+        for (size_t t = 0; t < m_Indices.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = m_Groups[m_Indices[t + k]];
+                unsigned int b = m_Groups[m_Indices[t + (k + 1) % 3]];
+                if (a != b) {
+                    edgeTriangles[MakeEdgeKey(a, b)]++;
+                }
+            }
+        }
+
+        ClassifyVertices(edgeTriangles);
+        BuildQuadrics(edgeTriangles);
+    }
+
+    // Collapses edges, cheapest first, until at most targetTriangles are left or no collapse stays
+    // under maxError. Returns the largest error reached so far.
+    float Simplify(size_t targetTriangles, float maxError) {
+        while (GetTriangleCount() > targetTriangles && RunPass(targetTriangles, maxError) > 0) {
+        }
+        return m_Error;
+    }
+
+    const std::vector<unsigned int>& GetIndices() const { return m_Indices; }
+    size_t GetTriangleCount() const { return m_Indices.size() / 3; }
+
+private:
+    struct Collapse {
+        unsigned int source;
+        unsigned int target;
+        float error;
+    };
+
+    const std::vector<Vertex>& m_Vertices;
+    std::vector<unsigned int> m_Indices;
+    std::vector<unsigned int> m_Groups;
+    std::vector<VertexKind> m_Kinds;
+    std::vector<Quadric> m_Quadrics;                // Per group
+    std::vector<unsigned int> m_BorderLinks;        // Two border neighbours (groups) per border vertex
+    float m_Error = 0.0f;
+
+    // Triangles of every vertex, rebuilt at the start of each pass
+    std::vector<unsigned int> m_FirstTriangle;
+    std::vector<unsigned int> m_VertexTriangles;
+
+    static uint64_t MakeEdgeKey(unsigned int a, unsigned int b) {
+        return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+    }
+
+    glm::dvec3 GetPosition(unsigned int vertex) const {
+        return glm::dvec3(m_Vertices[vertex].Position);
+    }
+
+    void BuildGroups() {
+        std::vector<unsigned int> order(m_Vertices.size());
+        std::iota(order.begin(), order.end(), 0u);
+        auto less = [this](unsigned int a, unsigned int b) {
+            const glm::vec3& pa = m_Vertices[a].Position;
+            const glm::vec3& pb = m_Vertices[b].Position;
+            if (pa.x != pb.x) {
+                return pa.x < pb.x;
+            }
+            if (pa.y != pb.y) {
+                return pa.y < pb.y;
+            }
+            if (pa.z != pb.z) {
+                return pa.z < pb.z;
+            }
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        m_Groups.resize(m_Vertices.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            bool samePosition = i > 0 && m_Vertices[order[i]].Position == m_Vertices[order[i - 1]].Position;
+            m_Groups[order[i]] = samePosition ? m_Groups[order[i - 1]] : order[i];
+        }
+    }
+
+    void ClassifyVertices(const std::unordered_map<uint64_t, unsigned int>& edgeTriangles) {
+        const size_t vertexCount = m_Vertices.size();
+        std::vector<unsigned int> groupSizes(vertexCount, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            groupSizes[m_Groups[v]]++;
+        }
+
+        std::vector<unsigned int> borderEdgeCounts(vertexCount, 0);
+        std::vector<bool> nonManifold(vertexCount, false);
+        m_BorderLinks.assign(vertexCount * 2, NO_VERTEX);
+        for (const auto& [key, count] : edgeTriangles) {
+            unsigned int a = static_cast<unsigned int>(key >> 32);
+            unsigned int b = static_cast<unsigned int>(key & 0xFFFFFFFFu);
+            if (count > 2) {
+                nonManifold[a] = nonManifold[b] = true;
+            } else if (count == 1) {
+                for (auto [vertex, other] : { std::pair(a, b), std::pair(b, a) }) {
+                    if (borderEdgeCounts[vertex] < 2) {
+                        m_BorderLinks[vertex * 2 + borderEdgeCounts[vertex]] = other;
+                    }
+                    borderEdgeCounts[vertex]++;
+                }
+            }
+        }
+
+        m_Kinds.resize(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            unsigned int group = m_Groups[v];
+            if (groupSizes[group] > 1 || nonManifold[group]) {
+                m_Kinds[v] = VertexKind::Locked;
+            } else if (borderEdgeCounts[group] == 0) {
+                m_Kinds[v] = VertexKind::Manifold;
+            } else {
+                m_Kinds[v] = borderEdgeCounts[group] == 2 ? VertexKind::Border : VertexKind::Locked;
+            }
+        }
+    }
+
+    void BuildQuadrics(const std::unordered_map<uint64_t, unsigned int>& edgeTriangles) {
+        m_Quadrics.assign(m_Vertices.size(), Quadric());
+
+        // Face planes weighted by area, added to the groups of their corners
+        for (size_t t = 0; t < m_Indices.size(); t += 3) {
+            glm::dvec3 p0 = GetPosition(m_Indices[t]);
+            glm::dvec3 normal = glm::cross(GetPosition(m_Indices[t + 1]) - p0, GetPosition(m_Indices[t + 2]) - p0);
+            double doubleArea = glm::length(normal);
+            if (doubleArea == 0.0) {
+                continue;
+            }
+            normal /= doubleArea;
+            for (int k = 0; k < 3; k++) {
+                m_Quadrics[m_Groups[m_Indices[t + k]]].AddPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5);
+            }
+        }
+
+        // Border planes, perpendicular to the face along each border edge
+        for (size_t t = 0; t < m_Indices.size(); t += 3) {
+            glm::dvec3 p0 = GetPosition(m_Indices[t]);
+            glm::dvec3 faceNormal = glm::cross(GetPosition(m_Indices[t + 1]) - p0, GetPosition(m_Indices[t + 2]) - p0);
+            if (glm::length(faceNormal) == 0.0) {
+                continue;
+            }
+            faceNormal = glm::normalize(faceNormal);
+
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = m_Groups[m_Indices[t + k]];
+                unsigned int b = m_Groups[m_Indices[t + (k + 1) % 3]];
+                auto edge = edgeTriangles.find(MakeEdgeKey(a, b));
+                if (a == b || edge == edgeTriangles.end() || edge->second != 1) {
+                    continue;
+                }
+
+                glm::dvec3 pa = GetPosition(a);
+                glm::dvec3 direction = GetPosition(b) - pa;
+                double length = glm::length(direction);
+                if (length == 0.0) {
+                    continue;
+                }
+                glm::dvec3 normal = glm::normalize(glm::cross(direction, faceNormal));
+                double planeWeight = length * length * BORDER_WEIGHT;
+                m_Quadrics[a].AddPlane(normal, -glm::dot(normal, pa), planeWeight);
+                m_Quadrics[b].AddPlane(normal, -glm::dot(normal, pa), planeWeight);
+            }
+        }
+    }
+
+    void BuildVertexTriangles() {
+        const size_t vertexCount = m_Vertices.size();
+        m_FirstTriangle.assign(vertexCount + 1, 0);
+        for (unsigned int index : m_Indices) {
+            m_FirstTriangle[index + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            m_FirstTriangle[v + 1] += m_FirstTriangle[v];
+        }
+        m_VertexTriangles.resize(m_Indices.size());
+        std::vector<unsigned int> filled(m_FirstTriangle.begin(), m_FirstTriangle.end() - 1);
+        for (size_t i = 0; i < m_Indices.size(); i++) {
+            m_VertexTriangles[filled[m_Indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+    }
+
+    // Cheap checks on the vertex kinds, before the collapse is costed
+    bool CanCollapse(unsigned int source, unsigned int target) const {
+        unsigned int targetGroup = m_Groups[target];
+        if (targetGroup == m_Groups[source]) {
+            return false;
+        }
+        if (m_Kinds[source] == VertexKind::Manifold) {
+            return true;
+        }
+        if (m_Kinds[source] != VertexKind::Border) {
+            return false;
+        }
+
+        // Slide along a border edge, without closing a border loop of three vertices
+        const unsigned int* links = &m_BorderLinks[source * 2];
+        if (links[0] != targetGroup && links[1] != targetGroup) {
+            return false;
+        }
+        unsigned int other = links[0] == targetGroup ? links[1] : links[0];
+        if (other == targetGroup) {
+            return false;
+        }
+        const unsigned int* targetLinks = &m_BorderLinks[targetGroup * 2];
+        return m_Kinds[target] != VertexKind::Border || (targetLinks[0] != other && targetLinks[1] != other);
+    }
+
+    // Topology and orientation checks against the current triangles
+    bool IsCollapseValid(unsigned int source, unsigned int target) const {
+        unsigned int sourceGroup = m_Groups[source];
+        unsigned int targetGroup = m_Groups[target];
+        glm::dvec3 targetPosition = GetPosition(target);
+
+        // Neighbours of the source, and the triangles the collapse removes
+        std::vector<unsigned int> sourceNeighbours;
+        unsigned int sharedTriangles = 0;
+        for (unsigned int i = m_FirstTriangle[source]; i < m_FirstTriangle[source + 1]; i++) {
+            const unsigned int* triangle = &m_Indices[m_VertexTriangles[i] * 3];
+            bool hasTarget = false;
+            for (int k = 0; k < 3; k++) {
+                unsigned int group = m_Groups[triangle[k]];
+                hasTarget = hasTarget || group == targetGroup;
+                if (group != sourceGroup && group != targetGroup) {
+                    sourceNeighbours.push_back(group);
+                }
+            }
+            if (hasTarget) {
+                sharedTriangles++;
+                continue;
+            }
+
+            // The triangles left must not flip or fold over
+            glm::dvec3 corners[3];
+            glm::dvec3 moved[3];
+            for (int k = 0; k < 3; k++) {
+                corners[k] = GetPosition(triangle[k]);
+                moved[k] = triangle[k] == source ? targetPosition : corners[k];
+            }
+            glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= MIN_NORMAL_COSINE * glm::length(before) * glm::length(after)) {
+                return false;
+            }
+        }
+        std::sort(sourceNeighbours.begin(), sourceNeighbours.end());
+        sourceNeighbours.erase(std::unique(sourceNeighbours.begin(), sourceNeighbours.end()), sourceNeighbours.end());
+
+        // Link condition: the two vertices may only share the neighbours opposite the collapsed
+        // edge, otherwise the surface pinches into a non-manifold one
+        std::vector<unsigned int> commonNeighbours;
+        for (unsigned int i = m_FirstTriangle[target]; i < m_FirstTriangle[target + 1]; i++) {
+            const unsigned int* triangle = &m_Indices[m_VertexTriangles[i] * 3];
+            for (int k = 0; k < 3; k++) {
+                unsigned int group = m_Groups[triangle[k]];
+                if (group != sourceGroup && group != targetGroup &&
+                    std::binary_search(sourceNeighbours.begin(), sourceNeighbours.end(), group)) {
+                    commonNeighbours.push_back(group);
+                }
+            }
+        }
+        std::sort(commonNeighbours.begin(), commonNeighbours.end());
+        commonNeighbours.erase(std::unique(commonNeighbours.begin(), commonNeighbours.end()), commonNeighbours.end());
+        return sharedTriangles > 0 && commonNeighbours.size() <= sharedTriangles;
+    }
+
+    // One round of independent collapses, none of them touching the triangles of another.
+    // Returns the number of collapses.
+    size_t RunPass(size_t targetTriangles, float maxError) {
+        const size_t vertexCount = m_Vertices.size();
+        BuildVertexTriangles();
+
+        // Cheapest collapse of every vertex that may move
+        std::vector<Collapse> best(vertexCount, { NO_VERTEX, NO_VERTEX, std::numeric_limits<float>::max() });
+        for (size_t t = 0; t < m_Indices.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int source = m_Indices[t + k];
+                for (int j = 1; j < 3; j++) {
+                    unsigned int target = m_Indices[t + (k + j) % 3];
+                    if (!CanCollapse(source, target)) {
+                        continue;
+                    }
+                    float error = static_cast<float>(std::sqrt(m_Quadrics[m_Groups[source]].Evaluate(GetPosition(target))));
+                    if (error < best[source].error) {
+                        best[source] = { source, target, error };
+                    }
+                }
+            }
+        }
+
+        std::vector<Collapse> collapses;
+        for (const auto& collapse : best) {
+            if (collapse.source != NO_VERTEX && collapse.error <= maxError) {
+                collapses.push_back(collapse);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        size_t trianglesToRemove = GetTriangleCount() - targetTriangles;
+        size_t removed = 0;
+        size_t collapsed = 0;
+        std::vector<bool> touched(vertexCount, false);
+        for (const auto& collapse : collapses) {
+            if (removed >= trianglesToRemove) {
+                break;
+            }
+            unsigned int source = collapse.source;
+            unsigned int target = collapse.target;
+            if (touched[source] || touched[target] || !IsCollapseValid(source, target)) {
+                continue;
+            }
+
+            for (unsigned int i = m_FirstTriangle[source]; i < m_FirstTriangle[source + 1]; i++) {
+                unsigned int* triangle = &m_Indices[m_VertexTriangles[i] * 3];
+                bool hasTarget = false;
+                for (int k = 0; k < 3; k++) {
+                    touched[triangle[k]] = true;
+                    hasTarget = hasTarget || m_Groups[triangle[k]] == m_Groups[target];
+                }
+                removed += hasTarget ? 1 : 0;
+                for (int k = 0; k < 3; k++) {
+                    if (triangle[k] == source) {
+                        triangle[k] = target;
+                    }
+                }
+            }
+
+            unsigned int sourceGroup = m_Groups[source];
+            unsigned int targetGroup = m_Groups[target];
+            m_Quadrics[targetGroup].Add(m_Quadrics[sourceGroup]);
+
+            // The border now runs from the target to the source's other border neighbour
+            if (m_Kinds[source] == VertexKind::Border) {
+                unsigned int* links = &m_BorderLinks[sourceGroup * 2];
+                unsigned int other = links[0] == targetGroup ? links[1] : links[0];
+                for (auto [vertex, replacement] : { std::pair(targetGroup, other), std::pair(other, targetGroup) }) {
+                    unsigned int* vertexLinks = &m_BorderLinks[vertex * 2];
+                    for (int k = 0; k < 2; k++) {
+                        if (vertexLinks[k] == sourceGroup) {
+                            vertexLinks[k] = replacement;
+                        }
+                    }
+                }
+            }
+
+            m_Kinds[source] = VertexKind::Locked;
+            m_Error = std::max(m_Error, collapse.error);
+            collapsed++;
+        }
+
+        // Drop the triangles that collapsed to a line
+        size_t write = 0;
+        for (size_t t = 0; t < m_Indices.size(); t += 3) {
+            unsigned int g0 = m_Groups[m_Indices[t]];
+            unsigned int g1 = m_Groups[m_Indices[t + 1]];
+            unsigned int g2 = m_Groups[m_Indices[t + 2]];
+            if (g0 == g1 || g1 == g2 || g0 == g2) {
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                m_Indices[write++] = m_Indices[t + k];
+            }
+        }
+        m_Indices.resize(write);
+        return collapsed;
+    }
+};
+
+}
+
+namespace MeshSimplifier {
+
+std::vector<MeshLOD> GenerateLODs(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    std::vector<MeshLOD> lods(1);
+    lods[0].indexCount = static_cast<uint32_t>(indices.size());
+
+    const size_t triangleCount = indices.size() / 3;
+    bool validIndices = std::all_of(indices.begin(), indices.end(), [&vertices](unsigned int index) { return index < vertices.size(); });
+    if (triangleCount < MIN_LOD_TRIANGLES || indices.size() % 3 != 0 || !validIndices) {
+        return lods;
+    }
+
+    glm::vec3 boundsMin = vertices[indices[0]].Position;
+    glm::vec3 boundsMax = boundsMin;
+    for (unsigned int index : indices) {
+        boundsMin = glm::min(boundsMin, vertices[index].Position);
+        boundsMax = glm::max(boundsMax, vertices[index].Position);
+    }
+    float maxError = glm::length(boundsMax - boundsMin) * 0.5f * MAX_RELATIVE_ERROR;
+
+    // Each level continues from the one before, so errors keep adding up from the full mesh
+    Simplifier simplifier(vertices, indices);
+    size_t previousCount = triangleCount;
+    for (int level = 1; level < MAX_LOD_COUNT; level++) {
+        size_t targetCount = static_cast<size_t>(previousCount * LOD_TRIANGLE_RATIO);
+        float error = simplifier.Simplify(targetCount, maxError);
+        size_t count = simplifier.GetTriangleCount();
+        if (count == 0 || count > previousCount * MIN_LOD_REDUCTION) {
+            break;
+        }
+
+        std::vector<unsigned int> levelIndices = MeshOptimizer::OptimizeTriangleOrder(simplifier.GetIndices(), vertices.size());
+        MeshLOD lod;
+        lod.firstIndex = static_cast<uint32_t>(indices.size());
+        lod.indexCount = static_cast<uint32_t>(levelIndices.size());
+        lod.error = error;
+        indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+        lods.push_back(lod);
+        previousCount = count;
+    }
+    return lods;
+}
+
+}
+
+}
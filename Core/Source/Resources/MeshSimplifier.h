@@ -0,0 +1,27 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "Mesh.h"
+#include <vector>
+
+namespace SockEngine {
+
+// Import-time generation of a mesh's detail levels by quadric error edge collapse (Garland and
+// Heckbert). Only indices are produced: every level reuses the mesh's vertices, so the levels share
+// its vertex streams, skin, morph targets and skeleton LODs.
+namespace MeshSimplifier {
+
+    // Levels per mesh, the full one included
+    constexpr int MAX_LOD_COUNT = 4;
+
+    // Appends the indices of the simplified levels to indices, each about half the triangles of the
+    // one before, and returns the range and error of every level, the full mesh first. Meshes too
+    // small to gain anything only get level 0. Attribute seams, non-manifold edges and the corners
+    // of open borders are kept in place; border vertices only slide along the border.
+    std::vector<MeshLOD> GenerateLODs(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+}
+
+}
+
+#endif
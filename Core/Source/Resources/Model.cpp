@@ -1,50 +1,394 @@
 #include "Model.h"
+#include "ModelCacheFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexPacking.h"
 #include <iostream>
 #include <map>
-#include <SOIL2/SOIL2.h>
+#include <algorithm>
+#include <numeric>
+#include <cctype>
+#include <filesystem>
+#include <limits>
+#include <cstdio>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
+#include <assimp/ProgressHandler.hpp>
 
 namespace SockEngine {
 
-Model::Model(std::string const& path, bool gamma)
-    : gammaCorrection(gamma)
+namespace {
+
+// Morph target offsets below this are treated as not moving the vertex
+constexpr float MORPH_DELTA_EPSILON = 1e-5f;
+
+// Post-processing applied to every import
+constexpr unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// Bumped whenever MeshOptimizer's output changes, so cached imports are optimized again
+constexpr uint32_t MESH_OPTIMIZER_VERSION = 1;
+
+// Bumped whenever MeshSimplifier's output changes, so the detail levels of cached imports are rebuilt
+constexpr uint32_t MESH_SIMPLIFIER_VERSION = 1;
+
+// Share of an async import's progress taken by Assimp's parsing, the rest is mesh and texture processing
+constexpr float PARSE_PROGRESS = 0.3f;
+
+// Reports Assimp's parsing progress to an async import and aborts the parse once it is cancelled
+class ImportProgressHandler : public Assimp::ProgressHandler {
+public:
+    explicit ImportProgressHandler(ModelImportProgress& progress) : m_Progress(progress) {}
+
+    bool Update(float percentage) override
+    {
+        if (percentage >= 0.0f) {
+            m_Progress.progress = std::min(percentage, 1.0f) * PARSE_PROGRESS;
+        }
+        return !m_Progress.cancelled;
+    }
+
+private:
+    ModelImportProgress& m_Progress;
+};
+
+// Lower-case words of a bone name without its rig namespace, see SkeletonLODBones
+std::vector<std::string> SplitBoneName(const std::string& boneName)
+{
+    size_t start = boneName.find_last_of(":|");
+    std::string name = boneName.substr(start == std::string::npos ? 0 : start + 1);
+
+    std::vector<std::string> words;
+    std::string word;
+    for (size_t i = 0; i < name.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(name[i]);
+        if (!std::isalnum(c)) {
+            if (!word.empty()) {
+                words.push_back(std::move(word));
+                word.clear();
+            }
+            continue;
+        }
+
+        // New word on letter/digit changes, before an upper case letter following a lower case one,
+        // and before the last upper case letter of a run followed by lower case ("IKHand")
+        if (!word.empty()) {
+            unsigned char previous = static_cast<unsigned char>(name[i - 1]);
+            unsigned char next = i + 1 < name.size() ? static_cast<unsigned char>(name[i + 1]) : 0;
+            bool split = std::isdigit(c) != std::isdigit(previous) ||
+                         (std::isupper(c) && std::islower(previous)) ||
+                         (std::isupper(c) && std::isupper(previous) && std::islower(next));
+            if (split) {
+                words.push_back(std::move(word));
+                word.clear();
+            }
+        }
+        word += static_cast<char>(std::tolower(c));
+    }
+    if (!word.empty()) {
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+
+bool MatchesAnyBone(const std::string& boneName, const std::vector<std::string>& patterns)
+{
+    for (const auto& word : SplitBoneName(boneName)) {
+        if (std::find(patterns.begin(), patterns.end(), word) != patterns.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Hash of everything besides the source that shapes an import, a cached model is rebuilt when it changes
+uint64_t ComputeImportSignature(const SkeletonLODBones& skeletonLODBones)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto hashBytes = [&hash](const void* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= static_cast<const unsigned char*>(data)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    hashBytes(&IMPORT_FLAGS, sizeof(IMPORT_FLAGS));
+    hashBytes(&MORPH_DELTA_EPSILON, sizeof(MORPH_DELTA_EPSILON));
+    hashBytes(&MESH_OPTIMIZER_VERSION, sizeof(MESH_OPTIMIZER_VERSION));
+    hashBytes(&MESH_SIMPLIFIER_VERSION, sizeof(MESH_SIMPLIFIER_VERSION));
+    for (const auto* bones : { &skeletonLODBones.reduced, &skeletonLODBones.minimal }) {
+        for (const auto& bone : *bones) {
+            hashBytes(bone.data(), bone.size() + 1);
+        }
+        hashBytes("|", 1);
+    }
+    return hash;
+}
+
+// Format family a material texture is cooked to, by the sampler it is bound to
+TextureUsage GetTextureUsage(const std::string& typeName)
+{
+    if (typeName == "texture_normal") {
+        return TextureUsage::Normal;
+    }
+    if (typeName == "texture_opacity") {
+        return TextureUsage::Mask;
+    }
+    return TextureUsage::Color;
+}
+
+// Key of m_TextureIndices, a file bound to several samplers is loaded once per sampler type
+std::string GetTextureIndexKey(const std::string& path, const std::string& typeName)
+{
+    return typeName + ':' + path;
+}
+
+}
+
+Model::Model(std::string const& path, bool gamma, ModelImportProgress* asyncImport, const SkeletonLODBones& skeletonLODBones)
+    : gammaCorrection(gamma), m_SkeletonLODBones(skeletonLODBones), m_AsyncImport(asyncImport)
 {
     LoadModel(path);
+
+    // The progress is owned by the loader, it is not needed past the import
+    m_AsyncImport = nullptr;
 }
 
 Model::~Model()
 {
     UnloadTextures();
+
+    // Hand the meshes' ranges back to the geometry arena and delete their own buffers
+    for (auto& mesh : meshes) {
+        mesh.ReleaseGeometry();
+    }
 }
 
-void Model::Draw(Shader& shader)
+bool Model::Upload(size_t& budget)
+{
+    // Textures stream in through the TextureManager, requesting them costs nothing of the budget
+    while (m_UploadedTextureCount < m_PendingTextures.size()) {
+        PendingTexture& pending = m_PendingTextures[m_UploadedTextureCount++];
+
+        // Another model may have loaded the same texture since the import
+        TextureRef texture = pending.embedded ? TextureManager::Get().Load(pending.key, std::move(pending.embedded), pending.usage)
+                                              : TextureManager::Get().Load(pending.key, pending.filePath, pending.usage);
+        m_TextureRefs.push_back(texture);
+
+        // Point the meshes at the texture, the same file may be bound for another usage too
+        for (auto& loaded : textures_loaded) {
+            if (loaded.path == pending.path && GetTextureUsage(loaded.type) == pending.usage) {
+                loaded.id = texture->GetID();
+            }
+        }
+        for (auto& mesh : meshes) {
+            for (auto& meshTexture : mesh.textures) {
+                if (meshTexture.path == pending.path && GetTextureUsage(meshTexture.type) == pending.usage) {
+                    meshTexture.id = texture->GetID();
+                }
+            }
+        }
+    }
+
+    while (budget > 0 && m_UploadedMeshCount < meshes.size()) {
+        Mesh& mesh = meshes[m_UploadedMeshCount++];
+        size_t size = mesh.GetUploadSize();
+        mesh.Upload();
+        budget -= std::min(budget, size);
+    }
+
+    if (IsUploaded()) {
+        m_PendingTextures.clear();
+        return true;
+    }
+    return false;
+}
+
+bool Model::IsUploaded() const
+{
+    return m_UploadedMeshCount >= meshes.size() && m_UploadedTextureCount >= m_PendingTextures.size();
+}
+
+void Model::ReleaseMeshData(MeshResidency residency)
+{
+    for (auto& mesh : meshes) {
+        mesh.ReleaseVertexData(residency);
+    }
+}
+
+size_t Model::GetPendingUploadSize() const
+{
+    size_t size = 0;
+    for (size_t i = m_UploadedMeshCount; i < meshes.size(); i++) {
+        size += meshes[i].GetUploadSize();
+    }
+    return size;
+}
+
+void Model::Draw(Shader& shader, int skeletonLOD, const std::vector<int>* meshLODs)
 {
     for (unsigned int i = 0; i < meshes.size(); i++) {
-        meshes[i].Draw(shader);
+        meshes[i].Draw(shader, skeletonLOD, meshLODs && i < meshLODs->size() ? (*meshLODs)[i] : 0);
+    }
+}
+
+void Model::Draw(Shader& shader, const std::vector<unsigned int>& vertexArrays, int instanceCount, const std::vector<int>* meshLODs)
+{
+    for (unsigned int i = 0; i < meshes.size() && i < vertexArrays.size(); i++) {
+        meshes[i].DrawVertexArray(shader, vertexArrays[i], instanceCount, meshLODs && i < meshLODs->size() ? (*meshLODs)[i] : 0);
+    }
+}
+
+void Model::SelectLODs(const glm::mat4& worldMatrix, const glm::vec3& cameraPosition, float projectionScale,
+                       float errorThreshold, std::vector<int>& meshLODs) const
+{
+    const float scale = std::max({ glm::length(glm::vec3(worldMatrix[0])), glm::length(glm::vec3(worldMatrix[1])),
+                                   glm::length(glm::vec3(worldMatrix[2])) });
+    meshLODs.resize(meshes.size(), 0);
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const Mesh& mesh = meshes[i];
+        if (mesh.GetLODCount() <= 1 || errorThreshold <= 0.0f) {
+            meshLODs[i] = 0;
+            continue;
+        }
+
+        // Pixels covered by one model unit at the nearest point of the bounding sphere, full detail from inside
+        glm::vec3 center = glm::vec3(worldMatrix * glm::vec4((mesh.GetBoundsMin() + mesh.GetBoundsMax()) * 0.5f, 1.0f));
+        float radius = glm::length(mesh.GetBoundsMax() - mesh.GetBoundsMin()) * 0.5f * scale;
+        float distance = glm::length(center - cameraPosition) - radius;
+        float pixelsPerUnit = distance > 0.0f ? projectionScale * scale / distance : std::numeric_limits<float>::max();
+
+        meshLODs[i] = mesh.SelectLOD(pixelsPerUnit, errorThreshold, meshLODs[i]);
+    }
+}
+
+void Model::RequestTextureDetail(const glm::mat4& worldMatrix, const glm::vec3& cameraPosition, float projectionScale) const
+{
+    const float scale = std::max({ glm::length(glm::vec3(worldMatrix[0])), glm::length(glm::vec3(worldMatrix[1])),
+                                   glm::length(glm::vec3(worldMatrix[2])) });
+
+    for (const auto& mesh : meshes) {
+        // Bounding sphere of the mesh, seen at full detail from inside
+        glm::vec3 center = glm::vec3(worldMatrix * glm::vec4((mesh.GetBoundsMin() + mesh.GetBoundsMax()) * 0.5f, 1.0f));
+        float radius = glm::length(mesh.GetBoundsMax() - mesh.GetBoundsMin()) * 0.5f * scale;
+        float distance = glm::length(center - cameraPosition);
+        float screenSize = distance > radius ? 2.0f * radius * projectionScale / distance : std::numeric_limits<float>::max();
+
+        for (const auto& texture : mesh.textures) {
+            TextureManager::Get().RequestDetail(texture.id, screenSize);
+        }
     }
 }
 
 void Model::LoadModel(std::string const& path)
 {
+    // Retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+
+    // Previously imported with the same content and settings, read the cache instead
+    uint64_t sourceHash = ModelCacheFile::ComputeSourceHash(path, ComputeImportSignature(m_SkeletonLODBones));
+    std::string cachePath = ModelCacheFile::GetCachePath(sourceHash);
+    if (sourceHash != 0 && LoadFromCache(cachePath, sourceHash)) {
+        if (m_AsyncImport) {
+            m_AsyncImport->progress = 1.0f;
+        }
+        return;
+    }
+
     // Read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    if (m_AsyncImport) {
+        importer.SetProgressHandler(new ImportProgressHandler(*m_AsyncImport));
+    }
+    const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
     // Check for errors
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // If is Not Zero
     {
-        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        // A cancelled async import aborts the parse on purpose
+        if (!m_AsyncImport || !m_AsyncImport->cancelled) {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        }
         return;
     }
-    // Retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
 
     // Process ASSIMP's root node recursively
     ProcessNode(scene->mRootNode, scene);
+    if (m_AsyncImport && m_AsyncImport->cancelled) {
+        return;
+    }
+
+    if (m_CacheStatsBefore.triangleCount > 0) {
+        char summary[160];
+        std::snprintf(summary, sizeof(summary), "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %zu -> %zu vertices",
+                      m_CacheStatsBefore.GetACMR(), m_CacheStatsAfter.GetACMR(), m_CacheStatsBefore.GetATVR(),
+                      m_CacheStatsAfter.GetATVR(), m_CacheStatsBefore.vertexCount, m_CacheStatsAfter.vertexCount);
+        std::cout << "Optimized meshes of '" << path << "': " << summary << std::endl;
+    }
+    if (m_LODTriangleCounts[1] > 0) {
+        std::cout << "Detail levels of '" << path << "':";
+        for (size_t count : m_LODTriangleCounts) {
+            if (count > 0) {
+                std::cout << " " << count;
+            }
+        }
+        std::cout << " triangles" << std::endl;
+    }
+
+    // Bone IDs are final once every mesh is processed
+    if (m_BoneCounter > VertexPacking::MAX_BONE_ID + 1) {
+        std::cout << "WARNING: Model '" << path << "' has " << m_BoneCounter << " bones, the influences of bones past "
+                  << VertexPacking::MAX_BONE_ID << " are dropped and given to the vertices' other bones" << std::endl;
+    }
+    if (m_BoneCounter > 0) {
+        BuildSkeletonLODs(scene->mRootNode);
+        m_SkinnedBounds = SkinnedBounds::Build(meshes, m_BoneCounter, *m_SkeletonLODs);
+    }
+
+    // Cache the import for the next load
+    if (sourceHash != 0 && !meshes.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(ModelCacheFile::MODEL_CACHE_DIRECTORY, error);
+        if (!ModelCacheFile::Write(*this, m_EmbeddedTextures, sourceHash, cachePath)) {
+            std::cout << "WARNING: Could not write model cache file '" << cachePath << "'" << std::endl;
+        }
+    }
+    m_EmbeddedTextures.clear();
+}
+
+bool Model::LoadFromCache(const std::string& cachePath, uint64_t sourceHash)
+{
+    std::vector<EmbeddedTexture> embeddedTextures;
+    if (!ModelCacheFile::Read(cachePath, sourceHash, m_AsyncImport == nullptr, *this, embeddedTextures)) {
+        return false;
+    }
+
+    // Textures are decoded from their files, or from the copy of the embedded ones in the cache
+    for (auto& mesh : meshes) {
+        for (auto& texture : mesh.textures) {
+            auto loaded = m_TextureIndices.find(GetTextureIndexKey(texture.path, texture.type));
+            if (loaded != m_TextureIndices.end()) {
+                texture.id = textures_loaded[loaded->second].id;
+                continue;
+            }
+
+            auto embedded = std::find_if(embeddedTextures.begin(), embeddedTextures.end(),
+                [&texture](const EmbeddedTexture& other) { return other.path == texture.path; });
+            texture = LoadTexture(texture.path, texture.type, embedded != embeddedTextures.end() ? &*embedded : nullptr);
+        }
+    }
+
+    if (m_BoneCounter > 0 && m_SkeletonLODs) {
+        m_SkinnedBounds = SkinnedBounds::Build(meshes, m_BoneCounter, *m_SkeletonLODs);
+    }
+    return true;
 }
 
 void Model::ProcessNode(aiNode* node, const aiScene* scene)
 {
+    if (m_AsyncImport && m_AsyncImport->cancelled) {
+        return;
+    }
+
     // Process each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
@@ -52,6 +396,11 @@ void Model::ProcessNode(aiNode* node, const aiScene* scene)
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
         meshes.push_back(ProcessMesh(mesh, scene));
+
+        if (m_AsyncImport) {
+            float processed = std::min(static_cast<float>(meshes.size()) / scene->mNumMeshes, 1.0f);
+            m_AsyncImport->progress = PARSE_PROGRESS + processed * (1.0f - PARSE_PROGRESS);
+        }
     }
     // After we've processed all the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++)
@@ -70,7 +419,8 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
     // Walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex vertex;
+        // Zeroed so the attributes Assimp doesn't provide don't keep identical vertices from welding
+        Vertex vertex = {};
         // Initialize bone data to default values
         SetVertexBoneDataToDefault(vertex);
         glm::vec3 vector; // We declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
@@ -149,9 +499,96 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 
     // Extract bone weight information for vertices
     ExtractBoneWeightForVertices(vertices, mesh, scene);
+
+    // Reorder for the GPU. Morph targets move vertices independently, theirs are never welded.
+    std::vector<unsigned int> remap;
+    if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+        VertexCacheStats before, after;
+        remap = MeshOptimizer::Optimize(vertices, indices, mesh->mNumAnimMeshes == 0, before, after);
+        m_CacheStatsBefore.Add(before);
+        m_CacheStatsAfter.Add(after);
+    }
+    else {
+        remap.resize(vertices.size());
+        std::iota(remap.begin(), remap.end(), 0u);
+    }
     
+    // Simplified detail levels, appended to the indices
+    std::vector<MeshLOD> lods;
+    if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+        lods = MeshSimplifier::GenerateLODs(vertices, indices);
+        for (size_t i = 0; i < lods.size(); i++) {
+            m_LODTriangleCounts[i] += lods[i].indexCount / 3;
+        }
+    }
+
     // Return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    Mesh result(std::move(vertices), std::move(indices), std::move(textures), m_AsyncImport == nullptr, std::move(lods));
+    if (mesh->mNumAnimMeshes > 0) {
+        ExtractMorphTargets(result, mesh, remap);
+    }
+    return result;
+}
+
+void Model::ExtractMorphTargets(Mesh& result, aiMesh* mesh, const std::vector<unsigned int>& remap)
+{
+    std::vector<MorphTarget> targets;
+    std::vector<MorphDelta> deltas;
+    std::vector<unsigned int> morphed;
+    std::vector<int> slots(mesh->mNumVertices, -1);
+
+    for (unsigned int i = 0; i < mesh->mNumAnimMeshes; i++) {
+        const aiAnimMesh* animMesh = mesh->mAnimMeshes[i];
+        if (!animMesh->mVertices || animMesh->mNumVertices != mesh->mNumVertices) {
+            std::cout << "WARNING: Skipping morph target " << i << " of mesh '" << mesh->mName.C_Str() << "', vertex count mismatch" << std::endl;
+            continue;
+        }
+
+        MorphTarget target;
+        target.name = animMesh->mName.length > 0 ? animMesh->mName.C_Str() : "Morph" + std::to_string(i);
+        target.firstDelta = static_cast<uint32_t>(deltas.size());
+
+        // Assimp stores the morphed vertices, keep only the ones that actually move
+        bool hasNormals = animMesh->mNormals && mesh->HasNormals();
+        for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+            if (remap[v] == MeshOptimizer::REMOVED_VERTEX) {
+                continue;
+            }
+
+            aiVector3D position = animMesh->mVertices[v] - mesh->mVertices[v];
+            aiVector3D normal = hasNormals ? animMesh->mNormals[v] - mesh->mNormals[v] : aiVector3D(0.0f);
+            if (position.SquareLength() <= MORPH_DELTA_EPSILON * MORPH_DELTA_EPSILON &&
+                normal.SquareLength() <= MORPH_DELTA_EPSILON * MORPH_DELTA_EPSILON) {
+                continue;
+            }
+
+            if (slots[v] < 0) {
+                slots[v] = static_cast<int>(morphed.size());
+                morphed.push_back(remap[v]);
+            }
+
+            MorphDelta delta;
+            delta.position = glm::vec3(position.x, position.y, position.z);
+            delta.slot = static_cast<uint32_t>(slots[v]);
+            delta.normal = glm::vec3(normal.x, normal.y, normal.z);
+            deltas.push_back(delta);
+        }
+
+        target.deltaCount = static_cast<uint32_t>(deltas.size()) - target.firstDelta;
+        if (target.deltaCount == 0) {
+            continue;
+        }
+
+        // Targets with the same name on different meshes (e.g. face and teeth) share a weight
+        auto name = std::find(m_MorphTargetNames.begin(), m_MorphTargetNames.end(), target.name);
+        target.index = static_cast<int>(name - m_MorphTargetNames.begin());
+        if (name == m_MorphTargetNames.end()) {
+            m_MorphTargetNames.push_back(target.name);
+        }
+        targets.push_back(target);
+    }
+
+    result.SetupMorphTargets(std::move(targets), std::move(deltas), std::move(morphed));
 }
 
 std::vector<Texture> Model::LoadMaterialTextures(const aiScene* scene, aiMaterial* mat, aiTextureType type, std::string typeName)
@@ -163,140 +600,76 @@ std::vector<Texture> Model::LoadMaterialTextures(const aiScene* scene, aiMateria
         mat->GetTexture(type, i, &str);
 
         // Check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
-        {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // A texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
+        auto loaded = m_TextureIndices.find(GetTextureIndexKey(str.C_Str(), typeName));
+        if (loaded != m_TextureIndices.end()) {
+            textures.push_back(textures_loaded[loaded->second]);
         }
-        if (!skip) { // If texture hasn't been loaded already, load it
-            // Check if the texture is embedded
+        else { // If texture hasn't been loaded already, load it
+            // Check if the texture is embedded, it is copied so the model cache can keep it
+            const EmbeddedTexture* embedded = nullptr;
             if (auto texture = scene->GetEmbeddedTexture(str.C_Str())) {
-                // Load texture from memory
-                unsigned int textureID;
-                glGenTextures(1, &textureID);
-
-                GLenum format = GL_RGB;
-                if (texture->mHeight == 0) {
-                    // Compressed format
-                    int width, height, nrComponents;
-                    unsigned char* data = SOIL_load_image_from_memory(
-                        reinterpret_cast<unsigned char*>(texture->pcData),
-                        texture->mWidth, &width, &height, &nrComponents, SOIL_LOAD_AUTO);
-
-                    if (data) {
-                        // Determine the color format
-                        if (nrComponents == 1) {
-                            format = GL_RED;
-                        }
-                        else if (nrComponents == 2) {
-                            format = GL_RG;
-                        }
-                        else if (nrComponents == 3) {
-                            format = GL_RGB;
-                        }
-                        else if (nrComponents == 4) {
-                            format = GL_RGBA;
-                        }
-
-                        glBindTexture(GL_TEXTURE_2D, textureID);
-                        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-                        glGenerateMipmap(GL_TEXTURE_2D);
-
-                        SOIL_free_image_data(data);
-                    }
-                    else {
-                        std::cout << "Embedded texture failed to load at path: " << str.C_Str() << std::endl;
-                    }
-                }
-                else {
-                    // Uncompressed format
-                    format = GL_RGBA;
-                    glBindTexture(GL_TEXTURE_2D, textureID);
-                    glTexImage2D(GL_TEXTURE_2D, 0, format, texture->mWidth, texture->mHeight, 0, format, GL_UNSIGNED_BYTE, texture->pcData);
-                    glGenerateMipmap(GL_TEXTURE_2D);
-                }
-
-                // Set texture parameters
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-                Texture tex;
-                tex.id = textureID;
-                tex.type = typeName;
-                tex.path = str.C_Str(); // Use the texture name as the path for embedded textures
-                textures.push_back(tex);
-                textures_loaded.push_back(tex);
-            }
-            else {
-                Texture tex;
-                tex.id = TextureFromFile(str.C_Str(), this->directory);
-                tex.type = typeName;
-                tex.path = str.C_Str();
-                textures.push_back(tex);
-                textures_loaded.push_back(tex); // Store it as texture loaded for entire model, to ensure we won't unnecessarily load duplicate textures.
+                EmbeddedTexture copy;
+                copy.path = str.C_Str();
+                copy.width = texture->mWidth;
+                copy.height = texture->mHeight;
+                size_t size = texture->mHeight == 0 ? texture->mWidth : static_cast<size_t>(texture->mWidth) * texture->mHeight * 4;
+                copy.data.assign(reinterpret_cast<const unsigned char*>(texture->pcData),
+                                 reinterpret_cast<const unsigned char*>(texture->pcData) + size);
+                m_EmbeddedTextures.push_back(std::move(copy));
+                embedded = &m_EmbeddedTextures.back();
             }
+            textures.push_back(LoadTexture(str.C_Str(), typeName, embedded));
         }
     }
     return textures;
 }
 
-unsigned int Model::TextureFromFile(const char* path, const std::string& dir, bool gamma)
+Texture Model::LoadTexture(const std::string& path, const std::string& typeName, const EmbeddedTexture* embedded)
 {
-    std::string filename = std::string(path);
-    filename = dir + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = SOIL_load_image(filename.c_str(), &width, &height, &nrComponents, SOIL_LOAD_AUTO);
-    GLenum format = GL_RGB;
-    if (data)
-    {
-        if (nrComponents == 1) {
-            format = GL_RED;
-        }
-        else if (nrComponents == 2) {
-            format = GL_RG;
-        }
-        else if (nrComponents == 3) {
-            format = GL_RGB;
+    // Files are shared by absolute path, embedded textures by content, each cooked for its usage
+    TextureUsage usage = GetTextureUsage(typeName);
+    uint64_t key = embedded ? TextureManager::HashData(embedded->data.data(), embedded->data.size(), usage)
+                            : TextureManager::HashPath(this->directory + '/' + path, usage);
+
+    Texture tex;
+    tex.id = 0;
+    tex.type = typeName;
+    tex.path = path; // Embedded textures use their name as the path
+    if (TextureRef texture = TextureManager::Get().Find(key)) {
+        tex.id = texture->GetID();
+        m_TextureRefs.push_back(std::move(texture));
+    }
+    else if (m_AsyncImport) {
+        // Async imports request the texture on Upload, on the GL thread
+        PendingTexture pending;
+        pending.path = tex.path;
+        pending.key = key;
+        pending.usage = usage;
+        if (embedded) {
+            pending.embedded = std::make_shared<EmbeddedTexture>(*embedded);
         }
-        else if (nrComponents == 4) {
-            format = GL_RGBA;
+        else {
+            pending.filePath = this->directory + '/' + path;
         }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        SOIL_free_image_data(data);
+        m_PendingTextures.push_back(std::move(pending));
     }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+    else {
+        // The texture is decoded and uploaded in the background, the mesh can use its id right away
+        TextureRef texture = embedded ? TextureManager::Get().Load(key, std::make_shared<EmbeddedTexture>(*embedded), usage)
+                                      : TextureManager::Get().Load(key, this->directory + '/' + path, usage);
+        tex.id = texture->GetID();
+        m_TextureRefs.push_back(std::move(texture));
     }
-
-    return textureID;
+    m_TextureIndices[GetTextureIndexKey(tex.path, typeName)] = textures_loaded.size();
+    textures_loaded.push_back(tex); // Store it as texture loaded for entire model, to ensure we won't unnecessarily load duplicate textures.
+    return tex;
 }
 
 void Model::UnloadTextures()
 {
-    for (auto& texture : textures_loaded) {
-        glDeleteTextures(1, &texture.id);
-    }
+    // The TextureManager deletes the textures no other model uses
+    m_TextureRefs.clear();
+    m_TextureIndices.clear();
     textures_loaded.clear();
 }
 
@@ -368,4 +741,60 @@ void Model::ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh*
     }
 }
 
-}
\ No newline at end of file
+void Model::BuildSkeletonLODs(const aiNode* rootNode)
+{
+    auto skeletonLODs = std::make_shared<SkeletonLODSet>();
+
+    std::vector<std::string> droppedBones;
+    for (int level = 0; level < 2; level++) {
+        const std::vector<std::string>& levelBones = level == 0 ? m_SkeletonLODBones.reduced : m_SkeletonLODBones.minimal;
+        for (const auto& bone : levelBones) {
+            std::string word = bone;
+            std::transform(word.begin(), word.end(), word.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            droppedBones.push_back(std::move(word));
+        }
+
+        SkeletonLOD skeletonLOD;
+        skeletonLOD.boneRemap.assign(m_BoneCounter, -1);
+        skeletonLOD.boneKept.assign(m_BoneCounter, false);
+        BuildSkeletonLOD(rootNode, droppedBones, -1, false, skeletonLOD);
+
+        // Only keep levels that actually remove bones
+        int previousSize = skeletonLODs->empty() ? m_BoneCounter : skeletonLODs->back().paletteSize;
+        if (skeletonLOD.paletteSize > 0 && skeletonLOD.paletteSize < previousSize) {
+            skeletonLODs->push_back(std::move(skeletonLOD));
+        }
+    }
+
+    for (auto& mesh : meshes) {
+        mesh.SetupSkeletonLODs(*skeletonLODs);
+    }
+
+    m_SkeletonLODs = skeletonLODs;
+}
+
+void Model::BuildSkeletonLOD(const aiNode* node, const std::vector<std::string>& droppedBones,
+                             int ancestorIndex, bool insideDroppedBone, SkeletonLOD& skeletonLOD)
+{
+    auto boneInfo = m_BoneInfoMap.find(node->mName.C_Str());
+    if (boneInfo != m_BoneInfoMap.end()) {
+        int boneID = boneInfo->second.id;
+
+        // A bone is only dropped if it has a kept ancestor to take over its weights
+        bool dropped = insideDroppedBone || (ancestorIndex >= 0 && MatchesAnyBone(boneInfo->first, droppedBones));
+        if (dropped) {
+            skeletonLOD.boneRemap[boneID] = ancestorIndex;
+            insideDroppedBone = true;
+        } else {
+            ancestorIndex = skeletonLOD.paletteSize++;
+            skeletonLOD.boneRemap[boneID] = ancestorIndex;
+            skeletonLOD.boneKept[boneID] = true;
+        }
+    }
+
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        BuildSkeletonLOD(node->mChildren[i], droppedBones, ancestorIndex, insideDroppedBone, skeletonLOD);
+    }
+}
+
+}
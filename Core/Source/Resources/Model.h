@@ -4,18 +4,33 @@
 #include "Mesh.h"
 #include "Shader.h"
 #include "AnimData.h"
+#include "SkinnedBounds.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "TextureManager.h"
 #include <string>
+#include <array>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <cstdint>
 #include <assimp/scene.h>
 
 namespace SockEngine {
 
+// Shared between a model imported on a worker thread and the ModelLoader waiting for it
+struct ModelImportProgress {
+    std::atomic<float> progress { 0.0f };   // Fraction of the CPU import done
+    std::atomic<bool> cancelled { false };  // Set to stop the import early
+};
+
 class Model
 {
 public:
     // Model data 
-    std::vector<Texture> textures_loaded; // Stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    std::vector<Texture> textures_loaded; // Stores all the textures of this model, each texture is shared with every other model using it through the TextureManager.
     std::vector<Mesh> meshes;
     std::string directory;
     bool gammaCorrection;
@@ -24,22 +39,99 @@ public:
     std::map<std::string, BoneInfo> m_BoneInfoMap;
     int m_BoneCounter = 0;
 
-    // Constructor, expects a filepath to a 3D model.
-    Model(std::string const& path, bool gamma = false);
+    // Reduced skeletons generated at import, shared with the animators of this model
+    std::shared_ptr<const SkeletonLODSet> m_SkeletonLODs;
+
+    // Per-bone boxes of the skinned vertices, used to bound animated poses
+    std::shared_ptr<const SkinnedBounds> m_SkinnedBounds;
+
+    // Names of the morph targets of every mesh, indexed by MorphTarget::index
+    std::vector<std::string> m_MorphTargetNames;
+
+    // Constructor, expects a filepath to a 3D model. With an asyncImport the model is imported without
+    // touching GL so it can be built on a worker thread, its buffers and textures are created by Upload.
+    // skeletonLODBones picks the bones its reduced skeletons drop.
+    Model(std::string const& path, bool gamma = false, ModelImportProgress* asyncImport = nullptr,
+          const SkeletonLODBones& skeletonLODBones = SkeletonLODBones());
 
     ~Model();
 
-    // Draws the model, and thus all its meshes
-    void Draw(Shader& shader);
+    // Creates the GPU resources of an async import a mesh or texture at a time, until the byte budget
+    // is spent. Returns true once everything is uploaded. GL thread only.
+    bool Upload(size_t& budget);
+    bool IsUploaded() const;
+    size_t GetPendingUploadSize() const;
+
+    // Drops the CPU copies of the meshes once they are uploaded, see MeshResidency
+    void ReleaseMeshData(MeshResidency residency);
+
+    // Draws the model, and thus all its meshes. Skinned models can draw with a reduced skeleton.
+    // meshLODs holds the detail level of each mesh (see SelectLODs), all at full detail without it.
+    void Draw(Shader& shader, int skeletonLOD = 0, const std::vector<int>* meshLODs = nullptr);
+
+    // Draws the meshes with other vertex arrays, one per mesh (e.g. skinned on the GPU or instanced)
+    void Draw(Shader& shader, const std::vector<unsigned int>& vertexArrays, int instanceCount = 1,
+              const std::vector<int>* meshLODs = nullptr);
+
+    // Picks the detail level of each mesh whose error projects under errorThreshold pixels.
+    // meshLODs holds the levels drawn last frame, for hysteresis, and is resized to the mesh count.
+    void SelectLODs(const glm::mat4& worldMatrix, const glm::vec3& cameraPosition, float projectionScale,
+                    float errorThreshold, std::vector<int>& meshLODs) const;
+
+    // Requests the texture mips each mesh needs from its bounds projected on screen. projectionScale
+    // is the height in pixels of one unit seen at a distance of one unit.
+    void RequestTextureDetail(const glm::mat4& worldMatrix, const glm::vec3& cameraPosition, float projectionScale) const;
 
     // Animation support
     auto& GetBoneInfoMap() { return m_BoneInfoMap; }
+    const auto& GetBoneInfoMap() const { return m_BoneInfoMap; }
     int& GetBoneCount() { return m_BoneCounter; }
+    std::shared_ptr<const SkeletonLODSet> GetSkeletonLODs() const { return m_SkeletonLODs; }
+    std::shared_ptr<const SkinnedBounds> GetSkinnedBounds() const { return m_SkinnedBounds; }
+    const std::vector<std::string>& GetMorphTargetNames() const { return m_MorphTargetNames; }
 
 private:
+    // Texture of an async import waiting for Upload, meshes refer to it by path until then
+    struct PendingTexture {
+        std::string path;
+        uint64_t key;
+        TextureUsage usage;
+        std::string filePath;
+        std::shared_ptr<const EmbeddedTexture> embedded;
+    };
+
+    // Index in textures_loaded of each texture path and sampler type of the model
+    std::unordered_map<std::string, size_t> m_TextureIndices;
+
+    // References keeping the shared textures of the model alive
+    std::vector<TextureRef> m_TextureRefs;
+
+    // Bones dropped by the reduced skeletons built at import
+    SkeletonLODBones m_SkeletonLODBones;
+
+    // Set while importing on a worker thread
+    ModelImportProgress* m_AsyncImport = nullptr;
+    std::vector<PendingTexture> m_PendingTextures;
+    size_t m_UploadedMeshCount = 0;
+    size_t m_UploadedTextureCount = 0;
+
+    // Textures found inside the source during an import, written to the model cache
+    std::vector<EmbeddedTexture> m_EmbeddedTextures;
+
+    // Vertex cache behaviour of the imported meshes before and after MeshOptimizer
+    VertexCacheStats m_CacheStatsBefore;
+    VertexCacheStats m_CacheStatsAfter;
+
+    // Triangles of the imported meshes at each detail level
+    std::array<size_t, MeshSimplifier::MAX_LOD_COUNT> m_LODTriangleCounts = {};
+
     // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // Imports are cached, later loads of the same file with the same settings skip Assimp.
     void LoadModel(std::string const& path);
 
+    // Fills the model from its cache file and loads the textures it refers to
+    bool LoadFromCache(const std::string& cachePath, uint64_t sourceHash);
+
     // Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
     void ProcessNode(aiNode* node, const aiScene* scene);
 
@@ -49,7 +141,9 @@ private:
     // the required info is returned as a Texture struct.
     std::vector<Texture> LoadMaterialTextures(const aiScene* scene, aiMaterial* mat, aiTextureType type, std::string typeName);
 
-    unsigned int TextureFromFile(const char* path, const std::string& dir, bool gamma = false);
+    // Takes the texture from the TextureManager if another model already loaded it. Otherwise asks the
+    // manager to stream it in, or queues it for Upload when importing asynchronously.
+    Texture LoadTexture(const std::string& path, const std::string& typeName, const EmbeddedTexture* embedded);
 
     void UnloadTextures();
 
@@ -57,6 +151,14 @@ private:
     void SetVertexBoneDataToDefault(Vertex& vertex);
     void SetVertexBoneData(Vertex& vertex, int boneID, float weight);
     void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene);
+
+    // Imports the mesh's blend shapes as sparse deltas, remap gives the optimized index of every Assimp vertex
+    void ExtractMorphTargets(Mesh& result, aiMesh* mesh, const std::vector<unsigned int>& remap);
+
+    // Generates the reduced skeletons and their bone ID streams
+    void BuildSkeletonLODs(const aiNode* rootNode);
+    void BuildSkeletonLOD(const aiNode* node, const std::vector<std::string>& droppedBones,
+                          int ancestorIndex, bool insideDroppedBone, SkeletonLOD& skeletonLOD);
 };
 
 }
@@ -0,0 +1,457 @@
+#include "ModelCacheFile.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <type_traits>
+
+namespace SockEngine {
+
+namespace {
+
+constexpr uint32_t MODEL_MAGIC = 0x4c444f4d;  // "MODL"
+constexpr uint32_t MODEL_VERSION = 2;
+
+// Guards against allocating garbage sizes from a corrupt file
+constexpr uint32_t MAX_ELEMENT_COUNT = 1u << 28;
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t HashBytes(uint64_t hash, const unsigned char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Replaces the %XX escapes of a relative URI
+std::string DecodeURI(const std::string& uri) {
+    std::string decoded;
+    for (size_t i = 0; i < uri.size(); i++) {
+        if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+            decoded += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += uri[i];
+        }
+    }
+    return decoded;
+}
+
+// URIs of the external buffers of a glTF, found by scanning the "buffers" array for "uri" members.
+// Data URIs are part of the file itself.
+void FindGltfBuffers(const std::string& text, std::vector<std::string>& dependencies) {
+    size_t start = text.find("\"buffers\"");
+    if (start == std::string::npos || (start = text.find('[', start)) == std::string::npos) {
+        return;
+    }
+
+    // Walk the array, skipping over strings, and pick the string following each "uri" key
+    int depth = 0;
+    bool expectURI = false;
+    for (size_t i = start; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '"') {
+            size_t end = i + 1;
+            while (end < text.size() && text[end] != '"') {
+                end += text[end] == '\\' ? 2 : 1;
+            }
+            std::string value = text.substr(i + 1, end - i - 1);
+            if (expectURI) {
+                if (value.compare(0, 5, "data:") != 0) {
+                    dependencies.push_back(DecodeURI(value));
+                }
+                expectURI = false;
+            } else if (value == "uri" && depth == 2) {
+                size_t colon = text.find_first_not_of(" \t\r\n", end + 1);
+                expectURI = colon != std::string::npos && text[colon] == ':';
+            }
+            i = end;
+        } else if (c == '[' || c == '{') {
+            depth++;
+        } else if (c == ']' || c == '}') {
+            if (--depth == 0) {
+                return;
+            }
+        }
+    }
+}
+
+// Material libraries named by the mtllib statements of an OBJ
+void FindObjMaterialLibraries(const std::string& text, std::vector<std::string>& dependencies) {
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = text.size();
+        }
+        if (text.compare(lineStart, 7, "mtllib ") == 0) {
+            std::string names = text.substr(lineStart + 7, lineEnd - lineStart - 7);
+            size_t nameStart = 0;
+            while ((nameStart = names.find_first_not_of(" \t\r", nameStart)) != std::string::npos) {
+                size_t nameEnd = names.find_first_of(" \t\r", nameStart);
+                dependencies.push_back(names.substr(nameStart, nameEnd - nameStart));
+                nameStart = nameEnd;
+            }
+        }
+        lineStart = lineEnd + 1;
+    }
+}
+
+// Files the import reads besides the source itself, relative to the source's directory
+std::vector<std::string> FindDependencies(const std::string& sourcePath, const unsigned char* data, size_t size) {
+    std::string extension = std::filesystem::path(sourcePath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    std::vector<std::string> dependencies;
+    if (extension == ".gltf") {
+        FindGltfBuffers(std::string(reinterpret_cast<const char*>(data), size), dependencies);
+    } else if (extension == ".obj") {
+        FindObjMaterialLibraries(std::string(reinterpret_cast<const char*>(data), size), dependencies);
+    }
+    return dependencies;
+}
+
+class CacheWriter {
+public:
+    explicit CacheWriter(std::ofstream& stream) : m_Stream(stream) {}
+
+    template<typename T>
+    void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_Stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void WriteVector(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Write(static_cast<uint32_t>(values.size()));
+        m_Stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void WriteString(const std::string& value) {
+        Write(static_cast<uint32_t>(value.size()));
+        m_Stream.write(value.data(), value.size());
+    }
+
+private:
+    std::ofstream& m_Stream;
+};
+
+// Reads from the mapped file, every read is bounds checked
+class CacheReader {
+public:
+    CacheReader(const unsigned char* data, size_t size) : m_Data(data), m_End(data + size) {}
+
+    bool IsGood() const { return m_Good; }
+
+    template<typename T>
+    void Read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (Take(sizeof(T))) {
+            std::memcpy(&value, m_Data - sizeof(T), sizeof(T));
+        }
+    }
+
+    template<typename T>
+    void ReadVector(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint32_t count = ReadCount();
+        size_t size = static_cast<size_t>(count) * sizeof(T);
+        if (Take(size)) {
+            values.resize(count);
+            std::memcpy(values.data(), m_Data - size, size);
+        }
+    }
+
+    void ReadString(std::string& value) {
+        uint32_t count = ReadCount();
+        if (Take(count)) {
+            value.assign(reinterpret_cast<const char*>(m_Data - count), count);
+        }
+    }
+
+    uint32_t ReadCount() {
+        uint32_t count = 0;
+        Read(count);
+        if (!m_Good || count > MAX_ELEMENT_COUNT) {
+            m_Good = false;
+            return 0;
+        }
+        return count;
+    }
+
+private:
+    bool Take(size_t size) {
+        if (!m_Good || size > static_cast<size_t>(m_End - m_Data)) {
+            m_Good = false;
+            return false;
+        }
+        m_Data += size;
+        return true;
+    }
+
+    const unsigned char* m_Data;
+    const unsigned char* m_End;
+    bool m_Good = true;
+};
+
+}
+
+namespace ModelCacheFile {
+
+uint64_t ComputeSourceHash(const std::string& sourcePath, uint64_t importSignature) {
+    MappedFile source(sourcePath);
+    if (!source.IsOpen()) {
+        return 0;
+    }
+
+    uint64_t hash = HashBytes(FNV_OFFSET, source.GetData(), source.GetSize());
+
+    // External glTF buffers and OBJ materials change the import without touching the source
+    std::filesystem::path directory = std::filesystem::path(sourcePath).parent_path();
+    for (const auto& dependency : FindDependencies(sourcePath, source.GetData(), source.GetSize())) {
+        hash = HashBytes(hash, reinterpret_cast<const unsigned char*>(dependency.data()), dependency.size());
+        MappedFile file((directory / dependency).string());
+        if (file.IsOpen()) {
+            hash = HashBytes(hash, file.GetData(), file.GetSize());
+        }
+    }
+
+    hash = HashBytes(hash, reinterpret_cast<const unsigned char*>(&importSignature), sizeof(importSignature));
+    return hash != 0 ? hash : 1;
+}
+
+std::string GetCachePath(uint64_t sourceHash) {
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.model", static_cast<unsigned long long>(sourceHash));
+    return std::string(MODEL_CACHE_DIRECTORY) + fileName;
+}
+
+bool Write(const Model& model, const std::vector<EmbeddedTexture>& embeddedTextures, uint64_t sourceHash, const std::string& path) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+        return false;
+    }
+
+    CacheWriter writer(stream);
+    writer.Write(MODEL_MAGIC);
+    writer.Write(MODEL_VERSION);
+    writer.Write(sourceHash);
+
+    writer.Write(static_cast<uint32_t>(model.meshes.size()));
+    for (const auto& mesh : model.meshes) {
+        writer.WriteVector(mesh.vertices);
+        writer.WriteVector(mesh.indices);
+        writer.WriteVector(mesh.lods);
+
+        // Material bindings, the texture objects are created on load
+        writer.Write(static_cast<uint32_t>(mesh.textures.size()));
+        for (const auto& texture : mesh.textures) {
+            writer.WriteString(texture.type);
+            writer.WriteString(texture.path);
+        }
+
+        writer.Write(static_cast<uint32_t>(mesh.morphTargets.size()));
+        for (const auto& target : mesh.morphTargets) {
+            writer.WriteString(target.name);
+            writer.Write(target.index);
+            writer.Write(target.firstDelta);
+            writer.Write(target.deltaCount);
+        }
+        writer.WriteVector(mesh.morphDeltas);
+        writer.WriteVector(mesh.morphedVertices);
+    }
+
+    writer.Write(model.m_BoneCounter);
+    writer.Write(static_cast<uint32_t>(model.m_BoneInfoMap.size()));
+    for (const auto& [name, boneInfo] : model.m_BoneInfoMap) {
+        writer.WriteString(name);
+        writer.Write(boneInfo.id);
+        writer.Write(boneInfo.offset);
+    }
+
+    const SkeletonLODSet emptySkeletonLODs;
+    const SkeletonLODSet& skeletonLODs = model.m_SkeletonLODs ? *model.m_SkeletonLODs : emptySkeletonLODs;
+    writer.Write(static_cast<uint8_t>(model.m_SkeletonLODs != nullptr));
+    writer.Write(static_cast<uint32_t>(skeletonLODs.size()));
+    for (const auto& skeletonLOD : skeletonLODs) {
+        writer.WriteVector(skeletonLOD.boneRemap);
+        writer.WriteVector(std::vector<uint8_t>(skeletonLOD.boneKept.begin(), skeletonLOD.boneKept.end()));
+        writer.Write(skeletonLOD.paletteSize);
+    }
+
+    writer.Write(static_cast<uint32_t>(model.m_MorphTargetNames.size()));
+    for (const auto& name : model.m_MorphTargetNames) {
+        writer.WriteString(name);
+    }
+
+    // The source is not read on a cache hit, so textures stored inside it are kept here
+    writer.Write(static_cast<uint32_t>(embeddedTextures.size()));
+    for (const auto& texture : embeddedTextures) {
+        writer.WriteString(texture.path);
+        writer.Write(texture.width);
+        writer.Write(texture.height);
+        writer.WriteVector(texture.data);
+    }
+
+    // Marks a complete file, an interrupted write is treated as corrupt
+    writer.Write(MODEL_MAGIC);
+    return static_cast<bool>(stream);
+}
+
+bool Read(const std::string& path, uint64_t sourceHash, bool upload, Model& model, std::vector<EmbeddedTexture>& embeddedTextures) {
+    MappedFile file(path);
+    if (!file.IsOpen()) {
+        return false;
+    }
+
+    CacheReader reader(file.GetData(), file.GetSize());
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t fileSourceHash = 0;
+    reader.Read(magic);
+    reader.Read(version);
+    reader.Read(fileSourceHash);
+    if (!reader.IsGood() || magic != MODEL_MAGIC || version != MODEL_VERSION || fileSourceHash != sourceHash) {
+        return false;
+    }
+
+    // Read everything before touching the model, a corrupt file leaves it as it was
+    struct MeshData {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<MeshLOD> lods;
+        std::vector<Texture> textures;
+        std::vector<MorphTarget> morphTargets;
+        std::vector<MorphDelta> morphDeltas;
+        std::vector<unsigned int> morphedVertices;
+    };
+    std::vector<MeshData> meshes(reader.ReadCount());
+    for (auto& mesh : meshes) {
+        reader.ReadVector(mesh.vertices);
+        reader.ReadVector(mesh.indices);
+        reader.ReadVector(mesh.lods);
+
+        mesh.textures.resize(reader.ReadCount());
+        for (auto& texture : mesh.textures) {
+            texture.id = 0;
+            reader.ReadString(texture.type);
+            reader.ReadString(texture.path);
+        }
+
+        mesh.morphTargets.resize(reader.ReadCount());
+        for (auto& target : mesh.morphTargets) {
+            reader.ReadString(target.name);
+            reader.Read(target.index);
+            reader.Read(target.firstDelta);
+            reader.Read(target.deltaCount);
+        }
+        reader.ReadVector(mesh.morphDeltas);
+        reader.ReadVector(mesh.morphedVertices);
+        if (!reader.IsGood()) {
+            break;
+        }
+    }
+
+    int boneCount = 0;
+    BoneInfoMap boneInfoMap;
+    reader.Read(boneCount);
+    uint32_t boneInfoCount = reader.ReadCount();
+    for (uint32_t i = 0; i < boneInfoCount && reader.IsGood(); i++) {
+        std::string name;
+        BoneInfo boneInfo;
+        reader.ReadString(name);
+        reader.Read(boneInfo.id);
+        reader.Read(boneInfo.offset);
+        boneInfoMap[name] = boneInfo;
+    }
+
+    uint8_t hasSkeletonLODs = 0;
+    reader.Read(hasSkeletonLODs);
+    auto skeletonLODs = std::make_shared<SkeletonLODSet>(reader.ReadCount());
+    for (auto& skeletonLOD : *skeletonLODs) {
+        std::vector<uint8_t> boneKept;
+        reader.ReadVector(skeletonLOD.boneRemap);
+        reader.ReadVector(boneKept);
+        reader.Read(skeletonLOD.paletteSize);
+        skeletonLOD.boneKept.assign(boneKept.begin(), boneKept.end());
+    }
+
+    std::vector<std::string> morphTargetNames(reader.ReadCount());
+    for (auto& name : morphTargetNames) {
+        reader.ReadString(name);
+    }
+
+    std::vector<EmbeddedTexture> embedded(reader.ReadCount());
+    for (auto& texture : embedded) {
+        reader.ReadString(texture.path);
+        reader.Read(texture.width);
+        reader.Read(texture.height);
+        reader.ReadVector(texture.data);
+    }
+
+    uint32_t endMagic = 0;
+    reader.Read(endMagic);
+    if (!reader.IsGood() || endMagic != MODEL_MAGIC) {
+        std::cout << "WARNING: Model cache file '" << path << "' is corrupt" << std::endl;
+        return false;
+    }
+
+    // Reject indices that point past the data that was read
+    for (const auto& mesh : meshes) {
+        bool valid = true;
+        for (unsigned int index : mesh.indices) {
+            valid = valid && index < mesh.vertices.size();
+        }
+        for (const auto& lod : mesh.lods) {
+            valid = valid && static_cast<uint64_t>(lod.firstIndex) + lod.indexCount <= mesh.indices.size();
+        }
+        for (const auto& target : mesh.morphTargets) {
+            valid = valid && static_cast<uint64_t>(target.firstDelta) + target.deltaCount <= mesh.morphDeltas.size() &&
+                    target.index >= 0 && target.index < static_cast<int>(morphTargetNames.size());
+        }
+        for (const auto& delta : mesh.morphDeltas) {
+            valid = valid && delta.slot < mesh.morphedVertices.size();
+        }
+        for (unsigned int vertex : mesh.morphedVertices) {
+            valid = valid && vertex < mesh.vertices.size();
+        }
+        if (!valid) {
+            std::cout << "WARNING: Model cache file '" << path << "' is corrupt" << std::endl;
+            return false;
+        }
+    }
+
+    for (auto& data : meshes) {
+        Mesh mesh(std::move(data.vertices), std::move(data.indices), std::move(data.textures), upload, std::move(data.lods));
+        if (!data.morphTargets.empty()) {
+            mesh.SetupMorphTargets(std::move(data.morphTargets), std::move(data.morphDeltas), std::move(data.morphedVertices));
+        }
+        if (hasSkeletonLODs) {
+            mesh.SetupSkeletonLODs(*skeletonLODs);
+        }
+        model.meshes.push_back(std::move(mesh));
+    }
+
+    model.m_BoneCounter = boneCount;
+    model.m_BoneInfoMap = std::move(boneInfoMap);
+    if (hasSkeletonLODs) {
+        model.m_SkeletonLODs = skeletonLODs;
+    }
+    model.m_MorphTargetNames = std::move(morphTargetNames);
+    embeddedTextures = std::move(embedded);
+    return true;
+}
+
+}
+
+}
@@ -0,0 +1,38 @@
+#ifndef MODEL_CACHE_FILE_H
+#define MODEL_CACHE_FILE_H
+
+#include "Model.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace SockEngine {
+
+// Post-processed model data exactly as the meshes hold it: vertices, indices, material bindings,
+// bones, skeleton LODs and morph targets. Loading a cached model maps the file and copies the
+// arrays out in bulk, Assimp is not involved.
+namespace ModelCacheFile {
+
+    constexpr const char* MODEL_CACHE_DIRECTORY = "../Cache/Models/";
+
+    // Identity of an import: FNV-1a over the source file's content, the files it pulls in beside it
+    // (external glTF buffers, OBJ material libraries) and the import settings.
+    // Returns 0 if the source can't be read.
+    uint64_t ComputeSourceHash(const std::string& sourcePath, uint64_t importSignature);
+
+    // Cache files are named after the source hash, so an edited source or a change of settings misses
+    std::string GetCachePath(uint64_t sourceHash);
+
+    // Writes the imported model. Returns false if the file could not be written.
+    bool Write(const Model& model, const std::vector<EmbeddedTexture>& embeddedTextures, uint64_t sourceHash, const std::string& path);
+
+    // Fills the model's meshes (without texture objects), bones, skeleton LODs and morph targets.
+    // Returns false if the file is missing, truncated, corrupt or was written for another source hash
+    // or version of the format, in which case the model is left untouched.
+    bool Read(const std::string& path, uint64_t sourceHash, bool upload, Model& model, std::vector<EmbeddedTexture>& embeddedTextures);
+
+}
+
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include "ModelLoader.h"
+#include "TextureManager.h"
+#include <iostream>
+#include <chrono>
+
+namespace SockEngine {
+
+namespace {
+
+bool IsFinished(const std::future<ModelLoader::Result>& future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+}
+
+ModelLoader& ModelLoader::Get() {
+    static ModelLoader instance;
+    return instance;
+}
+
+ModelLoader::ModelLoader() {
+    // Created first so the texture cache outlives the models still held here
+    TextureManager::Get();
+}
+
+ModelLoader::~ModelLoader() {
+    // Stop the imports in flight, the futures wait for their workers
+    for (auto& [id, load] : m_Loads) {
+        load.progress->cancelled = true;
+    }
+}
+
+ModelLoader::LoadID ModelLoader::Load(const std::string& path, const std::string& animationPath,
+                                      const SkeletonLODBones& skeletonLODBones) {
+    LoadID id = m_NextID++;
+
+    PendingLoad& load = m_Loads[id];
+    load.path = path;
+    load.progress = std::make_shared<ModelImportProgress>();
+
+    std::shared_ptr<ModelImportProgress> progress = load.progress;
+    load.import = std::async(std::launch::async, [path, animationPath, skeletonLODBones, progress]() {
+        Result result;
+        result.model = std::make_shared<Model>(path, false, progress.get(), skeletonLODBones);
+        if (progress->cancelled || result.model->meshes.empty()) {
+            return result;
+        }
+
+        // Import the clip here too, so attaching the animator is a cache hit on the main thread
+        if (!animationPath.empty() && result.model->GetBoneCount() > 0) {
+            result.animation = AnimationLibrary::Get().Load(animationPath, result.model->GetBoneInfoMap());
+        }
+        progress->progress = 1.0f;
+        return result;
+    });
+
+    return id;
+}
+
+void ModelLoader::Cancel(LoadID id) {
+    auto it = m_Loads.find(id);
+    if (it == m_Loads.end()) {
+        return;
+    }
+
+    // The model has to be released on this thread, its textures may already exist
+    PendingLoad& load = it->second;
+    load.progress->cancelled = true;
+    if (load.import.valid()) {
+        m_Abandoned.push_back(std::move(load.import));
+    }
+    m_Loads.erase(it);
+}
+
+void ModelLoader::Update() {
+    // Release abandoned imports that have stopped
+    for (auto it = m_Abandoned.begin(); it != m_Abandoned.end();) {
+        if (IsFinished(*it)) {
+            it->get();
+            it = m_Abandoned.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Collect finished imports
+    for (auto& [id, load] : m_Loads) {
+        if (load.state != State::Importing || !IsFinished(load.import)) {
+            continue;
+        }
+
+        load.result = load.import.get();
+        if (!load.result.model || load.result.model->meshes.empty()) {
+            std::cout << "ERROR: Failed to load model: " << load.path << std::endl;
+            load.result = Result();
+            load.state = State::Failed;
+            continue;
+        }
+        load.uploadSize = load.result.model->GetPendingUploadSize();
+        load.state = State::Uploading;
+    }
+
+    // Upload in request order until the frame's budget is spent
+    size_t budget = m_UploadBudget;
+    m_UploadedBytes = 0;
+    for (auto& [id, load] : m_Loads) {
+        if (budget == 0) {
+            break;
+        }
+        if (load.state != State::Uploading) {
+            continue;
+        }
+
+        size_t before = budget;
+        bool uploaded = load.result.model->Upload(budget);
+        load.uploadedBytes += before - budget;
+        m_UploadedBytes += before - budget;
+        if (uploaded) {
+            load.state = State::Ready;
+        }
+    }
+}
+
+void ModelLoader::Shutdown() {
+    for (auto& [id, load] : m_Loads) {
+        load.progress->cancelled = true;
+        if (load.import.valid()) {
+            m_Abandoned.push_back(std::move(load.import));
+        }
+    }
+    m_Loads.clear();
+
+    // The workers stop at their next check, their models are released here
+    for (auto& import : m_Abandoned) {
+        import.get();
+    }
+    m_Abandoned.clear();
+}
+
+ModelLoader::State ModelLoader::GetState(LoadID id) const {
+    auto it = m_Loads.find(id);
+    return it != m_Loads.end() ? it->second.state : State::Cancelled;
+}
+
+float ModelLoader::GetProgress(LoadID id) const {
+    auto it = m_Loads.find(id);
+    if (it == m_Loads.end()) {
+        return 0.0f;
+    }
+
+    const PendingLoad& load = it->second;
+    switch (load.state) {
+    case State::Importing:
+        return load.progress->progress;
+    case State::Uploading:
+        return load.uploadSize > 0 ? std::min(static_cast<float>(load.uploadedBytes) / load.uploadSize, 1.0f) : 1.0f;
+    case State::Ready:
+        return 1.0f;
+    default:
+        return 0.0f;
+    }
+}
+
+ModelLoader::Result ModelLoader::Take(LoadID id) {
+    auto it = m_Loads.find(id);
+    if (it == m_Loads.end() || (it->second.state != State::Ready && it->second.state != State::Failed)) {
+        return Result();
+    }
+
+    Result result = std::move(it->second.result);
+    m_Loads.erase(it);
+    return result;
+}
+
+}
@@ -0,0 +1,98 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include "Model.h"
+#include "AnimationLibrary.h"
+#include <string>
+#include <memory>
+#include <future>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+namespace SockEngine {
+
+// Imports models in the background. Assimp parsing, vertex conversion and image decoding run on a
+// worker thread; the GL buffers and textures are then created on the render thread a few at a time,
+// within a per-frame byte budget, so a large model never stalls a frame. Main thread only.
+class ModelLoader {
+public:
+    using LoadID = uint64_t;
+
+    enum class State {
+        Importing,  // CPU import on a worker thread
+        Uploading,  // Creating GPU resources within the frame budget
+        Ready,      // Waiting for Take
+        Failed,
+        Cancelled   // Also returned for unknown or already taken loads
+    };
+
+    // Model and the clip it was loaded with, warmed in the AnimationLibrary by the worker
+    struct Result {
+        std::shared_ptr<Model> model;
+        AnimationRef animation;
+    };
+
+    // Global instance
+    static ModelLoader& Get();
+
+    // Starts importing the model on a worker thread. The animation clip, if any, is imported too.
+    LoadID Load(const std::string& path, const std::string& animationPath = "",
+                const SkeletonLODBones& skeletonLODBones = SkeletonLODBones());
+
+    // Stops the load and forgets it. An import in flight is abandoned at its next check.
+    void Cancel(LoadID id);
+
+    // Collects finished imports and uploads them within the budget. Called once per frame.
+    void Update();
+
+    State GetState(LoadID id) const;
+
+    // Progress of the current state, from 0 to 1
+    float GetProgress(LoadID id) const;
+
+    // Hands over a ready load and forgets it. Failed loads return an empty result.
+    Result Take(LoadID id);
+
+    // Cancels every load, waits for the imports in flight and releases their models while the
+    // GL context is still alive. GL thread only.
+    void Shutdown();
+
+    // Bytes sent to the GPU per frame for finished imports
+    void SetUploadBudget(size_t bytes) { m_UploadBudget = bytes; }
+    size_t GetUploadBudget() const { return m_UploadBudget; }
+
+    // Statistics
+    size_t GetLoadCount() const { return m_Loads.size(); }
+    size_t GetUploadedBytes() const { return m_UploadedBytes; }
+
+private:
+    ModelLoader();
+    ~ModelLoader();
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+    struct PendingLoad {
+        std::string path;
+        State state = State::Importing;
+        std::shared_ptr<ModelImportProgress> progress;
+        std::future<Result> import;
+        Result result;
+        size_t uploadSize = 0;
+        size_t uploadedBytes = 0;
+    };
+
+    // Ordered by ID, so uploads go out in request order
+    std::map<LoadID, PendingLoad> m_Loads;
+
+    // Cancelled imports still running, their models are released here once the worker returns
+    std::vector<std::future<Result>> m_Abandoned;
+
+    LoadID m_NextID = 1;
+    size_t m_UploadBudget = 8 * 1024 * 1024;
+    size_t m_UploadedBytes = 0;
+};
+
+}
+
+#endif
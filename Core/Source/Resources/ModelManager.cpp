@@ -0,0 +1,253 @@
+#include "ModelManager.h"
+#include "GeometryArena.h"
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+namespace SockEngine {
+
+ModelManager& ModelManager::Get() {
+    static ModelManager instance;
+    return instance;
+}
+
+ModelManager::ModelManager() {
+    // Created first so the loader and the arena outlive the models and imports still held here
+    ModelLoader::Get();
+    GeometryArena::Get();
+}
+
+ModelHandle ModelManager::Load(const std::string& path) {
+    std::string key = MakeKey(path);
+
+    ModelHandle handle;
+    if (Slot* slot = FindCached(key, handle)) {
+        // Needed now, import it on this thread instead of waiting for the background import
+        if (slot->state != ModelLoader::State::Ready) {
+            ModelLoader::Get().Cancel(slot->loadID);
+            slot->loadID = 0;
+            slot->model = std::make_shared<Model>(path, false, nullptr, GetSkeletonLODBones(path));
+            slot->model->ReleaseMeshData(m_MeshResidency);
+            slot->state = slot->model->meshes.empty() ? ModelLoader::State::Failed : ModelLoader::State::Ready;
+        }
+        return handle;
+    }
+
+    handle = Allocate(key);
+    Slot& slot = m_Slots[handle.index];
+    slot.model = std::make_shared<Model>(path, false, nullptr, GetSkeletonLODBones(path));
+    slot.model->ReleaseMeshData(m_MeshResidency);
+    slot.state = slot.model->meshes.empty() ? ModelLoader::State::Failed : ModelLoader::State::Ready;
+    return handle;
+}
+
+ModelHandle ModelManager::LoadAsync(const std::string& path, const std::string& animationPath) {
+    std::string key = MakeKey(path);
+
+    ModelHandle handle;
+    if (FindCached(key, handle)) {
+        return handle;
+    }
+
+    handle = Allocate(key);
+    Slot& slot = m_Slots[handle.index];
+    slot.state = ModelLoader::State::Importing;
+    slot.loadID = ModelLoader::Get().Load(path, animationPath, GetSkeletonLODBones(path));
+    return handle;
+}
+
+void ModelManager::SetSkeletonLODBones(const std::string& path, SkeletonLODBones bones) {
+    m_SkeletonLODBones[MakeKey(path)] = std::move(bones);
+}
+
+const SkeletonLODBones& ModelManager::GetSkeletonLODBones(const std::string& path) const {
+    auto it = m_SkeletonLODBones.find(MakeKey(path));
+    return it != m_SkeletonLODBones.end() ? it->second : m_DefaultSkeletonLODBones;
+}
+
+ModelHandle ModelManager::Acquire(ModelHandle handle) {
+    Slot* slot = GetSlot(handle);
+    if (!slot) {
+        return ModelHandle();
+    }
+
+    // Brought back before its eviction
+    if (slot->refCount == 0) {
+        m_Unused.erase(std::find(m_Unused.begin(), m_Unused.end(), handle.index));
+    }
+    slot->refCount++;
+    return handle;
+}
+
+void ModelManager::Release(ModelHandle handle) {
+    Slot* slot = GetSlot(handle);
+    if (!slot || slot->refCount == 0 || --slot->refCount > 0) {
+        return;
+    }
+
+    // Imports nobody waits for anymore are stopped, failed ones have nothing to keep
+    if (slot->state == ModelLoader::State::Ready) {
+        slot->unusedTime = 0.0f;
+        m_Unused.push_back(handle.index);
+    }
+    else {
+        Evict(handle.index);
+    }
+}
+
+Model* ModelManager::Resolve(ModelHandle handle) const {
+    const Slot* slot = GetSlot(handle);
+    return slot && slot->state == ModelLoader::State::Ready ? slot->model.get() : nullptr;
+}
+
+ModelLoader::State ModelManager::GetState(ModelHandle handle) const {
+    const Slot* slot = GetSlot(handle);
+    if (!slot) {
+        return ModelLoader::State::Cancelled;
+    }
+    if (slot->state != ModelLoader::State::Importing) {
+        return slot->state;
+    }
+
+    // Only ready here once collected by Update
+    ModelLoader::State state = ModelLoader::Get().GetState(slot->loadID);
+    return state == ModelLoader::State::Importing ? state : ModelLoader::State::Uploading;
+}
+
+float ModelManager::GetProgress(ModelHandle handle) const {
+    const Slot* slot = GetSlot(handle);
+    if (!slot) {
+        return 0.0f;
+    }
+    return slot->state == ModelLoader::State::Importing ? ModelLoader::Get().GetProgress(slot->loadID) : 1.0f;
+}
+
+void ModelManager::Update(float deltaTime) {
+    ModelLoader& loader = ModelLoader::Get();
+
+    // Collect the background imports that finished
+    for (auto& slot : m_Slots) {
+        if (slot.state != ModelLoader::State::Importing) {
+            continue;
+        }
+
+        ModelLoader::State state = loader.GetState(slot.loadID);
+        if (state == ModelLoader::State::Importing || state == ModelLoader::State::Uploading) {
+            continue;
+        }
+
+        // The loader only warms the clip, the animators get it from the AnimationLibrary
+        slot.model = loader.Take(slot.loadID).model;
+        slot.loadID = 0;
+        slot.state = slot.model ? ModelLoader::State::Ready : ModelLoader::State::Failed;
+
+        // Everything is on the GPU by now, the CPU copies only take memory
+        if (slot.model) {
+            slot.model->ReleaseMeshData(m_MeshResidency);
+        }
+    }
+
+    // Evict the models that stayed unused for the whole delay
+    for (size_t i = 0; i < m_Unused.size();) {
+        Slot& slot = m_Slots[m_Unused[i]];
+        slot.unusedTime += deltaTime;
+        if (slot.unusedTime >= m_EvictionDelay) {
+            uint32_t index = m_Unused[i];
+            m_Unused.erase(m_Unused.begin() + i);
+            Evict(index);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+ModelManager::Slot* ModelManager::FindCached(const std::string& key, ModelHandle& handle) {
+    auto it = m_PathToSlot.find(key);
+    if (it == m_PathToSlot.end()) {
+        return nullptr;
+    }
+
+    // Failed imports are retried, the slot stays with its holders until they release it
+    Slot& slot = m_Slots[it->second];
+    if (slot.state == ModelLoader::State::Failed) {
+        m_PathToSlot.erase(it);
+        return nullptr;
+    }
+
+    handle = { it->second, slot.generation };
+    m_HitCount++;
+    return Acquire(handle) ? &slot : nullptr;
+}
+
+ModelHandle ModelManager::Allocate(const std::string& key) {
+    uint32_t index;
+    if (!m_FreeSlots.empty()) {
+        index = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(m_Slots.size());
+        m_Slots.emplace_back();
+    }
+
+    Slot& slot = m_Slots[index];
+    slot.key = key;
+    slot.refCount = 1;
+    m_PathToSlot[key] = index;
+    return { index, slot.generation };
+}
+
+void ModelManager::Shutdown() {
+    for (uint32_t i = 0; i < m_Slots.size(); i++) {
+        if (m_Slots[i].state != ModelLoader::State::Cancelled) {
+            Evict(i);
+        }
+    }
+    m_Unused.clear();
+    m_PathToSlot.clear();
+
+    // Evicting cancelled the imports, wait for them to release their models
+    ModelLoader::Get().Shutdown();
+}
+
+void ModelManager::Evict(uint32_t index) {
+    Slot& slot = m_Slots[index];
+    if (slot.state == ModelLoader::State::Importing) {
+        ModelLoader::Get().Cancel(slot.loadID);
+    }
+
+    // A retried import may have taken the path over
+    auto it = m_PathToSlot.find(slot.key);
+    if (it != m_PathToSlot.end() && it->second == index) {
+        m_PathToSlot.erase(it);
+    }
+
+    // Handles to the slot go stale, generation 0 is reserved for invalid handles
+    uint32_t generation = slot.generation + 1;
+    slot = Slot();
+    slot.generation = generation != 0 ? generation : 1;
+    m_FreeSlots.push_back(index);
+}
+
+const ModelManager::Slot* ModelManager::GetSlot(ModelHandle handle) const {
+    if (!handle || handle.index >= m_Slots.size()) {
+        return nullptr;
+    }
+
+    const Slot& slot = m_Slots[handle.index];
+    return slot.generation == handle.generation && slot.state != ModelLoader::State::Cancelled ? &slot : nullptr;
+}
+
+ModelManager::Slot* ModelManager::GetSlot(ModelHandle handle) {
+    return const_cast<Slot*>(static_cast<const ModelManager*>(this)->GetSlot(handle));
+}
+
+std::string ModelManager::MakeKey(const std::string& path) {
+    // The same file reached through different relative paths shares a model
+    std::error_code error;
+    std::filesystem::path absolute = std::filesystem::absolute(path, error);
+    return (error ? std::filesystem::path(path) : absolute).lexically_normal().generic_string();
+}
+
+}
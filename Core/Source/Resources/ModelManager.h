@@ -0,0 +1,125 @@
+#ifndef MODEL_MANAGER_H
+#define MODEL_MANAGER_H
+
+#include "Model.h"
+#include "ModelLoader.h"
+#include <string>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace SockEngine {
+
+// Reference to a model owned by the ModelManager, cheap to copy and compare. The generation tells
+// a handle to an evicted model apart from one to the model that reused its slot.
+struct ModelHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0;    // Live slots never use 0, so a default handle is invalid
+
+    bool IsValid() const { return generation != 0; }
+    explicit operator bool() const { return IsValid(); }
+    bool operator==(const ModelHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const ModelHandle& other) const { return !(*this == other); }
+};
+
+// Engine-wide model cache. Each file is imported once and every entity loading it shares the same
+// meshes and textures through a handle. Handles are counted explicitly with Acquire and Release;
+// a model nobody references is evicted after a delay, so a prop that is unloaded and streamed
+// back in shortly after costs nothing. Main thread only.
+class ModelManager {
+public:
+    // Global instance
+    static ModelManager& Get();
+
+    // Returns a handle to the model, importing it on the calling thread if it isn't loaded.
+    // Adds a reference.
+    ModelHandle Load(const std::string& path);
+
+    // Returns a handle to the model right away and imports it in the background if it isn't loaded.
+    // The animation clip, if any, is warmed by the import. Adds a reference.
+    ModelHandle LoadAsync(const std::string& path, const std::string& animationPath = "");
+
+    // Adds a reference to a live handle. Returns an invalid handle for a stale one.
+    ModelHandle Acquire(ModelHandle handle);
+
+    // Drops a reference. A model still importing is cancelled, a loaded one is queued for eviction.
+    void Release(ModelHandle handle);
+
+    // Model of the handle, or nullptr while it is loading, if it failed or if the handle is stale
+    Model* Resolve(ModelHandle handle) const;
+
+    // Ready once the model can be resolved. Stale handles are reported as Cancelled.
+    ModelLoader::State GetState(ModelHandle handle) const;
+
+    // Import or upload progress of a loading model, from 0 to 1
+    float GetProgress(ModelHandle handle) const;
+
+    // Collects finished imports and evicts the models unused for longer than the eviction delay.
+    // Called once per frame, after the ModelLoader.
+    void Update(float deltaTime);
+
+    // Evicts every model, referenced or not, and stops the imports in flight, so their meshes and
+    // textures are released while the GL context and the GeometryArena are still alive. Every
+    // handle goes stale. Called by the renderer on shutdown.
+    void Shutdown();
+
+    // Seconds an unreferenced model stays loaded in case it is loaded again
+    void SetEvictionDelay(float seconds) { m_EvictionDelay = seconds; }
+    float GetEvictionDelay() const { return m_EvictionDelay; }
+
+    // CPU data the meshes of a model keep once it is ready. Applies to models loaded afterwards.
+    void SetMeshResidency(MeshResidency residency) { m_MeshResidency = residency; }
+    MeshResidency GetMeshResidency() const { return m_MeshResidency; }
+
+    // Bones the reduced skeletons of a model drop, for rigs the default words don't suit. Applies
+    // to imports started afterwards, a cached import is rebuilt when its bones change.
+    void SetSkeletonLODBones(const std::string& path, SkeletonLODBones bones);
+    const SkeletonLODBones& GetSkeletonLODBones(const std::string& path) const;
+
+    // Statistics
+    size_t GetModelCount() const { return m_PathToSlot.size(); }
+    size_t GetUnusedCount() const { return m_Unused.size(); }
+    size_t GetHitCount() const { return m_HitCount; }
+
+private:
+    ModelManager();
+    ~ModelManager() = default;
+    ModelManager(const ModelManager&) = delete;
+    ModelManager& operator=(const ModelManager&) = delete;
+
+    struct Slot {
+        std::shared_ptr<Model> model;
+        std::string key;
+        uint32_t generation = 1;
+        uint32_t refCount = 0;
+        ModelLoader::State state = ModelLoader::State::Cancelled;
+        ModelLoader::LoadID loadID = 0;
+        float unusedTime = 0.0f;
+    };
+
+    // Returns the live slot for a path with an added reference, or nullptr if it isn't cached
+    Slot* FindCached(const std::string& key, ModelHandle& handle);
+
+    ModelHandle Allocate(const std::string& key);
+    void Evict(uint32_t index);
+
+    const Slot* GetSlot(ModelHandle handle) const;
+    Slot* GetSlot(ModelHandle handle);
+
+    static std::string MakeKey(const std::string& path);
+
+    std::vector<Slot> m_Slots;
+    std::vector<uint32_t> m_FreeSlots;
+    std::unordered_map<std::string, uint32_t> m_PathToSlot;
+    std::vector<uint32_t> m_Unused;     // Loaded slots without references, oldest first
+    float m_EvictionDelay = 10.0f;
+    MeshResidency m_MeshResidency = MeshResidency::GpuOnly;
+    std::unordered_map<std::string, SkeletonLODBones> m_SkeletonLODBones;    // By key, models without one use the defaults
+    SkeletonLODBones m_DefaultSkeletonLODBones;
+    size_t m_HitCount = 0;
+};
+
+}
+
+#endif
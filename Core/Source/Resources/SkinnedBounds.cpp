@@ -0,0 +1,167 @@
+#include "SkinnedBounds.h"
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKINNED_BOUNDS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace SockEngine {
+
+std::shared_ptr<SkinnedBounds> SkinnedBounds::Build(const std::vector<Mesh>& meshes, int boneCount,
+                                                    const SkeletonLODSet& skeletonLODs) {
+    auto bounds = std::make_shared<SkinnedBounds>();
+    int levelCount = static_cast<int>(skeletonLODs.size()) + 1;
+
+    // Palette entry of every bone at every level. At a reduced level a dropped bone's vertices
+    // move with the kept ancestor that took over its weights.
+    std::vector<std::vector<int>> entries(levelCount, std::vector<int>(boneCount, -1));
+    std::vector<int> entryCounts(levelCount, boneCount);
+    for (int bone = 0; bone < boneCount; bone++) {
+        entries[0][bone] = bone;
+    }
+    for (int level = 1; level < levelCount; level++) {
+        const SkeletonLOD& skeletonLOD = skeletonLODs[level - 1];
+        entryCounts[level] = skeletonLOD.paletteSize;
+        for (int bone = 0; bone < boneCount && bone < static_cast<int>(skeletonLOD.boneRemap.size()); bone++) {
+            entries[level][bone] = skeletonLOD.boneRemap[bone];
+        }
+    }
+
+    std::vector<std::vector<glm::vec3>> minimums(levelCount);
+    std::vector<std::vector<glm::vec3>> maximums(levelCount);
+    bounds->m_Levels.resize(levelCount);
+    for (int level = 0; level < levelCount; level++) {
+        minimums[level].assign(entryCounts[level], glm::vec3(FLT_MAX));
+        maximums[level].assign(entryCounts[level], glm::vec3(-FLT_MAX));
+    }
+
+    for (const auto& mesh : meshes) {
+        // How far morph targets can move each vertex with every weight at one
+        std::vector<glm::vec3> morphReach(mesh.morphedVertices.size(), glm::vec3(0.0f));
+        for (const auto& delta : mesh.morphDeltas) {
+            morphReach[delta.slot] += glm::abs(delta.position);
+        }
+        std::vector<int> morphSlots(mesh.vertices.size(), -1);
+        for (size_t slot = 0; slot < mesh.morphedVertices.size(); slot++) {
+            morphSlots[mesh.morphedVertices[slot]] = static_cast<int>(slot);
+        }
+
+        for (size_t v = 0; v < mesh.vertices.size(); v++) {
+            const Vertex& vertex = mesh.vertices[v];
+            glm::vec3 reach = morphSlots[v] >= 0 ? morphReach[morphSlots[v]] : glm::vec3(0.0f);
+            float totalWeight = 0.0f;
+
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+                int bone = vertex.m_BoneIDs[i];
+                if (bone < 0 || bone >= boneCount || vertex.m_Weights[i] <= 0.0f) {
+                    continue;
+                }
+                totalWeight += vertex.m_Weights[i];
+
+                for (int level = 0; level < levelCount; level++) {
+                    int entry = entries[level][bone];
+                    if (entry < 0) {
+                        bounds->m_Levels[level].includesOrigin = true;
+                        continue;
+                    }
+                    minimums[level][entry] = glm::min(minimums[level][entry], vertex.Position - reach);
+                    maximums[level][entry] = glm::max(maximums[level][entry], vertex.Position + reach);
+                }
+            }
+
+            // The shaders don't renormalize, missing weight pulls the vertex towards the origin
+            if (totalWeight < 0.999f) {
+                for (auto& level : bounds->m_Levels) {
+                    level.includesOrigin = true;
+                }
+            }
+        }
+    }
+
+    for (int level = 0; level < levelCount; level++) {
+        auto& bones = bounds->m_Levels[level].bones;
+        bones.resize(minimums[level].size());
+        for (size_t entry = 0; entry < bones.size(); entry++) {
+            if (minimums[level][entry].x <= maximums[level][entry].x) {
+                bones[entry].center = (minimums[level][entry] + maximums[level][entry]) * 0.5f;
+                bones[entry].extent = (maximums[level][entry] - minimums[level][entry]) * 0.5f;
+            }
+        }
+    }
+
+    return bounds;
+}
+
+bool SkinnedBounds::ComputeAABB(const std::vector<glm::mat4>& palette, int skeletonLOD, glm::vec3& min, glm::vec3& max) const {
+    if (skeletonLOD < 0 || skeletonLOD >= static_cast<int>(m_Levels.size())) {
+        return false;
+    }
+    const Level& level = m_Levels[skeletonLOD];
+    if (palette.size() < level.bones.size()) {
+        return false;
+    }
+
+    size_t count = level.bones.size();
+
+#ifdef SKINNED_BOUNDS_SSE
+    // One box per iteration, the xyz lanes carry the three axes:
+    // center' = M * center, extent' = |M0| * ex + |M1| * ey + |M2| * ez
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 boxMin = _mm_set1_ps(level.includesOrigin ? 0.0f : FLT_MAX);
+    __m128 boxMax = _mm_set1_ps(level.includesOrigin ? 0.0f : -FLT_MAX);
+
+    for (size_t i = 0; i < count; i++) {
+        const BoneBounds& bone = level.bones[i];
+        if (!bone.IsValid()) {
+            continue;
+        }
+
+        const float* matrix = &palette[i][0][0];
+        __m128 column0 = _mm_loadu_ps(matrix);
+        __m128 column1 = _mm_loadu_ps(matrix + 4);
+        __m128 column2 = _mm_loadu_ps(matrix + 8);
+        __m128 column3 = _mm_loadu_ps(matrix + 12);
+
+        __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(bone.center.x)),
+                                              _mm_mul_ps(column1, _mm_set1_ps(bone.center.y))),
+                                   _mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(bone.center.z)), column3));
+        __m128 extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(column0, absMask), _mm_set1_ps(bone.extent.x)),
+                                              _mm_mul_ps(_mm_and_ps(column1, absMask), _mm_set1_ps(bone.extent.y))),
+                                   _mm_mul_ps(_mm_and_ps(column2, absMask), _mm_set1_ps(bone.extent.z)));
+
+        boxMin = _mm_min_ps(boxMin, _mm_sub_ps(center, extent));
+        boxMax = _mm_max_ps(boxMax, _mm_add_ps(center, extent));
+    }
+
+    alignas(16) float minValues[4];
+    alignas(16) float maxValues[4];
+    _mm_store_ps(minValues, boxMin);
+    _mm_store_ps(maxValues, boxMax);
+    min = glm::vec3(minValues[0], minValues[1], minValues[2]);
+    max = glm::vec3(maxValues[0], maxValues[1], maxValues[2]);
+#else
+    min = glm::vec3(level.includesOrigin ? 0.0f : FLT_MAX);
+    max = glm::vec3(level.includesOrigin ? 0.0f : -FLT_MAX);
+
+    for (size_t i = 0; i < count; i++) {
+        const BoneBounds& bone = level.bones[i];
+        if (!bone.IsValid()) {
+            continue;
+        }
+
+        const glm::mat4& matrix = palette[i];
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(bone.center, 1.0f));
+        glm::vec3 extent = glm::abs(glm::vec3(matrix[0])) * bone.extent.x +
+                           glm::abs(glm::vec3(matrix[1])) * bone.extent.y +
+                           glm::abs(glm::vec3(matrix[2])) * bone.extent.z;
+        min = glm::min(min, center - extent);
+        max = glm::max(max, center + extent);
+    }
+#endif
+
+    return min.x <= max.x;
+}
+
+}
@@ -0,0 +1,48 @@
+#ifndef SKINNED_BOUNDS_H
+#define SKINNED_BOUNDS_H
+
+#include "Mesh.h"
+#include "AnimData.h"
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+namespace SockEngine {
+
+// Bind-pose box around the vertices a palette entry moves
+struct BoneBounds {
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 extent = glm::vec3(-1.0f);    // Negative if no vertex uses the entry
+
+    bool IsValid() const { return extent.x >= 0.0f; }
+};
+
+// Per-bone bounding boxes of a skinned model, computed once at import. A skinned vertex is a
+// weighted average of its bones' transforms, so moving each box by its palette matrix and
+// merging the results bounds the mesh in any pose, however far the root travels. Boxes include
+// the reach of the mesh's morph targets at full weight.
+class SkinnedBounds {
+public:
+    // Boxes for the full skeleton's palette and for each reduced skeleton's palette
+    static std::shared_ptr<SkinnedBounds> Build(const std::vector<Mesh>& meshes, int boneCount,
+                                                const SkeletonLODSet& skeletonLODs);
+
+    // Model-space box around the mesh skinned with a palette of the given skeleton LOD
+    // (0 is the full skeleton). Returns false if the palette is too small for the level.
+    bool ComputeAABB(const std::vector<glm::mat4>& palette, int skeletonLOD, glm::vec3& min, glm::vec3& max) const;
+
+    const std::vector<BoneBounds>& GetBoneBounds(int skeletonLOD = 0) const { return m_Levels[skeletonLOD].bones; }
+    int GetLevelCount() const { return static_cast<int>(m_Levels.size()); }
+
+private:
+    struct Level {
+        std::vector<BoneBounds> bones;  // Indexed by palette entry
+        bool includesOrigin = false;    // Some vertices lose weight at this level and are pulled towards the origin
+    };
+
+    std::vector<Level> m_Levels;
+};
+
+}
+
+#endif
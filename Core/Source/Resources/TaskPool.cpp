@@ -0,0 +1,48 @@
+#include "TaskPool.h"
+#include <algorithm>
+
+namespace SockEngine {
+
+TaskPool& TaskPool::Get() {
+    static TaskPool instance;
+    return instance;
+}
+
+TaskPool::TaskPool() {
+    // The main thread keeps a core for itself
+    unsigned int workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (unsigned int i = 0; i < workerCount; i++) {
+        m_Workers.emplace_back(&TaskPool::WorkerLoop, this);
+    }
+}
+
+TaskPool::~TaskPool() {
+    // Jobs already queued still run, their futures may be waited on by other singletons
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_JobAvailable.notify_all();
+
+    for (auto& worker : m_Workers) {
+        worker.join();
+    }
+}
+
+void TaskPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_JobAvailable.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+            if (m_Jobs.empty()) {
+                return;
+            }
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+        }
+        job();
+    }
+}
+
+}
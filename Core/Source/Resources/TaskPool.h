@@ -0,0 +1,56 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+namespace SockEngine {
+
+// Fixed set of worker threads, one per core besides the main thread, running short CPU jobs
+// (decoding, filtering, copies) in submission order. Jobs must not call GL.
+class TaskPool {
+public:
+    // Global instance
+    static TaskPool& Get();
+
+    // Queues a job and returns the future of its result
+    template<typename Function>
+    auto Submit(Function&& function) -> std::future<std::invoke_result_t<std::decay_t<Function>>> {
+        using Result = std::invoke_result_t<std::decay_t<Function>>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Jobs.emplace_back([task]() { (*task)(); });
+        }
+        m_JobAvailable.notify_one();
+        return future;
+    }
+
+    size_t GetWorkerCount() const { return m_Workers.size(); }
+
+private:
+    TaskPool();
+    ~TaskPool();
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void WorkerLoop();
+
+    std::vector<std::thread> m_Workers;
+    std::deque<std::function<void()>> m_Jobs;
+    std::mutex m_Mutex;
+    std::condition_variable m_JobAvailable;
+    bool m_Stopping = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include "TextureCacheFile.h"
+#include "TextureCompression.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <filesystem>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+namespace SockEngine {
+
+namespace {
+
+// Bumped whenever the cooker's output changes, so stale cooked files miss
+constexpr uint32_t COOK_VERSION = 1;
+
+constexpr uint32_t DDS_MAGIC = 0x20534444;  // "DDS "
+constexpr uint32_t DX10_FOURCC = 0x30315844; // "DX10"
+
+// Header flags: caps, height, width, pixel format, mip count and linear size are set
+constexpr uint32_t DDS_HEADER_FLAGS = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+constexpr uint32_t DDS_PIXEL_FORMAT_FOURCC = 0x4;
+constexpr uint32_t DDS_CAPS_TEXTURE = 0x1000 | 0x400000 | 0x8;  // Texture, mipmap, complex
+constexpr uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+// Guards against allocating garbage sizes from a corrupt file
+constexpr uint32_t MAX_DIMENSION = 16384;
+constexpr uint32_t MAX_MIP_COUNT = 15;
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+struct DDSPixelFormat {
+    uint32_t size = sizeof(DDSPixelFormat);
+    uint32_t flags = DDS_PIXEL_FORMAT_FOURCC;
+    uint32_t fourCC = DX10_FOURCC;
+    uint32_t rgbBitCount = 0;
+    uint32_t bitMasks[4] = {};
+};
+
+struct DDSHeader {
+    uint32_t size = sizeof(DDSHeader);
+    uint32_t flags = DDS_HEADER_FLAGS;
+    uint32_t height = 0;
+    uint32_t width = 0;
+    uint32_t linearSize = 0;
+    uint32_t depth = 0;
+    uint32_t mipCount = 0;
+    uint32_t reserved[11] = {};
+    DDSPixelFormat pixelFormat;
+    uint32_t caps = DDS_CAPS_TEXTURE;
+    uint32_t caps2 = 0;
+    uint32_t caps3 = 0;
+    uint32_t caps4 = 0;
+    uint32_t reserved2 = 0;
+};
+
+struct DDSHeaderDX10 {
+    uint32_t dxgiFormat = 0;
+    uint32_t dimension = DDS_DIMENSION_TEXTURE2D;
+    uint32_t miscFlags = 0;
+    uint32_t arraySize = 1;
+    uint32_t miscFlags2 = 0;
+};
+
+static_assert(sizeof(DDSHeader) == 124 && sizeof(DDSHeaderDX10) == 20);
+
+// DXGI_FORMAT values of the block formats
+uint32_t GetDXGIFormat(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::BC1: return 71;
+    case TextureFormat::BC3: return 77;
+    case TextureFormat::BC4: return 80;
+    case TextureFormat::BC5: return 83;
+    default: return 0;
+    }
+}
+
+TextureFormat GetTextureFormat(uint32_t dxgiFormat, int& components) {
+    switch (dxgiFormat) {
+    case 71: components = 3; return TextureFormat::BC1;
+    case 77: components = 4; return TextureFormat::BC3;
+    case 80: components = 1; return TextureFormat::BC4;
+    case 83: components = 2; return TextureFormat::BC5;
+    default: components = 0; return TextureFormat::Uncompressed;
+    }
+}
+
+uint64_t HashBytes(uint64_t hash, const unsigned char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+}
+
+namespace TextureCacheFile {
+
+uint64_t ComputeSourceHash(const unsigned char* data, size_t size, TextureUsage usage) {
+    uint64_t hash = HashBytes(FNV_OFFSET, data, size);
+    hash = HashBytes(hash, reinterpret_cast<const unsigned char*>(&usage), sizeof(usage));
+    hash = HashBytes(hash, reinterpret_cast<const unsigned char*>(&COOK_VERSION), sizeof(COOK_VERSION));
+    return hash;
+}
+
+std::string GetCachePath(uint64_t sourceHash) {
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.dds", static_cast<unsigned long long>(sourceHash));
+    return std::string(TEXTURE_CACHE_DIRECTORY) + fileName;
+}
+
+bool Write(const TextureImage& image, const std::string& path) {
+    if (!image.IsValid() || GetDXGIFormat(image.format) == 0) {
+        return false;
+    }
+
+    DDSHeader header;
+    header.width = static_cast<uint32_t>(image.GetWidth());
+    header.height = static_cast<uint32_t>(image.GetHeight());
+    header.linearSize = static_cast<uint32_t>(image.mips[0].size);
+    header.mipCount = static_cast<uint32_t>(image.mips.size());
+    DDSHeaderDX10 headerDX10;
+    headerDX10.dxgiFormat = GetDXGIFormat(image.format);
+
+    // Written aside and renamed, two workers cooking the same image never leave a torn file
+    static std::atomic<uint32_t> writeCount = 0;
+    std::string temporaryPath = path + "." + std::to_string(writeCount++) + ".tmp";
+    {
+        std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            return false;
+        }
+        stream.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char*>(&headerDX10), sizeof(headerDX10));
+        stream.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size());
+        if (!stream) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+TextureImage Read(const std::string& path) {
+    MappedFile file(path);
+    const size_t headerSize = sizeof(DDS_MAGIC) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10);
+    if (!file.IsOpen() || file.GetSize() < headerSize) {
+        return TextureImage();
+    }
+
+    uint32_t magic;
+    DDSHeader header;
+    DDSHeaderDX10 headerDX10;
+    std::memcpy(&magic, file.GetData(), sizeof(magic));
+    std::memcpy(&header, file.GetData() + sizeof(magic), sizeof(header));
+    std::memcpy(&headerDX10, file.GetData() + sizeof(magic) + sizeof(header), sizeof(headerDX10));
+    if (magic != DDS_MAGIC || header.size != sizeof(DDSHeader) || header.pixelFormat.fourCC != DX10_FOURCC ||
+        header.width == 0 || header.height == 0 || header.width > MAX_DIMENSION || header.height > MAX_DIMENSION ||
+        header.mipCount == 0 || header.mipCount > MAX_MIP_COUNT) {
+        return TextureImage();
+    }
+
+    TextureImage image;
+    image.format = GetTextureFormat(headerDX10.dxgiFormat, image.components);
+    if (image.format == TextureFormat::Uncompressed) {
+        return TextureImage();
+    }
+
+    // Level sizes follow from the dimensions, the file must hold all of them
+    size_t totalSize = 0;
+    int width = static_cast<int>(header.width);
+    int height = static_cast<int>(header.height);
+    for (uint32_t level = 0; level < header.mipCount; level++) {
+        TextureMip mip;
+        mip.width = width;
+        mip.height = height;
+        mip.offset = totalSize;
+        mip.size = TextureCompression::GetLevelSize(image.format, width, height, image.components);
+        totalSize += mip.size;
+        image.mips.push_back(mip);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    if (file.GetSize() - headerSize != totalSize) {
+        return TextureImage();
+    }
+
+    image.pixels.assign(file.GetData() + headerSize, file.GetData() + headerSize + totalSize);
+    return image;
+}
+
+}
+
+}
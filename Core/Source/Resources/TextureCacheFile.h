@@ -0,0 +1,33 @@
+#ifndef TEXTURE_CACHE_FILE_H
+#define TEXTURE_CACHE_FILE_H
+
+#include "TextureDecoder.h"
+#include <string>
+#include <cstdint>
+
+namespace SockEngine {
+
+// Cooked textures: the block compressed mip chain stored as a DDS file with a DX10 header, so the
+// cache can be inspected with any image tool. Loading one reads the levels as they are uploaded.
+namespace TextureCacheFile {
+
+    constexpr const char* TEXTURE_CACHE_DIRECTORY = "../Cache/Textures/";
+
+    // Identity of a cooked texture: FNV-1a over the source image's bytes and the usage it is cooked for
+    uint64_t ComputeSourceHash(const unsigned char* data, size_t size, TextureUsage usage);
+
+    // Cache files are named after the source hash, an edited image or another usage misses
+    std::string GetCachePath(uint64_t sourceHash);
+
+    // Writes a block compressed image. Returns false if the file could not be written.
+    bool Write(const TextureImage& image, const std::string& path);
+
+    // Returns the image, or an invalid one if the file is missing, truncated or not a format the
+    // cooker writes
+    TextureImage Read(const std::string& path);
+
+}
+
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include "TextureCompression.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+
+namespace SockEngine {
+
+namespace {
+
+// Iterations of the power method finding a block's principal color axis
+constexpr int PRINCIPAL_AXIS_ITERATIONS = 4;
+
+// RGBA texels of a 4x4 block, row by row
+struct Block {
+    unsigned char texels[16][4];
+};
+
+// Reads a block, repeating the last row and column past the edges of the level
+void ReadBlock(const unsigned char* pixels, int width, int height, int components, int blockX, int blockY, Block& block) {
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            int sourceX = std::min(blockX * 4 + x, width - 1);
+            int sourceY = std::min(blockY * 4 + y, height - 1);
+            const unsigned char* texel = pixels + (static_cast<size_t>(sourceY) * width + sourceX) * components;
+            unsigned char* output = block.texels[y * 4 + x];
+
+            // Same expansion as GL_RED, GL_RG and GL_RGB textures
+            output[0] = texel[0];
+            output[1] = components > 1 ? texel[1] : 0;
+            output[2] = components > 2 ? texel[2] : 0;
+            output[3] = components > 3 ? texel[3] : 255;
+        }
+    }
+}
+
+uint16_t PackColor565(const float color[3]) {
+    int r = std::clamp(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    int g = std::clamp(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    int b = std::clamp(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void UnpackColor565(uint16_t packed, int color[3]) {
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// Color block: two 565 endpoints along the principal axis of the texels and a 2 bit index per
+// texel into the four colors interpolated between them
+void EncodeColorBlock(const Block& block, unsigned char* output) {
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (const auto& texel : block.texels) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += texel[c];
+        }
+    }
+    for (float& value : mean) {
+        value /= 16.0f;
+    }
+
+    float covariance[6] = {};
+    for (const auto& texel : block.texels) {
+        float r = texel[0] - mean[0], g = texel[1] - mean[1], b = texel[2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int i = 0; i < PRINCIPAL_AXIS_ITERATIONS; i++) {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+        };
+        float length = std::max({ std::abs(next[0]), std::abs(next[1]), std::abs(next[2]) });
+        if (length == 0.0f) {
+            break;
+        }
+        for (int c = 0; c < 3; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    // Endpoints are the extreme projections of the texels on the axis
+    float minProjection = 0.0f, maxProjection = 0.0f;
+    for (const auto& texel : block.texels) {
+        float projection = (texel[0] - mean[0]) * axis[0] + (texel[1] - mean[1]) * axis[1] + (texel[2] - mean[2]) * axis[2];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    float axisLengthSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float maxEndpoint[3], minEndpoint[3];
+    for (int c = 0; c < 3; c++) {
+        maxEndpoint[c] = mean[c] + axis[c] * maxProjection / axisLengthSquared;
+        minEndpoint[c] = mean[c] + axis[c] * minProjection / axisLengthSquared;
+    }
+
+    // The first endpoint must be the larger one for the four color mode
+    uint16_t color0 = PackColor565(maxEndpoint);
+    uint16_t color1 = PackColor565(minEndpoint);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        UnpackColor565(color0, palette[0]);
+        UnpackColor565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* texel = block.texels[i];
+            int bestIndex = 0;
+            int bestDistance = INT32_MAX;
+            for (int index = 0; index < 4; index++) {
+                int dr = texel[0] - palette[index][0], dg = texel[1] - palette[index][1], db = texel[2] - palette[index][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = index;
+                }
+            }
+            indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+        }
+    }
+
+    std::memcpy(output, &color0, 2);
+    std::memcpy(output + 2, &color1, 2);
+    std::memcpy(output + 4, &indices, 4);
+}
+
+// Single channel block: two 8 bit endpoints and a 3 bit index per texel into the eight values
+// interpolated between them
+void EncodeChannelBlock(const Block& block, int channel, unsigned char* output) {
+    int minValue = 255, maxValue = 0;
+    for (const auto& texel : block.texels) {
+        minValue = std::min<int>(minValue, texel[channel]);
+        maxValue = std::max<int>(maxValue, texel[channel]);
+    }
+
+    // With the first endpoint larger, the eight value mode: endpoints, then six steps from the first
+    uint64_t indices = 0;
+    if (maxValue != minValue) {
+        int palette[8];
+        palette[0] = maxValue;
+        palette[1] = minValue;
+        for (int step = 1; step < 7; step++) {
+            palette[step + 1] = ((7 - step) * maxValue + step * minValue) / 7;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int value = block.texels[i][channel];
+            int bestIndex = 0;
+            int bestDistance = 256;
+            for (int index = 0; index < 8; index++) {
+                int distance = std::abs(value - palette[index]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = index;
+                }
+            }
+            indices |= static_cast<uint64_t>(bestIndex) << (i * 3);
+        }
+    }
+
+    output[0] = static_cast<unsigned char>(maxValue);
+    output[1] = static_cast<unsigned char>(minValue);
+    for (int i = 0; i < 6; i++) {
+        output[2 + i] = static_cast<unsigned char>(indices >> (i * 8));
+    }
+}
+
+size_t GetBlockSize(TextureFormat format) {
+    return format == TextureFormat::BC1 || format == TextureFormat::BC4 ? 8 : 16;
+}
+
+}
+
+namespace TextureCompression {
+
+TextureFormat ChooseFormat(const TextureImage& image, TextureUsage usage) {
+    if (usage == TextureUsage::Normal) {
+        return TextureFormat::BC5;
+    }
+    if (usage == TextureUsage::Mask) {
+        return TextureFormat::BC4;
+    }
+
+    // Keep alpha only if the image uses it
+    if (image.components == 4) {
+        const TextureMip& base = image.mips[0];
+        for (size_t i = base.offset + 3; i < base.offset + base.size; i += 4) {
+            if (image.pixels[i] != 255) {
+                return TextureFormat::BC3;
+            }
+        }
+    }
+    return TextureFormat::BC1;
+}
+
+size_t GetLevelSize(TextureFormat format, int width, int height, int components) {
+    if (format == TextureFormat::Uncompressed) {
+        return static_cast<size_t>(width) * height * components;
+    }
+    size_t blockCount = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+    return blockCount * GetBlockSize(format);
+}
+
+TextureImage Compress(const TextureImage& image, TextureFormat format) {
+    TextureImage compressed;
+    compressed.components = image.components;
+    compressed.format = format;
+
+    size_t totalSize = 0;
+    for (const auto& mip : image.mips) {
+        TextureMip level = mip;
+        level.offset = totalSize;
+        level.size = GetLevelSize(format, mip.width, mip.height, image.components);
+        totalSize += level.size;
+        compressed.mips.push_back(level);
+    }
+    compressed.pixels.resize(totalSize);
+
+    const size_t blockSize = GetBlockSize(format);
+    for (size_t level = 0; level < image.mips.size(); level++) {
+        const TextureMip& source = image.mips[level];
+        unsigned char* output = compressed.pixels.data() + compressed.mips[level].offset;
+        const int blocksX = (source.width + 3) / 4;
+        const int blocksY = (source.height + 3) / 4;
+
+        Block block;
+        for (int blockY = 0; blockY < blocksY; blockY++) {
+            for (int blockX = 0; blockX < blocksX; blockX++) {
+                ReadBlock(image.pixels.data() + source.offset, source.width, source.height, image.components, blockX, blockY, block);
+                switch (format) {
+                case TextureFormat::BC1:
+                    EncodeColorBlock(block, output);
+                    break;
+                case TextureFormat::BC3:
+                    EncodeChannelBlock(block, 3, output);
+                    EncodeColorBlock(block, output + 8);
+                    break;
+                case TextureFormat::BC4:
+                    EncodeChannelBlock(block, 0, output);
+                    break;
+                case TextureFormat::BC5:
+                    EncodeChannelBlock(block, 0, output);
+                    EncodeChannelBlock(block, 1, output + 8);
+                    break;
+                default:
+                    break;
+                }
+                output += blockSize;
+            }
+        }
+    }
+    return compressed;
+}
+
+}
+
+}
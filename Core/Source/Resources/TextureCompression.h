@@ -0,0 +1,27 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include "TextureDecoder.h"
+#include <cstddef>
+
+namespace SockEngine {
+
+// CPU encoders for the BCn block formats the GPU samples directly. Every 4x4 block of texels is
+// stored in 8 or 16 bytes, a quarter to an eighth of the uncompressed size.
+namespace TextureCompression {
+
+// Format an uncompressed image is cooked to for the usage
+TextureFormat ChooseFormat(const TextureImage& image, TextureUsage usage);
+
+// Bytes of one level of the format, blocks are padded to whole 4x4 texels
+size_t GetLevelSize(TextureFormat format, int width, int height, int components);
+
+// Block compresses every level of an uncompressed image. Texels are read the way GL samples the
+// uncompressed texture (a single channel reads as red), so the result looks the same on screen.
+TextureImage Compress(const TextureImage& image, TextureFormat format);
+
+}
+
+}
+
+#endif
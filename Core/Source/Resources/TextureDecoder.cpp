@@ -0,0 +1,241 @@
+#include "TextureDecoder.h"
+#include "TextureCompression.h"
+#include "TextureCacheFile.h"
+#include "MappedFile.h"
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <SOIL2/SOIL2.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_FILTER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace SockEngine {
+
+namespace {
+
+#ifdef MIP_FILTER_SSE
+
+// Four RGBA output pixels from eight pixels of two source rows. Widened to 16 bits so the
+// rounding matches the scalar (sum + 2) >> 2 exactly.
+inline void DownsampleRGBA4(const unsigned char* row0, const unsigned char* row1, unsigned char* output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+    const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 16));
+    const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+    const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 16));
+
+    // Vertical sums, two source pixels per register
+    __m128i v0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+    __m128i v1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+    __m128i v2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+    __m128i v3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+    // Horizontal sums, even pixels plus odd pixels
+    const __m128i rounding = _mm_set1_epi16(2);
+    __m128i sum01 = _mm_add_epi16(_mm_unpacklo_epi64(v0, v1), _mm_unpackhi_epi64(v0, v1));
+    __m128i sum23 = _mm_add_epi16(_mm_unpacklo_epi64(v2, v3), _mm_unpackhi_epi64(v2, v3));
+    sum01 = _mm_srli_epi16(_mm_add_epi16(sum01, rounding), 2);
+    sum23 = _mm_srli_epi16(_mm_add_epi16(sum23, rounding), 2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_packus_epi16(sum01, sum23));
+}
+
+#endif
+
+// Halves one level into the next, averaging 2x2 blocks. Odd edges repeat their last row or
+// column. Templated on the component count so the inner loop has a fixed stride; RGBA levels
+// are filtered four pixels at a time with SSE2 where available.
+template<int Components>
+void DownsampleLevel(const unsigned char* source, int sourceWidth, int sourceHeight,
+                     unsigned char* destination, int width, int height)
+{
+    const size_t sourceStride = static_cast<size_t>(sourceWidth) * Components;
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row0 = source + static_cast<size_t>(std::min(y * 2, sourceHeight - 1)) * sourceStride;
+        const unsigned char* row1 = source + static_cast<size_t>(std::min(y * 2 + 1, sourceHeight - 1)) * sourceStride;
+        unsigned char* output = destination + static_cast<size_t>(y) * width * Components;
+
+        int x = 0;
+#ifdef MIP_FILTER_SSE
+        // Only where both source columns exist, the odd edge goes through the scalar loop
+        if constexpr (Components == 4) {
+            const int pairedWidth = std::min(width, sourceWidth / 2);
+            for (; x + 4 <= pairedWidth; x += 4) {
+                DownsampleRGBA4(row0 + x * 8, row1 + x * 8, output + x * 4);
+            }
+        }
+#endif
+
+        for (; x < width; x++) {
+            const size_t x0 = static_cast<size_t>(std::min(x * 2, sourceWidth - 1)) * Components;
+            const size_t x1 = static_cast<size_t>(std::min(x * 2 + 1, sourceWidth - 1)) * Components;
+            for (int c = 0; c < Components; c++) {
+                unsigned int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                output[x * Components + c] = static_cast<unsigned char>((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+void DownsampleLevel(int components, const unsigned char* source, int sourceWidth, int sourceHeight,
+                     unsigned char* destination, int width, int height)
+{
+    switch (components) {
+    case 1: DownsampleLevel<1>(source, sourceWidth, sourceHeight, destination, width, height); break;
+    case 2: DownsampleLevel<2>(source, sourceWidth, sourceHeight, destination, width, height); break;
+    case 3: DownsampleLevel<3>(source, sourceWidth, sourceHeight, destination, width, height); break;
+    default: DownsampleLevel<4>(source, sourceWidth, sourceHeight, destination, width, height); break;
+    }
+}
+
+TextureImage MakeImage(const unsigned char* data, int width, int height, int components, bool generateMips)
+{
+    TextureImage image;
+    image.components = components;
+
+    TextureMip base;
+    base.width = width;
+    base.height = height;
+    base.size = static_cast<size_t>(width) * height * components;
+    image.mips.push_back(base);
+    image.pixels.assign(data, data + base.size);
+
+    if (generateMips) {
+        TextureDecoder::GenerateMips(image);
+    }
+    return image;
+}
+
+// Decodes an image file held in memory, returns an invalid image if it isn't a supported format
+TextureImage DecodeMemory(const unsigned char* encoded, size_t size, bool generateMips)
+{
+    int width, height, components;
+    unsigned char* data = SOIL_load_image_from_memory(encoded, static_cast<int>(size), &width, &height, &components, SOIL_LOAD_AUTO);
+    if (!data) {
+        return TextureImage();
+    }
+
+    TextureImage image = MakeImage(data, width, height, components, generateMips);
+    SOIL_free_image_data(data);
+    return image;
+}
+
+// Cooks a decoded image and stores it in the texture cache. The uncompressed image is returned if
+// it can't be compressed, so the texture still loads.
+TextureImage CookImage(TextureImage image, TextureUsage usage, uint64_t sourceHash)
+{
+    if (!image.IsValid()) {
+        return image;
+    }
+
+    TextureImage cooked = TextureCompression::Compress(image, TextureCompression::ChooseFormat(image, usage));
+    std::string cachePath = TextureCacheFile::GetCachePath(sourceHash);
+    std::error_code error;
+    std::filesystem::create_directories(TextureCacheFile::TEXTURE_CACHE_DIRECTORY, error);
+    if (!TextureCacheFile::Write(cooked, cachePath)) {
+        std::cout << "WARNING: Could not write texture cache file '" << cachePath << "'" << std::endl;
+    }
+    return cooked;
+}
+
+}
+
+namespace TextureDecoder {
+
+TextureImage DecodeFile(const std::string& path, bool generateMips)
+{
+    int width, height, components;
+    unsigned char* data = SOIL_load_image(path.c_str(), &width, &height, &components, SOIL_LOAD_AUTO);
+    if (!data) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return TextureImage();
+    }
+
+    TextureImage image = MakeImage(data, width, height, components, generateMips);
+    SOIL_free_image_data(data);
+    return image;
+}
+
+TextureImage DecodeEmbedded(const EmbeddedTexture& texture, bool generateMips)
+{
+    // Uncompressed format
+    if (texture.height != 0) {
+        return MakeImage(texture.data.data(), static_cast<int>(texture.width), static_cast<int>(texture.height), 4, generateMips);
+    }
+
+    // Compressed format
+    TextureImage image = DecodeMemory(texture.data.data(), texture.data.size(), generateMips);
+    if (!image.IsValid()) {
+        std::cout << "Embedded texture failed to load at path: " << texture.path << std::endl;
+    }
+    return image;
+}
+
+TextureImage CookFile(const std::string& path, TextureUsage usage)
+{
+    // The source is mapped once, hashed to find its cooked version and decoded only on a miss
+    MappedFile source(path);
+    if (!source.IsOpen()) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return TextureImage();
+    }
+
+    uint64_t sourceHash = TextureCacheFile::ComputeSourceHash(source.GetData(), source.GetSize(), usage);
+    TextureImage cooked = TextureCacheFile::Read(TextureCacheFile::GetCachePath(sourceHash));
+    if (cooked.IsValid()) {
+        return cooked;
+    }
+
+    TextureImage image = DecodeMemory(source.GetData(), source.GetSize(), true);
+    if (!image.IsValid()) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    }
+    return CookImage(std::move(image), usage, sourceHash);
+}
+
+TextureImage CookEmbedded(const EmbeddedTexture& texture, TextureUsage usage)
+{
+    uint64_t sourceHash = TextureCacheFile::ComputeSourceHash(texture.data.data(), texture.data.size(), usage);
+    TextureImage cooked = TextureCacheFile::Read(TextureCacheFile::GetCachePath(sourceHash));
+
+    // Raw texels only identify the image together with its dimensions
+    if (cooked.IsValid() && (texture.height == 0 || static_cast<uint32_t>(cooked.GetWidth()) == texture.width)) {
+        return cooked;
+    }
+    return CookImage(DecodeEmbedded(texture), usage, sourceHash);
+}
+
+void GenerateMips(TextureImage& image)
+{
+    if (image.mips.size() != 1) {
+        return;
+    }
+
+    // Lay out the whole chain first so the pixels are allocated once
+    size_t totalSize = image.mips[0].size;
+    while (image.mips.back().width > 1 || image.mips.back().height > 1) {
+        const TextureMip& previous = image.mips.back();
+        TextureMip mip;
+        mip.width = std::max(previous.width / 2, 1);
+        mip.height = std::max(previous.height / 2, 1);
+        mip.offset = totalSize;
+        mip.size = static_cast<size_t>(mip.width) * mip.height * image.components;
+        totalSize += mip.size;
+        image.mips.push_back(mip);
+    }
+    image.pixels.resize(totalSize);
+
+    for (size_t level = 1; level < image.mips.size(); level++) {
+        const TextureMip& source = image.mips[level - 1];
+        const TextureMip& mip = image.mips[level];
+        DownsampleLevel(image.components, image.pixels.data() + source.offset, source.width, source.height,
+                        image.pixels.data() + mip.offset, mip.width, mip.height);
+    }
+}
+
+}
+
+}
@@ -0,0 +1,80 @@
+#ifndef TEXTURE_DECODER_H
+#define TEXTURE_DECODER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace SockEngine {
+
+// Texture stored inside a model file. A height of 0 means data holds a compressed image
+// (PNG, JPG...), otherwise it holds width * height RGBA texels.
+struct EmbeddedTexture {
+    std::string path;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<unsigned char> data;
+};
+
+// Layout of TextureImage::pixels, either plain texels or 4x4 blocks of a BCn format
+enum class TextureFormat : uint32_t {
+    Uncompressed = 0,   // components bytes per texel
+    BC1,                // RGB, 8 bytes per block
+    BC3,                // RGBA, 16 bytes per block
+    BC4,                // R, 8 bytes per block
+    BC5                 // RG, 16 bytes per block
+};
+
+// What a texture holds, decides the format it is cooked to
+enum class TextureUsage : uint32_t {
+    Color,      // Diffuse and specular maps, BC1 or BC3 when it has transparent texels
+    Normal,     // Tangent space normals, BC5 storing X and Y only
+    Mask        // Single channel such as opacity, BC4
+};
+
+// One level of a TextureImage
+struct TextureMip {
+    int width = 0;
+    int height = 0;
+    size_t offset = 0;  // Into TextureImage::pixels
+    size_t size = 0;
+};
+
+// Decoded image with its mip chain, every level tightly packed one after the other, largest first.
+// An image that failed to decode has no mips.
+struct TextureImage {
+    std::vector<unsigned char> pixels;
+    std::vector<TextureMip> mips;
+    int components = 0;
+    TextureFormat format = TextureFormat::Uncompressed;
+
+    bool IsValid() const { return !mips.empty(); }
+    int GetWidth() const { return mips.empty() ? 0 : mips[0].width; }
+    int GetHeight() const { return mips.empty() ? 0 : mips[0].height; }
+};
+
+// Image decoding for the texture pipeline. Thread safe, called from the TaskPool.
+namespace TextureDecoder {
+
+// Decodes an image file. With generateMips the whole chain down to 1x1 is filtered on the CPU.
+TextureImage DecodeFile(const std::string& path, bool generateMips = true);
+
+// Decodes an image embedded in a model
+TextureImage DecodeEmbedded(const EmbeddedTexture& texture, bool generateMips = true);
+
+// Appends the mip chain of the image's single level with a 2x2 box filter
+void GenerateMips(TextureImage& image);
+
+// Loads the cooked image of a file from the texture cache: mips filtered and block compressed for
+// the usage. Images that aren't cached yet are decoded, cooked and written to the cache first.
+TextureImage CookFile(const std::string& path, TextureUsage usage);
+
+// Same for an image embedded in a model
+TextureImage CookEmbedded(const EmbeddedTexture& texture, TextureUsage usage);
+
+}
+
+}
+
+#endif
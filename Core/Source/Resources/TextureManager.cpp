@@ -0,0 +1,658 @@
+#include "TextureManager.h"
+#include "TaskPool.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+
+namespace SockEngine {
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+// Size of the persistently mapped staging ring, larger images are uploaded from memory
+constexpr size_t STAGING_BUFFER_SIZE = 64 * 1024 * 1024;
+
+// Alignment of the staging regions, enough for any unpack offset
+constexpr size_t STAGING_ALIGNMENT = 256;
+
+// Largest dimension of the levels a texture starts with, finer levels are streamed in on request
+constexpr int INITIAL_LEVEL_SIZE = 64;
+
+uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<const unsigned char*>(data)[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+GLenum GetFormat(int components) {
+    if (components == 1) {
+        return GL_RED;
+    }
+    else if (components == 2) {
+        return GL_RG;
+    }
+    else if (components == 4) {
+        return GL_RGBA;
+    }
+    return GL_RGB;
+}
+
+GLenum GetCompressedFormat(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TextureFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TextureFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+    case TextureFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    default: return 0;
+    }
+}
+
+GLenum GetInternalFormat(int components) {
+    if (components == 1) {
+        return GL_R8;
+    }
+    else if (components == 2) {
+        return GL_RG8;
+    }
+    else if (components == 4) {
+        return GL_RGBA8;
+    }
+    return GL_RGB8;
+}
+
+template<typename T>
+bool IsReady(const std::future<T>& future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+}
+
+TextureHandle::~TextureHandle() {
+    TextureManager::Get().Release(m_Key, m_ID, m_Size);
+}
+
+TextureManager& TextureManager::Get() {
+    static TextureManager instance;
+    return instance;
+}
+
+TextureManager::TextureManager() {
+    // Created first so the decode and copy jobs still queued finish before the textures go away
+    TaskPool::Get();
+}
+
+uint64_t TextureManager::HashPath(const std::string& path, TextureUsage usage) {
+    // The same file reached through different relative paths gets the same key
+    std::error_code error;
+    std::filesystem::path absolute = std::filesystem::absolute(path, error);
+    std::string normalized = (error ? std::filesystem::path(path) : absolute).lexically_normal().generic_string();
+    uint64_t hash = HashBytes(FNV_OFFSET, normalized.data(), normalized.size());
+
+    // An image used both as a normal map and as a colour map is cooked to two formats
+    return HashBytes(hash, &usage, sizeof(usage));
+}
+
+uint64_t TextureManager::HashData(const void* data, size_t size, TextureUsage usage) {
+    // Tagged so an image never shares a key with a path of the same bytes
+    uint64_t hash = HashBytes(FNV_OFFSET, "data:", 5);
+    hash = HashBytes(hash, data, size);
+    return HashBytes(hash, &usage, sizeof(usage));
+}
+
+TextureRef TextureManager::Find(uint64_t key) const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto it = m_Textures.find(key);
+    if (it == m_Textures.end()) {
+        return nullptr;
+    }
+
+    TextureRef texture = it->second.lock();
+    if (texture) {
+        m_HitCount++;
+    }
+    return texture;
+}
+
+TextureRef TextureManager::Load(uint64_t key, const std::string& path, TextureUsage usage) {
+    if (m_CompressionEnabled && GLAD_GL_EXT_texture_compression_s3tc) {
+        return Stream(key, [path, usage]() { return TextureDecoder::CookFile(path, usage); });
+    }
+    return Stream(key, [path]() { return TextureDecoder::DecodeFile(path); });
+}
+
+TextureRef TextureManager::Load(uint64_t key, std::shared_ptr<const EmbeddedTexture> embedded, TextureUsage usage) {
+    if (m_CompressionEnabled && GLAD_GL_EXT_texture_compression_s3tc) {
+        return Stream(key, [embedded, usage]() { return TextureDecoder::CookEmbedded(*embedded, usage); });
+    }
+    return Stream(key, [embedded]() { return TextureDecoder::DecodeEmbedded(*embedded); });
+}
+
+template<typename Decode>
+TextureRef TextureManager::Stream(uint64_t key, Decode&& decode) {
+    if (TextureRef existing = Find(key)) {
+        return existing;
+    }
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    std::shared_ptr<TextureHandle> texture = Insert(key, textureID);
+    texture->m_Source = std::forward<Decode>(decode);
+
+    // Loading until Finish, so no request streams the coarse levels in a second time meanwhile
+    texture->m_Loading = true;
+
+    StreamingTexture streaming;
+    streaming.texture = texture;
+    streaming.decode = TaskPool::Get().Submit(texture->m_Source);
+    m_Streaming.push_back(std::move(streaming));
+    return texture;
+}
+
+TextureRef TextureManager::LoadCubemap(const std::vector<std::string>& faces) {
+    uint64_t key = HashBytes(FNV_OFFSET, "cubemap:", 8);
+    for (const auto& face : faces) {
+        uint64_t faceKey = HashPath(face, TextureUsage::Color);
+        key = HashBytes(key, &faceKey, sizeof(faceKey));
+    }
+
+    if (TextureRef existing = Find(key)) {
+        return existing;
+    }
+
+    // Decode every face at once, the GPU filters the mips of the whole cube
+    std::vector<std::future<TextureImage>> decodes;
+    for (const auto& face : faces) {
+        decodes.push_back(TaskPool::Get().Submit([face]() { return TextureDecoder::DecodeFile(face, false); }));
+    }
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    size_t size = 0;
+    for (unsigned int i = 0; i < decodes.size(); i++) {
+        TextureImage image = decodes[i].get();
+        if (image.IsValid()) {
+            GLenum format = GetFormat(image.components);
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, image.GetWidth(), image.GetHeight(), 0, format,
+                         GL_UNSIGNED_BYTE, image.pixels.data());
+            size += image.pixels.size() * 4 / 3;
+        }
+        else {
+            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    std::shared_ptr<TextureHandle> texture = Insert(key, textureID);
+    texture->m_Size = size;
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_TextureMemory += size;
+    return texture;
+}
+
+void TextureManager::RequestDetail(unsigned int id, float screenSize) {
+    auto it = m_StreamedTextures.find(id);
+    if (it == m_StreamedTextures.end()) {
+        return;
+    }
+    std::shared_ptr<TextureHandle> texture = it->second.lock();
+    if (!texture) {
+        return;
+    }
+
+    // One texel per pixel: every halving of the size on screen needs one level less
+    const int levelCount = static_cast<int>(texture->m_LevelSizes.size());
+    const float texels = static_cast<float>(std::max(texture->m_Width, texture->m_Height));
+    int level = levelCount - 1;
+    if (screenSize >= 1.0f) {
+        level = std::clamp(static_cast<int>(std::floor(std::log2(texels / screenSize))), 0, levelCount - 1);
+    }
+
+    // The finest level asked for by any mesh this frame wins
+    if (texture->m_LastRequestFrame != m_Frame) {
+        texture->m_LastRequestFrame = m_Frame;
+        texture->m_WantedLevel = level;
+    }
+    else {
+        texture->m_WantedLevel = std::min(texture->m_WantedLevel, level);
+    }
+}
+
+void TextureManager::Update() {
+    DeleteReleasedTextures();
+    ReclaimStaging(false);
+    UpdateRequests();
+
+    for (auto it = m_Streaming.begin(); it != m_Streaming.end();) {
+        if (Advance(*it, false)) {
+            Finish(*it);
+            it = m_Streaming.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    // Requests made while rendering this frame are handled by the next update
+    m_Frame++;
+}
+
+void TextureManager::Flush() {
+    while (!m_Streaming.empty()) {
+        Advance(m_Streaming.front(), true);
+        Finish(m_Streaming.front());
+        m_Streaming.pop_front();
+    }
+    DeleteReleasedTextures();
+}
+
+void TextureManager::Shutdown() {
+    // The pool may still be writing into the ring
+    for (auto& streaming : m_Streaming) {
+        if (streaming.copy.valid()) {
+            streaming.copy.wait();
+        }
+    }
+    m_Streaming.clear();
+    m_StreamedTextures.clear();
+    m_PendingMemory = 0;
+    DeleteReleasedTextures();
+
+    for (auto& region : m_StagingRegions) {
+        if (region.fence) {
+            glDeleteSync(region.fence);
+        }
+    }
+    m_StagingRegions.clear();
+
+    if (m_StagingBuffer != 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_StagingBuffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &m_StagingBuffer);
+        m_StagingBuffer = 0;
+        m_StagingData = nullptr;
+        m_StagingSize = 0;
+    }
+}
+
+bool TextureManager::Advance(StreamingTexture& streaming, bool wait) {
+    // Decode and mip filtering on the pool
+    if (!streaming.image) {
+        if (!wait && !IsReady(streaming.decode)) {
+            return false;
+        }
+        streaming.image = std::make_shared<TextureImage>(streaming.decode.get());
+    }
+
+    // Copy into the staging ring on the pool, then the GL thread issues the copies to the texture.
+    // The region is fenced even if the texture was dropped meanwhile, so it is reclaimed in order.
+    if (streaming.copy.valid()) {
+        if (!wait && !IsReady(streaming.copy)) {
+            return false;
+        }
+        streaming.copy.get();
+
+        if (std::shared_ptr<TextureHandle> texture = streaming.texture.lock()) {
+            UploadImage(*texture, *streaming.image, streaming, true);
+        }
+        FenceStaging(streaming.stagingOffset);
+        return true;
+    }
+
+    // Released before it was streamed in, or failed to decode and stays an empty texture object
+    std::shared_ptr<TextureHandle> texture = streaming.texture.lock();
+    if (!texture || !streaming.image->IsValid()) {
+        if (texture) {
+            texture->m_Source = nullptr;
+        }
+        return true;
+    }
+
+    const TextureImage& image = *streaming.image;
+    const int levelCount = static_cast<int>(image.mips.size());
+    if (texture->m_LevelSizes.empty()) {
+        // New texture, it takes the layout of the image and starts with the coarse levels
+        texture->m_Width = image.GetWidth();
+        texture->m_Height = image.GetHeight();
+        texture->m_Components = image.components;
+        texture->m_Format = image.format;
+        texture->m_MinimumLevel = 0;
+        for (const auto& mip : image.mips) {
+            texture->m_LevelSizes.push_back(mip.size);
+        }
+        while (texture->m_MinimumLevel < levelCount - 1 &&
+               std::max(image.mips[texture->m_MinimumLevel].width, image.mips[texture->m_MinimumLevel].height) > INITIAL_LEVEL_SIZE) {
+            texture->m_MinimumLevel++;
+        }
+        texture->m_ResidentLevel = levelCount;
+        texture->m_WantedLevel = texture->m_MinimumLevel;
+        streaming.firstLevel = texture->m_MinimumLevel;
+        streaming.lastLevel = levelCount;
+        if (texture->m_MinimumLevel > 0) {
+            m_StreamedTextures[texture->m_ID] = texture;
+        }
+    }
+    else if (levelCount != static_cast<int>(texture->m_LevelSizes.size()) || image.GetWidth() != texture->m_Width ||
+             image.GetHeight() != texture->m_Height || image.format != texture->m_Format) {
+        // The source changed since the texture was created, it keeps the levels it has
+        texture->m_Source = nullptr;
+        return true;
+    }
+
+    const TextureMip& first = image.mips[streaming.firstLevel];
+    const TextureMip& last = image.mips[streaming.lastLevel - 1];
+    const size_t size = last.offset + last.size - first.offset;
+    if (!ReserveStaging(size, streaming.stagingOffset)) {
+        if (!wait && size <= m_StagingSize) {
+            return false;   // Ring full, retried next frame
+        }
+
+        // Too large for the ring, no persistent mapping, or waited on while the ring is full
+        UploadImage(*texture, image, streaming, false);
+        return true;
+    }
+
+    unsigned char* destination = m_StagingData + streaming.stagingOffset;
+    const unsigned char* source = image.pixels.data() + first.offset;
+    std::shared_ptr<const TextureImage> keepAlive = streaming.image;
+    streaming.copy = TaskPool::Get().Submit([destination, source, size, keepAlive]() {
+        std::memcpy(destination, source, size);
+    });
+    return wait ? Advance(streaming, true) : false;
+}
+
+void TextureManager::Finish(StreamingTexture& streaming) {
+    m_PendingMemory -= streaming.reservedMemory;
+    if (std::shared_ptr<TextureHandle> texture = streaming.texture.lock()) {
+        texture->m_Loading = false;
+    }
+}
+
+void TextureManager::UploadImage(TextureHandle& texture, const TextureImage& image, StreamingTexture& streaming, bool fromStaging) {
+    const GLenum format = GetFormat(image.components);
+    const GLenum compressedFormat = GetCompressedFormat(image.format);
+    const size_t firstOffset = image.mips[streaming.firstLevel].offset;
+    const bool isNew = texture.m_Size == 0;
+
+    glBindTexture(GL_TEXTURE_2D, texture.m_ID);
+
+    // Levels are tightly packed, rows of one or three components are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (fromStaging) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_StagingBuffer);
+    }
+    size_t size = 0;
+    for (int level = streaming.firstLevel; level < streaming.lastLevel; level++) {
+        const TextureMip& mip = image.mips[level];
+        const void* pixels = fromStaging ? reinterpret_cast<const void*>(streaming.stagingOffset + mip.offset - firstOffset)
+                                         : image.pixels.data() + mip.offset;
+        if (compressedFormat != 0) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat, mip.width, mip.height, 0,
+                                   static_cast<GLsizei>(mip.size), pixels);
+        }
+        else {
+            glTexImage2D(GL_TEXTURE_2D, level, GetInternalFormat(image.components), mip.width, mip.height, 0,
+                         format, GL_UNSIGNED_BYTE, pixels);
+        }
+        size += mip.size;
+    }
+    if (fromStaging) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // The storage is defined level by level so the finest ones can be added and dropped, sampling
+    // is limited to the resident levels by the base level
+    if (isNew) {
+        const GLsizei levelCount = static_cast<GLsizei>(image.mips.size());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, streaming.firstLevel);
+    texture.m_ResidentLevel = streaming.firstLevel;
+
+    texture.m_Size += size;
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_TextureMemory += size;
+}
+
+void TextureManager::UpdateRequests() {
+    for (auto it = m_StreamedTextures.begin(); it != m_StreamedTextures.end();) {
+        std::shared_ptr<TextureHandle> texture = it->second.lock();
+        if (!texture) {
+            it = m_StreamedTextures.erase(it);
+            continue;
+        }
+        ++it;
+        if (texture->m_Loading || !texture->m_Source || texture->m_LastRequestFrame != m_Frame ||
+            texture->m_WantedLevel >= texture->m_ResidentLevel) {
+            continue;
+        }
+
+        // Stream in as much of the request as the budget allows, giving up the finest levels first
+        int firstLevel = texture->m_WantedLevel;
+        size_t size = 0;
+        for (int level = firstLevel; level < texture->m_ResidentLevel; level++) {
+            size += texture->m_LevelSizes[level];
+        }
+        while (firstLevel < texture->m_ResidentLevel && !Evict(size)) {
+            size -= texture->m_LevelSizes[firstLevel++];
+        }
+        if (firstLevel == texture->m_ResidentLevel) {
+            continue;
+        }
+
+        StreamingTexture streaming;
+        streaming.texture = texture;
+        streaming.decode = TaskPool::Get().Submit(texture->m_Source);
+        streaming.firstLevel = firstLevel;
+        streaming.lastLevel = texture->m_ResidentLevel;
+        streaming.reservedMemory = size;
+        m_PendingMemory += size;
+        texture->m_Loading = true;
+        m_Streaming.push_back(std::move(streaming));
+    }
+
+    // The budget may have been lowered
+    Evict(0);
+}
+
+bool TextureManager::Evict(size_t needed) {
+    auto fits = [this, needed]() { return GetTextureMemory() + m_PendingMemory + needed <= m_MemoryBudget; };
+    if (fits()) {
+        return true;
+    }
+
+    std::vector<std::shared_ptr<TextureHandle>> candidates;
+    for (const auto& [id, weakTexture] : m_StreamedTextures) {
+        std::shared_ptr<TextureHandle> texture = weakTexture.lock();
+        if (texture && !texture->m_Loading && texture->m_ResidentLevel < texture->m_MinimumLevel) {
+            candidates.push_back(std::move(texture));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a->m_LastRequestFrame < b->m_LastRequestFrame;
+    });
+
+    for (const auto& texture : candidates) {
+        // Levels requested this frame are in use, only finer ones can go
+        int limit = texture->m_MinimumLevel;
+        if (texture->m_LastRequestFrame == m_Frame) {
+            limit = std::min(texture->m_WantedLevel, limit);
+        }
+        int residentLevel = texture->m_ResidentLevel;
+        size_t memory = GetTextureMemory() + m_PendingMemory + needed;
+        while (residentLevel < limit && memory > m_MemoryBudget) {
+            memory -= texture->m_LevelSizes[residentLevel++];
+        }
+        if (residentLevel != texture->m_ResidentLevel) {
+            DropLevels(*texture, residentLevel);
+        }
+        if (fits()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TextureManager::DropLevels(TextureHandle& texture, int residentLevel) {
+    glBindTexture(GL_TEXTURE_2D, texture.m_ID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, residentLevel);
+
+    // Redefining a level as empty frees its memory, levels under the base level aren't sampled
+    size_t size = 0;
+    for (int level = texture.m_ResidentLevel; level < residentLevel; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        size += texture.m_LevelSizes[level];
+        m_EvictedLevelCount++;
+    }
+    texture.m_ResidentLevel = residentLevel;
+
+    texture.m_Size -= size;
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_TextureMemory -= size;
+}
+
+bool TextureManager::ReserveStaging(size_t size, size_t& offset) {
+    if (!GLAD_GL_VERSION_4_4 || size > STAGING_BUFFER_SIZE) {
+        return false;
+    }
+
+    if (m_StagingBuffer == 0) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &m_StagingBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_StagingBuffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, STAGING_BUFFER_SIZE, nullptr, flags);
+        m_StagingData = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, STAGING_BUFFER_SIZE, flags));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        m_StagingSize = m_StagingData ? STAGING_BUFFER_SIZE : 0;
+    }
+    if (size > m_StagingSize) {
+        return false;
+    }
+
+    size = (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    if (m_StagingRegions.empty()) {
+        offset = 0;
+    }
+    else {
+        // Free space is after the newest region up to the end, then from the start up to the oldest
+        size_t head = m_StagingRegions.back().offset + m_StagingRegions.back().size;
+        size_t tail = m_StagingRegions.front().offset;
+        if (head > tail && head + size <= m_StagingSize) {
+            offset = head;
+        }
+        else if (head > tail && size <= tail) {
+            offset = 0;
+        }
+        else if (head < tail && head + size <= tail) {
+            offset = head;
+        }
+        else {
+            return false;
+        }
+    }
+
+    StagingRegion region;
+    region.offset = offset;
+    region.size = size;
+    m_StagingRegions.push_back(region);
+    return true;
+}
+
+void TextureManager::FenceStaging(size_t offset) {
+    for (auto& region : m_StagingRegions) {
+        if (region.offset == offset && !region.fence) {
+            region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            return;
+        }
+    }
+}
+
+void TextureManager::ReclaimStaging(bool wait) {
+    while (!m_StagingRegions.empty() && m_StagingRegions.front().fence) {
+        GLsync fence = m_StagingRegions.front().fence;
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+            return;
+        }
+
+        glDeleteSync(fence);
+        m_StagingRegions.pop_front();
+    }
+}
+
+std::shared_ptr<TextureHandle> TextureManager::Insert(uint64_t key, unsigned int id) {
+    auto texture = std::make_shared<TextureHandle>(key, id);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_GLThread = std::this_thread::get_id();
+    m_Textures[key] = texture;
+    m_CreateCount++;
+    return texture;
+}
+
+void TextureManager::Release(uint64_t key, unsigned int id, size_t size) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_TextureMemory -= size;
+
+    // A texture with the same key may have been created since the last reference started going away
+    auto it = m_Textures.find(key);
+    if (it != m_Textures.end() && it->second.expired()) {
+        m_Textures.erase(it);
+    }
+
+    // Only the GL thread can delete it right away, e.g. when a cancelled import is freed by its worker
+    if (std::this_thread::get_id() == m_GLThread) {
+        glDeleteTextures(1, &id);
+    }
+    else {
+        m_ReleasedTextures.push_back(id);
+    }
+}
+
+void TextureManager::DeleteReleasedTextures() {
+    std::vector<unsigned int> released;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        released.swap(m_ReleasedTextures);
+    }
+    if (!released.empty()) {
+        glDeleteTextures(static_cast<GLsizei>(released.size()), released.data());
+    }
+}
+
+size_t TextureManager::GetTextureCount() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Textures.size();
+}
+
+size_t TextureManager::GetTextureMemory() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_TextureMemory;
+}
+
+}
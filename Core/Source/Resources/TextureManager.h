@@ -0,0 +1,217 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include "TextureDecoder.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include <glad/gl.h>
+
+namespace SockEngine {
+
+// GPU texture owned by the TextureManager, deleted when the last reference goes away
+class TextureHandle {
+public:
+    TextureHandle(uint64_t key, unsigned int id) : m_Key(key), m_ID(id) {}
+    ~TextureHandle();
+
+    TextureHandle(const TextureHandle&) = delete;
+    TextureHandle& operator=(const TextureHandle&) = delete;
+
+    uint64_t GetKey() const { return m_Key; }
+    unsigned int GetID() const { return m_ID; }
+
+    // Bytes of GPU memory, zero until the texture has been streamed in
+    size_t GetSize() const { return m_Size; }
+    bool IsResident() const { return m_Size != 0; }
+
+    // Finest mip on the GPU, 0 once the full resolution is streamed in
+    int GetResidentLevel() const { return m_ResidentLevel; }
+
+private:
+    friend class TextureManager;
+
+    uint64_t m_Key;
+    unsigned int m_ID;
+    std::atomic<size_t> m_Size = 0;
+
+    // Mip streaming, GL thread only. Levels from m_ResidentLevel to the last are on the GPU.
+    std::function<TextureImage()> m_Source;     // Decodes the image again to stream finer levels in
+    std::vector<size_t> m_LevelSizes;
+    int m_Width = 0;
+    int m_Height = 0;
+    int m_Components = 0;
+    TextureFormat m_Format = TextureFormat::Uncompressed;
+    int m_ResidentLevel = 0;
+    int m_MinimumLevel = 0;                     // Coarsest resident level, never evicted
+    int m_WantedLevel = 0;
+    uint64_t m_LastRequestFrame = 0;
+    bool m_Loading = false;
+};
+
+// Shared texture, the GPU texture lives as long as any reference to it
+using TextureRef = std::shared_ptr<const TextureHandle>;
+
+// Engine-wide texture cache. Textures are keyed by the hash of their absolute path, or of their
+// content for textures embedded in a model, and of the usage that decides the format they are
+// cooked to, so every model and the skybox sharing an image for the same usage share a single
+// GPU texture. The cache only holds weak references: a texture is deleted as soon as its
+// last user releases it.
+//
+// Loads return a texture object right away and stream its content in: images are decoded and
+// their mips filtered on the TaskPool, then copied by the pool into a persistently mapped pixel
+// buffer ring. The GL thread only allocates the storage and issues the buffer to texture copies.
+// Until then the texture is incomplete and samples as black.
+//
+// Images are cooked to the BCn format of their usage the first time they load and read back from
+// the texture cache afterwards, block compressed with their mips.
+//
+// Only the coarse mips are loaded at first. The renderer requests the level each texture needs
+// from the projected size of the meshes using it, finer levels are streamed in while the memory
+// budget allows and the levels needed least recently are dropped to make room.
+class TextureManager {
+public:
+    // Global instance
+    static TextureManager& Get();
+
+    // Keys of a texture file and of an image stored in memory, loaded for the given usage
+    static uint64_t HashPath(const std::string& path, TextureUsage usage);
+    static uint64_t HashData(const void* data, size_t size, TextureUsage usage);
+
+    // Returns the texture if it is loaded or streaming, or nullptr. Any thread.
+    TextureRef Find(uint64_t key) const;
+
+    // Returns the texture of an image file, starting to stream it in if it isn't loaded. GL thread only.
+    TextureRef Load(uint64_t key, const std::string& path, TextureUsage usage = TextureUsage::Color);
+
+    // Same for an image embedded in a model
+    TextureRef Load(uint64_t key, std::shared_ptr<const EmbeddedTexture> embedded, TextureUsage usage = TextureUsage::Color);
+
+    // Loads a cube map from its six face files, shared by every caller with the same faces.
+    // The faces are decoded in parallel and the cube map is complete on return. GL thread only.
+    TextureRef LoadCubemap(const std::vector<std::string>& faces);
+
+    // Asks for the mip level a texture needs to be drawn about screenSize pixels wide this frame.
+    // Ignored for textures that aren't streamed. GL thread only.
+    void RequestDetail(unsigned int id, float screenSize);
+
+    // Streams in the requested levels, evicts over the budget, advances the streaming textures and
+    // deletes the ones released on other threads. Called once per frame on the GL thread.
+    void Update();
+
+    // Waits for every streaming texture and issues its copies. GL thread only.
+    void Flush();
+
+    // Releases the staging ring while the GL context is still alive
+    void Shutdown();
+
+    // Cooking can be turned off to load the source images uncompressed, it is off without S3TC support
+    void SetCompressionEnabled(bool enabled) { m_CompressionEnabled = enabled; }
+    bool IsCompressionEnabled() const { return m_CompressionEnabled; }
+
+    // GPU memory the streamed mips must fit in
+    void SetMemoryBudget(size_t bytes) { m_MemoryBudget = bytes; }
+    size_t GetMemoryBudget() const { return m_MemoryBudget; }
+
+    // Statistics
+    size_t GetTextureCount() const;
+    size_t GetTextureMemory() const;
+    size_t GetStreamingCount() const { return m_Streaming.size(); }
+    size_t GetCreateCount() const { return m_CreateCount; }
+    size_t GetHitCount() const { return m_HitCount; }
+    size_t GetEvictedLevelCount() const { return m_EvictedLevelCount; }
+
+private:
+    friend class TextureHandle;
+
+    TextureManager();
+    ~TextureManager() = default;
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    // Levels of a texture on their way to the GPU, all of them for a new texture
+    struct StreamingTexture {
+        std::weak_ptr<TextureHandle> texture;
+        std::future<TextureImage> decode;
+        std::shared_ptr<TextureImage> image;    // Set once decoded
+        std::future<void> copy;                 // Copy into the staging ring, when one was reserved
+        size_t stagingOffset = 0;
+        int firstLevel = 0;                     // Levels firstLevel to lastLevel - 1 are uploaded
+        int lastLevel = 0;
+        size_t reservedMemory = 0;              // Counted against the budget until uploaded
+    };
+
+    // Span of the staging ring read by copies the GPU may not have finished
+    struct StagingRegion {
+        size_t offset = 0;
+        size_t size = 0;
+        GLsync fence = nullptr;     // Null while the pool is still writing it
+    };
+
+    // Starts streaming a new texture decoded by the given job
+    template<typename Decode>
+    TextureRef Stream(uint64_t key, Decode&& decode);
+
+    // Moves a streaming texture forward, returns true once its copies are issued or it was dropped
+    bool Advance(StreamingTexture& streaming, bool wait);
+
+    // Gives back the budget reserved by a streaming texture that is done
+    void Finish(StreamingTexture& streaming);
+
+    // Defines the streamed levels of the texture and copies them, from the staging ring or from memory.
+    // A new texture takes the layout of the image and only its coarse levels.
+    void UploadImage(TextureHandle& texture, const TextureImage& image, StreamingTexture& streaming, bool fromStaging);
+
+    // Starts streaming in the requested levels that fit the budget, then evicts down to the budget
+    void UpdateRequests();
+
+    // Drops the finest resident levels of the least recently needed textures until needed bytes
+    // fit the budget. Levels requested this frame are kept. Returns false if they still don't fit.
+    bool Evict(size_t needed);
+    void DropLevels(TextureHandle& texture, int residentLevel);
+
+    // Staging ring, created on first use. Regions are reserved in order, fenced once their copies
+    // are issued and reclaimed from the oldest once the GPU is done with them.
+    bool ReserveStaging(size_t size, size_t& offset);
+    void FenceStaging(size_t offset);
+    void ReclaimStaging(bool wait);
+
+    // Called by the last reference of a texture
+    void Release(uint64_t key, unsigned int id, size_t size);
+    void DeleteReleasedTextures();
+
+    std::shared_ptr<TextureHandle> Insert(uint64_t key, unsigned int id);
+
+    mutable std::mutex m_Mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<TextureHandle>> m_Textures;
+    std::vector<unsigned int> m_ReleasedTextures;
+    std::thread::id m_GLThread;
+    size_t m_TextureMemory = 0;
+    std::atomic<size_t> m_CreateCount = 0;
+    mutable std::atomic<size_t> m_HitCount = 0;
+
+    // GL thread only
+    bool m_CompressionEnabled = true;
+    std::deque<StreamingTexture> m_Streaming;
+    std::unordered_map<unsigned int, std::weak_ptr<TextureHandle>> m_StreamedTextures;
+    size_t m_MemoryBudget = 512 * 1024 * 1024;
+    size_t m_PendingMemory = 0;
+    uint64_t m_Frame = 1;
+    size_t m_EvictedLevelCount = 0;
+    unsigned int m_StagingBuffer = 0;
+    unsigned char* m_StagingData = nullptr;
+    size_t m_StagingSize = 0;
+    std::deque<StagingRegion> m_StagingRegions;
+};
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "VertexPacking.h"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace SockEngine {
+
+namespace {
+
+// Smallest quantization scale, keeps flat meshes (e.g. a quad) from dividing by zero
+constexpr float MIN_QUANTIZATION_SCALE = 1e-6f;
+
+int16_t PackSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+float SignNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+}
+
+namespace VertexPacking {
+
+PositionQuantization ComputeQuantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    PositionQuantization quantization;
+    quantization.offset = (boundsMin + boundsMax) * 0.5f;
+    quantization.scale = glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(MIN_QUANTIZATION_SCALE));
+    return quantization;
+}
+
+PackedVertex PackVertex(const Vertex& vertex, const PositionQuantization& quantization) {
+    PackedVertex packed;
+    glm::vec3 position = (vertex.Position - quantization.offset) / quantization.scale;
+    packed.position[0] = PackSnorm16(position.x);
+    packed.position[1] = PackSnorm16(position.y);
+    packed.position[2] = PackSnorm16(position.z);
+
+    // Same handedness test the shaders did with the full bitangent
+    float sign = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+    packed.position[3] = PackSnorm16(sign);
+
+    glm::vec2 normal = EncodeOctahedral(vertex.Normal);
+    packed.normal[0] = PackSnorm16(normal.x);
+    packed.normal[1] = PackSnorm16(normal.y);
+    packed.texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+    packed.texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+    glm::vec2 tangent = EncodeOctahedral(vertex.Tangent);
+    packed.tangent[0] = PackSnorm16(tangent.x);
+    packed.tangent[1] = PackSnorm16(tangent.y);
+    return packed;
+}
+
+SkinVertex PackSkin(const Vertex& vertex) {
+    SkinVertex packed;
+    uint32_t boneIDs = PackBoneIDs(vertex.m_BoneIDs);
+
+    // Influences of bones that don't fit are dropped, the remaining ones are scaled up to the
+    // vertex's full weight so it isn't pulled toward the origin
+    float weights[MAX_BONE_INFLUENCE];
+    float influenceSum = 0.0f;
+    float keptSum = 0.0f;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        packed.boneIDs[i] = static_cast<uint8_t>(boneIDs >> (i * 8));
+        float weight = vertex.m_BoneIDs[i] >= 0 ? std::clamp(vertex.m_Weights[i], 0.0f, 1.0f) : 0.0f;
+        weights[i] = packed.boneIDs[i] == NO_BONE ? 0.0f : weight;
+        influenceSum += weight;
+        keptSum += weights[i];
+    }
+    if (keptSum > 0.0f && keptSum < influenceSum) {
+        for (float& weight : weights) {
+            weight *= influenceSum / keptSum;
+        }
+    }
+
+    // Round every weight, then give the rounding error to the largest so the total stays right
+    float weightSum = 0.0f;
+    int total = 0;
+    int largest = 0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        float weight = std::min(weights[i], 1.0f);
+        packed.weights[i] = static_cast<uint8_t>(std::lround(weight * 255.0f));
+        weightSum += weight;
+        total += packed.weights[i];
+        if (packed.weights[i] > packed.weights[largest]) {
+            largest = i;
+        }
+    }
+
+    int expected = std::min(static_cast<int>(std::lround(weightSum * 255.0f)), 255);
+    if (total > 0) {
+        packed.weights[largest] = static_cast<uint8_t>(std::clamp(packed.weights[largest] + expected - total, 0, 255));
+    }
+    return packed;
+}
+
+uint32_t PackBoneIDs(const int boneIDs[MAX_BONE_INFLUENCE]) {
+    uint32_t packed = 0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        bool fits = boneIDs[i] >= 0 && boneIDs[i] <= MAX_BONE_ID;
+        packed |= static_cast<uint32_t>(fits ? boneIDs[i] : NO_BONE) << (i * 8);
+    }
+    return packed;
+}
+
+glm::vec2 EncodeOctahedral(const glm::vec3& direction) {
+    float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (length == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+
+    // Project on the octahedron, then fold the lower half over the upper one
+    glm::vec3 projected = direction / length;
+    if (projected.z >= 0.0f) {
+        return glm::vec2(projected.x, projected.y);
+    }
+    return glm::vec2((1.0f - std::abs(projected.y)) * SignNotZero(projected.x),
+                     (1.0f - std::abs(projected.x)) * SignNotZero(projected.y));
+}
+
+}
+
+}
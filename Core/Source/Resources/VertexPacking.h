@@ -0,0 +1,60 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include "Mesh.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace SockEngine {
+
+// GPU vertex layouts. Meshes keep the float Vertex on the CPU for import, caching and bounds, and
+// upload it packed: every mesh gets a PackedVertex stream, skinned meshes a SkinVertex stream next
+// to it. The vertex shaders decode them, see DecodeOctahedral in Lighting.vert.
+namespace VertexPacking {
+
+    // Bone ID of an unused influence. Bone IDs above MAX_BONE_ID don't fit the 8 bit stream.
+    constexpr uint8_t NO_BONE = 255;
+    constexpr int MAX_BONE_ID = 254;
+
+    // 20 bytes, attributes 0 to 3
+    struct PackedVertex {
+        int16_t position[4];    // snorm16 in the mesh's bounds, w holds the bitangent sign
+        int16_t normal[2];      // snorm16 octahedral
+        uint16_t texCoords[2];  // half
+        int16_t tangent[2];     // snorm16 octahedral, the bitangent is cross(normal, tangent) * sign
+    };
+    static_assert(sizeof(PackedVertex) == 20);
+
+    // 8 bytes, attributes 5 and 6
+    struct SkinVertex {
+        uint8_t boneIDs[4];
+        uint8_t weights[4];     // unorm8
+    };
+    static_assert(sizeof(SkinVertex) == 8);
+
+    // Maps the snorm16 positions back to model space: position = offset + scale * packed
+    struct PositionQuantization {
+        glm::vec3 offset = glm::vec3(0.0f);
+        glm::vec3 scale = glm::vec3(1.0f);
+    };
+
+    // Quantization spanning the bounds, flat axes get a tiny scale instead of zero
+    PositionQuantization ComputeQuantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+    PackedVertex PackVertex(const Vertex& vertex, const PositionQuantization& quantization);
+
+    // Weights are rounded so their sum is kept. Influences of bones past MAX_BONE_ID are dropped
+    // and the others renormalized to the same sum.
+    SkinVertex PackSkin(const Vertex& vertex);
+
+    // Four bone IDs as they are laid out in SkinVertex, -1 and IDs that don't fit become NO_BONE
+    uint32_t PackBoneIDs(const int boneIDs[MAX_BONE_INFLUENCE]);
+
+    // Unit vector to the octahedral encoding, components in [-1, 1]
+    glm::vec2 EncodeOctahedral(const glm::vec3& direction);
+
+}
+
+}
+
+#endif
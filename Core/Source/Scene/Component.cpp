@@ -1,6 +1,11 @@
 #include "Component.h"
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
 
 namespace SockEngine {
 
@@ -124,12 +129,7 @@ glm::quat TransformComponent::GetWorldRotation(const entt::registry& registry) c
     return worldRotation;
 }
 
-void AnimatorComponent::Initialize(std::shared_ptr<Model> model, const std::string& animationPath) {
-    if (!model) {
-        std::cout << "ERROR: Cannot initialize AnimatorComponent without a valid model" << std::endl;
-        return;
-    }
-    
+void AnimatorComponent::Initialize(const Model& model, const std::string& animationPath) {
     try {
         // Extract bone information from the model
         ExtractBoneInfoFromModel(model);
@@ -139,7 +139,11 @@ void AnimatorComponent::Initialize(std::shared_ptr<Model> model, const std::stri
         }
         
         // Load the animation using the extracted bone info
-        currentAnimation = std::make_shared<Animation>(animationPath, boneInfoMap);
+        currentAnimation = AnimationLibrary::Get().Load(animationPath, boneInfoMap);
+        if (!currentAnimation) {
+            std::cout << "ERROR: Failed to load animation: " << animationPath << std::endl;
+            return;
+        }
         
         // Create the animator
         animator = std::make_unique<Animator>(currentAnimation.get());
@@ -163,14 +167,40 @@ void AnimatorComponent::LoadAnimation(const std::string& name, const std::string
         return;
     }
     
-    try {
-        auto animation = std::make_shared<Animation>(path, boneInfoMap);
-        animations[name] = animation;
-        animationPaths.push_back(path);
+    auto animation = AnimationLibrary::Get().Load(path, boneInfoMap);
+    if (!animation) {
+        std::cout << "ERROR: Failed to load animation '" << name << "' from: " << path << std::endl;
+        return;
     }
-    catch (const std::exception& e) {
-        std::cout << "ERROR: Failed to load animation '" << name << "': " << e.what() << std::endl;
+
+    animations[name] = animation;
+    animationPaths.push_back(path);
+}
+
+void AnimatorComponent::LoadAnimationAsync(const std::string& name, const std::string& path) {
+    if (boneInfoMap.empty()) {
+        std::cout << "ERROR: Cannot load animation without bone information. Initialize with a model first." << std::endl;
+        return;
+    }
+
+    pendingAnimations[name] = AnimationLibrary::Get().LoadAsync(path, boneInfoMap);
+    animationPaths.push_back(path);
+}
+
+void AnimatorComponent::LoadStreamedAnimation(const std::string& name, const std::string& path) {
+    if (boneInfoMap.empty()) {
+        std::cout << "ERROR: Cannot load animation without bone information. Initialize with a model first." << std::endl;
+        return;
     }
+
+    auto clip = AnimationStreamer::Get().Register(path, boneInfoMap);
+    if (!clip) {
+        std::cout << "ERROR: Failed to load animation '" << name << "' from: " << path << std::endl;
+        return;
+    }
+
+    streamedAnimations[name] = clip;
+    animationPaths.push_back(path);
 }
 
 void AnimatorComponent::Play() {
@@ -206,10 +236,13 @@ void AnimatorComponent::SetPlaybackSpeed(float speed) {
 }
 
 void AnimatorComponent::PlayAnimation(const std::string& animationName) {
-    auto it = animations.find(animationName);
-    if (it != animations.end()) {
-        currentAnimation = it->second;
+    std::shared_ptr<StreamedClip> stream;
+    AnimationRef animation = FindClip(animationName, stream);
+    if (animation) {
+        currentAnimation = animation;
         currentAnimationName = animationName;
+        currentStream = stream;
+        fadeSourceAnimation.reset();
         
         if (animator) {
             animator->PlayAnimation(currentAnimation.get());
@@ -218,25 +251,119 @@ void AnimatorComponent::PlayAnimation(const std::string& animationName) {
         currentTime = 0.0f;
         isPlaying = true;
     }
+    else if (stream) {
+        std::cout << "WARNING: Animation '" << animationName << "' is still being imported" << std::endl;
+    }
     else {
         std::cout << "WARNING: Animation '" << animationName << "' not found" << std::endl;
     }
 }
 
+void AnimatorComponent::CrossfadeTo(const std::string& animationName, float duration) {
+    std::shared_ptr<StreamedClip> stream;
+    AnimationRef animation = FindClip(animationName, stream);
+    if (!animation) {
+        std::cout << "WARNING: Animation '" << animationName << (stream ? "' is still being imported" : "' not found") << std::endl;
+        return;
+    }
+
+    // The animator only holds a pointer to the clip it fades out of
+    fadeSourceAnimation = currentAnimation;
+    currentAnimation = animation;
+    currentAnimationName = animationName;
+    currentStream = stream;
+    if (animator) {
+        animator->CrossfadeTo(currentAnimation.get(), duration);
+    }
+
+    currentTime = 0.0f;
+    isPlaying = true;
+}
+
+void AnimatorComponent::SetBlend(const std::vector<std::pair<std::string, float>>& weights) {
+    if (!animator) {
+        return;
+    }
+
+    std::vector<BlendInput> inputs;
+    for (const auto& [name, weight] : weights) {
+        auto it = animations.find(name);
+        if (it == animations.end()) {
+            std::cout << "WARNING: Animation '" << name << "' not found" << std::endl;
+            continue;
+        }
+
+        BlendInput input;
+        input.animation = it->second.get();
+        input.weight = weight;
+        inputs.push_back(input);
+
+        // The first clip drives playback
+        if (inputs.size() == 1) {
+            currentAnimation = it->second;
+            currentAnimationName = name;
+            currentStream.reset();
+        }
+    }
+
+    animator->SetBlendInputs(inputs);
+}
+
+int AnimatorComponent::AddLayer(const std::string& animationName, float weight, bool additive, const std::vector<std::string>& maskRoots) {
+    auto it = animations.find(animationName);
+    if (it == animations.end() || !animator) {
+        std::cout << "WARNING: Animation '" << animationName << "' not found" << std::endl;
+        return -1;
+    }
+
+    std::shared_ptr<const BoneMask> mask;
+    if (!maskRoots.empty()) {
+        mask = std::make_shared<BoneMask>(it->second->CreateBoneMask(maskRoots));
+    }
+
+    return animator->AddLayer(it->second.get(), weight, additive, mask);
+}
+
+void AnimatorComponent::SetLayerWeight(int layer, float weight) {
+    if (animator) {
+        animator->SetLayerWeight(layer, weight);
+    }
+}
+
+void AnimatorComponent::ClearLayers() {
+    if (animator) {
+        animator->ClearLayers();
+    }
+}
+
 bool AnimatorComponent::HasAnimation(const std::string& name) const {
-    return animations.find(name) != animations.end();
+    return animations.find(name) != animations.end() || streamedAnimations.find(name) != streamedAnimations.end();
 }
 
-void AnimatorComponent::Update(float deltaTime) {
+void AnimatorComponent::Update(float deltaTime, AnimationPoseCache* poseCache) {
+    if (!pendingAnimations.empty()) {
+        CollectPendingAnimations();
+    }
+
     if (!isPlaying || !animator || !currentAnimation) {
         return;
     }
     
     // Apply playback speed
     float scaledDeltaTime = deltaTime * playbackSpeed;
+
+    if (currentStream) {
+        UpdateStream(scaledDeltaTime);
+    }
     
     // Update the animator
-    UpdateAnimator(scaledDeltaTime);
+    UpdateAnimator(deltaTime, scaledDeltaTime, poseCache);
+    if (currentLOD != AnimationLOD::Paused) {
+        UpdateBounds();
+    } else if (pausedMotionAnimation != currentAnimation.get()) {
+        pausedMotionExtent = currentAnimation->ComputeRootMotionExtent();
+        pausedMotionAnimation = currentAnimation.get();
+    }
     
     // Handle time display and playback state
     if (isLooping) {
@@ -253,14 +380,14 @@ void AnimatorComponent::Update(float deltaTime) {
     }
 }
 
-std::vector<glm::mat4> AnimatorComponent::GetBoneMatrices() const {
+const std::vector<glm::mat4>& AnimatorComponent::GetBoneMatrices() const {
     if (animator) {
         return animator->GetFinalBoneMatrices();
     }
     
-    // Return identity matrices if no animator
-    std::vector<glm::mat4> identityMatrices(100, glm::mat4(1.0f));
-    return identityMatrices;
+    // Without a palette the shaders leave the vertices in bind pose
+    static const std::vector<glm::mat4> emptyPalette;
+    return emptyPalette;
 }
 
 float AnimatorComponent::GetDuration() const {
@@ -274,19 +401,240 @@ float AnimatorComponent::GetCurrentTime() const {
     return currentTime;
 }
 
-void AnimatorComponent::UpdateAnimator(float deltaTime) {
-    if (animator) {
-        animator->UpdateAnimation(deltaTime, isLooping);
+void AnimatorComponent::UpdateLOD(float distanceToCamera) {
+    AnimationLOD lod = AnimationLOD::Full;
+
+    if (enableLOD) {
+        if (!isVisible && !castsVisibleShadow && pauseWhenInvisible) {
+            lod = AnimationLOD::Paused;
+        } else if (!isVisible || distanceToCamera > lodMinimalRateDistance) {
+            // Shadow-only characters never need more than the minimal rate
+            lod = AnimationLOD::Minimal;
+        } else if (distanceToCamera > lodFullRateDistance) {
+            lod = AnimationLOD::Reduced;
+        }
+    }
+
+    if (lod != currentLOD) {
+        // Start the new LOD from a fresh pose instead of interpolating from a stale one
+        currentLOD = lod;
+        lodTimeSinceEvaluation = 0.0f;
+        if (animator) {
+            animator->ResetKeyPoses();
+        }
+    }
+
+    int level = 0;
+    if (enableLOD && enableSkeletonLOD) {
+        if (distanceToCamera > lodMinimalSkeletonDistance) {
+            level = 2;
+        } else if (distanceToCamera > lodReducedSkeletonDistance) {
+            level = 1;
+        }
+    }
+    SetSkeletonLOD(level);
+}
+
+void AnimatorComponent::SetSkeletonLOD(int level) {
+    int levelCount = skeletonLODs ? static_cast<int>(skeletonLODs->size()) : 0;
+    level = glm::clamp(level, 0, levelCount);
+    if (level == skeletonLOD || !animator) {
+        return;
     }
+
+    skeletonLOD = level;
+    lodTimeSinceEvaluation = 0.0f;
+    animator->SetSkeletonLOD(level > 0 ? &(*skeletonLODs)[level - 1] : nullptr);
+
+    // The palette was reset, so produce a pose for the new skeleton right away
+    animator->EvaluatePose();
+    UpdateBounds();
 }
 
-void AnimatorComponent::ExtractBoneInfoFromModel(std::shared_ptr<Model> model) {
-    if (!model) {
+void AnimatorComponent::UpdateBounds() {
+    hasBounds = skinnedBounds && animator &&
+                skinnedBounds->ComputeAABB(animator->GetFinalBoneMatrices(), skeletonLOD, boundsMin, boundsMax);
+}
+
+void AnimatorComponent::UpdateAnimator(float deltaTime, float scaledDeltaTime, AnimationPoseCache* poseCache) {
+    if (!animator) {
+        return;
+    }
+
+    // Only single looping clips share poses, a blended pose depends on more than clip and time
+    bool useSharedPose = sharePose && isLooping && poseCache && !animator->IsBlending();
+
+    // Time always advances so the animation stays in phase while throttled
+    if (!animator->AdvanceTime(scaledDeltaTime, isLooping)) {
+        return;
+    }
+
+    if (useSharedPose && currentLOD != AnimationLOD::Paused) {
+        UpdateSharedPose(*poseCache);
         return;
     }
 
+    switch (currentLOD) {
+        case AnimationLOD::Full:
+            animator->EvaluatePose();
+            break;
+
+        case AnimationLOD::Reduced:
+        case AnimationLOD::Minimal:
+        {
+            float rate = currentLOD == AnimationLOD::Reduced ? lodReducedUpdateRate : lodMinimalUpdateRate;
+            float interval = rate > 0.0f ? 1.0f / rate : 0.0f;
+
+            lodTimeSinceEvaluation += deltaTime;
+            if (!animator->HasKeyPoses() || lodTimeSinceEvaluation >= interval) {
+                lodTimeSinceEvaluation = interval > 0.0f ? fmod(lodTimeSinceEvaluation, interval) : 0.0f;
+                animator->EvaluateKeyPose();
+            }
+
+            // Minimal rate snaps between key poses, reduced rate blends them
+            if (currentLOD == AnimationLOD::Reduced && interval > 0.0f) {
+                animator->InterpolateKeyPoses(glm::min(lodTimeSinceEvaluation / interval, 1.0f));
+            }
+            break;
+        }
+
+        case AnimationLOD::Paused:
+            break;
+    }
+}
+
+void AnimatorComponent::CollectPendingAnimations() {
+    for (auto it = pendingAnimations.begin(); it != pendingAnimations.end();) {
+        if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+
+        if (auto animation = it->second.get()) {
+            animations[it->first] = animation;
+        } else {
+            std::cout << "ERROR: Failed to load animation '" << it->first << "'" << std::endl;
+        }
+        it = pendingAnimations.erase(it);
+    }
+}
+
+AnimationRef AnimatorComponent::FindClip(const std::string& name, std::shared_ptr<StreamedClip>& stream) {
+    auto it = animations.find(name);
+    if (it != animations.end()) {
+        stream.reset();
+        return it->second;
+    }
+
+    auto streamIt = streamedAnimations.find(name);
+    if (streamIt == streamedAnimations.end()) {
+        return nullptr;
+    }
+
+    // Start with the full clip if it is resident, otherwise with the head while it pages in.
+    // Neither exists until a clip without a clip file has been cooked.
+    stream = streamIt->second;
+    AnimationRef body = stream->Acquire();
+    return body ? body : stream->GetHead();
+}
+
+void AnimatorComponent::UpdateStream(float& scaledDeltaTime) {
+    AnimationRef body = currentStream->Acquire();
+    if (body) {
+        if (body != currentAnimation) {
+            currentAnimation = body;
+            animator->ReplaceAnimation(currentAnimation.get());
+        }
+        return;
+    }
+
+    // Still playing the head, hold its last pose instead of wrapping until the body arrives
+    float ticksPerSecond = currentAnimation->m_TicksPerSecond > 0 ? static_cast<float>(currentAnimation->m_TicksPerSecond) : 25.0f;
+    float remainingTicks = glm::max(currentAnimation->m_Duration - animator->m_CurrentTime - 1e-3f, 0.0f);
+    scaledDeltaTime = glm::min(scaledDeltaTime, remainingTicks / ticksPerSecond);
+}
+
+void AnimatorComponent::UpdateSharedPose(AnimationPoseCache& poseCache) {
+    // Bucket the playback time, every instance in the same bucket shows the bucket's start pose
+    float ticksPerSecond = currentAnimation->m_TicksPerSecond > 0 ? static_cast<float>(currentAnimation->m_TicksPerSecond) : 25.0f;
+    float quantum = glm::max(sharedPoseQuantum * ticksPerSecond, 1e-4f);
+    int64_t bucket = static_cast<int64_t>(std::floor(animator->m_CurrentTime / quantum));
+
+    const SkeletonLOD* skeleton = animator->GetSkeletonLOD();
+    const std::vector<glm::mat4>* palette = poseCache.Find(currentAnimation.get(), skeleton, bucket);
+    if (palette) {
+        // Copy rather than point at the cache, its palettes are recycled next frame
+        animator->m_FinalBoneMatrices = *palette;
+        animator->MarkPaletteChanged();
+        poseCache.RecordHit();
+    } else {
+        animator->EvaluatePoseAt(static_cast<float>(bucket) * quantum);
+        poseCache.Store(currentAnimation.get(), skeleton, bucket, animator->m_FinalBoneMatrices);
+    }
+}
+
+void AnimatorComponent::ExtractBoneInfoFromModel(const Model& model) {
     // Copy bone information from the model
-    boneInfoMap = model->GetBoneInfoMap();
+    boneInfoMap = model.GetBoneInfoMap();
+    skeletonLODs = model.GetSkeletonLODs();
+    skinnedBounds = model.GetSkinnedBounds();
+}
+
+void MorphTargetComponent::Initialize(const Model& model) {
+    names = model.GetMorphTargetNames();
+    weights.assign(names.size(), 0.0f);
 }
 
-}
\ No newline at end of file
+int MorphTargetComponent::FindTarget(const std::string& name) const {
+    auto it = std::find(names.begin(), names.end(), name);
+    return it != names.end() ? static_cast<int>(it - names.begin()) : -1;
+}
+
+void MorphTargetComponent::SetWeight(const std::string& name, float weight) {
+    int target = FindTarget(name);
+    if (target < 0) {
+        std::cout << "WARNING: Morph target '" << name << "' not found" << std::endl;
+        return;
+    }
+    weights[target] = weight;
+}
+
+void MorphTargetComponent::ResetWeights() {
+    std::fill(weights.begin(), weights.end(), 0.0f);
+}
+
+void CrowdComponent::Update(float deltaTime) {
+    if (isPlaying) {
+        time += deltaTime * playbackSpeed;
+    }
+}
+
+void CrowdComponent::Scatter(int count, float spacing, unsigned int seed) {
+    instances.clear();
+    instanceVersion++;
+    if (count <= 0) {
+        return;
+    }
+
+    int clipCount = bakedAnimation ? static_cast<int>(bakedAnimation->GetClips().size()) : 1;
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> clipDistribution(0, std::max(clipCount - 1, 0));
+    std::uniform_real_distribution<float> unitDistribution(0.0f, 1.0f);
+
+    // Square grid centred on the crowd entity, jittered so rows do not line up
+    int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    float extent = (columns - 1) * spacing * 0.5f;
+    instances.reserve(count);
+    for (int i = 0; i < count; i++) {
+        CrowdInstance instance;
+        glm::vec2 jitter = (glm::vec2(unitDistribution(random), unitDistribution(random)) - 0.5f) * spacing * 0.5f;
+        instance.position = glm::vec3((i % columns) * spacing - extent + jitter.x, 0.0f, (i / columns) * spacing - extent + jitter.y);
+        instance.yaw = unitDistribution(random) * glm::two_pi<float>();
+        instance.clip = clipDistribution(random);
+        instance.timeOffset = unitDistribution(random) * 10.0f;
+        instance.speed = 0.9f + unitDistribution(random) * 0.2f;
+        instances.push_back(instance);
+    }
+}
+
+}
@@ -3,10 +3,16 @@
 
 #include <entt/entt.hpp>
 #include "Resources/Model.h"
+#include "Resources/ModelManager.h"
 #include "Resources/Animation.h"
+#include "Resources/AnimationLibrary.h"
+#include "Resources/AnimationStreamer.h"
+#include "Resources/AnimationPoseCache.h"
 #include "Resources/AnimData.h"
+#include "Resources/BakedAnimation.h"
 #include <string>
 #include <memory>
+#include <future>
 #include <vector>
 #include <map>
 #include <glm/glm.hpp>
@@ -55,44 +61,113 @@ struct TransformComponent {
     glm::quat GetWorldRotation(const entt::registry& registry) const;
 };
 
-// Model component
+// Model component. The handle holds a reference on the model in the ModelManager, which the
+// scene releases when the component is removed.
 struct ModelComponent {
-    std::shared_ptr<Model> model;
+    ModelHandle model;
     std::string modelPath;
     float shininess = 32.0f;
     bool castShadows = true;
     bool receiveShadows = true;
+    std::vector<int> meshLODs;      // Detail level drawn for each mesh, picked by the renderer every frame
+};
+
+// Model being imported in the background. The entity stays a placeholder until the model and its
+// clip are ready, then the scene attaches the model (and its animator) and removes this component.
+struct PendingModelComponent {
+    ModelHandle model;
+    std::shared_future<AnimationRef> animation;     // Clip of a model that was already loaded
+    std::string modelPath;
+    std::string animationPath;
+};
+
+// Animation update rate chosen by distance and visibility
+enum class AnimationLOD {
+    Full,       // Evaluated every frame
+    Reduced,    // Evaluated at lodReducedUpdateRate, interpolated in between
+    Minimal,    // Evaluated at lodMinimalUpdateRate, no interpolation
+    Paused      // Not visible and casts no visible shadow, pose is frozen
 };
 
 // Animator component for skeletal animation
 struct AnimatorComponent {
-    // Animation data
-    std::shared_ptr<Animation> currentAnimation;
+    // Animation data (clips are shared through the AnimationLibrary)
+    AnimationRef currentAnimation;
     std::unique_ptr<Animator> animator;
-    std::map<std::string, std::shared_ptr<Animation>> animations; // Named animations
+    std::map<std::string, AnimationRef> animations; // Named animations
+    std::map<std::string, std::shared_future<AnimationRef>> pendingAnimations; // Clips still importing
+    std::map<std::string, std::shared_ptr<StreamedClip>> streamedAnimations;   // Clips paged in on demand
+    std::shared_ptr<StreamedClip> currentStream;    // Set while the current clip is streamed
+    AnimationRef fadeSourceAnimation;               // Keeps the crossfade source resident while it fades out
     
     // Bone information extracted from model
     BoneInfoMap boneInfoMap;
+    std::shared_ptr<const SkeletonLODSet> skeletonLODs; // Reduced skeletons generated by the model
+    std::shared_ptr<const SkinnedBounds> skinnedBounds; // Per-bone boxes generated by the model
     
     // Playback state
     bool isPlaying = true;
     bool isLooping = true;
     float playbackSpeed = 1.0f;
     float currentTime = 0.0f;
+    float crossfadeDuration = 0.25f;    // Seconds, used when switching clips from the editor
     std::string currentAnimationName = "";
     
     // Animation file paths for editor
     std::vector<std::string> animationPaths;
     int selectedAnimationIndex = 0;
+
+    // Animation LOD settings (distances in world units)
+    bool enableLOD = true;
+    float lodFullRateDistance = 1500.0f;    // Evaluate every frame inside this distance
+    float lodMinimalRateDistance = 5000.0f; // Use the minimal rate beyond this distance
+    float lodReducedUpdateRate = 15.0f;     // Pose evaluations per second between the two distances
+    float lodMinimalUpdateRate = 4.0f;      // Pose evaluations per second beyond the minimal rate distance
+    bool pauseWhenInvisible = true;         // Freeze the pose outside the camera and shadow frustums
+    float boundingRadius = 250.0f;          // Radius around the entity used for visibility tests until the pose has bounds
+    bool enableSkeletonLOD = true;          // Drop detail bones (fingers, face, twist) at a distance
+    float lodReducedSkeletonDistance = 2500.0f; // Use the reduced skeleton beyond this distance
+    float lodMinimalSkeletonDistance = 6000.0f; // Use the minimal skeleton beyond this distance
+
+    // Shared pose cache (opt-in). Looping instances of the same clip whose time falls in the same
+    // bucket reuse one evaluated palette per frame and snap to the bucket's start time.
+    bool sharePose = false;
+    float sharedPoseQuantum = 1.0f / 30.0f; // Bucket size in seconds
+
+    // LOD state, visibility is written by the renderer each frame
+    AnimationLOD currentLOD = AnimationLOD::Full;
+    int skeletonLOD = 0;                    // 0 is the full skeleton, then index + 1 into skeletonLODs
+    bool isVisible = true;
+    bool castsVisibleShadow = true;
+
+    // Model-space box around the skinned mesh in the current pose, refreshed whenever the pose changes
+    bool hasBounds = false;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    // While Paused the bounds stay frozen but time keeps advancing, so culling grows them by
+    // the current clip's root motion (see Animation::ComputeRootMotionExtent)
+    glm::vec3 pausedMotionExtent = glm::vec3(0.0f);
+    const Animation* pausedMotionAnimation = nullptr;  // Clip the extent was computed for
+    float lodTimeSinceEvaluation = 0.0f;
     
     // Constructor
     AnimatorComponent() = default;
     
     // Initialize with a model and animation
-    void Initialize(std::shared_ptr<Model> model, const std::string& animationPath);
+    void Initialize(const Model& model, const std::string& animationPath);
     
     // Load additional animations
     void LoadAnimation(const std::string& name, const std::string& path);
+
+    // Load an additional animation on a worker thread. It becomes available once the import finishes.
+    void LoadAnimationAsync(const std::string& name, const std::string& path);
+
+    // Register an animation whose keyframes are paged in when it is played and evicted when the
+    // AnimationStreamer runs over budget. Until they arrive the clip plays its resident head.
+    // A clip without a clip file is imported on a worker first and can't be played until it finishes.
+    // Streamed clips can be played and crossfaded to, but not used in blends or layers.
+    void LoadStreamedAnimation(const std::string& name, const std::string& path);
     
     // Playback controls
     void Play();
@@ -103,13 +178,24 @@ struct AnimatorComponent {
     
     // Animation switching
     void PlayAnimation(const std::string& animationName);
+    void CrossfadeTo(const std::string& animationName, float duration);
     bool HasAnimation(const std::string& name) const;
+
+    // Blending. SetBlend plays a weighted blend of the named clips, the first one drives playback.
+    // Layers are applied on top in order, optionally masked to the given bones and their children.
+    void SetBlend(const std::vector<std::pair<std::string, float>>& weights);
+    int AddLayer(const std::string& animationName, float weight, bool additive, const std::vector<std::string>& maskRoots = {});
+    void SetLayerWeight(int layer, float weight);
+    void ClearLayers();
     
-    // Update method (called each frame)
-    void Update(float deltaTime);
+    // Pick the LOD for this frame from the distance to the camera and last frame's visibility
+    void UpdateLOD(float distanceToCamera);
+
+    // Update method (called each frame). The pose cache is used if sharePose is enabled.
+    void Update(float deltaTime, AnimationPoseCache* poseCache = nullptr);
     
-    // Get bone matrices for rendering
-    std::vector<glm::mat4> GetBoneMatrices() const;
+    // Get bone matrices for rendering, empty if there is no animator
+    const std::vector<glm::mat4>& GetBoneMatrices() const;
     
     // Get animation info
     float GetDuration() const;
@@ -119,8 +205,59 @@ struct AnimatorComponent {
     float GetPlaybackSpeed() const { return playbackSpeed; }
     
 private:
-    void UpdateAnimator(float deltaTime);
-    void ExtractBoneInfoFromModel(std::shared_ptr<Model> model);
+    void UpdateAnimator(float deltaTime, float scaledDeltaTime, AnimationPoseCache* poseCache);
+    void UpdateSharedPose(AnimationPoseCache& poseCache);
+    AnimationRef FindClip(const std::string& name, std::shared_ptr<StreamedClip>& stream);
+    void UpdateStream(float& scaledDeltaTime);
+    void SetSkeletonLOD(int level);
+    void UpdateBounds();
+    void CollectPendingAnimations();
+    void ExtractBoneInfoFromModel(const Model& model);
+};
+
+// Blend shape weights of a model with morph targets. The skinning pass applies the nonzero
+// weights to the model's sparse deltas before skinning, so it needs an AnimatorComponent.
+struct MorphTargetComponent {
+    std::vector<std::string> names;     // Model-wide targets, see Model::GetMorphTargetNames
+    std::vector<float> weights;         // One per target, targets at zero cost nothing
+
+    void Initialize(const Model& model);
+    int FindTarget(const std::string& name) const;
+    void SetWeight(const std::string& name, float weight);
+    void ResetWeights();
+};
+
+// Character of a crowd, placed relative to the crowd entity
+struct CrowdInstance {
+    glm::vec3 position = glm::vec3(0.0f);
+    float yaw = 0.0f;               // Radians around the up axis
+    float scale = 1.0f;
+    int clip = 0;                   // Index into the baked clips
+    float timeOffset = 0.0f;        // Seconds, keeps instances playing the same clip out of step
+    float speed = 1.0f;
+};
+
+// Crowd of instanced characters animated entirely on the GPU. Each instance reads its palette
+// from the baked animation by (clip, frame), so the CPU only advances a single clock.
+struct CrowdComponent {
+    ModelHandle model;
+    std::string modelPath;
+    std::shared_ptr<const BakedAnimation> bakedAnimation;
+    std::vector<CrowdInstance> instances;
+
+    float time = 0.0f;
+    float playbackSpeed = 1.0f;
+    bool isPlaying = true;
+    float shininess = 32.0f;
+    bool castShadows = true;
+
+    // Bump after editing instances so the renderer uploads them again
+    uint32_t instanceVersion = 1;
+
+    void Update(float deltaTime);
+
+    // Replaces the instances with a grid of characters playing random clips at random phases
+    void Scatter(int count, float spacing, unsigned int seed = 0);
 };
 
 }
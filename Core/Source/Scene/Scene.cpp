@@ -1,9 +1,23 @@
 #include "Scene.h"
 #include "Component.h"
+#include "Resources/ModelManager.h"
+#include "Resources/TextureManager.h"
 #include <memory>
+#include <iostream>
+#include <chrono>
 
 namespace SockEngine {
 
+namespace {
+
+// Gives the component's model reference back to the ModelManager when it is removed or its entity destroyed
+template<typename Component>
+void ReleaseModelReference(entt::registry& registry, entt::entity entity) {
+    ModelManager::Get().Release(registry.get<Component>(entity).model);
+}
+
+}
+
 Scene::Scene(const std::string& name)
     : m_Name(name), m_EditorCamera(glm::vec3(0.0f, 90.0f, 0.0f))
 {
@@ -11,24 +25,75 @@ Scene::Scene(const std::string& name)
     entt::entity rootEntityHandle = m_Registry.CreateEntity("Scene Root");
     m_RootEntity = Entity(rootEntityHandle, &m_Registry);
     m_Registry.GetNativeRegistry().emplace<RelationshipComponent>(rootEntityHandle);
+
+    // Components holding a model handle own a reference on the model
+    auto& registry = m_Registry.GetNativeRegistry();
+    registry.on_destroy<ModelComponent>().connect<&ReleaseModelReference<ModelComponent>>();
+    registry.on_destroy<PendingModelComponent>().connect<&ReleaseModelReference<PendingModelComponent>>();
+    registry.on_destroy<CrowdComponent>().connect<&ReleaseModelReference<CrowdComponent>>();
 }
 
 Scene::~Scene() {
-    // The EnTT registry automatically cleans up all entities and components
+    // The EnTT registry automatically cleans up all entities and components, the model references
+    // are released here so the models can be evicted once no other scene uses them
+    auto& registry = m_Registry.GetNativeRegistry();
+    registry.on_destroy<ModelComponent>().disconnect<&ReleaseModelReference<ModelComponent>>();
+    registry.on_destroy<PendingModelComponent>().disconnect<&ReleaseModelReference<PendingModelComponent>>();
+    registry.on_destroy<CrowdComponent>().disconnect<&ReleaseModelReference<CrowdComponent>>();
+
+    ModelManager& modelManager = ModelManager::Get();
+    for (auto [entity, modelComponent] : registry.view<ModelComponent>().each()) {
+        modelManager.Release(modelComponent.model);
+    }
+    for (auto [entity, pending] : registry.view<PendingModelComponent>().each()) {
+        modelManager.Release(pending.model);
+    }
+    for (auto [entity, crowd] : registry.view<CrowdComponent>().each()) {
+        modelManager.Release(crowd.model);
+    }
 }
 
 void Scene::OnUpdate(float deltaTime) {
+    auto& registry = m_Registry.GetNativeRegistry();
+
+    // Shared poses are only valid for the frame they were evaluated in
+    m_PoseCache.BeginFrame();
+
+    // Swap in streamed clips that finished paging in, evict the ones over budget
+    AnimationStreamer::Get().Update();
+
+    // Upload background model imports within the frame budget, attach the ready ones
+    ModelLoader::Get().Update();
+    ModelManager::Get().Update(deltaTime);
+    UpdatePendingModels();
+
+    // Issue the copies of decoded textures, delete the ones released on worker threads
+    TextureManager::Get().Update();
+
     // Update all entities with an ActiveComponent
-    auto view = m_Registry.GetNativeRegistry().view<ActiveComponent>();
+    auto view = registry.view<ActiveComponent>();
     for (auto entity : view) {
         auto& active = view.get<ActiveComponent>(entity);
         
         if (active.active) {
             // Scan and update each updatable component type that exists on this entity.
-            // Currently, only Animators are updatable.
-            if (m_Registry.GetNativeRegistry().all_of<AnimatorComponent>(entity)) {
-                auto& animator = m_Registry.GetNativeRegistry().get<AnimatorComponent>(entity);
-                animator.Update(deltaTime);
+            // Crowds only advance their clock, the poses are read from the baked animation.
+            if (registry.all_of<CrowdComponent>(entity)) {
+                registry.get<CrowdComponent>(entity).Update(deltaTime);
+            }
+
+            if (registry.all_of<AnimatorComponent>(entity)) {
+                auto& animator = registry.get<AnimatorComponent>(entity);
+
+                // Throttle the animation by distance to the camera
+                float distanceToCamera = 0.0f;
+                if (registry.all_of<TransformComponent>(entity)) {
+                    auto& transform = registry.get<TransformComponent>(entity);
+                    distanceToCamera = glm::distance(transform.GetWorldPosition(registry), m_EditorCamera.Position);
+                }
+                animator.UpdateLOD(distanceToCamera);
+
+                animator.Update(deltaTime, &m_PoseCache);
             }
         }
     }
@@ -120,10 +185,16 @@ Entity Scene::DuplicateEntityHierarchy(Entity entity, Entity parent) {
         dstModel.receiveShadows = srcModel.receiveShadows;
         
         // Share the model resource
-        dstModel.model = srcModel.model;
+        dstModel.model = ModelManager::Get().Acquire(srcModel.model);
         dstModel.modelPath = srcModel.modelPath;
     }
 
+    // A copy of a placeholder imports the model on its own
+    if (entity.HasComponent<PendingModelComponent>()) {
+        auto& srcPending = entity.GetComponent<PendingModelComponent>();
+        RequestModel(newEntity, srcPending.modelPath, srcPending.animationPath);
+    }
+
     // Copy animator component
     if (entity.HasComponent<AnimatorComponent>()) {
         auto& srcAnimator = entity.GetComponent<AnimatorComponent>();
@@ -133,8 +204,59 @@ Entity Scene::DuplicateEntityHierarchy(Entity entity, Entity parent) {
                             newEntity.AddComponent<AnimatorComponent>();
 
         dstAnimator.boneInfoMap = srcAnimator.boneInfoMap;
+        dstAnimator.skeletonLODs = srcAnimator.skeletonLODs;
+        dstAnimator.skinnedBounds = srcAnimator.skinnedBounds;
         dstAnimator.animationPaths = srcAnimator.animationPaths;
         dstAnimator.animations = srcAnimator.animations;
+        dstAnimator.pendingAnimations = srcAnimator.pendingAnimations;
+        dstAnimator.streamedAnimations = srcAnimator.streamedAnimations;
+        dstAnimator.isLooping = srcAnimator.isLooping;
+        dstAnimator.playbackSpeed = srcAnimator.playbackSpeed;
+        dstAnimator.crossfadeDuration = srcAnimator.crossfadeDuration;
+        dstAnimator.enableLOD = srcAnimator.enableLOD;
+        dstAnimator.lodFullRateDistance = srcAnimator.lodFullRateDistance;
+        dstAnimator.lodMinimalRateDistance = srcAnimator.lodMinimalRateDistance;
+        dstAnimator.lodReducedUpdateRate = srcAnimator.lodReducedUpdateRate;
+        dstAnimator.lodMinimalUpdateRate = srcAnimator.lodMinimalUpdateRate;
+        dstAnimator.pauseWhenInvisible = srcAnimator.pauseWhenInvisible;
+        dstAnimator.boundingRadius = srcAnimator.boundingRadius;
+        dstAnimator.enableSkeletonLOD = srcAnimator.enableSkeletonLOD;
+        dstAnimator.lodReducedSkeletonDistance = srcAnimator.lodReducedSkeletonDistance;
+        dstAnimator.lodMinimalSkeletonDistance = srcAnimator.lodMinimalSkeletonDistance;
+        dstAnimator.sharePose = srcAnimator.sharePose;
+        dstAnimator.sharedPoseQuantum = srcAnimator.sharedPoseQuantum;
+
+        // Clips are immutable and shared, so the duplicate only needs its own playback state
+        if (srcAnimator.currentAnimation) {
+            dstAnimator.currentAnimation = srcAnimator.currentAnimation;
+            dstAnimator.currentAnimationName = srcAnimator.currentAnimationName;
+            dstAnimator.currentStream = srcAnimator.currentStream;
+            dstAnimator.animator = std::make_unique<Animator>(dstAnimator.currentAnimation.get());
+        }
+    }
+    
+    // Copy morph target weights
+    if (entity.HasComponent<MorphTargetComponent>()) {
+        auto& srcMorphs = entity.GetComponent<MorphTargetComponent>();
+
+        auto& dstMorphs = newEntity.HasComponent<MorphTargetComponent>() ?
+                          newEntity.GetComponent<MorphTargetComponent>() :
+                          newEntity.AddComponent<MorphTargetComponent>();
+
+        dstMorphs = srcMorphs;
+    }
+    
+    // Copy crowd component, the model and baked animation are shared
+    if (entity.HasComponent<CrowdComponent>()) {
+        auto& srcCrowd = entity.GetComponent<CrowdComponent>();
+
+        auto& dstCrowd = newEntity.HasComponent<CrowdComponent>() ?
+                         newEntity.GetComponent<CrowdComponent>() :
+                         newEntity.AddComponent<CrowdComponent>();
+
+        dstCrowd = srcCrowd;
+        dstCrowd.model = ModelManager::Get().Acquire(srcCrowd.model);
+        dstCrowd.instanceVersion++;
     }
     
     // Set the parent
@@ -200,7 +322,7 @@ void Scene::DestroyEntity(Entity entity) {
     if (m_SelectedEntity == entity) {
         m_SelectedEntity = Entity();
     }
-    
+
     // Get all children before destroying the entity
     std::vector<Entity> children;
     if (entity.HasComponent<RelationshipComponent>()) {
@@ -242,6 +364,49 @@ void Scene::DestroyEntity(Entity entity) {
 }
 
 Entity Scene::LoadModel(const std::string& filepath, const std::string& animation, const glm::vec3& position, const glm::vec3& scale) {
+    Entity entity = CreateModelEntity(filepath, position, scale);
+    AttachModel(entity, ModelManager::Get().Load(filepath), filepath, animation);
+    return entity;
+}
+
+Entity Scene::LoadModelAsync(const std::string& filepath, const std::string& animation, const glm::vec3& position, const glm::vec3& scale) {
+    Entity entity = CreateModelEntity(filepath, position, scale);
+    RequestModel(entity, filepath, animation);
+    return entity;
+}
+
+void Scene::RequestModel(Entity entity, const std::string& filepath, const std::string& animation) {
+    if (!entity) {
+        return;
+    }
+
+    // A newer request replaces the one in flight
+    if (entity.HasComponent<PendingModelComponent>()) {
+        entity.RemoveComponent<PendingModelComponent>();
+    }
+
+    // Models already loaded by another entity are ready on the next update
+    auto& pending = entity.AddComponent<PendingModelComponent>();
+    pending.model = ModelManager::Get().LoadAsync(filepath, animation);
+    pending.modelPath = filepath;
+    pending.animationPath = animation;
+}
+
+void Scene::CancelModelLoad(Entity entity) {
+    if (!entity || !entity.HasComponent<PendingModelComponent>()) {
+        return;
+    }
+
+    // Releasing the last reference stops the import
+    entity.RemoveComponent<PendingModelComponent>();
+
+    bool placeholder = !entity.HasComponent<ModelComponent>() || !ModelManager::Get().Resolve(entity.GetComponent<ModelComponent>().model);
+    if (placeholder) {
+        DestroyEntity(entity);
+    }
+}
+
+Entity Scene::CreateModelEntity(const std::string& filepath, const glm::vec3& position, const glm::vec3& scale) {
     // Get model name
     std::string name = filepath.substr(filepath.find_last_of("/\\") + 1);
 
@@ -260,17 +425,136 @@ Entity Scene::LoadModel(const std::string& filepath, const std::string& animatio
     transform.localScale = scale;
     transform.localMatrixDirty = true;
     transform.worldMatrixDirty = true;
-    
-    // Add a model component
-    auto& modelComponent = entity.AddComponent<ModelComponent>();
-    modelComponent.model = std::make_shared<Model>(filepath);
+
+    return entity;
+}
+
+void Scene::AttachModel(Entity entity, ModelHandle model, const std::string& filepath, const std::string& animation) {
+    ModelManager& modelManager = ModelManager::Get();
+    Model* resolvedModel = modelManager.Resolve(model);
+    if (!resolvedModel) {
+        std::cout << "ERROR: Failed to load model: " << filepath << std::endl;
+        modelManager.Release(model);
+        return;
+    }
+
+    // Add a model component, or replace the model of an existing one
+    auto& modelComponent = entity.HasComponent<ModelComponent>() ?
+                           entity.GetComponent<ModelComponent>() :
+                           entity.AddComponent<ModelComponent>();
+    modelManager.Release(modelComponent.model);
+    modelComponent.model = model;
     modelComponent.modelPath = filepath;
 
+    // Animation and morph state belong to the previous model's skeleton and meshes
+    if (entity.HasComponent<AnimatorComponent>()) {
+        entity.RemoveComponent<AnimatorComponent>();
+    }
+    if (entity.HasComponent<MorphTargetComponent>()) {
+        entity.RemoveComponent<MorphTargetComponent>();
+    }
+
     if (!animation.empty()) {
         auto& animatorComponent = entity.AddComponent<AnimatorComponent>();
-        animatorComponent.Initialize(modelComponent.model, animation);
+        animatorComponent.Initialize(*resolvedModel, animation);
     }
-    
+
+    if (!resolvedModel->GetMorphTargetNames().empty()) {
+        entity.AddComponent<MorphTargetComponent>().Initialize(*resolvedModel);
+    }
+}
+
+void Scene::UpdatePendingModels() {
+    auto& registry = m_Registry.GetNativeRegistry();
+    ModelManager& modelManager = ModelManager::Get();
+
+    // Collected first, attaching and destroying change the view
+    std::vector<Entity> finished;
+    auto view = registry.view<PendingModelComponent>();
+    for (auto entityHandle : view) {
+        auto& pending = view.get<PendingModelComponent>(entityHandle);
+        ModelLoader::State state = modelManager.GetState(pending.model);
+        if (state == ModelLoader::State::Importing || state == ModelLoader::State::Uploading) {
+            continue;
+        }
+
+        // A model that was already loaded skipped the import warming its clip, import it in the background too
+        if (state == ModelLoader::State::Ready && !pending.animationPath.empty()) {
+            Model* model = modelManager.Resolve(pending.model);
+            if (!pending.animation.valid() && model->GetBoneCount() > 0) {
+                pending.animation = AnimationLibrary::Get().LoadAsync(pending.animationPath, model->GetBoneInfoMap());
+            }
+            if (pending.animation.valid() && pending.animation.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                continue;
+            }
+        }
+        finished.emplace_back(entityHandle, &m_Registry);
+    }
+
+    for (auto entity : finished) {
+        // Destroyed along with a failed parent
+        if (!entity || !entity.HasComponent<PendingModelComponent>()) {
+            continue;
+        }
+
+        // The model component takes its own reference before the pending one is released
+        PendingModelComponent pending = entity.GetComponent<PendingModelComponent>();
+        bool ready = modelManager.GetState(pending.model) == ModelLoader::State::Ready;
+        ModelHandle model = ready ? modelManager.Acquire(pending.model) : ModelHandle();
+        entity.RemoveComponent<PendingModelComponent>();
+
+        if (ready) {
+            AttachModel(entity, model, pending.modelPath, pending.animationPath);
+        } else if (!entity.HasComponent<ModelComponent>()) {
+            // Nothing to show for a placeholder whose model failed to load
+            DestroyEntity(entity);
+        }
+    }
+}
+
+Entity Scene::CreateCrowd(Entity source, int count, float spacing, float framesPerSecond) {
+    if (!source || !source.HasComponent<ModelComponent>() || !source.HasComponent<AnimatorComponent>()) {
+        std::cout << "WARNING: A crowd needs an animated model to bake" << std::endl;
+        return Entity();
+    }
+
+    auto& modelComponent = source.GetComponent<ModelComponent>();
+    auto& animatorComponent = source.GetComponent<AnimatorComponent>();
+
+    // Bake every clip the source has loaded, the current one first so it is clip 0
+    std::vector<std::pair<std::string, AnimationRef>> clips;
+    if (animatorComponent.currentAnimation) {
+        clips.emplace_back(animatorComponent.currentAnimationName, animatorComponent.currentAnimation);
+    }
+    for (const auto& [name, clip] : animatorComponent.animations) {
+        if (clip && clip != animatorComponent.currentAnimation) {
+            clips.emplace_back(name, clip);
+        }
+    }
+
+    std::shared_ptr<BakedAnimation> bakedAnimation = BakedAnimation::Bake(clips, framesPerSecond);
+    if (!bakedAnimation) {
+        return Entity();
+    }
+
+    Entity entity = CreateEntity(source.GetName() + " Crowd");
+
+    // Start where the source stands, at its scale
+    auto& sourceTransform = source.GetComponent<TransformComponent>();
+    auto& transform = entity.GetComponent<TransformComponent>();
+    transform.localPosition = sourceTransform.GetWorldPosition(GetNativeRegistry());
+    transform.localScale = sourceTransform.GetWorldScale(GetNativeRegistry());
+    transform.localMatrixDirty = true;
+    transform.worldMatrixDirty = true;
+
+    auto& crowd = entity.AddComponent<CrowdComponent>();
+    crowd.model = ModelManager::Get().Acquire(modelComponent.model);
+    crowd.modelPath = modelComponent.modelPath;
+    crowd.shininess = modelComponent.shininess;
+    crowd.castShadows = modelComponent.castShadows;
+    crowd.bakedAnimation = bakedAnimation;
+    crowd.Scatter(count, spacing);
+
     return entity;
 }
 
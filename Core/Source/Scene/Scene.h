@@ -4,8 +4,11 @@
 #include "Registry.h"
 #include "Entity.h"
 #include "Camera/Camera.h"
+#include "Resources/AnimationPoseCache.h"
+#include "Resources/ModelManager.h"
 #include <vector>
 #include <string>
+#include <memory>
 
 namespace SockEngine {
 
@@ -29,6 +32,19 @@ public:
     Entity LoadModel(const std::string& filepath, const std::string& animation = "", const glm::vec3& position = glm::vec3(0.0f),
                      const glm::vec3& scale = glm::vec3(1.0f));
 
+    // Creates a placeholder entity right away and imports the model in the background
+    Entity LoadModelAsync(const std::string& filepath, const std::string& animation = "", const glm::vec3& position = glm::vec3(0.0f),
+                          const glm::vec3& scale = glm::vec3(1.0f));
+
+    // Imports a model in the background and attaches it to the entity once ready, replacing its current model
+    void RequestModel(Entity entity, const std::string& filepath, const std::string& animation = "");
+
+    // Stops the entity's background import. Placeholders without a model are destroyed.
+    void CancelModelLoad(Entity entity);
+
+    // Bakes the source's animations and creates a crowd of GPU-animated copies of its model
+    Entity CreateCrowd(Entity source, int count, float spacing, float framesPerSecond = 30.0f);
+
     // Entity queries
     Entity FindEntityByName(const std::string& name);
     std::vector<Entity> GetRootEntities();
@@ -49,6 +65,9 @@ public:
     // Hierarchy management
     void UpdateRelationship(Entity child, Entity parent);
 
+    // Palettes shared between animators this frame
+    const AnimationPoseCache& GetPoseCache() const { return m_PoseCache; }
+
 private:
     std::string m_Name;
     Camera m_EditorCamera;
@@ -62,9 +81,20 @@ private:
     // Editor state
     Entity m_SelectedEntity;
 
+    // Shared animation poses, rebuilt every update
+    AnimationPoseCache m_PoseCache;
+
     // Hierarchy management
     Entity DuplicateEntityHierarchy(Entity entity, Entity parent);
 
+    // Model loading helpers
+    Entity CreateModelEntity(const std::string& filepath, const glm::vec3& position, const glm::vec3& scale);
+    // Takes over the caller's reference on the model
+    void AttachModel(Entity entity, ModelHandle model, const std::string& filepath, const std::string& animation);
+
+    // Attaches the background imports that finished
+    void UpdatePendingModels();
+
     // Utility function to check if setting a new parent would create a cycle
     bool WouldCreateCycle(Entity child, Entity newParent);
 };
@@ -1,4 +1,7 @@
 #include "EditorApplication.h"
+#include "Resources/ModelManager.h"
+#include "Resources/TextureManager.h"
+#include "Resources/GeometryArena.h"
 #include <imgui/imgui.h>
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
@@ -31,13 +34,13 @@ EditorApplication::EditorApplication()
     m_Renderer->LoadSkybox(skyboxFaces);
     m_SkyboxEnabled = m_Renderer->IsSkyboxEnabled();
     
-    // Regular environment model
-    m_ActiveScene->LoadModel("../Assets/Models/sponza/sponza/Sponza.gltf");
+    // Regular environment model, imported in the background
+    m_ActiveScene->LoadModelAsync("../Assets/Models/sponza/sponza/Sponza.gltf");
 
     // Animated character model
-    m_ActiveScene->LoadModel("../Assets/Models/mannequin/mannequin.fbx",
+    m_ActiveScene->LoadModelAsync("../Assets/Models/mannequin/mannequin.fbx",
                             "../Assets/Models/mannequin/mannequin.fbx",
-                            glm::vec3(0, 1315, -300), glm::vec3(1, 1, 1));
+                                 glm::vec3(0, 1315, -300), glm::vec3(1, 1, 1));
 }
 
 EditorApplication::~EditorApplication() {
@@ -370,7 +373,9 @@ void EditorApplication::DrawEntityNode(Entity entity) {
     }
     
     // Begin the tree node
-    bool opened = ImGui::TreeNodeEx(nodeId.c_str(), flags, "%s", entity.GetName().c_str());
+    // Placeholders of background imports are marked until their model is attached
+    const char* loading = entity.HasComponent<PendingModelComponent>() ? " (Loading)" : "";
+    bool opened = ImGui::TreeNodeEx(nodeId.c_str(), flags, "%s%s", entity.GetName().c_str(), loading);
     
     // Handle selection when clicked
     if (ImGui::IsItemClicked(ImGuiMouseButton_Left)) {
@@ -525,10 +530,25 @@ void EditorApplication::DrawComponents(Entity entity) {
         DrawModelComponent(entity);
     }
 
+    // Draw the background import if one is running
+    if (registry.all_of<PendingModelComponent>(entityHandle)) {
+        DrawPendingModelComponent(entity);
+    }
+
     // Draw Animator component if present
     if (registry.all_of<AnimatorComponent>(entityHandle)) {
         DrawAnimatorComponent(entity);
     }
+
+    // Draw Morph Target component if present
+    if (registry.all_of<MorphTargetComponent>(entityHandle)) {
+        DrawMorphTargetComponent(entity);
+    }
+
+    // Draw Crowd component if present
+    if (registry.all_of<CrowdComponent>(entityHandle)) {
+        DrawCrowdComponent(entity);
+    }
 }
 
 void EditorApplication::DrawTransformComponent(Entity entity) {
@@ -602,18 +622,37 @@ void EditorApplication::DrawModelComponent(Entity entity) {
             modelComponent.receiveShadows = receiveShadows;
         }
         
-        // Load model button
-        if (ImGui::Button("Load Model")) {
-            // Currently, there is no file system, so a popup will be shown for now
-            ImGui::OpenPopup("ModelLoadNotSupported");
+        // Load model, imported in the background and swapped in once ready
+        ImGui::InputText("Model Path", m_ModelPath, sizeof(m_ModelPath));
+        ImGui::InputText("Animation Path", m_ModelAnimationPath, sizeof(m_ModelAnimationPath));
+        if (ImGui::Button("Load Model") && m_ModelPath[0] != '\0') {
+            m_ActiveScene->RequestModel(entity, m_ModelPath, m_ModelAnimationPath);
         }
-        
-        if (ImGui::BeginPopup("ModelLoadNotSupported")) {
-            ImGui::Text("Sorry, not implemented yet :(");
-            if (ImGui::Button("Close")) {
-                ImGui::CloseCurrentPopup();
-            }
-            ImGui::EndPopup();
+    }
+}
+
+void EditorApplication::DrawPendingModelComponent(Entity entity) {
+    if (ImGui::CollapsingHeader("Loading Model", ImGuiTreeNodeFlags_DefaultOpen)) {
+        auto& registry = m_ActiveScene->GetNativeRegistry();
+        auto entityHandle = static_cast<entt::entity>(entity);
+        auto& pendingComponent = registry.get<PendingModelComponent>(entityHandle);
+        ModelManager& modelManager = ModelManager::Get();
+
+        ImGui::Text("Model: %s", pendingComponent.modelPath.c_str());
+        if (!pendingComponent.animationPath.empty()) {
+            ImGui::Text("Animation: %s", pendingComponent.animationPath.c_str());
+        }
+
+        ModelLoader::State state = modelManager.GetState(pendingComponent.model);
+        const char* stage = state == ModelLoader::State::Importing ? "Importing" :
+                            state == ModelLoader::State::Uploading ? "Uploading" : "Finishing";
+        float progress = modelManager.GetProgress(pendingComponent.model);
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%s %.0f%%", stage, progress * 100.0f);
+        ImGui::ProgressBar(progress, ImVec2(-1.0f, 0.0f), overlay);
+
+        if (ImGui::Button("Cancel")) {
+            m_ActiveScene->CancelModelLoad(entity);
         }
     }
 }
@@ -627,9 +666,10 @@ void EditorApplication::DrawAnimatorComponent(Entity entity) {
         // Initialize animator if needed
         if (!animatorComponent.animator && registry.all_of<ModelComponent>(entityHandle)) {
             auto& modelComponent = registry.get<ModelComponent>(entityHandle);
-            if (modelComponent.model && !modelComponent.modelPath.empty()) {
+            Model* model = ModelManager::Get().Resolve(modelComponent.model);
+            if (model && !modelComponent.modelPath.empty()) {
                 // Try to initialize with the model file (assuming it contains animations)
-                animatorComponent.Initialize(modelComponent.model, modelComponent.modelPath);
+                animatorComponent.Initialize(*model, modelComponent.modelPath);
             }
         }
         
@@ -638,6 +678,7 @@ void EditorApplication::DrawAnimatorComponent(Entity entity) {
             ImGui::Text("Current Animation: %s", animatorComponent.currentAnimationName.c_str());
             ImGui::Text("Duration: %.0f ticks", animatorComponent.GetDuration());
             ImGui::Text("Current Tick: %.0f", animatorComponent.GetCurrentTime());
+            ImGui::Text("Keyframe Memory: %.1f KB", animatorComponent.currentAnimation->GetKeyframeMemory() / 1024.0f);
             
             // Progress bar
             float progress = animatorComponent.GetDuration() > 0.0f ? 
@@ -672,25 +713,95 @@ void EditorApplication::DrawAnimatorComponent(Entity entity) {
                 animatorComponent.SetPlaybackSpeed(speed);
             }
             
+            // Animation LOD
+            if (ImGui::TreeNode("Animation LOD")) {
+                const char* lodNames[] = { "Full", "Reduced", "Minimal", "Paused" };
+                ImGui::Text("Current LOD: %s", lodNames[static_cast<int>(animatorComponent.currentLOD)]);
+                ImGui::Checkbox("Enable LOD", &animatorComponent.enableLOD);
+                ImGui::DragFloat("Full Rate Distance", &animatorComponent.lodFullRateDistance, 10.0f, 0.0f, 100000.0f);
+                ImGui::DragFloat("Minimal Rate Distance", &animatorComponent.lodMinimalRateDistance, 10.0f, 0.0f, 100000.0f);
+                ImGui::SliderFloat("Reduced Rate (Hz)", &animatorComponent.lodReducedUpdateRate, 1.0f, 60.0f, "%.1f");
+                ImGui::SliderFloat("Minimal Rate (Hz)", &animatorComponent.lodMinimalUpdateRate, 0.5f, 30.0f, "%.1f");
+                ImGui::Checkbox("Pause When Invisible", &animatorComponent.pauseWhenInvisible);
+                ImGui::DragFloat("Bounding Radius", &animatorComponent.boundingRadius, 1.0f, 0.0f, 10000.0f);
+
+                // Skeleton LOD
+                int skeletonLevels = animatorComponent.skeletonLODs ? static_cast<int>(animatorComponent.skeletonLODs->size()) : 0;
+                int paletteSize = animatorComponent.animator ? static_cast<int>(animatorComponent.animator->m_FinalBoneMatrices.size()) : 0;
+                ImGui::Text("Skeleton LOD: %d / %d (%d bones)", animatorComponent.skeletonLOD, skeletonLevels, paletteSize);
+                ImGui::Checkbox("Enable Skeleton LOD", &animatorComponent.enableSkeletonLOD);
+                ImGui::DragFloat("Reduced Skeleton Distance", &animatorComponent.lodReducedSkeletonDistance, 10.0f, 0.0f, 100000.0f);
+                ImGui::DragFloat("Minimal Skeleton Distance", &animatorComponent.lodMinimalSkeletonDistance, 10.0f, 0.0f, 100000.0f);
+                ImGui::TreePop();
+            }
+            
+            // Shared pose cache
+            ImGui::Checkbox("Share Pose", &animatorComponent.sharePose);
+            if (animatorComponent.sharePose) {
+                float quantumMs = animatorComponent.sharedPoseQuantum * 1000.0f;
+                if (ImGui::SliderFloat("Pose Quantum (ms)", &quantumMs, 1.0f, 200.0f, "%.1f")) {
+                    animatorComponent.sharedPoseQuantum = quantumMs / 1000.0f;
+                }
+            }
+            
             // Animation selection
-            if (animatorComponent.animations.size() > 1) {
+            if (animatorComponent.animations.size() + animatorComponent.streamedAnimations.size() > 1) {
                 ImGui::Text("Available Animations:");
+                ImGui::SliderFloat("Crossfade (s)", &animatorComponent.crossfadeDuration, 0.0f, 2.0f, "%.2f");
                 
                 for (const auto& [name, animation] : animatorComponent.animations) {
                     bool isSelected = (name == animatorComponent.currentAnimationName);
                     
                     if (ImGui::Selectable(name.c_str(), isSelected)) {
                         if (!isSelected) {
-                            animatorComponent.PlayAnimation(name);
+                            animatorComponent.CrossfadeTo(name, animatorComponent.crossfadeDuration);
+                        }
+                    }
+                }
+
+                // Streamed clips show whether their keyframes are resident
+                for (const auto& [name, clip] : animatorComponent.streamedAnimations) {
+                    bool isSelected = (name == animatorComponent.currentAnimationName);
+                    std::string label = name + (clip->IsResident() ? " (Streamed)" : " (Streamed, Evicted)");
+                    
+                    if (ImGui::Selectable(label.c_str(), isSelected)) {
+                        if (!isSelected) {
+                            animatorComponent.CrossfadeTo(name, animatorComponent.crossfadeDuration);
                         }
                     }
                 }
             }
+
+            // Blend layers
+            if (animatorComponent.animator && !animatorComponent.animator->GetLayers().empty()) {
+                ImGui::Text("Layers:");
+                const auto& layers = animatorComponent.animator->GetLayers();
+                for (int i = 0; i < static_cast<int>(layers.size()); i++) {
+                    float weight = layers[i].weight;
+                    std::string label = "Layer " + std::to_string(i) + (layers[i].additive ? " (Additive)" : "");
+                    if (ImGui::SliderFloat(label.c_str(), &weight, 0.0f, 1.0f)) {
+                        animatorComponent.SetLayerWeight(i, weight);
+                    }
+                }
+            }
+            
+            // Bake the loaded clips into a GPU-animated crowd of this model
+            if (ImGui::TreeNode("Crowd")) {
+                ImGui::DragInt("Crowd Size", &m_CrowdSize, 10.0f, 1, 100000);
+                ImGui::DragFloat("Crowd Spacing", &m_CrowdSpacing, 1.0f, 0.0f, 10000.0f);
+                if (ImGui::Button("Bake Crowd")) {
+                    Entity crowd = m_ActiveScene->CreateCrowd(entity, m_CrowdSize, m_CrowdSpacing);
+                    if (crowd) {
+                        m_ActiveScene->SetSelectedEntity(crowd);
+                    }
+                }
+                ImGui::TreePop();
+            }
             
             // Animation loading
             if (ImGui::Button("Load Animation File")) {
                 auto& modelComponent = registry.get<ModelComponent>(entityHandle);
-                if (modelComponent.model) {
+                if (ModelManager::Get().Resolve(modelComponent.model)) {
                     // Currently, there is no file system, so a popup will be shown for now
                     ImGui::OpenPopup("AnimationLoadNotSupported");
                 }
@@ -712,8 +823,9 @@ void EditorApplication::DrawAnimatorComponent(Entity entity) {
                 auto& modelComponent = registry.get<ModelComponent>(entityHandle);
                 
                 if (ImGui::Button("Initialize with Model")) {
-                    if (modelComponent.model && !modelComponent.modelPath.empty()) {
-                        animatorComponent.Initialize(modelComponent.model, modelComponent.modelPath);
+                    Model* model = ModelManager::Get().Resolve(modelComponent.model);
+                    if (model && !modelComponent.modelPath.empty()) {
+                        animatorComponent.Initialize(*model, modelComponent.modelPath);
                     }
                 }
                 
@@ -725,6 +837,60 @@ void EditorApplication::DrawAnimatorComponent(Entity entity) {
     }
 }
 
+void EditorApplication::DrawMorphTargetComponent(Entity entity) {
+    if (ImGui::CollapsingHeader("Morph Targets", ImGuiTreeNodeFlags_DefaultOpen)) {
+        auto& registry = m_ActiveScene->GetNativeRegistry();
+        auto entityHandle = static_cast<entt::entity>(entity);
+        auto& morphComponent = registry.get<MorphTargetComponent>(entityHandle);
+
+        // Applied by the GPU skinning pass
+        if (!registry.all_of<AnimatorComponent>(entityHandle)) {
+            ImGui::TextDisabled("Needs an Animator component");
+        }
+
+        for (size_t i = 0; i < morphComponent.names.size(); i++) {
+            ImGui::SliderFloat(morphComponent.names[i].c_str(), &morphComponent.weights[i], 0.0f, 1.0f, "%.2f");
+        }
+
+        if (ImGui::Button("Reset Weights")) {
+            morphComponent.ResetWeights();
+        }
+    }
+}
+
+void EditorApplication::DrawCrowdComponent(Entity entity) {
+    if (ImGui::CollapsingHeader("Crowd", ImGuiTreeNodeFlags_DefaultOpen)) {
+        auto& registry = m_ActiveScene->GetNativeRegistry();
+        auto entityHandle = static_cast<entt::entity>(entity);
+        auto& crowdComponent = registry.get<CrowdComponent>(entityHandle);
+
+        ImGui::Text("Model: %s", crowdComponent.modelPath.c_str());
+        ImGui::Text("Instances: %zu", crowdComponent.instances.size());
+
+        // Baked clips
+        if (crowdComponent.bakedAnimation) {
+            const BakedAnimation& baked = *crowdComponent.bakedAnimation;
+            ImGui::Text("Baked Animation: %zu clips, %d bones, %.1f KB", baked.GetClips().size(), baked.GetBoneCount(),
+                        baked.GetMemory() / 1024.0f);
+            for (const auto& clip : baked.GetClips()) {
+                ImGui::BulletText("%s: %d frames at %.0f fps", clip.name.c_str(), clip.frameCount, clip.framesPerSecond);
+            }
+        }
+
+        // Playback, shared by every instance
+        ImGui::Checkbox("Playing", &crowdComponent.isPlaying);
+        ImGui::SliderFloat("Speed", &crowdComponent.playbackSpeed, 0.0f, 3.0f, "%.2fx");
+        ImGui::Checkbox("Cast Shadows", &crowdComponent.castShadows);
+
+        // Regenerate the instances
+        ImGui::DragInt("Crowd Size", &m_CrowdSize, 10.0f, 1, 100000);
+        ImGui::DragFloat("Crowd Spacing", &m_CrowdSpacing, 1.0f, 0.0f, 10000.0f);
+        if (ImGui::Button("Scatter")) {
+            crowdComponent.Scatter(m_CrowdSize, m_CrowdSpacing, static_cast<unsigned int>(crowdComponent.instanceVersion));
+        }
+    }
+}
+
 void EditorApplication::DrawAddComponentPopup(Entity entity) {
     if (!entity) {
         return;
@@ -809,6 +975,13 @@ void EditorApplication::DrawDebugPanel() {
         if (ImGui::Checkbox("Enable Skybox", &m_SkyboxEnabled)) {
             m_Renderer->EnableSkybox(m_SkyboxEnabled);
         }
+
+        if (m_Renderer->IsGPUSkinningSupported()) {
+            bool gpuSkinning = m_Renderer->IsGPUSkinningEnabled();
+            if (ImGui::Checkbox("GPU Skinning", &gpuSkinning)) {
+                m_Renderer->EnableGPUSkinning(gpuSkinning);
+            }
+        }
     }
     
     ImGui::Separator();
@@ -820,6 +993,73 @@ void EditorApplication::DrawDebugPanel() {
         ImGui::SliderFloat("Movement Speed", &camera.MovementSpeed, 100.0f, 8000.0f, "%.1f");
     }
 
+    ImGui::Separator();
+
+    // Animation statistics
+    if (ImGui::CollapsingHeader("Animation", ImGuiTreeNodeFlags_DefaultOpen)) {
+        const AnimationPoseCache& poseCache = m_ActiveScene->GetPoseCache();
+        ImGui::Text("Shared Poses: %zu evaluated, %zu reused", poseCache.GetPaletteCount(), poseCache.GetHitCount());
+        ImGui::Text("Cached Clips: %zu", AnimationLibrary::Get().GetClipCount());
+        AnimationStreamer& streamer = AnimationStreamer::Get();
+        ImGui::Text("Streamed Clips: %zu / %zu resident, %.2f / %.2f MB (heads %.2f MB)", streamer.GetResidentClipCount(),
+                    streamer.GetClipCount(), streamer.GetResidentMemory() / (1024.0f * 1024.0f),
+                    streamer.GetBudget() / (1024.0f * 1024.0f), streamer.GetHeadMemory() / (1024.0f * 1024.0f));
+        ImGui::Text("Clip Page-ins: %zu, Evictions: %zu", streamer.GetPageInCount(), streamer.GetEvictionCount());
+        float budgetMB = streamer.GetBudget() / (1024.0f * 1024.0f);
+        if (ImGui::SliderFloat("Clip Budget (MB)", &budgetMB, 1.0f, 512.0f, "%.0f")) {
+            streamer.SetBudget(static_cast<size_t>(budgetMB * 1024.0f * 1024.0f));
+        }
+        const BonePaletteBuffer* bonePalettes = m_Renderer->GetBonePalettes();
+        ImGui::Text("Bone Palettes: %zu / %zu matrices%s", bonePalettes->GetMatrixCount(), bonePalettes->GetCapacity(),
+                    bonePalettes->IsPersistent() ? "" : " (orphaned)");
+        if (m_Renderer->IsGPUSkinningEnabled() && m_Renderer->IsGPUSkinningSupported()) {
+            const SkinningPass* skinningPass = m_Renderer->GetSkinningPass();
+            ImGui::Text("GPU Skinned: %zu entities, %zu skipped, %zu vertices", skinningPass->GetInstanceCount(),
+                        skinningPass->GetSkippedInstanceCount(), skinningPass->GetSkinnedVertexCount());
+            ImGui::Text("Morph Targets: %zu active, %zu deltas", skinningPass->GetActiveMorphTargetCount(), skinningPass->GetMorphDeltaCount());
+        }
+        ImGui::Text("Animated Culled: %zu view, %zu shadow", m_Renderer->GetCulledAnimatedCount(), m_Renderer->GetCulledAnimatedShadowCount());
+        const CrowdPass* crowdPass = m_Renderer->GetCrowdPass();
+        ImGui::Text("Crowds: %zu, %zu instances", crowdPass->GetCrowdCount(), crowdPass->GetInstanceCount());
+        ModelLoader& modelLoader = ModelLoader::Get();
+        ImGui::Text("Model Loads: %zu, %.1f KB uploaded", modelLoader.GetLoadCount(), modelLoader.GetUploadedBytes() / 1024.0f);
+        float uploadBudgetMB = modelLoader.GetUploadBudget() / (1024.0f * 1024.0f);
+        if (ImGui::SliderFloat("Upload Budget (MB)", &uploadBudgetMB, 1.0f, 128.0f, "%.0f")) {
+            modelLoader.SetUploadBudget(static_cast<size_t>(uploadBudgetMB * 1024.0f * 1024.0f));
+        }
+        ModelManager& modelManager = ModelManager::Get();
+        ImGui::Text("Models: %zu cached, %zu unused, %zu shared", modelManager.GetModelCount(), modelManager.GetUnusedCount(),
+                    modelManager.GetHitCount());
+        float evictionDelay = modelManager.GetEvictionDelay();
+        if (ImGui::SliderFloat("Eviction Delay (s)", &evictionDelay, 0.0f, 60.0f, "%.0f")) {
+            modelManager.SetEvictionDelay(evictionDelay);
+        }
+        bool keepCollision = modelManager.GetMeshResidency() == MeshResidency::Collision;
+        if (ImGui::Checkbox("Keep Collision Meshes", &keepCollision)) {
+            modelManager.SetMeshResidency(keepCollision ? MeshResidency::Collision : MeshResidency::GpuOnly);
+        }
+        const GeometryArena& geometryArena = GeometryArena::Get();
+        ImGui::Text("Geometry: %zu blocks, %.1f / %.0f MB", geometryArena.GetBlockCount(),
+                    geometryArena.GetUsedSize() / (1024.0f * 1024.0f), geometryArena.GetCapacity() / (1024.0f * 1024.0f));
+        ImGui::Text("Mesh LODs: %zu / %zu triangles", m_Renderer->GetLODTriangleCount(), m_Renderer->GetFullTriangleCount());
+        float lodErrorThreshold = m_Renderer->GetMeshLODErrorThreshold();
+        if (ImGui::SliderFloat("LOD Error (px)", &lodErrorThreshold, 0.0f, 8.0f, "%.1f")) {
+            m_Renderer->SetMeshLODErrorThreshold(lodErrorThreshold);
+        }
+        const TextureManager& textureManager = TextureManager::Get();
+        ImGui::Text("Textures: %zu, %.1f / %.0f MB, %zu shared, %zu streaming, %zu mips evicted", textureManager.GetTextureCount(),
+                    textureManager.GetTextureMemory() / (1024.0f * 1024.0f), textureManager.GetMemoryBudget() / (1024.0f * 1024.0f),
+                    textureManager.GetHitCount(), textureManager.GetStreamingCount(), textureManager.GetEvictedLevelCount());
+        bool compressTextures = TextureManager::Get().IsCompressionEnabled();
+        if (ImGui::Checkbox("Compress Textures", &compressTextures)) {
+            TextureManager::Get().SetCompressionEnabled(compressTextures);
+        }
+        int textureBudget = static_cast<int>(textureManager.GetMemoryBudget() / (1024 * 1024));
+        if (ImGui::SliderInt("Texture Budget (MB)", &textureBudget, 32, 4096)) {
+            TextureManager::Get().SetMemoryBudget(static_cast<size_t>(textureBudget) * 1024 * 1024);
+        }
+    }
+
     ImGui::Separator();
     
     // Input debug info
@@ -80,10 +80,21 @@ private:
     void DrawComponents(Entity entity);
     void DrawTransformComponent(Entity entity);
     void DrawModelComponent(Entity entity);
+    void DrawPendingModelComponent(Entity entity);
     void DrawAnimatorComponent(Entity entity);
+    void DrawMorphTargetComponent(Entity entity);
+    void DrawCrowdComponent(Entity entity);
     void DrawAddComponentPopup(Entity entity);
 
     bool m_ShowAboutWindow = false;
+
+    // Paths typed into the model inspector
+    char m_ModelPath[256] = "";
+    char m_ModelAnimationPath[256] = "";
+
+    // Crowd baking settings
+    int m_CrowdSize = 1000;
+    float m_CrowdSpacing = 150.0f;
 };
 
 }
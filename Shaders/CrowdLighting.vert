@@ -0,0 +1,103 @@
+#version 460 core
+layout (location = 0) in vec4 aPos;          // Quantized position, w is the bitangent sign
+layout (location = 1) in vec2 aNormal;       // Octahedral
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec2 aTangent;      // Octahedral
+layout (location = 5) in uvec4 aBoneIDs;
+layout (location = 6) in vec4 aBoneWeights;
+layout (location = 7) in mat4 aInstanceMatrix;
+layout (location = 11) in vec4 aInstanceAnimation;
+
+out vec3 FragPos;
+out vec2 TexCoords;
+out mat3 TBN;
+out vec4 FragPosLightSpace;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 lightSpaceMatrix;
+
+// Maps the mesh's quantized positions to model space (see VertexPacking.h)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+const int MAX_BONE_INFLUENCE = 4;
+const uint NO_BONE = 255u;
+
+// Baked palettes, one row per frame and three texels per bone (see BakedAnimation.h)
+uniform sampler2D bakedAnimation;
+uniform float crowdTime;
+
+mat4 BakedBoneMatrix(int boneID, int frame)
+{
+    int x = boneID * 3;
+    vec4 row0 = texelFetch(bakedAnimation, ivec2(x, frame), 0);
+    vec4 row1 = texelFetch(bakedAnimation, ivec2(x + 1, frame), 0);
+    vec4 row2 = texelFetch(bakedAnimation, ivec2(x + 2, frame), 0);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0)
+        direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(direction);
+}
+
+void main()
+{
+    // Frame of this instance's clip, blending towards the next frame. Clips loop.
+    float frameCount = aInstanceAnimation.y;
+    float frame = mod((crowdTime + aInstanceAnimation.w) * aInstanceAnimation.z, frameCount);
+    int frame0 = int(aInstanceAnimation.x) + int(frame);
+    int frame1 = int(aInstanceAnimation.x) + int(mod(floor(frame) + 1.0, frameCount));
+    float frameBlend = fract(frame);
+
+    // Calculate the bone transformation matrix
+    int boneCount = textureSize(bakedAnimation, 0).x / 3;
+    mat4 boneTransform = mat4(0.0);
+    for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        if(aBoneIDs[i] == NO_BONE)
+        continue;
+        if(aBoneIDs[i] >= uint(boneCount))
+        {
+            boneTransform = mat4(1.0);
+            break;
+        }
+        boneTransform += BakedBoneMatrix(int(aBoneIDs[i]), frame0) * (aBoneWeights[i] * (1.0 - frameBlend));
+        boneTransform += BakedBoneMatrix(int(aBoneIDs[i]), frame1) * (aBoneWeights[i] * frameBlend);
+    }
+
+    // Apply bone transformation to vertex position
+    vec4 animatedPos = boneTransform * vec4(positionOffset + positionScale * aPos.xyz, 1.0);
+
+    // Transform to world space, instances are placed relative to the crowd entity
+    mat4 instanceModel = model * aInstanceMatrix;
+    vec4 worldPos = instanceModel * animatedPos;
+    FragPos = worldPos.xyz;
+    TexCoords = aTexCoords;
+
+    // Apply bone transformation to normal vectors
+    mat3 boneNormalMatrix = mat3(boneTransform);
+    vec3 animatedNormal = boneNormalMatrix * DecodeOctahedral(aNormal);
+    vec3 animatedTangent = boneNormalMatrix * DecodeOctahedral(aTangent);
+
+    // Calculate normal matrix and transform animated normals to world space
+    mat3 normalMatrix = transpose(inverse(mat3(instanceModel)));
+    vec3 T = normalize(normalMatrix * animatedTangent);
+    vec3 N = normalize(normalMatrix * animatedNormal);
+
+    // Re-orthogonalize T with respect to N
+    T = normalize(T - dot(T, N) * N);
+    // Then retrieve perpendicular vector B with the cross product of T and N while accounting for handedness
+    vec3 B = cross(N, T) * (aPos.w < 0.0 ? -1.0 : 1.0);
+    TBN = mat3(T, B, N);
+
+    // Calculate fragment position in light space for shadow mapping
+    FragPosLightSpace = lightSpaceMatrix * vec4(FragPos, 1.0);
+
+    gl_Position = projection * view * worldPos;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#version 460 core
+layout (location = 0) in vec4 aPos;          // Quantized position, w is the bitangent sign
+layout (location = 1) in vec2 aNormal;       // Octahedral
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec2 aTangent;      // Octahedral
+layout (location = 5) in uvec4 aBoneIDs;
+layout (location = 6) in vec4 aBoneWeights;
+layout (location = 7) in mat4 aInstanceMatrix;
+layout (location = 11) in vec4 aInstanceAnimation;
+
+uniform mat4 lightSpaceMatrix;
+uniform mat4 model;
+
+// Maps the mesh's quantized positions to model space (see VertexPacking.h)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+const int MAX_BONE_INFLUENCE = 4;
+const uint NO_BONE = 255u;
+
+// Baked palettes, one row per frame and three texels per bone (see BakedAnimation.h)
+uniform sampler2D bakedAnimation;
+uniform float crowdTime;
+
+mat4 BakedBoneMatrix(int boneID, int frame)
+{
+    int x = boneID * 3;
+    vec4 row0 = texelFetch(bakedAnimation, ivec2(x, frame), 0);
+    vec4 row1 = texelFetch(bakedAnimation, ivec2(x + 1, frame), 0);
+    vec4 row2 = texelFetch(bakedAnimation, ivec2(x + 2, frame), 0);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+void main()
+{
+    // Frame of this instance's clip, blending towards the next frame. Clips loop.
+    float frameCount = aInstanceAnimation.y;
+    float frame = mod((crowdTime + aInstanceAnimation.w) * aInstanceAnimation.z, frameCount);
+    int frame0 = int(aInstanceAnimation.x) + int(frame);
+    int frame1 = int(aInstanceAnimation.x) + int(mod(floor(frame) + 1.0, frameCount));
+    float frameBlend = fract(frame);
+
+    // Calculate the bone transformation matrix
+    int boneCount = textureSize(bakedAnimation, 0).x / 3;
+    mat4 boneTransform = mat4(0.0);
+    for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        if(aBoneIDs[i] == NO_BONE)
+        continue;
+        if(aBoneIDs[i] >= uint(boneCount))
+        {
+            boneTransform = mat4(1.0);
+            break;
+        }
+        boneTransform += BakedBoneMatrix(int(aBoneIDs[i]), frame0) * (aBoneWeights[i] * (1.0 - frameBlend));
+        boneTransform += BakedBoneMatrix(int(aBoneIDs[i]), frame1) * (aBoneWeights[i] * frameBlend);
+    }
+
+    // Apply bone transformation to vertex position
+    vec4 animatedPos = boneTransform * vec4(positionOffset + positionScale * aPos.xyz, 1.0);
+
+    gl_Position = lightSpaceMatrix * model * aInstanceMatrix * animatedPos;
+}
\ No newline at end of file
@@ -187,8 +187,9 @@ void main()
     vec4 specularMap = texture(material.texture_specular1, TexCoords);
 
     // Properties
-    vec3 normal = texture(material.texture_normal1, TexCoords).rgb;
-    normal = normal * 2.0 - 1.0;
+    // Normal maps may be stored as X and Y only (BC5), Z is rebuilt from the unit length
+    vec2 normalXY = texture(material.texture_normal1, TexCoords).rg * 2.0 - 1.0;
+    vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
     normal = normalize(TBN * normal);
     vec3 viewDir = normalize(viewPos - FragPos);
     float specOut = 0.0;
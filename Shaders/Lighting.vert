@@ -1,9 +1,8 @@
 #version 460 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;          // Quantized position, w is the bitangent sign
+layout (location = 1) in vec2 aNormal;       // Octahedral
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
+layout (location = 3) in vec2 aTangent;      // Octahedral
 
 out vec3 FragPos;
 out vec2 TexCoords;
@@ -15,19 +14,31 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform mat4 lightSpaceMatrix;
 
+// Maps the mesh's quantized positions to model space (see VertexPacking.h)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0)
+        direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(direction);
+}
+
 void main()
 {
-    vec4 worldPos = model * vec4(aPos, 1.0);
+    vec4 worldPos = model * vec4(positionOffset + positionScale * aPos.xyz, 1.0);
     FragPos = worldPos.xyz;
     TexCoords = aTexCoords;
 
     mat3 normalMatrix = transpose(inverse(mat3(model)));
-    vec3 T = normalize(normalMatrix * aTangent);
-    vec3 N = normalize(normalMatrix * aNormal);
+    vec3 T = normalize(normalMatrix * DecodeOctahedral(aTangent));
+    vec3 N = normalize(normalMatrix * DecodeOctahedral(aNormal));
     // Re-orthogonalize T with respect to N
     T = normalize(T - dot(T, N) * N);
     // Then retrieve perpendicular vector B with the cross product of T and N while accounting for handedness
-    vec3 B = cross(N, T) * (dot(cross(aNormal, aTangent), aBitangent) < 0.0 ? -1.0 : 1.0);
+    vec3 B = cross(N, T) * (aPos.w < 0.0 ? -1.0 : 1.0);
     TBN = mat3(T, B, N);
 
     // Calculate fragment position in light space for shadow mapping
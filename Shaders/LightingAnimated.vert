@@ -1,10 +1,9 @@
 #version 460 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;          // Quantized position, w is the bitangent sign
+layout (location = 1) in vec2 aNormal;       // Octahedral
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
-layout (location = 5) in ivec4 aBoneIDs;
+layout (location = 3) in vec2 aTangent;      // Octahedral
+layout (location = 5) in uvec4 aBoneIDs;
 layout (location = 6) in vec4 aBoneWeights;
 
 out vec3 FragPos;
@@ -16,9 +15,26 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 uniform mat4 lightSpaceMatrix;
-const int MAX_BONES = 100;
+
+// Maps the mesh's quantized positions to model space (see VertexPacking.h)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+const uint NO_BONE = 255u;
+
+// Palettes of every animated entity, written once per frame
+layout (std430, binding = 2) readonly buffer BoneMatrices { mat4 finalBonesMatrices[]; };
+uniform int boneOffset;     // First matrix of this entity's palette
+uniform int boneCount;
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0.0)
+        direction.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(direction);
+}
 
 void main()
 {
@@ -26,18 +42,18 @@ void main()
     mat4 boneTransform = mat4(0.0);
     for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
     {
-        if(aBoneIDs[i] == -1)
+        if(aBoneIDs[i] == NO_BONE)
         continue;
-        if(aBoneIDs[i] >= MAX_BONES)
+        if(aBoneIDs[i] >= uint(boneCount))
         {
             boneTransform = mat4(1.0);
             break;
         }
-        boneTransform += finalBonesMatrices[aBoneIDs[i]] * aBoneWeights[i];
+        boneTransform += finalBonesMatrices[boneOffset + int(aBoneIDs[i])] * aBoneWeights[i];
     }
 
     // Apply bone transformation to vertex position
-    vec4 animatedPos = boneTransform * vec4(aPos, 1.0);
+    vec4 animatedPos = boneTransform * vec4(positionOffset + positionScale * aPos.xyz, 1.0);
 
     // Transform to world space
     vec4 worldPos = model * animatedPos;
@@ -46,9 +62,8 @@ void main()
 
     // Apply bone transformation to normal vectors
     mat3 boneNormalMatrix = mat3(boneTransform);
-    vec3 animatedNormal = boneNormalMatrix * aNormal;
-    vec3 animatedTangent = boneNormalMatrix * aTangent;
-    vec3 animatedBitangent = boneNormalMatrix * aBitangent;
+    vec3 animatedNormal = boneNormalMatrix * DecodeOctahedral(aNormal);
+    vec3 animatedTangent = boneNormalMatrix * DecodeOctahedral(aTangent);
 
     // Calculate normal matrix and transform animated normals to world space
     mat3 normalMatrix = transpose(inverse(mat3(model)));
@@ -58,7 +73,7 @@ void main()
     // Re-orthogonalize T with respect to N
     T = normalize(T - dot(T, N) * N);
     // Then retrieve perpendicular vector B with the cross product of T and N while accounting for handedness
-    vec3 B = cross(N, T) * (dot(cross(animatedNormal, animatedTangent), animatedBitangent) < 0.0 ? -1.0 : 1.0);
+    vec3 B = cross(N, T) * (aPos.w < 0.0 ? -1.0 : 1.0);
     TBN = mat3(T, B, N);
 
     // Calculate fragment position in light space for shadow mapping
@@ -1,14 +1,17 @@
 #version 460 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;          // Quantized position, w is the bitangent sign
+layout (location = 1) in vec2 aNormal;       // Octahedral
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
+layout (location = 3) in vec2 aTangent;      // Octahedral
 
 uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
 
+// Maps the mesh's quantized positions to model space (see VertexPacking.h)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    gl_Position = lightSpaceMatrix * model * vec4(positionOffset + positionScale * aPos.xyz, 1.0);
 }
\ No newline at end of file
@@ -1,17 +1,25 @@
 #version 460 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;          // Quantized position, w is the bitangent sign
+layout (location = 1) in vec2 aNormal;       // Octahedral
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
-layout (location = 5) in ivec4 aBoneIDs;
+layout (location = 3) in vec2 aTangent;      // Octahedral
+layout (location = 5) in uvec4 aBoneIDs;
 layout (location = 6) in vec4 aBoneWeights;
 
 uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
-const int MAX_BONES = 100;
+
+// Maps the mesh's quantized positions to model space (see VertexPacking.h)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+const uint NO_BONE = 255u;
+
+// Palettes of every animated entity, written once per frame
+layout (std430, binding = 2) readonly buffer BoneMatrices { mat4 finalBonesMatrices[]; };
+uniform int boneOffset;     // First matrix of this entity's palette
+uniform int boneCount;
 
 void main()
 {
@@ -19,18 +27,18 @@ void main()
     mat4 boneTransform = mat4(0.0);
     for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
     {
-        if(aBoneIDs[i] == -1)
+        if(aBoneIDs[i] == NO_BONE)
         continue;
-        if(aBoneIDs[i] >= MAX_BONES)
+        if(aBoneIDs[i] >= uint(boneCount))
         {
             boneTransform = mat4(1.0);
             break;
         }
-        boneTransform += finalBonesMatrices[aBoneIDs[i]] * aBoneWeights[i];
+        boneTransform += finalBonesMatrices[boneOffset + int(aBoneIDs[i])] * aBoneWeights[i];
     }
 
     // Apply bone transformation to vertex position
-    vec4 animatedPos = boneTransform * vec4(aPos, 1.0);
+    vec4 animatedPos = boneTransform * vec4(positionOffset + positionScale * aPos.xyz, 1.0);
 
     gl_Position = lightSpaceMatrix * model * animatedPos;
 }
\ No newline at end of file